@@ -1,15 +1,22 @@
 #!/usr/bin/python3
+import argparse
+import random
 import socket
+import struct
 import cv2
 import numpy as np
 import threading
 import time
-from queue import Queue, Empty
+from queue import Queue, Empty, Full
 
 # --- 設定 ---
 BIND_IP = "0.0.0.0"
 PORT = 50000          # 受信するポート番号（1つのみ）
 BUFFER_SIZE = 65535
+CODEC = "jpeg"        # "jpeg" または "h264" (--codec で変更)
+LOSS_RATE = 0.0       # 受信パケットをわざと捨てる割合 (--loss で変更、FEC / 再送の確認用)
+USE_NACK = True       # 欠けたチャンクの再送を要求する (--no-nack で無効)
+MULTICAST_GROUP = None  # 参加するマルチキャストグループ (--group で指定)
 
 DISPLAY_FPS = 30
 DISPLAY_INTERVAL = 1.0 / DISPLAY_FPS
@@ -18,73 +25,365 @@ WINDOW_NAME = "Video Stream"
 running = True
 
 # UDP → JPEGバイト列（常に最新1枚）
+# H.264は参照フレームを落とせないため main() で深いキューに差し替える
 raw_queue = Queue(maxsize=1)
 
 # JPEG → デコード済み画像（常に最新1枚）
 frame_queue = Queue(maxsize=1)
 
-# 分割パケット再構成用バッファ
-frame_buffer = bytearray()
+# --- フレーム分割パケットのヘッダ (src/include/network/frame_packet.hpp と同じ形式) ---
+FRAME_HEADER = struct.Struct("!HBBHHHHIIQ")
+FRAME_MAGIC = 0x5746
+FRAME_VERSION = 1
+FRAME_FLAG_PARITY = 0x02    # XORパリティパケット (chunk_index = グループ番号)
+
+MAX_PENDING_FRAMES = 4      # 同時に再構成中にしておくフレーム数
+FRAME_TIMEOUT = 0.5         # 最後のパケットからこの時間 [s] 経っても揃わないフレームは捨てる
+
+# --- 再送要求 (NACK、src/include/network/frame_packet.hpp と同じ形式) ---
+NACK_HEADER = struct.Struct("!HBBHHI")
+NACK_MAGIC = 0x574E
+NACK_MAX_CHUNKS = 512
+NACK_DELAY = 0.01           # 後続フレームが来ていなくても、この時間 [s] 更新が無ければ要求する
+NACK_RETRY_INTERVAL = 0.02  # 同じフレームへの再要求の間隔 [s]
+NACK_MAX_RETRIES = 2        # 1フレームあたりの最大要求回数
+NACK_CHECK_INTERVAL = 0.005 # 欠落を調べる間隔 [s]
+
+
+class FrameAssembler:
+    """フレームID毎にチャンクを集め、全チャンクが揃ったフレームだけを返す
+
+    パリティパケットがあれば、グループ内で1個だけ欠けたチャンクを XOR で復元する
+    """
+
+    def __init__(self):
+        self.pending = {}           # (stream_id, frame_id) -> dict
+        self.last_frame_id = {}     # stream_id -> 最後に完成させたフレームID
+        self.newest_frame_id = {}   # stream_id -> 受信した中で最も新しいフレームID
+        self.completed = 0
+        self.discarded = 0
+        self.recovered = 0
+
+    def push(self, data):
+        """データグラム1個を取り込み、完成したフレーム (stream_id, frame_id, timestamp_us, bytes) を返す"""
+        if len(data) < FRAME_HEADER.size:
+            return None
+
+        (magic, version, flags, stream_id, chunk_index, chunk_count, parity_groups,
+         frame_id, total_size, timestamp_us) = FRAME_HEADER.unpack_from(data)
+
+        if magic != FRAME_MAGIC or version != FRAME_VERSION:
+            return None
+        if chunk_count == 0 or chunk_index >= chunk_count:
+            return None
+
+        # 完成済み以前のフレームに遅れて届いたパケット (余ったパリティ等) は捨てる (32bit の一周を考慮)
+        last = self.last_frame_id.get(stream_id)
+        if last is not None and not 0 < ((frame_id - last) & 0xFFFFFFFF) < 0x80000000:
+            return None
+
+        key = (stream_id, frame_id)
+        entry = self.pending.get(key)
+        if entry is None:
+            entry = {
+                "chunks": [None] * chunk_count,
+                "received": 0,
+                "parity": {},       # グループ番号 -> パリティ
+                "groups": 0,        # パリティのグループ数
+                "total_size": total_size,
+                "timestamp_us": timestamp_us,
+                "updated": time.monotonic(),
+                "nacks": 0,         # 再送要求した回数
+                "last_nack": 0.0,
+            }
+            self.pending[key] = entry
+            self._evict(stream_id)
+            if key not in self.pending:
+                return None
+
+        if chunk_count != len(entry["chunks"]):
+            return None
+
+        payload = data[FRAME_HEADER.size:]
+        entry["updated"] = time.monotonic()
+
+        newest = self.newest_frame_id.get(stream_id)
+        if newest is None or 0 < ((frame_id - newest) & 0xFFFFFFFF) < 0x80000000:
+            self.newest_frame_id[stream_id] = frame_id
+
+        if flags & FRAME_FLAG_PARITY:
+            if parity_groups == 0 or chunk_index >= parity_groups:
+                return None
+            entry["groups"] = parity_groups
+            entry["parity"][chunk_index] = payload
+            self._recover(entry, chunk_index)
+        else:
+            if entry["chunks"][chunk_index] is None:
+                entry["chunks"][chunk_index] = payload
+                entry["received"] += 1
+            if entry["groups"]:
+                self._recover(entry, chunk_index % entry["groups"])
+
+        if entry["received"] != chunk_count:
+            return None
+
+        del self.pending[key]
+        frame = b"".join(entry["chunks"])
+        if len(frame) != entry["total_size"]:
+            self.discarded += 1
+            return None
+
+        # これより古い未完成フレームはもう表示しないので捨てる
+        for old in [k for k in self.pending
+                    if k[0] == stream_id and ((k[1] - frame_id) & 0xFFFFFFFF) >= 0x80000000]:
+            del self.pending[old]
+            self.discarded += 1
+
+        self.last_frame_id[stream_id] = frame_id
+        self.completed += 1
+        return stream_id, frame_id, entry["timestamp_us"], frame
+
+    def nack_requests(self, now):
+        """再送を要求すべきフレームの (stream_id, frame_id, 欠けたチャンク番号) を返す"""
+        requests = []
+        for (stream_id, frame_id), entry in self.pending.items():
+            if entry["nacks"] >= NACK_MAX_RETRIES or now - entry["last_nack"] < NACK_RETRY_INTERVAL:
+                continue
+
+            # 後続フレームが届き始めた = このフレームの送信は終わっている
+            newer_seen = self.newest_frame_id.get(stream_id, frame_id) != frame_id
+            if not newer_seen and now - entry["updated"] < NACK_DELAY:
+                continue
+
+            missing = [i for i, c in enumerate(entry["chunks"]) if c is None]
+            if not missing:
+                continue
+
+            entry["nacks"] += 1
+            entry["last_nack"] = now
+            requests.append((stream_id, frame_id, missing[:NACK_MAX_CHUNKS]))
+        return requests
+
+    def _recover(self, entry, group):
+        """グループ内で欠けているチャンクが1個だけなら、パリティとの XOR で復元する"""
+        parity = entry["parity"].get(group)
+        if parity is None:
+            return
+
+        chunks = entry["chunks"]
+        count = len(chunks)
+        members = range(group, count, entry["groups"])
+        missing = [i for i in members if chunks[i] is None]
+        if len(missing) != 1:
+            return
+
+        index = missing[0]
+        chunk_size = len(parity)
+        if index < count - 1:
+            length = chunk_size
+        else:
+            length = entry["total_size"] - (count - 1) * chunk_size
+        if not 0 < length <= chunk_size:
+            return
+
+        acc = np.frombuffer(parity, dtype=np.uint8).copy()
+        for i in members:
+            if i != index:
+                acc[:len(chunks[i])] ^= np.frombuffer(chunks[i], dtype=np.uint8)
+
+        chunks[index] = acc[:length].tobytes()
+        entry["received"] += 1
+        self.recovered += 1
+
+    def _evict(self, stream_id):
+        """タイムアウトしたフレームと、上限を超えた古いフレームを捨てる"""
+        now = time.monotonic()
+        for key in [k for k, e in self.pending.items() if now - e["updated"] > FRAME_TIMEOUT]:
+            del self.pending[key]
+            self.discarded += 1
+
+        base = self.last_frame_id.get(stream_id, 0)
+        keys = sorted((k for k in self.pending if k[0] == stream_id),
+                      key=lambda k: (k[1] - base) & 0xFFFFFFFF)
+        while len(keys) > MAX_PENDING_FRAMES:
+            del self.pending[keys.pop(0)]
+            self.discarded += 1
+
+
+def join_multicast(sock):
+    """--group 指定時、受信ソケットをマルチキャストグループに参加させる"""
+    if MULTICAST_GROUP is None:
+        return
+    mreq = struct.pack("4s4s", socket.inet_aton(MULTICAST_GROUP), socket.inet_aton("0.0.0.0"))
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_ADD_MEMBERSHIP, mreq)
+    print(f"[UDP] Joined multicast group {MULTICAST_GROUP}")
 
 
 def udp_listener():
     """UDPパケットを受信し、JPEGデータを再構成するスレッド"""
     global running
-    
+
     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
     # 受信バッファを大きめに設定
     sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
     sock.settimeout(1.0)
 
+    assembler = FrameAssembler()
+    last_report = time.monotonic()
+    last_nack_check = 0.0
+    sender_addr = None
+    nacks_sent = 0
+    if USE_NACK:
+        sock.settimeout(NACK_CHECK_INTERVAL)
+
     try:
         sock.bind((BIND_IP, PORT))
+        join_multicast(sock)
         print(f"[UDP] Listening on port {PORT}")
 
         while running:
+            result = None
             try:
-                data, _ = sock.recvfrom(BUFFER_SIZE)
-                if len(data) < 2:
-                    continue
+                data, sender_addr = sock.recvfrom(BUFFER_SIZE)
+                if LOSS_RATE <= 0.0 or random.random() >= LOSS_RATE:
+                    result = assembler.push(data)
+            except socket.timeout:
+                pass
+
+            now = time.monotonic()
+
+            # 欠けたチャンクの再送を送信元 (送信ソケット) に要求する
+            if USE_NACK and sender_addr is not None and now - last_nack_check >= NACK_CHECK_INTERVAL:
+                for stream_id, frame_id, missing in assembler.nack_requests(now):
+                    nack = NACK_HEADER.pack(NACK_MAGIC, FRAME_VERSION, 0, stream_id, len(missing), frame_id)
+                    sock.sendto(nack + struct.pack(f"!{len(missing)}H", *missing), sender_addr)
+                    nacks_sent += 1
+                last_nack_check = now
+
+            if now - last_report >= 5.0:
+                print(f"[UDP] frames completed {assembler.completed}, "
+                      f"discarded (incomplete) {assembler.discarded}, "
+                      f"chunks recovered by FEC {assembler.recovered}, "
+                      f"NACKs sent {nacks_sent}")
+                last_report = now
+
+            if result is None:
+                continue
+
+            # 欠けたフレームは捨てるので、表示側は直前のフレームを出し続ける
+            _, _, _, jpeg_data = result
+
+            # 最新フレームのみをキューに入れる（古いのは捨てる）
+            if raw_queue.full():
+                try:
+                    raw_queue.get_nowait()
+                except Empty:
+                    pass
+            raw_queue.put_nowait(jpeg_data)
+
+    finally:
+        sock.close()
+
 
-                # 先頭1バイトをフラグとして使用
-                flag = data[0]
-                payload = data[1:]
+def rtp_h264_listener():
+    """RTP(RFC 6184)パケットを受信し、H.264アクセスユニットを再構成するスレッド"""
+    global running
 
-                # バッファに追記
-                frame_buffer.extend(payload)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+    sock.settimeout(1.0)
 
-                # フラグが1ならフレーム終了（JPEG完成）
-                if flag == 1:
-                    jpeg_data = bytes(frame_buffer)
-                    frame_buffer.clear()
+    start_code = b"\x00\x00\x00\x01"
+    access_unit = bytearray()
+    expected_seq = None
+    broken = False   # FU-A途中の欠落など、現在のアクセスユニットが壊れているか
 
-                    # 最新フレームのみをキューに入れる（古いのは捨てる）
-                    if raw_queue.full():
-                        raw_queue.get_nowait()
-                    raw_queue.put_nowait(jpeg_data)
+    try:
+        sock.bind((BIND_IP, PORT))
+        join_multicast(sock)
+        print(f"[RTP] Listening on port {PORT} (H.264)")
 
+        while running:
+            try:
+                data, _ = sock.recvfrom(BUFFER_SIZE)
             except socket.timeout:
                 continue
-            except Exception as e:
-                print(f"[UDP] Error: {e}")
-                frame_buffer.clear()
+
+            if len(data) < 13 or (data[0] >> 6) != 2:
+                continue
+
+            marker = data[1] >> 7
+            seq = struct.unpack("!H", data[2:4])[0]
+            cc = data[0] & 0x0F
+            payload = data[12 + 4 * cc:]
+
+            if expected_seq is not None and seq != expected_seq:
+                broken = True
+            expected_seq = (seq + 1) & 0xFFFF
+
+            nal_type = payload[0] & 0x1F
+
+            if 1 <= nal_type <= 23:
+                # Single NAL Unit
+                access_unit += start_code + payload
+            elif nal_type == 24:
+                # STAP-A
+                pos = 1
+                while pos + 2 <= len(payload):
+                    size = struct.unpack("!H", payload[pos:pos + 2])[0]
+                    access_unit += start_code + payload[pos + 2:pos + 2 + size]
+                    pos += 2 + size
+            elif nal_type == 28 and len(payload) > 2:
+                # FU-A
+                fu_header = payload[1]
+                if fu_header & 0x80:
+                    nal_header = (payload[0] & 0xE0) | (fu_header & 0x1F)
+                    access_unit += start_code + bytes([nal_header])
+                access_unit += payload[2:]
+
+            if marker:
+                if not broken and access_unit:
+                    try:
+                        raw_queue.put(bytes(access_unit), timeout=0.5)
+                    except Full:
+                        pass
+                access_unit.clear()
+                broken = False
 
     finally:
         sock.close()
 
 
 def decode_worker():
-    """受信したJPEGデータをデコードするスレッド"""
+    """受信したJPEG / H.264データをデコードするスレッド"""
     global running
 
+    h264_decoder = None
+    if CODEC == "h264":
+        import av   # PyAV (pip install av)
+        h264_decoder = av.CodecContext.create("h264", "r")
+
     while running:
         try:
-            # キューからJPEGデータを取得
-            jpeg_data = raw_queue.get(timeout=0.5)
-            
+            # キューから圧縮データを取得
+            encoded = raw_queue.get(timeout=0.5)
+
             # デコード処理
-            np_data = np.frombuffer(jpeg_data, dtype=np.uint8)
-            frame = cv2.imdecode(np_data, cv2.IMREAD_COLOR)
+            if h264_decoder is not None:
+                frame = None
+                try:
+                    for packet in h264_decoder.parse(encoded):
+                        for decoded in h264_decoder.decode(packet):
+                            frame = decoded.to_ndarray(format="bgr24")
+                except Exception as e:
+                    # キーフレーム到着前などは復号できないので読み飛ばす
+                    print(f"[Decode] H.264 error: {e}")
+                    continue
+                if frame is None:
+                    continue
+            else:
+                np_data = np.frombuffer(encoded, dtype=np.uint8)
+                frame = cv2.imdecode(np_data, cv2.IMREAD_COLOR)
 
             if frame is not None:
                 # デコード済み画像をキューへ
@@ -101,14 +400,35 @@ def decode_worker():
 
 
 def main():
-    global running
+    global running, PORT, CODEC, LOSS_RATE, USE_NACK, MULTICAST_GROUP, raw_queue
+
+    parser = argparse.ArgumentParser(description="Debug video stream receiver")
+    parser.add_argument("--port", type=int, default=PORT, help="receive port")
+    parser.add_argument("--codec", choices=["jpeg", "h264"], default=CODEC,
+                        help="stream codec (jpeg: chunked MJPEG, h264: RTP/H.264)")
+    parser.add_argument("--loss", type=float, default=LOSS_RATE,
+                        help="drop this fraction of received datagrams (FEC / retransmission test)")
+    parser.add_argument("--no-nack", action="store_true", help="do not request retransmission")
+    parser.add_argument("--group", default=MULTICAST_GROUP,
+                        help="join this multicast group (sender dest_ip / extra_dest_ips)")
+    args = parser.parse_args()
+
+    PORT = args.port
+    CODEC = args.codec
+    LOSS_RATE = args.loss
+    USE_NACK = not args.no_nack
+    MULTICAST_GROUP = args.group
+
+    if CODEC == "h264":
+        raw_queue = Queue(maxsize=64)
 
     print("Starting Receiver (Single Stream)...")
 
     threads = []
 
     # 1. UDP受信スレッド起動
-    t_udp = threading.Thread(target=udp_listener, daemon=True)
+    listener = rtp_h264_listener if CODEC == "h264" else udp_listener
+    t_udp = threading.Thread(target=listener, daemon=True)
     threads.append(t_udp)
     t_udp.start()
 
@@ -0,0 +1,25 @@
+#!/bin/bash
+
+# pipeline_bench を今のコミット名で実行し、bench_results/<コミット>.json に保存する
+# 使い方: script/pipeline_bench.sh [記録ディレクトリ等] [pipeline_bench の追加オプション...]
+# 例:     script/pipeline_bench.sh recordings/20261017_101500 --iterations 200
+
+cd "$(dirname "$0")/.." || exit 1
+
+label=$(git rev-parse --short HEAD)
+if ! git diff --quiet HEAD; then
+    label="${label}-dirty"
+fi
+
+frames=()
+if [[ $# -gt 0 && $1 != --* ]]; then
+    frames=(--frames "$1")
+    shift
+fi
+
+mkdir -p bench_results
+
+./bin/pipeline_bench "${frames[@]}" --model train_data/best.onnx --label "$label" \
+    --output "bench_results/${label}.json" "$@" || exit 1
+
+echo "bench_results/${label}.json"
@@ -10,4 +10,5 @@ gdb valgrind strace ltrace linux-perf \
 clang-format clang-tidy cppcheck \
 doxygen graphviz \
 ffmpeg tcpdump wireshark \
+libavcodec-dev libavutil-dev libswscale-dev \
 libturbojpeg0-dev
@@ -0,0 +1,251 @@
+/**
+ * @file    mailbox_bench.cpp
+ * @brief   エンコードスレッドから送信スレッドへのフレーム受け渡しの遅延を測るマイクロベンチマーク
+ * @details
+ * 1フレーム分のバッファ (std::vector) を一定間隔で送信スレッド役へ渡し、
+ * 呼び出し側が受け渡しに使った時間 (enqueue) と、渡してから受け取り側が取り出すまでの時間 (handoff) を
+ * 平均 / p50 / p99 / 最大で表示する。
+ * 従来の std::mutex + std::condition_variable + std::queue と、
+ * UDPSenderThread が使う SpscRing + EventWaiter (eventfd) を同じ条件で比較する。
+ * 受け取り側は取り出したフレームを busy_us だけ処理 (空回り) してから次を待つ。
+ *
+ * 使い方: mailbox_bench [フレーム数] [間隔(us)] [処理時間(us)]
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "network/spsc_ring.hpp"
+#include "network/event_waiter.hpp"
+
+#define DEFAULT_FRAME_COUNT 20000       /**< 既定の受け渡しフレーム数 */
+#define DEFAULT_INTERVAL_US 200         /**< 既定の受け渡し間隔 [us] */
+#define DEFAULT_BUSY_US 50              /**< 既定の受け取り側の処理時間 [us] */
+#define FRAME_SIZE 280000               /**< 受け渡すバッファの大きさ [byte] (JPEG 1枚相当) */
+#define MAILBOX_SIZE 8                  /**< SpscRing の容量 */
+
+/**
+ * @brief 受け渡す1フレーム
+ */
+struct Message {
+    std::vector<uint8_t> data;          /**< フレームのバッファ */
+    std::chrono::steady_clock::time_point sent_at;  /**< 渡した時刻 */
+};
+
+/**
+ * @brief 1方式分の計測結果
+ */
+struct Result {
+    std::vector<double> enqueue_us;     /**< 呼び出し側が受け渡しに使った時間 [us] */
+    std::vector<double> handoff_us;     /**< 渡してから取り出されるまでの時間 [us] */
+    uint64_t dropped = 0;               /**< 受け取られずに捨てられたフレーム数 */
+};
+
+static double elapsed_us(std::chrono::steady_clock::time_point from, std::chrono::steady_clock::time_point to)
+{
+    return std::chrono::duration<double, std::micro>(to - from).count();
+}
+
+/**
+ * @brief 受け取り側の処理を模して busy_us だけ空回りする
+ */
+static void spin_for(int busy_us)
+{
+    const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(busy_us);
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+/**
+ * @brief 従来方式: std::mutex + std::condition_variable + std::queue (最新1枚以外は捨てる)
+ */
+static Result run_mutex_queue(int frame_count, int interval_us, int busy_us)
+{
+    Result result;
+    result.enqueue_us.reserve(frame_count);
+    result.handoff_us.reserve(frame_count);
+
+    std::mutex mutex;
+    std::condition_variable cond_var;
+    std::queue<Message> queue;
+    bool running = true;
+
+    std::thread consumer([&]() {
+        while (true) {
+            Message message;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond_var.wait(lock, [&]() { return !queue.empty() || !running; });
+                if (queue.empty()) {
+                    break;
+                }
+                message = std::move(queue.front());
+                queue.pop();
+            }
+
+            result.handoff_us.push_back(elapsed_us(message.sent_at, std::chrono::steady_clock::now()));
+            spin_for(busy_us);
+        }
+    });
+
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < frame_count; ++i) {
+        Message message;
+        message.data.resize(FRAME_SIZE);
+
+        const auto t0 = std::chrono::steady_clock::now();
+        message.sent_at = t0;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            while (!queue.empty()) {
+                queue.pop();
+                result.dropped += 1;
+            }
+            queue.push(std::move(message));
+        }
+        cond_var.notify_one();
+        result.enqueue_us.push_back(elapsed_us(t0, std::chrono::steady_clock::now()));
+
+        next += std::chrono::microseconds(interval_us);
+        std::this_thread::sleep_until(next);
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        running = false;
+    }
+    cond_var.notify_one();
+    consumer.join();
+
+    return result;
+}
+
+/**
+ * @brief UDPSenderThread の方式: SpscRing + EventWaiter (満杯なら新しいフレーム、溜まっていたら古いフレームを捨てる)
+ */
+static Result run_spsc_ring(int frame_count, int interval_us, int busy_us)
+{
+    Result result;
+    result.enqueue_us.reserve(frame_count);
+    result.handoff_us.reserve(frame_count);
+
+    SpscRing<Message> ring(MAILBOX_SIZE);
+    EventWaiter wakeup;
+    std::atomic<bool> running(true);
+
+    std::atomic<uint64_t> stale(0);
+
+    std::thread consumer([&]() {
+        while (true) {
+            Message message;
+
+            wakeup.wait(-1, [&]() { return !ring.empty() || !running.load(std::memory_order_acquire); });
+
+            if (!ring.try_pop(message)) {
+                if (!running.load(std::memory_order_acquire)) {
+                    break;
+                }
+                continue;
+            }
+
+            // UDPSenderThread (方針 latest) と同じく、溜まっていたら最新だけを使う
+            Message newer;
+            while (ring.try_pop(newer)) {
+                message = std::move(newer);
+                stale.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            result.handoff_us.push_back(elapsed_us(message.sent_at, std::chrono::steady_clock::now()));
+            spin_for(busy_us);
+        }
+    });
+
+    auto next = std::chrono::steady_clock::now();
+    for (int i = 0; i < frame_count; ++i) {
+        Message message;
+        message.data.resize(FRAME_SIZE);
+
+        const auto t0 = std::chrono::steady_clock::now();
+        message.sent_at = t0;
+        if (ring.try_push(message)) {
+            wakeup.notify();
+        } else {
+            result.dropped += 1;
+        }
+        result.enqueue_us.push_back(elapsed_us(t0, std::chrono::steady_clock::now()));
+
+        next += std::chrono::microseconds(interval_us);
+        std::this_thread::sleep_until(next);
+    }
+
+    running.store(false, std::memory_order_release);
+    wakeup.notify();
+    consumer.join();
+
+    result.dropped += stale.load(std::memory_order_relaxed);
+
+    return result;
+}
+
+/**
+ * @brief 計測値の平均 / p50 / p99 / 最大を表示する
+ */
+static void report_times(const char* name, const char* label, std::vector<double>& times_us)
+{
+    std::sort(times_us.begin(), times_us.end());
+
+    double total = 0.0;
+    for (double t : times_us) {
+        total += t;
+    }
+
+    const size_t n = times_us.size();
+    const double avg = n ? total / n : 0.0;
+    const double p50 = n ? times_us[n / 2] : 0.0;
+    const double p99 = n ? times_us[std::min(n - 1, n * 99 / 100)] : 0.0;
+    const double max = n ? times_us[n - 1] : 0.0;
+
+    std::printf("%-12s %-8s avg %8.2f us  p50 %8.2f us  p99 %8.2f us  max %9.2f us\n",
+                name, label, avg, p50, p99, max);
+}
+
+int main(int argc, char** argv)
+{
+    const int frame_count = (argc > 1) ? std::atoi(argv[1]) : DEFAULT_FRAME_COUNT;
+    const int interval_us = (argc > 2) ? std::atoi(argv[2]) : DEFAULT_INTERVAL_US;
+    const int busy_us = (argc > 3) ? std::atoi(argv[3]) : DEFAULT_BUSY_US;
+
+    if (frame_count <= 0 || interval_us < 0 || busy_us < 0) {
+        std::fprintf(stderr, "usage: %s [frame_count] [interval_us] [busy_us]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%d frames, interval %d us, consumer work %d us\n", frame_count, interval_us, busy_us);
+
+    {
+        Result result = run_mutex_queue(frame_count, interval_us, busy_us);
+        report_times("mutex+cv", "enqueue", result.enqueue_us);
+        report_times("", "handoff", result.handoff_us);
+        std::printf("%-12s dropped %lu\n", "", static_cast<unsigned long>(result.dropped));
+    }
+
+    {
+        Result result = run_spsc_ring(frame_count, interval_us, busy_us);
+        report_times("spsc+eventfd", "enqueue", result.enqueue_us);
+        report_times("", "handoff", result.handoff_us);
+        std::printf("%-12s dropped %lu\n", "", static_cast<unsigned long>(result.dropped));
+    }
+
+    return 0;
+}
@@ -0,0 +1,461 @@
+/**
+ * @file    pipeline_bench.cpp
+ * @brief   上カメラの処理を段階毎に計測し、結果を JSON で出すベンチマーク
+ * @details
+ * 記録・保存したフレーム (FileFrameSource で読めるもの。指定しなければテストパターン) を起動時に --max-frames 枚まで読み込み、
+ * 次の段階を1つずつ、同じフレームを順に回しながら計測する。各段階の入力は計測の外で前の段階から作っておくので、
+ * 段階同士は影響しない (前の段階のキャッシュの温まり方だけは実際のパイプラインと異なる)。
+ *
+ * | 段階              | 計測する処理                                            |
+ * |-------------------|---------------------------------------------------------|
+ * | yuyv_to_bgr       | cv::cvtColor (COLOR_YUV2BGR_YUYV、全解像度)             |
+ * | blob_from_image   | ImageProcessor::prepare_input (cv::dnn::blobFromImage)  |
+ * | forward           | ImageProcessor::run_inference (net_.forward)            |
+ * | decode_nms        | ImageProcessor::decode_detections (YOLO 出力の変換 + NMS) |
+ * | draw_results      | ImageProcessor::draw_results (全解像度)                 |
+ * | bgr_to_jpeg       | JpegEncoder::encode (TurboJPEG)                         |
+ * | udp_send          | UDPSender::send (ループバック、sendmmsg)                |
+ *
+ * JSON は標準出力 (--output で指定したファイル) に、読みやすい要約は標準エラーに出す。
+ * --label にコミットのハッシュ等を入れておくと、コミット毎の結果を並べて比べられる (script/pipeline_bench.sh)。
+ *
+ * 使い方: pipeline_bench [--frames PATH] [--size WxH] [--model PATH] [--iterations N] [--warmup N]
+ *                        [--max-frames N] [--quality Q] [--threads N] [--label TEXT] [--output FILE]
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <linux/videodev2.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <opencv2/core.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include "camera/frame_source.hpp"
+#include "image_processor/image_processor.hpp"
+#include "image_processor/video_encoder.hpp"
+#include "image_processor/yuyv_convert.hpp"
+#include "network/udp_sender.hpp"
+
+#define DEFAULT_MODEL_PATH "../train_data/best.onnx"   /**< main と同じモデル */
+#define DEFAULT_WIDTH 1280              /**< テストパターン・YUYV ファイルの既定の横幅 (config.yaml と同じ) */
+#define DEFAULT_HEIGHT 960              /**< テストパターン・YUYV ファイルの既定の高さ */
+#define DEFAULT_ITERATIONS 100          /**< 既定の1段階あたりの計測回数 */
+#define DEFAULT_WARMUP 5                /**< 既定の計測前に捨てる回数 */
+#define DEFAULT_MAX_FRAMES 32           /**< 既定の読み込むフレーム数の上限 */
+#define DEFAULT_JPEG_QUALITY 90         /**< 既定の JPEG 品質 (config.yaml と同じ) */
+#define BENCH_PORT 50124                /**< udp_send の送信先ポート (ループバック) */
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief コマンドライン引数
+ */
+struct Options {
+    std::string frames_path;            /**< 再生するファイル・ディレクトリ (空 = テストパターン) */
+    uint32_t width = DEFAULT_WIDTH;
+    uint32_t height = DEFAULT_HEIGHT;
+    std::string model_path = DEFAULT_MODEL_PATH;
+    int iterations = DEFAULT_ITERATIONS;
+    int warmup = DEFAULT_WARMUP;
+    size_t max_frames = DEFAULT_MAX_FRAMES;
+    int jpeg_quality = DEFAULT_JPEG_QUALITY;
+    int threads = -1;                   /**< OpenCV のスレッド数 (負 = 変えない) */
+    std::string label;                  /**< JSON に入れる名前 (コミットのハッシュ等) */
+    std::string output_path;            /**< JSON の出力先 (空 = 標準出力) */
+};
+
+/**
+ * @brief 1フレーム分の各段階の入力 (前の段階の結果)
+ */
+struct BenchFrame {
+    std::vector<uint8_t> yuyv;
+    uint32_t width = 0;
+    uint32_t height = 0;
+    cv::Mat bgr;
+    std::vector<cv::Mat> outputs;
+    std::vector<ImageProcessor::ResistorInfo> resistors;
+    std::vector<uint8_t> jpeg;
+};
+
+/**
+ * @brief 1段階分の計測結果
+ */
+struct StageResult {
+    std::string name;
+    std::vector<double> times_us;
+    std::vector<std::pair<std::string, double>> extra;  /**< 段階毎の補足 (平均の出力サイズ等) */
+};
+
+/**
+ * @brief fn(frame) を warmup + iterations 回、フレームを順に回して呼び、後ろの iterations 回を計測する
+ * @param[in] prepare 計測しない下準備 (nullptr = なし)
+ */
+static StageResult run_stage(const char* name,
+                             std::vector<BenchFrame>& frames,
+                             const Options& options,
+                             const std::function<void(BenchFrame&)>& prepare,
+                             const std::function<void(BenchFrame&)>& fn)
+{
+    StageResult result;
+    result.name = name;
+    result.times_us.reserve(options.iterations);
+
+    for (int i = 0; i < options.warmup + options.iterations; ++i) {
+        BenchFrame& frame = frames[i % frames.size()];
+
+        if (prepare) {
+            prepare(frame);
+        }
+
+        const auto start = Clock::now();
+        fn(frame);
+        const auto end = Clock::now();
+
+        if (i >= options.warmup) {
+            result.times_us.push_back(std::chrono::duration<double, std::micro>(end - start).count());
+        }
+    }
+
+    return result;
+}
+
+/**
+ * @brief フレームを読み込み、全て YUYV にそろえる (MJPEG はデコードしてから変換する)
+ */
+static bool load_frames(const Options& options, std::vector<BenchFrame>& frames)
+{
+    std::unique_ptr<FrameSource> source;
+    if (options.frames_path.empty()) {
+        source = std::make_unique<SyntheticFrameSource>(
+            options.width, options.height, FramePacer::Mode::AS_FAST_AS_POSSIBLE, 0.0);
+    } else {
+        source = std::make_unique<FileFrameSource>(
+            options.frames_path, options.width, options.height, FramePacer::Mode::AS_FAST_AS_POSSIBLE, 0.0, false);
+    }
+
+    if (!source->initialize()) {
+        return false;
+    }
+
+    FrameSource::Frame frame;
+    while (frames.size() < options.max_frames && source->dequeue_frame(frame)) {
+        BenchFrame bench;
+
+        if (frame.fourcc == V4L2_PIX_FMT_MJPEG) {
+            const cv::Mat jpeg(1, static_cast<int>(frame.size), CV_8UC1, frame.data);
+            const cv::Mat bgr = cv::imdecode(jpeg, cv::IMREAD_COLOR);
+            if (bgr.empty() || bgr.cols < 2) {
+                source->release_frame(frame);
+                continue;
+            }
+
+            bench.width = static_cast<uint32_t>(bgr.cols) & ~1u;
+            bench.height = static_cast<uint32_t>(bgr.rows);
+            bench.yuyv.resize(static_cast<size_t>(bench.width) * bench.height * 2);
+            bgr_to_yuyv(bgr.data, bgr.step, bench.width, bench.height, bench.yuyv.data());
+        } else {
+            bench.width = frame.width;
+            bench.height = frame.height;
+            bench.yuyv.assign(frame.data, frame.data + frame.size);
+        }
+
+        source->release_frame(frame);
+        frames.push_back(std::move(bench));
+    }
+
+    return !frames.empty();
+}
+
+/**
+ * @brief 計測値を並べ替え、分位点を返す
+ */
+static double percentile(const std::vector<double>& sorted, double ratio)
+{
+    if (sorted.empty()) {
+        return 0.0;
+    }
+
+    const size_t index = std::min(sorted.size() - 1, static_cast<size_t>(sorted.size() * ratio));
+
+    return sorted[index];
+}
+
+/**
+ * @brief JSON の文字列としてエスケープする
+ */
+static std::string json_string(const std::string& text)
+{
+    std::string out = "\"";
+    for (const char c : text) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out += escaped;
+        } else {
+            out += c;
+        }
+    }
+    out += "\"";
+
+    return out;
+}
+
+/**
+ * @brief 結果を JSON で書き出し、要約を標準エラーに出す
+ */
+static void report(FILE* out,
+                   const Options& options,
+                   const std::vector<BenchFrame>& frames,
+                   std::vector<StageResult>& results)
+{
+    char timestamp[32];
+    const time_t now = time(nullptr);
+    struct tm utc;
+    gmtime_r(&now, &utc);
+    strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", &utc);
+
+    std::fprintf(out, "{\n");
+    std::fprintf(out, "  \"label\": %s,\n", json_string(options.label).c_str());
+    std::fprintf(out, "  \"timestamp\": \"%s\",\n", timestamp);
+    std::fprintf(out, "  \"frames\": {\"source\": %s, \"count\": %zu, \"width\": %u, \"height\": %u},\n",
+                 json_string(options.frames_path.empty() ? "synthetic" : options.frames_path).c_str(),
+                 frames.size(), frames[0].width, frames[0].height);
+    std::fprintf(out, "  \"model\": %s,\n", json_string(options.model_path).c_str());
+    std::fprintf(out, "  \"iterations\": %d,\n", options.iterations);
+    std::fprintf(out, "  \"warmup\": %d,\n", options.warmup);
+    std::fprintf(out, "  \"jpeg_quality\": %d,\n", options.jpeg_quality);
+    std::fprintf(out, "  \"opencv\": {\"version\": \"%s\", \"threads\": %d},\n", CV_VERSION, cv::getNumThreads());
+    std::fprintf(out, "  \"stages\": [\n");
+
+    std::fprintf(stderr, "%-16s %10s %10s %10s %10s %10s\n", "stage", "mean us", "p50 us", "p90 us", "p99 us", "max us");
+
+    for (size_t i = 0; i < results.size(); ++i) {
+        StageResult& result = results[i];
+        std::sort(result.times_us.begin(), result.times_us.end());
+
+        double total = 0.0;
+        for (const double t : result.times_us) {
+            total += t;
+        }
+
+        const size_t n = result.times_us.size();
+        const double mean = n ? total / n : 0.0;
+        const double p50 = percentile(result.times_us, 0.50);
+        const double p90 = percentile(result.times_us, 0.90);
+        const double p99 = percentile(result.times_us, 0.99);
+        const double min = n ? result.times_us.front() : 0.0;
+        const double max = n ? result.times_us.back() : 0.0;
+
+        std::fprintf(out, "    {\"name\": %s, \"samples\": %zu, \"mean_us\": %.3f, \"p50_us\": %.3f, "
+                          "\"p90_us\": %.3f, \"p99_us\": %.3f, \"min_us\": %.3f, \"max_us\": %.3f",
+                     json_string(result.name).c_str(), n, mean, p50, p90, p99, min, max);
+        for (const auto& extra : result.extra) {
+            std::fprintf(out, ", %s: %.3f", json_string(extra.first).c_str(), extra.second);
+        }
+        std::fprintf(out, "}%s\n", (i + 1 < results.size()) ? "," : "");
+
+        std::fprintf(stderr, "%-16s %10.1f %10.1f %10.1f %10.1f %10.1f\n",
+                     result.name.c_str(), mean, p50, p90, p99, max);
+    }
+
+    std::fprintf(out, "  ]\n");
+    std::fprintf(out, "}\n");
+}
+
+/**
+ * @brief コマンドライン引数を読む
+ * @return true 成功 / false 不正な引数
+ */
+static bool parse_options(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--frames" && has_value) {
+            options.frames_path = argv[++i];
+        } else if (arg == "--size" && has_value) {
+            if (std::sscanf(argv[++i], "%ux%u", &options.width, &options.height) != 2) {
+                return false;
+            }
+        } else if (arg == "--model" && has_value) {
+            options.model_path = argv[++i];
+        } else if (arg == "--iterations" && has_value) {
+            options.iterations = std::atoi(argv[++i]);
+        } else if (arg == "--warmup" && has_value) {
+            options.warmup = std::atoi(argv[++i]);
+        } else if (arg == "--max-frames" && has_value) {
+            options.max_frames = std::strtoul(argv[++i], nullptr, 10);
+        } else if (arg == "--quality" && has_value) {
+            options.jpeg_quality = std::atoi(argv[++i]);
+        } else if (arg == "--threads" && has_value) {
+            options.threads = std::atoi(argv[++i]);
+        } else if (arg == "--label" && has_value) {
+            options.label = argv[++i];
+        } else if (arg == "--output" && has_value) {
+            options.output_path = argv[++i];
+        } else {
+            return false;
+        }
+    }
+
+    return options.iterations > 0 && options.warmup >= 0 && options.max_frames > 0
+        && options.jpeg_quality >= 1 && options.jpeg_quality <= 100;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::fprintf(stderr,
+                     "usage: %s [--frames PATH] [--size WxH] [--model PATH] [--iterations N] [--warmup N]"
+                     " [--max-frames N] [--quality Q] [--threads N] [--label TEXT] [--output FILE]\n", argv[0]);
+        return 1;
+    }
+
+    if (access(options.model_path.c_str(), R_OK) != 0) {
+        std::fprintf(stderr, "model %s not found (--model)\n", options.model_path.c_str());
+        return 1;
+    }
+
+    if (options.threads >= 0) {
+        cv::setNumThreads(options.threads);
+    }
+
+    std::vector<BenchFrame> frames;
+    if (!load_frames(options, frames)) {
+        std::fprintf(stderr, "no frames in %s\n",
+                     options.frames_path.empty() ? "synthetic source" : options.frames_path.c_str());
+        return 1;
+    }
+
+    // 各段階が全てのフレームを1回以上処理するよう (次の段階の入力がそろうよう)、回数より多いフレームは使わない
+    if (frames.size() > static_cast<size_t>(options.warmup + options.iterations)) {
+        frames.resize(options.warmup + options.iterations);
+    }
+
+    ImageProcessor processor(options.model_path, options.jpeg_quality, 0);
+    JpegEncoder encoder(options.jpeg_quality);
+
+    // udp_send の受け手。読まずに溜めると取りこぼすだけなので、計測の外で読み捨てる
+    const int receiver_fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(BENCH_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (receiver_fd < 0 || bind(receiver_fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        std::perror("bind");
+        return 1;
+    }
+    int recvbuf_size = 16 * 1024 * 1024;
+    setsockopt(receiver_fd, SOL_SOCKET, SO_RCVBUF, &recvbuf_size, sizeof(recvbuf_size));
+
+    UDPSender sender("127.0.0.1", BENCH_PORT);
+
+    std::vector<StageResult> results;
+    uint64_t detections = 0;
+    uint64_t jpeg_bytes = 0;
+    uint32_t frame_id = 0;
+
+    // 各段階の入力を前の段階の結果から作りながら、段階毎に計測する
+    results.push_back(run_stage("yuyv_to_bgr", frames, options, nullptr, [](BenchFrame& frame) {
+        const cv::Mat yuyv(frame.height, frame.width, CV_8UC2, frame.yuyv.data());
+        cv::cvtColor(yuyv, frame.bgr, cv::COLOR_YUV2BGR_YUYV);
+    }));
+
+    results.push_back(run_stage("blob_from_image", frames, options, nullptr, [&](BenchFrame& frame) {
+        processor.prepare_input(frame.bgr);
+    }));
+
+    std::vector<cv::Mat> outputs;
+    results.push_back(run_stage("forward", frames, options,
+                                [&](BenchFrame& frame) { processor.prepare_input(frame.bgr); },
+                                [&](BenchFrame&) { processor.run_inference(outputs); }));
+
+    // 出力はネットワーク内のバッファを指しているので、フレーム毎に推論し直して複製しておく
+    for (BenchFrame& frame : frames) {
+        processor.prepare_input(frame.bgr);
+        processor.run_inference(outputs);
+
+        frame.outputs.clear();
+        for (const cv::Mat& output : outputs) {
+            frame.outputs.push_back(output.clone());
+        }
+        if (frame.outputs.empty()) {
+            std::fprintf(stderr, "model %s produced no output\n", options.model_path.c_str());
+            return 1;
+        }
+    }
+
+    results.push_back(run_stage("decode_nms", frames, options, nullptr, [&](BenchFrame& frame) {
+        processor.decode_detections(frame.outputs[0], frame.bgr.cols, frame.bgr.rows, frame.resistors);
+    }));
+    for (const BenchFrame& frame : frames) {
+        detections += frame.resistors.size();
+    }
+    results.back().extra.emplace_back("detections_per_frame", static_cast<double>(detections) / frames.size());
+
+    // 描画は画像を書き換えるので、毎回描く前の画像に戻してから描く
+    cv::Mat canvas;
+    results.push_back(run_stage("draw_results", frames, options,
+                                [&](BenchFrame& frame) { frame.bgr.copyTo(canvas); },
+                                [&](BenchFrame& frame) { processor.draw_results(canvas, frame.resistors, 1.0); }));
+
+    results.push_back(run_stage("bgr_to_jpeg", frames, options, nullptr, [&](BenchFrame& frame) {
+        bool is_keyframe = false;
+        encoder.encode(frame.bgr, frame.jpeg, is_keyframe);
+    }));
+    for (const BenchFrame& frame : frames) {
+        jpeg_bytes += frame.jpeg.size();
+    }
+    results.back().extra.emplace_back("bytes_per_frame", static_cast<double>(jpeg_bytes) / frames.size());
+
+    std::vector<uint8_t> drain(65536);
+    results.push_back(run_stage("udp_send", frames, options,
+                                [&](BenchFrame&) {
+                                    while (recv(receiver_fd, drain.data(), drain.size(), MSG_DONTWAIT) > 0) {
+                                    }
+                                },
+                                [&](BenchFrame& frame) {
+                                    sender.send(frame.jpeg.data(), frame.jpeg.size(), frame_id++, 0);
+                                }));
+
+    close(receiver_fd);
+
+    FILE* out = stdout;
+    if (!options.output_path.empty()) {
+        out = std::fopen(options.output_path.c_str(), "w");
+        if (out == nullptr) {
+            std::perror(options.output_path.c_str());
+            return 1;
+        }
+    }
+
+    report(out, options, frames, results);
+
+    if (out != stdout) {
+        std::fclose(out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,283 @@
+/**
+ * @file    reactor_bench.cpp
+ * @brief   キャプチャ待ちの方式毎に、起床遅延・1フレームあたりのシステムコール回数・コンテキストスイッチ回数を測るマイクロベンチマーク
+ * @details
+ * カメラの代わりに、別スレッドが一定間隔で eventfd に書き込む (= V4L2 のバッファが1枚埋まる)。
+ * 受け取り側は fd が読み込み可能になったら eventfd を読み (= VIDIOC_DQBUF)、書き込みから読み込みまでの時間を記録する。
+ * 従来の main (poll を 1000 ms のタイムアウトで呼び、フレーム間でだけ終了フラグを見る) と、
+ * IoReactor の io_uring / epoll を同じ条件で比較する。IoReactor には main と同じ 1000 ms の監視タイマも登録する。
+ * 最後にフレームが止まった状態で別スレッドから終了を要求し、ループを抜けるまでの時間も測る。
+ *
+ * 使い方: reactor_bench [フレーム数] [間隔(us)]
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstdlib>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "event_loop/io_reactor.hpp"
+
+#define DEFAULT_FRAME_COUNT 5000        /**< 既定のフレーム数 */
+#define DEFAULT_INTERVAL_US 2000        /**< 既定のフレーム間隔 [us] */
+#define POLL_TIMEOUT_MS 1000            /**< 従来方式の poll のタイムアウト [ms] (main と同じ) */
+#define WATCHDOG_MS 1000                /**< IoReactor に登録する監視タイマの周期 [ms] (main と同じ) */
+#define STOP_DELAY_MS 50                /**< 最後のフレームから終了を要求するまでの時間 [ms] */
+
+using Clock = std::chrono::steady_clock;
+
+/**
+ * @brief 1方式分の計測結果
+ */
+struct Result {
+    std::vector<double> latency_us;     /**< 書き込みから読み込みまでの時間 [us] */
+    uint64_t syscalls = 0;              /**< 受け取り側が使ったシステムコールの回数 */
+    uint64_t context_switches = 0;      /**< 受け取り側スレッドのコンテキストスイッチ回数 */
+    double shutdown_ms = 0.0;           /**< 終了要求からループを抜けるまでの時間 [ms] */
+};
+
+/**
+ * @brief カメラ役: 一定間隔で eventfd に書き込むスレッド
+ */
+class FakeCamera {
+public:
+    FakeCamera(int frame_count, int interval_us)
+        : fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+          frame_count_(frame_count),
+          interval_us_(interval_us),
+          written_at_ns_(0)
+    {
+    }
+
+    ~FakeCamera()
+    {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        if (fd_ >= 0) {
+            close(fd_);
+        }
+    }
+
+    int fd() const { return fd_; }
+
+    void start()
+    {
+        thread_ = std::thread([this]() {
+            auto next = Clock::now();
+
+            for (int i = 0; i < frame_count_; ++i) {
+                next += std::chrono::microseconds(interval_us_);
+                std::this_thread::sleep_until(next);
+
+                written_at_ns_.store(Clock::now().time_since_epoch().count(), std::memory_order_release);
+
+                const uint64_t one = 1;
+                ssize_t ret = write(fd_, &one, sizeof(one));
+                (void)ret;
+            }
+        });
+    }
+
+    /**
+     * @brief 1フレーム取り出し、書き込みからの経過時間を返す (無ければ負)
+     */
+    double dequeue()
+    {
+        uint64_t count = 0;
+        if (read(fd_, &count, sizeof(count)) != sizeof(count)) {
+            return -1.0;
+        }
+
+        const int64_t written = written_at_ns_.load(std::memory_order_acquire);
+        return (Clock::now().time_since_epoch().count() - written) / 1000.0;
+    }
+
+    void join()
+    {
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+    }
+
+private:
+    int fd_;
+    int frame_count_;
+    int interval_us_;
+    std::atomic<int64_t> written_at_ns_;
+    std::thread thread_;
+};
+
+static uint64_t thread_context_switches()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_THREAD, &usage);
+
+    return static_cast<uint64_t>(usage.ru_nvcsw + usage.ru_nivcsw);
+}
+
+/**
+ * @brief 最後のフレームの後、少し待ってから別スレッドで終了を要求する
+ */
+template <typename StopFunction>
+static std::thread request_stop_later(FakeCamera& camera, Clock::time_point& requested_at, StopFunction stop)
+{
+    return std::thread([&camera, &requested_at, stop]() {
+        camera.join();
+        std::this_thread::sleep_for(std::chrono::milliseconds(STOP_DELAY_MS));
+
+        requested_at = Clock::now();
+        stop();
+    });
+}
+
+/**
+ * @brief 従来方式: poll(1000 ms) → 読み込み、フレーム間で終了フラグを見る
+ */
+static Result run_poll(int frame_count, int interval_us)
+{
+    Result result;
+    result.latency_us.reserve(frame_count);
+
+    FakeCamera camera(frame_count, interval_us);
+    std::atomic<bool> stop_requested(false);
+    Clock::time_point requested_at;
+
+    const uint64_t switches_before = thread_context_switches();
+    camera.start();
+    std::thread stopper = request_stop_later(camera, requested_at, [&]() { stop_requested.store(true); });
+
+    while (!stop_requested.load()) {
+        struct pollfd pfd;
+        pfd.fd = camera.fd();
+        pfd.events = POLLIN;
+        pfd.revents = 0;
+
+        result.syscalls += 1;
+        if (poll(&pfd, 1, POLL_TIMEOUT_MS) <= 0) {
+            continue;
+        }
+
+        result.syscalls += 1;
+        const double latency = camera.dequeue();
+        if (latency >= 0.0) {
+            result.latency_us.push_back(latency);
+        }
+    }
+
+    result.shutdown_ms = std::chrono::duration<double, std::milli>(Clock::now() - requested_at).count();
+    result.context_switches = thread_context_switches() - switches_before;
+    stopper.join();
+
+    return result;
+}
+
+/**
+ * @brief IoReactor: fd の読み込み可能通知 + 監視タイマ、終了は stop() で起こす
+ */
+static Result run_reactor(IoReactor::Backend backend, int frame_count, int interval_us, bool& supported)
+{
+    Result result;
+    result.latency_us.reserve(frame_count);
+
+    IoReactor reactor(backend);
+    supported = reactor.is_valid() && reactor.backend() == backend;
+    if (!supported) {
+        return result;
+    }
+
+    FakeCamera camera(frame_count, interval_us);
+    Clock::time_point requested_at;
+    uint64_t reads = 0;
+
+    reactor.add_reader(camera.fd(), [&]() {
+        reads += 1;
+        const double latency = camera.dequeue();
+        if (latency >= 0.0) {
+            result.latency_us.push_back(latency);
+        }
+    });
+    reactor.add_timer(WATCHDOG_MS, []() {});
+
+    const uint64_t switches_before = thread_context_switches();
+    camera.start();
+    std::thread stopper = request_stop_later(camera, requested_at, [&]() { reactor.stop(); });
+
+    reactor.run();
+
+    result.shutdown_ms = std::chrono::duration<double, std::milli>(Clock::now() - requested_at).count();
+    result.context_switches = thread_context_switches() - switches_before;
+    result.syscalls = reactor.stats().syscalls + reads;
+    stopper.join();
+
+    return result;
+}
+
+/**
+ * @brief 計測結果を表示する
+ */
+static void report(const char* name, Result& result, int frame_count)
+{
+    std::vector<double>& times = result.latency_us;
+    std::sort(times.begin(), times.end());
+
+    double total = 0.0;
+    for (double t : times) {
+        total += t;
+    }
+
+    const size_t n = times.size();
+    const double avg = n ? total / n : 0.0;
+    const double p50 = n ? times[n / 2] : 0.0;
+    const double p99 = n ? times[std::min(n - 1, n * 99 / 100)] : 0.0;
+    const double max = n ? times[n - 1] : 0.0;
+
+    std::printf("%-9s wake avg %7.1f us  p50 %7.1f us  p99 %7.1f us  max %8.1f us | "
+                "%5.2f syscalls/frame  %5.2f ctxsw/frame | shutdown %7.1f ms (%zu/%d frames)\n",
+                name, avg, p50, p99, max,
+                static_cast<double>(result.syscalls) / frame_count,
+                static_cast<double>(result.context_switches) / frame_count,
+                result.shutdown_ms, n, frame_count);
+}
+
+int main(int argc, char** argv)
+{
+    const int frame_count = (argc > 1) ? std::atoi(argv[1]) : DEFAULT_FRAME_COUNT;
+    const int interval_us = (argc > 2) ? std::atoi(argv[2]) : DEFAULT_INTERVAL_US;
+
+    if (frame_count <= 0 || interval_us <= 0) {
+        std::fprintf(stderr, "usage: %s [frame_count] [interval_us]\n", argv[0]);
+        return 1;
+    }
+
+    std::printf("%d frames, interval %d us\n", frame_count, interval_us);
+
+    {
+        Result result = run_poll(frame_count, interval_us);
+        report("poll", result, frame_count);
+    }
+
+    const IoReactor::Backend backends[] = { IoReactor::Backend::EPOLL, IoReactor::Backend::IO_URING };
+    for (IoReactor::Backend backend : backends) {
+        bool supported = false;
+        Result result = run_reactor(backend, frame_count, interval_us, supported);
+
+        if (!supported) {
+            std::printf("%-9s not supported on this kernel\n", IoReactor::backend_name(backend));
+            continue;
+        }
+        report(IoReactor::backend_name(backend), result, frame_count);
+    }
+
+    return 0;
+}
@@ -0,0 +1,368 @@
+/**
+ * @file    udp_send_bench.cpp
+ * @brief   UDPSender の送信性能を測るマイクロベンチマーク
+ * @details
+ * ループバック上に受信スレッド (recvmmsg) を立て、1フレーム分のデータを
+ * 繰り返し送信して、1フレームあたりのシステムコール回数・データグラム数と
+ * 送信時間 (平均 / p50 / p99) を表示する。
+ * UDPSender の送信方式 (sendmsg / sendmmsg / io_uring / gso / gso+MSG_ZEROCOPY) 毎に計測し、比較用に従来の送信方式
+ * （1チャンク毎に sendmsg、10パケット毎に 100us スリープ）も同じ条件で計測する。
+ * 最後にレート制限 (トークンバケット) 付きの gso を計測し、送信時間がレートから決まることを確かめる。
+ *
+ * 使い方: udp_send_bench [frame_size_bytes] [frame_count]
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <unistd.h>
+#include <poll.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "network/udp_sender.hpp"
+
+#define BENCH_PORT 50123                /**< 受信側ポート */
+#define DEFAULT_FRAME_SIZE 280000       /**< 既定のフレームサイズ [byte] (JPEG 1枚相当) */
+#define DEFAULT_FRAME_COUNT 500         /**< 既定の送信フレーム数 */
+#define LEGACY_CHUNK_SIZE 1400          /**< 従来方式のチャンクサイズ */
+#define RECV_BATCH 64                   /**< recvmmsg 1回あたりの最大受信数 */
+#define PACED_RATE_MBPS 1000            /**< レート制限付き計測のレート [Mbit/s] */
+
+/**
+ * @brief ループバック受信スレッド
+ * @details 受信したデータグラム数とバイト数を数えるだけ（受信側で詰まらせないため）
+ */
+class LoopbackReceiver {
+public:
+    LoopbackReceiver() : sock_fd_(-1), running_(false), packets_(0), bytes_(0) {}
+
+    ~LoopbackReceiver() { stop(); }
+
+    bool start(uint16_t port)
+    {
+        sock_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+        if (sock_fd_ < 0) {
+            std::perror("socket");
+            return false;
+        }
+
+        int recvbuf_size = 16 * 1024 * 1024;
+        setsockopt(sock_fd_, SOL_SOCKET, SO_RCVBUF, &recvbuf_size, sizeof(recvbuf_size));
+
+        struct sockaddr_in addr;
+        std::memset(&addr, 0, sizeof(addr));
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(port);
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+        if (bind(sock_fd_, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+            std::perror("bind");
+            close(sock_fd_);
+            sock_fd_ = -1;
+            return false;
+        }
+
+        running_ = true;
+        thread_ = std::thread(&LoopbackReceiver::run, this);
+
+        return true;
+    }
+
+    void stop()
+    {
+        running_ = false;
+        if (thread_.joinable()) {
+            thread_.join();
+        }
+        if (sock_fd_ >= 0) {
+            close(sock_fd_);
+            sock_fd_ = -1;
+        }
+    }
+
+    uint64_t packets() const { return packets_; }
+    uint64_t bytes() const { return bytes_; }
+
+private:
+    void run()
+    {
+        std::vector<uint8_t> buffers(RECV_BATCH * 65536);
+        struct iovec iovecs[RECV_BATCH];
+        struct mmsghdr msgs[RECV_BATCH];
+
+        while (running_) {
+            struct pollfd pfd{};
+            pfd.fd = sock_fd_;
+            pfd.events = POLLIN;
+            if (poll(&pfd, 1, 50) <= 0) {
+                continue;
+            }
+
+            for (int i = 0; i < RECV_BATCH; ++i) {
+                iovecs[i].iov_base = buffers.data() + static_cast<size_t>(i) * 65536;
+                iovecs[i].iov_len = 65536;
+                std::memset(&msgs[i], 0, sizeof(msgs[i]));
+                msgs[i].msg_hdr.msg_iov = &iovecs[i];
+                msgs[i].msg_hdr.msg_iovlen = 1;
+            }
+
+            int ret = recvmmsg(sock_fd_, msgs, RECV_BATCH, MSG_DONTWAIT, nullptr);
+            if (ret <= 0) {
+                continue;
+            }
+
+            packets_ += ret;
+            for (int i = 0; i < ret; ++i) {
+                bytes_ += msgs[i].msg_len;
+            }
+        }
+    }
+
+    int sock_fd_;
+    std::atomic<bool> running_;
+    std::atomic<uint64_t> packets_;
+    std::atomic<uint64_t> bytes_;
+    std::thread thread_;
+};
+
+/**
+ * @brief 従来の送信方式（1チャンク毎に sendmsg、10パケット毎に 100us スリープ）
+ */
+class LegacySender {
+public:
+    LegacySender(const std::string& ip, uint16_t port) : syscall_count_(0), sent_packets_(0)
+    {
+        sock_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
+
+        int sendbuf_size = 4 * 1024 * 1024;
+        setsockopt(sock_fd_, SOL_SOCKET, SO_SNDBUF, &sendbuf_size, sizeof(sendbuf_size));
+
+        std::memset(&addr_, 0, sizeof(addr_));
+        addr_.sin_family = AF_INET;
+        addr_.sin_port = htons(port);
+        inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr);
+    }
+
+    ~LegacySender() { close(sock_fd_); }
+
+    bool send(const void* data, size_t size)
+    {
+        const uint8_t* ptr = static_cast<const uint8_t*>(data);
+        size_t offset = 0;
+        int packet_count = 0;
+
+        while (offset < size) {
+            size_t chunk_size = std::min(static_cast<size_t>(LEGACY_CHUNK_SIZE), size - offset);
+            uint8_t flag = (offset + chunk_size == size) ? 1 : 0;
+
+            struct iovec iov[2];
+            iov[0].iov_base = &flag;
+            iov[0].iov_len = 1;
+            iov[1].iov_base = const_cast<uint8_t*>(ptr + offset);
+            iov[1].iov_len = chunk_size;
+
+            struct msghdr msg;
+            std::memset(&msg, 0, sizeof(msg));
+            msg.msg_name = &addr_;
+            msg.msg_namelen = sizeof(addr_);
+            msg.msg_iov = iov;
+            msg.msg_iovlen = 2;
+
+            int retry_count = 0;
+            while (sendmsg(sock_fd_, &msg, 0) < 0) {
+                syscall_count_ += 1;
+                if ((errno == EAGAIN || errno == ENOBUFS) && retry_count++ < 5) {
+                    std::this_thread::sleep_for(std::chrono::microseconds(500));
+                    continue;
+                }
+                return false;
+            }
+            syscall_count_ += 1;
+            sent_packets_ += 1;
+
+            offset += chunk_size;
+
+            if (++packet_count % 10 == 0) {
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+            }
+        }
+
+        return true;
+    }
+
+    uint64_t syscall_count() const { return syscall_count_; }
+    uint64_t sent_packets() const { return sent_packets_; }
+
+private:
+    int sock_fd_;
+    struct sockaddr_in addr_;
+    uint64_t syscall_count_;
+    uint64_t sent_packets_;
+};
+
+/**
+ * @brief 1方式分の計測結果を表示する
+ */
+static void report(const char* name,
+                   std::vector<double>& times_us,
+                   uint64_t syscalls,
+                   uint64_t packets,
+                   uint64_t frames,
+                   uint64_t received)
+{
+    std::sort(times_us.begin(), times_us.end());
+
+    double total = 0.0;
+    for (double t : times_us) {
+        total += t;
+    }
+
+    const size_t n = times_us.size();
+    const double avg = n ? total / n : 0.0;
+    const double p50 = n ? times_us[n / 2] : 0.0;
+    const double p99 = n ? times_us[std::min(n - 1, n * 99 / 100)] : 0.0;
+
+    std::printf("%-10s syscalls/frame %7.1f  packets/frame %6.1f  "
+                "send time avg %8.1f us  p50 %8.1f us  p99 %8.1f us  received %5.1f%%\n",
+                name,
+                static_cast<double>(syscalls) / frames,
+                static_cast<double>(packets) / frames,
+                avg, p50, p99,
+                packets ? 100.0 * received / packets : 0.0);
+}
+
+/**
+ * @brief send_frame を frame_count 回呼んで送信時間を計測する
+ */
+static std::vector<double> run_frames(const std::function<void()>& send_frame, int frame_count)
+{
+    std::vector<double> times_us;
+    times_us.reserve(frame_count);
+
+    for (int i = 0; i < frame_count; ++i) {
+        auto t0 = std::chrono::steady_clock::now();
+        send_frame();
+        auto t1 = std::chrono::steady_clock::now();
+
+        times_us.push_back(std::chrono::duration<double, std::micro>(t1 - t0).count());
+
+        // フレーム間隔をあけて受信側に追いつかせる (30fps より十分短い)
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+
+    return times_us;
+}
+
+/**
+ * @brief 受信スレッドが全データグラムを読み終えるまで少し待つ
+ */
+static uint64_t wait_received(const LoopbackReceiver& receiver, uint64_t expected)
+{
+    for (int i = 0; i < 100 && receiver.packets() < expected; ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    }
+
+    return receiver.packets();
+}
+
+int main(int argc, char** argv)
+{
+    const size_t frame_size = (argc > 1) ? std::strtoul(argv[1], nullptr, 10) : DEFAULT_FRAME_SIZE;
+    const int frame_count = (argc > 2) ? std::atoi(argv[2]) : DEFAULT_FRAME_COUNT;
+
+    if (frame_size == 0 || frame_count <= 0) {
+        std::fprintf(stderr, "usage: %s [frame_size_bytes] [frame_count]\n", argv[0]);
+        return 1;
+    }
+
+    std::vector<uint8_t> frame(frame_size);
+    for (size_t i = 0; i < frame_size; ++i) {
+        frame[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+
+    std::printf("frame size %zu bytes, %d frames, loopback port %d\n", frame_size, frame_count, BENCH_PORT);
+
+    /* ---------- 従来方式 ---------- */
+    {
+        LoopbackReceiver receiver;
+        if (!receiver.start(BENCH_PORT)) {
+            return 1;
+        }
+
+        LegacySender sender("127.0.0.1", BENCH_PORT);
+        auto times = run_frames([&]() { sender.send(frame.data(), frame.size()); }, frame_count);
+        uint64_t received = wait_received(receiver, sender.sent_packets());
+
+        report("legacy", times, sender.syscall_count(), sender.sent_packets(), frame_count, received);
+    }
+
+    /* ---------- UDPSender の各送信方式 ---------- */
+    struct Mode {
+        const char* label;
+        const char* send_mode;
+        bool zerocopy;
+        uint32_t rate_mbps;
+    };
+    const Mode modes[] = {
+        { "sendmsg",  "sendmsg",  false, 0 },
+        { "sendmmsg", "sendmmsg", false, 0 },
+        { "io_uring", "io_uring", false, 0 },
+        { "gso",      "gso",      false, 0 },
+        { "gso+zc",   "gso",      true,  0 },
+        { "gso+pace", "gso",      false, PACED_RATE_MBPS },
+    };
+
+    for (const Mode& mode : modes) {
+        LoopbackReceiver receiver;
+        if (!receiver.start(BENCH_PORT)) {
+            return 1;
+        }
+
+        UDPSender::Config config;
+        UDPSender::parse_send_mode(mode.send_mode, config.send_mode);
+        config.zerocopy = mode.zerocopy;
+        config.max_rate_mbps = mode.rate_mbps;
+
+        UDPSender sender("127.0.0.1", BENCH_PORT, config);
+        if (sender.send_mode() != config.send_mode || sender.zerocopy_enabled() != config.zerocopy) {
+            std::printf("%-10s not supported on this kernel\n", mode.label);
+            continue;
+        }
+
+        // 毎フレーム同じ内容を送るので、ゼロコピー送信中の frame を再送しても中身は変わらない
+        uint32_t frame_id = 0;
+        auto times = run_frames([&]() {
+            sender.send(frame.data(), frame.size(), frame_id++, 0);
+            sender.reap_zerocopy_completions(0);
+        }, frame_count);
+        uint64_t received = wait_received(receiver, sender.sent_packets());
+
+        report(mode.label, times, sender.syscall_count(), sender.sent_packets(), frame_count, received);
+
+        if (mode.rate_mbps > 0) {
+            std::printf("%-10s (%u Mbps %s pacing: %.1f us of data per frame at that rate)\n", "",
+                        mode.rate_mbps, sender.kernel_pacing_enabled() ? "kernel" : "userspace",
+                        static_cast<double>(sender.sent_packets()) / frame_count
+                            * (config.max_payload_size + FRAME_PACKET_HEADER_SIZE) * 8 / mode.rate_mbps);
+        }
+
+        if (mode.zerocopy && !sender.zerocopy_enabled()) {
+            std::printf("%-10s (kernel copied the zero-copy sends and the sender fell back to copying)\n", "");
+        }
+    }
+
+    return 0;
+}
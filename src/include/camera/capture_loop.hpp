@@ -0,0 +1,145 @@
+/**
+ * @file    capture_loop.hpp
+ * @brief   複数のフレーム取得元 (カメラ・再生) を1つのイベントループで待ち、届いたフレームをカメラ毎の処理へ渡す
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef CAPTURE_LOOP_HPP_
+#define CAPTURE_LOOP_HPP_
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "camera/device_watcher.hpp"
+#include "camera/frame_source.hpp"
+#include "event_loop/io_reactor.hpp"
+
+/**
+ * @brief 複数カメラのフレーム待ちを IoReactor に登録し、1スレッドで処理する
+ * @details カメラの fd が読み込み可能になる度に1フレームだけ取り出して処理関数を呼び、呼び終えたらバッファを返す。
+ *          両方のカメラにフレームがあっても交互に処理されるので、片方が他方を待たせ続けることはない。
+ *          カメラが抜けたら (FrameSource::is_disconnected()) 登録を外して閉じ、デバイスノードの再作成 (inotify) か
+ *          待ち時間を倍々に伸ばすタイマで開き直しを試み、成功したら登録し直す。もう片方のカメラは止まらない。
+ *          再生が最後まで終わった取得元 (FrameSource::is_finished()) は登録を外し、全て終わったらイベントループを止める。
+ *          終了は IoReactor::stop() で、フレーム待ちの途中でもすぐに戻る
+ */
+class CaptureLoop {
+public:
+    /**
+     * @brief フレーム処理関数 (戻った後でバッファはカメラへ返される)
+     */
+    using FrameHandler = std::function<void(FrameSource::Frame& frame)>;
+
+    /**
+     * @brief 抜けたカメラを開き直す間隔
+     */
+    struct RecoveryPolicy {
+        uint32_t initial_backoff_ms = 200;  /**< 最初の再試行までの時間 [ms] (失敗する度に倍) */
+        uint32_t max_backoff_ms = 5000;     /**< 再試行の間隔の上限 [ms] */
+    };
+
+    /**
+     * @brief コンストラクタ
+     * @param[in,out] reactor          フレーム待ちに使うイベントループ (CaptureLoop より長く生存すること)
+     * @param[in]     stall_timeout_ms この時間フレームが来なければ警告する [ms]
+     */
+    CaptureLoop(IoReactor& reactor, uint32_t stall_timeout_ms);
+
+    /**
+     * @brief デストラクタ（全てのカメラの登録を外す）
+     */
+    ~CaptureLoop();
+
+    CaptureLoop(const CaptureLoop&) = delete;
+    CaptureLoop& operator=(const CaptureLoop&) = delete;
+
+    /**
+     * @brief 抜けたカメラを開き直す間隔を設定する（以後の切断から使う）
+     */
+    void set_recovery_policy(const RecoveryPolicy& policy) { recovery_policy_ = policy; }
+
+    /**
+     * @brief 初期化済みのカメラを登録する
+     * @param[in]     name    ログに出す名前
+     * @param[in,out] camera  カメラ・再生などの取得元 (初期化済み、登録中は生存すること)
+     * @param[in]     handler フレーム処理関数
+     * @return true 成功 / false 未初期化・登録失敗
+     */
+    bool add_camera(const std::string& name, FrameSource& camera, FrameHandler handler);
+
+    /**
+     * @brief カメラの登録を外す（フレーム処理関数の中から呼び出し可）
+     * @param[in] camera add_camera() で登録したカメラ
+     */
+    void remove_camera(FrameSource& camera);
+
+    /**
+     * @brief カメラから取り出したフレームの累計数を取得する
+     * @param[in] camera add_camera() で登録したカメラ
+     */
+    uint64_t frame_count(const FrameSource& camera) const;
+
+private:
+    /**
+     * @brief 登録したカメラ1台
+     */
+    struct Entry {
+        std::string name;
+        FrameSource* camera = nullptr;  /**< nullptr = 登録を外した */
+        int fd = -1;                    /**< 登録時の fd (外す時に使う) */
+        FrameHandler handler;
+        bool received = false;          /**< 前回の監視タイマ以降にフレームが来た */
+        uint64_t frames = 0;            /**< 取り出したフレームの累計数 */
+        bool recovering = false;        /**< 抜けたカメラの開き直し中 */
+        uint32_t backoff_ms = 0;        /**< 次の再試行までの時間 [ms] */
+        int retry_timer = -1;           /**< 再試行タイマのID (-1 = なし) */
+        std::unique_ptr<DeviceWatcher> watcher; /**< デバイスノードの監視 (開き直し中のみ) */
+    };
+
+    /**
+     * @brief カメラの fd が読み込み可能になった
+     */
+    void on_readable(size_t index);
+
+    /**
+     * @brief フレームが来ないカメラを警告する
+     */
+    void check_stalls();
+
+    /**
+     * @brief 再生が終わった取得元の登録を外す (全て終わればイベントループを止める)
+     */
+    void finish(size_t index);
+
+    /**
+     * @brief 抜けたカメラの登録を外して閉じ、開き直しを始める
+     */
+    void start_recovery(size_t index);
+
+    /**
+     * @brief デバイスノードのディレクトリに変化があった
+     */
+    void on_device_event(size_t index);
+
+    /**
+     * @brief カメラを開き直す (失敗したら待ち時間を倍にして再試行を予約する)
+     */
+    void try_reconnect(size_t index);
+
+    /**
+     * @brief 開き直しのタイマ・デバイスノードの監視を止める
+     */
+    void stop_recovery(Entry& entry);
+
+    IoReactor& reactor_;
+    uint32_t stall_timeout_ms_;
+    RecoveryPolicy recovery_policy_;
+    int stall_timer_;               /**< 監視タイマのID */
+    std::deque<Entry> entries_;     /**< 登録したカメラ (位置をコールバックに渡すので deque) */
+};
+
+#endif
@@ -0,0 +1,58 @@
+/**
+ * @file    device_watcher.hpp
+ * @brief   inotify でデバイスノード (/dev/videoN 等) の作成・属性変更を待つ
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef DEVICE_WATCHER_HPP_
+#define DEVICE_WATCHER_HPP_
+
+#include <string>
+
+/**
+ * @brief デバイスノードが現れた・使えるようになったことを知らせる
+ * @details ノードのあるディレクトリを inotify で監視する (ノード自体は抜かれると消えるので監視できない)。
+ *          udev はノードを作った後で所有者・権限を変えるので、作成 (IN_CREATE) に加えて属性変更 (IN_ATTRIB) も拾う。
+ *          /dev/v4l/by-id/ 等のシンボリックリンクを指定した場合はリンクの作成を拾う
+ */
+class DeviceWatcher {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] device_path 待つデバイスノードのパス
+     */
+    explicit DeviceWatcher(const std::string& device_path);
+
+    /**
+     * @brief デストラクタ
+     */
+    ~DeviceWatcher();
+
+    DeviceWatcher(const DeviceWatcher&) = delete;
+    DeviceWatcher& operator=(const DeviceWatcher&) = delete;
+
+    /**
+     * @brief 監視を開始できたか
+     */
+    bool is_valid() const { return watch_ >= 0; }
+
+    /**
+     * @brief inotify の fd (イベントループへの登録用。読み込み可能になったら consume() を呼ぶ)
+     */
+    int fd() const { return inotify_fd_; }
+
+    /**
+     * @brief 溜まった通知を読み捨てる
+     * @return true 待っているノードの作成・属性変更があった / false 無関係な通知だけ
+     */
+    bool consume();
+
+private:
+    std::string directory_;     /**< 監視するディレクトリ */
+    std::string name_;          /**< 待つノードのファイル名 */
+    int inotify_fd_;
+    int watch_;                 /**< inotify の監視ID (-1 = 失敗) */
+};
+
+#endif
@@ -0,0 +1,339 @@
+/**
+ * @file    frame_source.hpp
+ * @brief   フレーム取得元の抽象クラスと、カメラなしで使える実装（ファイル再生 / テストパターン）
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef FRAME_SOURCE_HPP_
+#define FRAME_SOURCE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+/**
+ * @class FrameSource
+ * @brief YUYV / MJPEG のフレームを1枚ずつ貸し出す取得元の基底クラス
+ * @details fd() が読み込み可能になったら dequeue_frame() でフレームを借り、処理後に release_frame() で返す。
+ *          V4L2Capture (カメラ) の他に、ファイル再生 (FileFrameSource) とテストパターン (SyntheticFrameSource) があり、
+ *          CaptureLoop からは同じように扱える
+ */
+class FrameSource {
+public:
+    struct Frame {
+        uint8_t* data = nullptr;
+        uint32_t size = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t fourcc = 0;
+        int buffer_index = -1;
+        uint64_t timestamp_us = 0;  // キャプチャ時刻 [us] (CLOCK_MONOTONIC)
+
+        Frame() = default;
+
+        // コピー禁止
+        Frame(const Frame&) = delete;
+        Frame& operator=(const Frame&) = delete;
+
+        // ムーブのみ許可
+        Frame(Frame&& other) noexcept
+        {
+            *this = std::move(other);
+        }
+
+        Frame& operator=(Frame&& other) noexcept
+        {
+            data = other.data;
+            size = other.size;
+            width = other.width;
+            height = other.height;
+            fourcc = other.fourcc;
+            buffer_index = other.buffer_index;
+            timestamp_us = other.timestamp_us;
+
+            other.data = nullptr;
+            other.buffer_index = -1;
+            return *this;
+        }
+    };
+
+    virtual ~FrameSource() = default;
+
+    /**
+     * @brief 取得を開始する
+     * @return true 成功 / false 失敗
+     */
+    virtual bool initialize() = 0;
+
+    /**
+     * @brief 待たずに1フレーム借りる（fd() が読み込み可能になった時に使う）
+     * @param[out] frame 借りたフレーム (release_frame() で返す)
+     * @return true 成功 / false まだ無い・終わった・切断された
+     */
+    virtual bool dequeue_frame(Frame& frame) = 0;
+
+    /**
+     * @brief 借りたフレームを返す
+     */
+    virtual void release_frame(Frame& frame) = 0;
+
+    /**
+     * @brief フレームが来ると読み込み可能になる fd (イベントループへの登録用、未初期化なら -1)
+     */
+    virtual int fd() const = 0;
+
+    /**
+     * @brief ログに出す名前 (デバイス・ファイルのパス等)
+     */
+    virtual const std::string& name() const = 0;
+
+    /**
+     * @brief 取得元が切断された (close() して reconnect() するまで取得できない)
+     */
+    virtual bool is_disconnected() const { return false; }
+
+    /**
+     * @brief 再生が最後まで終わり、もうフレームが来ない
+     */
+    virtual bool is_finished() const { return false; }
+
+    /**
+     * @brief 取得を止めて fd を閉じる（イベントループの登録を外してから呼ぶ）
+     */
+    virtual void close() {}
+
+    /**
+     * @brief 切断された取得元を開き直す（対応していなければ false）
+     */
+    virtual bool reconnect() { return false; }
+
+    /**
+     * @brief fd() を最大 1000 ms 待ってから1フレーム借りる
+     */
+    bool get_once_frame(Frame& frame);
+};
+
+/**
+ * @class FramePacer
+ * @brief ファイル再生・テストパターンがフレームを出す間隔を作る
+ * @details REAL_TIME は timerfd で fps 毎に読み込み可能になる。処理が間に合わず周期が過ぎた分は、
+ *          カメラと同じように捨てたものとして数える。AS_FAST_AS_POSSIBLE は常に読み込み可能な eventfd で、
+ *          処理が終わる度にすぐ次のフレームを出す (パイプラインの最大スループットの計測用)
+ */
+class FramePacer {
+public:
+    /**
+     * @brief フレームを出す間隔
+     */
+    enum class Mode {
+        REAL_TIME,              /**< fps の周期 */
+        AS_FAST_AS_POSSIBLE     /**< 待たない */
+    };
+
+    /**
+     * @brief 間隔を文字列から変換する ("realtime" / "fast")
+     * @param[in]  name 名前
+     * @param[out] mode 変換結果
+     * @return true 成功 / false 未知の名前
+     */
+    static bool parse_mode(const std::string& name, Mode& mode);
+
+    /**
+     * @brief コンストラクタ
+     * @param[in] mode 間隔
+     * @param[in] fps  REAL_TIME のフレームレート
+     */
+    FramePacer(Mode mode, double fps);
+
+    /**
+     * @brief デストラクタ
+     */
+    ~FramePacer();
+
+    FramePacer(const FramePacer&) = delete;
+    FramePacer& operator=(const FramePacer&) = delete;
+
+    /**
+     * @brief fd を作って周期を開始する
+     * @return true 成功 / false 失敗
+     */
+    bool start();
+
+    /**
+     * @brief fd を閉じる
+     */
+    void stop();
+
+    /**
+     * @brief 読み込み可能になる fd (未開始なら -1)
+     */
+    int fd() const { return fd_; }
+
+    /**
+     * @brief 出してよいフレーム数を取り出す
+     * @return 前回から過ぎた周期の数 (0 = まだ。2 以上なら 1 を除いた分が捨てられた)
+     */
+    uint64_t take();
+
+private:
+    Mode mode_;
+    double fps_;
+    int fd_;
+};
+
+/**
+ * @class FileFrameSource
+ * @brief 保存したフレームを再生する
+ * @details path の種類で読み方を変える。記録以外は起動時にメモリへ載せ (ファイルは mmap)、再生中はディスクを読まない。
+ *          - 索引 (index.bin) のあるディレクトリ: FrameRecorder の記録 (RAM より大きいことがあるので、
+ *            セグメントを mmap して再生中に必要な所をディスクから読む)
+ *          - ディレクトリ: 名前順の画像 (.jpg / .jpeg は MJPEG のまま、.png / .bmp 等は YUYV に変換)
+ *          - .mjpeg / .mjpg / .jpg / .jpeg: JPEG を連結したファイル (MJPEG)
+ *          - それ以外: width x height の YUYV を連結したファイル
+ */
+class FileFrameSource : public FrameSource {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] path   再生するファイル・ディレクトリ
+     * @param[in] width  YUYV ファイルの横幅 [px]
+     * @param[in] height YUYV ファイルの高さ [px]
+     * @param[in] pacing フレームを出す間隔
+     * @param[in] fps    REAL_TIME のフレームレート
+     * @param[in] loop   最後まで再生したら先頭に戻る
+     */
+    FileFrameSource(const std::string& path,
+                    uint32_t width,
+                    uint32_t height,
+                    FramePacer::Mode pacing,
+                    double fps,
+                    bool loop);
+
+    ~FileFrameSource() override;
+
+    FileFrameSource(const FileFrameSource&) = delete;
+    FileFrameSource& operator=(const FileFrameSource&) = delete;
+
+    bool initialize() override;
+    bool dequeue_frame(Frame& frame) override;
+    void release_frame(Frame& frame) override;
+    int fd() const override { return pacer_.fd(); }
+    const std::string& name() const override { return path_; }
+    bool is_finished() const override { return finished_; }
+
+    /**
+     * @brief 読み込んだフレーム数
+     */
+    size_t frame_count() const { return frames_.size(); }
+
+    /**
+     * @brief REAL_TIME で処理が間に合わずに飛ばしたフレーム数
+     */
+    uint64_t dropped_frames() const { return dropped_; }
+
+    /**
+     * @brief 次に出すフレームを変える (initialize() の後に呼ぶ)
+     * @param[in] index フレームの位置 (0 = 先頭)
+     * @return true 成功 / false 範囲外
+     */
+    bool seek(size_t index);
+
+private:
+    /**
+     * @brief 読み込んだフレーム1枚 (data は mappings_ か images_ の中)
+     */
+    struct StoredFrame {
+        uint8_t* data = nullptr;
+        uint32_t size = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t fourcc = 0;
+    };
+
+    /**
+     * @brief ファイルを mmap する (mappings_ に足し、unload() で解放する)
+     * @param[in]  file     ファイル
+     * @param[in]  populate 全体を先に読み込む
+     * @param[out] size     ファイルの大きさ [byte]
+     * @return 先頭 (失敗時は nullptr)
+     */
+    uint8_t* map_file(const std::string& file, bool populate, size_t& size);
+
+    /**
+     * @brief YUYV を連結したファイルを読む
+     */
+    bool load_raw_yuyv();
+
+    /**
+     * @brief JPEG を連結したファイルを読む
+     */
+    bool load_mjpeg_stream();
+
+    /**
+     * @brief ディレクトリの画像を読む
+     */
+    bool load_image_directory();
+
+    /**
+     * @brief FrameRecorder の記録を読む
+     */
+    bool load_recording();
+
+    /**
+     * @brief 全てのフレームを解放する
+     */
+    void unload();
+
+    std::string path_;
+    uint32_t width_;
+    uint32_t height_;
+    FramePacer pacer_;
+    bool loop_;
+
+    std::vector<std::pair<void*, size_t>> mappings_;    /**< mmap したファイル (先頭と大きさ) */
+    std::vector<std::vector<uint8_t>> images_;  /**< ディレクトリから読んだ画像 */
+    std::vector<StoredFrame> frames_;           /**< 再生順のフレーム */
+
+    size_t next_;                               /**< 次に出すフレームの位置 */
+    bool finished_;
+    uint64_t dropped_;
+};
+
+/**
+ * @class SyntheticFrameSource
+ * @brief テストパターン (カラーバーの上を四角が動く YUYV) を生成する
+ * @details 背景は初期化時に1回だけ作り、フレーム毎には背景のコピーと四角の描画だけを行う
+ */
+class SyntheticFrameSource : public FrameSource {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] width  横幅 [px] (偶数に切り下げる)
+     * @param[in] height 高さ [px]
+     * @param[in] pacing フレームを出す間隔
+     * @param[in] fps    REAL_TIME のフレームレート
+     */
+    SyntheticFrameSource(uint32_t width, uint32_t height, FramePacer::Mode pacing, double fps);
+
+    bool initialize() override;
+    bool dequeue_frame(Frame& frame) override;
+    void release_frame(Frame& frame) override;
+    int fd() const override { return pacer_.fd(); }
+    const std::string& name() const override { return name_; }
+
+private:
+    std::string name_;
+    uint32_t width_;
+    uint32_t height_;
+    FramePacer pacer_;
+
+    std::vector<uint8_t> background_;           /**< カラーバー (YUYV) */
+    std::vector<uint8_t> buffers_[2];           /**< 貸し出すフレーム (カメラと同じく2枚) */
+    bool in_use_[2];                            /**< 貸し出し中 */
+    uint64_t sequence_;                         /**< 生成したフレーム数 (四角の位置) */
+};
+
+#endif // FRAME_SOURCE_HPP_
@@ -12,59 +12,155 @@
 #include <string>
 #include <vector>
 
+#include <linux/videodev2.h>
 
-class V4L2Capture {
+#include "camera/frame_source.hpp"
+
+class V4L2Capture : public FrameSource {
 public:
-    struct Frame {
-        uint8_t* data = nullptr;
-        uint32_t size = 0;
-        uint32_t width = 0;
-        uint32_t height = 0;
-        uint32_t fourcc = 0;
-        int buffer_index = -1;
+    // カメラコントロールの固定値 (負の値 = 変更しない、ドライバの自動制御のまま)
+    struct Controls {
+        uint32_t frame_rate = 0;            // timeperframe を 1/frame_rate に固定 (0 = 変更しない)
+        int32_t exposure = -1;              // 露光時間 (exposure_time_absolute、100us 単位)。指定すると自動露光を切る
+        int32_t exposure_auto_priority = -1;    // 0 = 自動露光でもフレームレートを落とさない / 1 = 落としてよい
+        int32_t gain = -1;                  // ゲイン。指定すると自動ゲインを切る
+        int32_t white_balance = -1;         // 色温度 [K]。指定すると自動ホワイトバランスを切る
+        int32_t focus = -1;                 // フォーカス位置 (focus_absolute)。指定するとオートフォーカスを切る
+    };
 
-        Frame() = default;
+    // ドライバが持つコントロール1個の情報 (VIDIOC_QUERYCTRL)
+    struct ControlInfo {
+        uint32_t id = 0;
+        std::string name;
+        uint32_t type = 0;                  // V4L2_CTRL_TYPE_*
+        int32_t minimum = 0;
+        int32_t maximum = 0;
+        int32_t step = 0;
+        int32_t default_value = 0;
+        int32_t value = 0;                  // 現在値 (読めない種類なら既定値)
+        uint32_t flags = 0;                 // V4L2_CTRL_FLAG_* (INACTIVE = 自動制御中で手動値は効かない 等)
+    };
 
-        // コピー禁止
-        Frame(const Frame&) = delete;
-        Frame& operator=(const Frame&) = delete;
+    // 取得モード1個 (ピクセルフォーマット・解像度・フレーム間隔の組)
+    struct Mode {
+        uint32_t fourcc = 0;
+        uint32_t width = 0;
+        uint32_t height = 0;
+        uint32_t interval_numerator = 0;    // フレーム間隔 = numerator / denominator [s] (0 = 不明)
+        uint32_t interval_denominator = 0;
 
-        // ムーブのみ許可
-        Frame(Frame&& other) noexcept
+        double fps() const
         {
-            *this = std::move(other);
+            return interval_numerator ? static_cast<double>(interval_denominator) / interval_numerator : 0.0;
         }
+    };
 
-        Frame& operator=(Frame&& other) noexcept
-        {
-            data = other.data;
-            size = other.size;
-            width = other.width;
-            height = other.height;
-            fourcc = other.fourcc;
-            buffer_index = other.buffer_index;
-
-            other.data = nullptr;
-            other.buffer_index = -1;
-            return *this;
-        }
+    // 取得モードの選び方
+    enum class ModePolicy {
+        EXACT,          // 指定した幅・高さで一番速いフレームレート
+        MAX_FPS,        // 幅 min_width 以上で一番速いフレームレート (同じなら小さい解像度)
+        MAX_RESOLUTION  // min_fps 以上で一番大きい解像度 (同じなら速いフレームレート)
+    };
+
+    struct ModeRequest {
+        ModePolicy policy = ModePolicy::EXACT;
+        uint32_t min_width = 0;     // MAX_FPS の最小幅 (0 = コンストラクタの width)
+        double min_fps = 0.0;       // MAX_RESOLUTION の最低フレームレート
+    };
+
+    // カメラが抜けた時の復帰の統計
+    struct RecoveryStats {
+        uint32_t disconnects = 0;       // 切断を検出した回数
+        uint32_t reconnects = 0;        // 開き直しに成功した回数
+        uint32_t failed_reconnects = 0; // 開き直しに失敗した回数
+        uint64_t downtime_ms = 0;       // 復帰するまで取得できなかった時間の合計 [ms]
     };
 
     V4L2Capture(const std::string& device_name,
                 uint32_t width,
-                uint32_t height);
+                uint32_t height,
+                uint32_t fourcc = V4L2_PIX_FMT_YUYV);
+
+    ~V4L2Capture() override;
+
+    // "yuyv" / "mjpeg" / "auto" を V4L2 の fourcc へ変換する (auto は 0 = YUYV と MJPEG の速い方。未知の名前なら false)
+    static bool parse_pixel_format(const std::string& name, uint32_t& fourcc);
+
+    // "exact" / "max_fps" / "max_resolution" を変換する (未知の名前なら false)
+    static bool parse_mode_policy(const std::string& name, ModePolicy& policy);
+
+    // modes から fourcc (0 = YUYV か MJPEG) ・width × height と request に合う一番良いモードを選ぶ (無ければ false)
+    static bool select_mode(const std::vector<Mode>& modes,
+                            uint32_t fourcc,
+                            uint32_t width,
+                            uint32_t height,
+                            const ModeRequest& request,
+                            Mode& chosen);
+
+    bool initialize() override;
+
+    // initialize() でのモードの選び方を設定する (一度決めたモードは再初期化でもそのまま使う)
+    void set_mode_request(const ModeRequest& request) { mode_request_ = request; }
+
+    // ドライバが対応しているモードを列挙する (VIDIOC_ENUM_FMT / ENUM_FRAMESIZES / ENUM_FRAMEINTERVALS)
+    bool enumerate_modes(std::vector<Mode>& modes);
+
+    // enumerate_modes() の結果をログに出す
+    void log_modes();
+
+    // 実際に設定されたモード (initialize() 後。フレーム間隔はドライバから読み戻した値)
+    const Mode& mode() const { return mode_; }
+
+    // initialize() で適用するコントロールを設定する (フレームレートはストリーム開始前にしか変えられない)
+    void set_controls(const Controls& controls) { controls_ = controls; }
+
+    // 露光・ゲイン・ホワイトバランス・フォーカスを適用する (初期化後にも呼べる。フレームレートは変えない)
+    bool apply_controls(const Controls& controls);
+
+    // ドライバが対応しているコントロールを列挙する
+    bool query_controls(std::vector<ControlInfo>& controls);
+
+    // query_controls() の結果をログに出す
+    void log_controls();
+
+    // コントロールを1個設定する (範囲・刻みに丸める。対応していなければ false)
+    bool set_control(uint32_t id, int32_t value);
+
+    // コントロールの現在値を読む
+    bool get_control(uint32_t id, int32_t& value);
+
+    // 実際のフレームレート (VIDIOC_G_PARM、取得できなければ 0)
+    double frame_rate();
+
+    void release_frame(Frame& frame) override;
+
+    // 待たずに1フレーム取り出す (イベントループで fd が読み込み可能になった時に使う。無ければ false)
+    bool dequeue_frame(Frame& frame) override;
+
+    // デバイスの fd (イベントループへの登録用、未初期化なら -1)
+    int fd() const override { return device_fd_; }
+
+    // デバイス名
+    const std::string& name() const override { return device_name_; }
+
+    // 取り出しが ENODEV / EIO で失敗した (USB ケーブルが抜けた等。close() して reconnect() するまで取得できない)
+    bool is_disconnected() const override { return disconnected_; }
 
-    ~V4L2Capture();
+    // ストリームを止め、バッファを解放してデバイスを閉じる (イベントループの登録を外してから呼ぶ)
+    void close() override;
 
-    bool initialize();
+    // デバイスを開き直し、前回と同じモード・コントロールで取得を再開する (成功すれば切断状態を解除する)
+    bool reconnect() override;
 
-    bool get_once_frame(Frame& frame);
-    void release_frame(Frame& frame);
+    const RecoveryStats& recovery_stats() const { return recovery_stats_; }
 
 private:
     bool open_device();
     void close_device();
+    void negotiate_mode(Mode& target);
     bool set_frame_format(uint32_t width, uint32_t height, uint32_t fourcc);
+    bool set_frame_interval(uint32_t numerator, uint32_t denominator);
+    bool has_control(uint32_t id);
 
     struct Buffer {
         void*  start = nullptr;
@@ -75,6 +171,13 @@ private:
     int device_fd_{-1};
     uint32_t width_;
     uint32_t height_;
+    uint32_t fourcc_;   // 要求するピクセルフォーマット (YUYV / MJPEG、0 = どちらか)
+    Controls controls_; // initialize() で適用するコントロール
+    ModeRequest mode_request_;  // initialize() でのモードの選び方
+    Mode mode_;         // 実際に設定されたモード (fourcc 0 = 未決定)
+    bool disconnected_{false};
+    uint64_t disconnected_at_us_{0};    // 切断を検出した時刻 [us] (CLOCK_MONOTONIC)
+    RecoveryStats recovery_stats_;
     std::vector<Buffer> buffers_;
 };
 
@@ -0,0 +1,236 @@
+/**
+ * @file    io_reactor.hpp
+ * @brief   io_uring (非対応なら epoll) でファイルディスクリプタの読み込み可能通知とタイマを1か所で待つイベントループ
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef IO_REACTOR_HPP_
+#define IO_REACTOR_HPP_
+
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "event_loop/io_uring_queue.hpp"
+
+/**
+ * @brief 1スレッドで回すイベントループ
+ * @details カメラ (V4L2) やソケットの fd の読み込み可能通知と周期タイマを、1回のシステムコールでまとめて待つ。
+ *          io_uring では前回の通知で外れた監視の再登録 (IORING_OP_POLL_ADD) を次の待機と同じ io_uring_enter で投入し、
+ *          待ち時間は io_uring_enter に直接渡す。io_uring が使えない・古い (5.11 未満) 場合は epoll を使う。
+ *          stop() と post() だけは他スレッドから呼び出せる (シグナルハンドラからは stop() のみ)
+ */
+class IoReactor {
+public:
+    /**
+     * @brief 待機に使う仕組み
+     */
+    enum class Backend {
+        IO_URING,   /**< io_uring (Linux 5.11+) */
+        EPOLL       /**< epoll */
+    };
+
+    /**
+     * @brief 読み込み可能・タイマ満了時に呼ぶ関数
+     */
+    using Callback = std::function<void()>;
+
+    /**
+     * @brief 統計情報
+     */
+    struct Stats {
+        uint64_t waits = 0;         /**< 待機した回数 */
+        uint64_t syscalls = 0;      /**< イベントループ自身が使ったシステムコールの回数 (コールバック内は含まない) */
+        uint64_t dispatched = 0;    /**< 呼び出した読み込み可能コールバックの回数 */
+        uint64_t timer_fires = 0;   /**< 呼び出したタイマコールバックの回数 */
+    };
+
+    /**
+     * @brief 待機の仕組みを文字列から変換する ("io_uring" / "epoll")
+     * @param[in]  name    名前
+     * @param[out] backend 変換結果
+     * @return true 成功 / false 未知の名前
+     */
+    static bool parse_backend(const std::string& name, Backend& backend);
+
+    /**
+     * @brief 待機の仕組みの名前
+     */
+    static const char* backend_name(Backend backend);
+
+    /**
+     * @brief コンストラクタ
+     * @param[in] preferred 使いたい仕組み (io_uring が使えなければ epoll になる)
+     */
+    explicit IoReactor(Backend preferred);
+
+    /**
+     * @brief デストラクタ
+     */
+    ~IoReactor();
+
+    IoReactor(const IoReactor&) = delete;
+    IoReactor& operator=(const IoReactor&) = delete;
+
+    /**
+     * @brief 初期化に成功したか
+     */
+    bool is_valid() const { return wakeup_fd_ >= 0 && (uring_ != nullptr || epoll_fd_ >= 0); }
+
+    /**
+     * @brief 実際に使っている仕組み
+     */
+    Backend backend() const { return backend_; }
+
+    /**
+     * @brief fd が読み込み可能になったら callback を呼ぶように登録する
+     * @details 読み残しがあれば次の run_once() でも呼ぶ (レベルトリガ)。エラー・切断 (POLLERR / POLLHUP) でも呼ぶので、
+     *          callback 側で読み込みの失敗を確かめること
+     * @param[in] fd       監視する fd
+     * @param[in] callback 呼ぶ関数
+     * @return true 成功 / false 登録失敗・登録済み
+     */
+    bool add_reader(int fd, Callback callback);
+
+    /**
+     * @brief add_reader() の登録を外す（コールバック内から呼び出し可。fd を閉じる前に呼ぶ）
+     * @param[in] fd 監視をやめる fd
+     */
+    void remove_reader(int fd);
+
+    /**
+     * @brief interval_ms 毎に callback を呼ぶタイマを登録する
+     * @param[in] interval_ms 周期 [ms] (1 以上)
+     * @param[in] callback    呼ぶ関数
+     * @return タイマID (cancel_timer() に渡す)
+     */
+    int add_timer(uint32_t interval_ms, Callback callback);
+
+    /**
+     * @brief タイマを止める（コールバック内から呼び出し可）
+     * @param[in] timer_id add_timer() の戻り値
+     */
+    void cancel_timer(int timer_id);
+
+    /**
+     * @brief 待機中の run() / run_once() を起こし、run() を終わらせる
+     * @note  async-signal-safe。他スレッド・シグナルハンドラから呼び出せる
+     */
+    void stop();
+
+    /**
+     * @brief callback をイベントループのスレッドで次の run_once() 中に呼ぶ (他スレッドからの制御用)
+     * @note  他スレッドから呼び出せる。async-signal-safe ではない
+     * @param[in] callback 呼ぶ関数
+     */
+    void post(Callback callback);
+
+    /**
+     * @brief stop() が呼ばれたか
+     */
+    bool is_stopped() const { return stopped_.load(std::memory_order_relaxed); }
+
+    /**
+     * @brief イベントかタイマか timeout_ms の経過まで1回待ち、該当するコールバックを呼ぶ
+     * @param[in] timeout_ms 最大待ち時間 [ms] (-1 = タイマの満了まで)
+     */
+    void run_once(int timeout_ms);
+
+    /**
+     * @brief stop() が呼ばれるまで run_once() を繰り返す
+     */
+    void run();
+
+    /**
+     * @brief 統計情報を取得する
+     */
+    const Stats& stats() const { return stats_; }
+
+private:
+    /**
+     * @brief 登録された fd 1個
+     */
+    struct Reader {
+        int fd = -1;                /**< 監視する fd (-1 = 空き) */
+        uint32_t generation = 0;    /**< 登録し直す毎に増やす (外した登録の遅れて届いた通知を捨てるため) */
+        bool armed = false;         /**< io_uring で監視を投入済み */
+        Callback callback;
+    };
+
+    /**
+     * @brief 周期タイマ1個
+     */
+    struct Timer {
+        bool active = false;
+        uint64_t interval_us = 0;
+        uint64_t deadline_us = 0;   /**< 次に呼ぶ時刻 (CLOCK_MONOTONIC) */
+        Callback callback;
+    };
+
+    /**
+     * @brief 登録の識別値 (下位32bit = readers_ の位置、上位32bit = 世代)
+     */
+    static uint64_t make_token(size_t slot, uint32_t generation)
+    {
+        return (static_cast<uint64_t>(generation) << 32) | static_cast<uint64_t>(slot);
+    }
+
+    /**
+     * @brief 次のタイマ満了までの時間 [us] (タイマなしは -1)
+     */
+    int64_t time_to_next_timer_us(uint64_t now_us) const;
+
+    /**
+     * @brief 満了したタイマのコールバックを呼ぶ
+     */
+    void run_timers();
+
+    /**
+     * @brief token の登録が有効なら、読み込み可能コールバックを呼ぶ
+     */
+    void dispatch(uint64_t token);
+
+    /**
+     * @brief io_uring で待つ
+     */
+    void wait_io_uring(int64_t timeout_us);
+
+    /**
+     * @brief epoll で待つ
+     */
+    void wait_epoll(int64_t timeout_us);
+
+    /**
+     * @brief 起床用 eventfd を読み捨て、post() された関数を呼ぶ
+     */
+    void drain_wakeup();
+
+    /**
+     * @brief 起床用 eventfd に書き込む
+     */
+    void wakeup();
+
+    Backend backend_;
+    std::unique_ptr<IoUringQueue> uring_;   /**< io_uring のリング (epoll 使用時は nullptr) */
+    int epoll_fd_;                          /**< epoll の fd (io_uring 使用時は -1) */
+    int wakeup_fd_;                         /**< stop() / post() で書く eventfd */
+
+    std::deque<Reader> readers_;    /**< 登録された fd (コールバック実行中に追加しても参照が無効にならないよう deque) */
+    std::deque<Timer> timers_;      /**< タイマ (タイマIDが位置) */
+    size_t dispatching_slot_;       /**< コールバック実行中の readers_ の位置 (その位置は再利用しない) */
+
+    std::mutex posted_mutex_;           /**< posted_ の保護 */
+    std::vector<Callback> posted_;      /**< post() された関数 */
+    std::vector<Callback> running_posted_;  /**< 実行中の post() された関数 (入れ替えて再利用) */
+
+    std::atomic<bool> stopped_;
+    Stats stats_;
+};
+
+#endif
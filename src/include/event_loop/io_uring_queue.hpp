@@ -0,0 +1,135 @@
+/**
+ * @file    io_uring_queue.hpp
+ * @brief   io_uring の投入キュー・完了キューの薄いラッパ (liburing を使わずシステムコールを直接呼ぶ)
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef IO_URING_QUEUE_HPP_
+#define IO_URING_QUEUE_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <ctime>
+#include <linux/io_uring.h>
+#include <sys/socket.h>
+
+/**
+ * @brief 1スレッドから使う io_uring のリング
+ * @details get_sqe() で投入エントリを埋め、submit() で投入と完了待ちを1回の io_uring_enter で行う。
+ *          完了は peek_cqe() / cqe_seen() で順に取り出す。複数スレッドから同時に使ってはならない
+ */
+class IoUringQueue {
+public:
+    /**
+     * @brief コンストラクタ（リングの作成と mmap）
+     * @param[in] entries 投入キューの大きさ (2 の累乗に切り上げられる。完了キューはその2倍)
+     */
+    explicit IoUringQueue(unsigned entries);
+
+    /**
+     * @brief デストラクタ（リングを閉じる）
+     */
+    ~IoUringQueue();
+
+    IoUringQueue(const IoUringQueue&) = delete;
+    IoUringQueue& operator=(const IoUringQueue&) = delete;
+
+    /**
+     * @brief 初期化に成功したか（カーネルが io_uring 非対応・無効化されていれば false）
+     */
+    bool is_valid() const { return ring_fd_ >= 0; }
+
+    /**
+     * @brief io_uring_enter にタイムアウトを直接渡せるか (IORING_FEAT_EXT_ARG、Linux 5.11+)
+     */
+    bool has_ext_arg() const { return (features_ & IORING_FEAT_EXT_ARG) != 0; }
+
+    /**
+     * @brief 空いている投入エントリを1個取得する（0 で埋めてある）
+     * @return 投入エントリ / nullptr 投入キューが満杯 (submit() で空ける)
+     */
+    struct io_uring_sqe* get_sqe();
+
+    /**
+     * @brief 溜めた投入エントリを投入し、完了が wait_nr 個揃うまで待つ
+     * @param[in] wait_nr    待つ完了数 (0 = 投入だけ)
+     * @param[in] timeout_ns 待つ最大時間 [ns] (-1 = 無期限、has_ext_arg() が false なら無視)
+     * @return 投入した数 / 負の errno (タイムアウトは -ETIME)
+     */
+    int submit(unsigned wait_nr, int64_t timeout_ns = -1);
+
+    /**
+     * @brief 完了エントリを1個覗く（取り出すには cqe_seen() を呼ぶ）
+     * @return 完了エントリ / nullptr 完了なし
+     */
+    struct io_uring_cqe* peek_cqe();
+
+    /**
+     * @brief peek_cqe() で覗いた完了エントリを取り出し済みにする
+     */
+    void cqe_seen();
+
+    /**
+     * @brief メッセージ列を sendmmsg と同じ結果になるように送る
+     * @details 送信順を保つため投入エントリを IOSQE_IO_LINK で繋ぎ、1回の io_uring_enter で投入と完了待ちを行う。
+     *          途中で失敗した場合、残りはカーネルが取り消す。io_uring_enter 自体が失敗した場合は、
+     *          未投入の分を取り消し、投入済みの分の完了を刈り取ってから戻る (msgs を参照したまま戻らない)
+     * @param[in] fd    ソケット
+     * @param[in] msgs  送るメッセージ (msg_len には送った長さが入る)
+     * @param[in] count メッセージ数 (投入キューの大きさまで)
+     * @param[in] flags sendmsg のフラグ
+     * @return 送れたメッセージ数 / -1 先頭から失敗 (errno を設定)
+     */
+    int send_messages(int fd, struct mmsghdr* msgs, unsigned count, int flags);
+
+    /**
+     * @brief 投入キューの大きさを取得する
+     */
+    unsigned sq_entries() const { return sq_entries_; }
+
+    /**
+     * @brief io_uring_enter を呼んだ累計回数を取得する
+     */
+    uint64_t enter_count() const { return enter_count_; }
+
+private:
+    /**
+     * @brief リングを閉じて mmap を解除する
+     */
+    void close_ring();
+
+    /**
+     * @brief io_uring_enter が失敗した一括送信を片付ける
+     * @details 末尾 count 個のうち未投入の分を取り消し、投入済みで未完了の分の完了を待って捨てる
+     * @param[in] count     一括送信した投入エントリ数
+     * @param[in] completed 既に刈り取った完了の数
+     */
+    void discard_batch(unsigned count, unsigned completed);
+
+    int ring_fd_;
+    uint32_t features_;
+
+    void* sq_ring_;             /**< 投入キューのリング (mmap) */
+    size_t sq_ring_size_;
+    void* cq_ring_;             /**< 完了キューのリング (単一 mmap なら sq_ring_ と同じ) */
+    size_t cq_ring_size_;
+    struct io_uring_sqe* sqes_; /**< 投入エントリ配列 (mmap) */
+    size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned* sq_mask_;
+    unsigned* sq_array_;
+    unsigned sq_entries_;
+    unsigned sq_local_tail_;    /**< get_sqe() で埋めた末尾 (submit() でカーネルへ公開する) */
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned* cq_mask_;
+    struct io_uring_cqe* cqes_;
+
+    uint64_t enter_count_;
+};
+
+#endif
@@ -9,14 +9,16 @@
 #define IMAGE_PROCESSOR_HPP_
 
 #include <cstdint>
+#include <memory>
 #include <vector>
 #include <string>
 
-#include <turbojpeg.h>
-
 #include <opencv2/core.hpp>
 #include <opencv2/dnn.hpp>
 
+#include "image_processor/video_encoder.hpp"
+#include "image_processor/iou_tracker.hpp"
+
 /**
  * @class ImageProcessor
  * @brief カメラ画像の変換、AI推論、GUI用画像生成を行うクラス
@@ -32,6 +34,7 @@ public:
         cv::Rect box;            /**< 画像上の検出矩形 (x, y, width, height) */
         float confidence;        /**< 検出の確信度 (0.0 - 1.0) */
         double resistance_value; /**< 推定された抵抗値 [Ω]。未計算/計算不能時は -1.0 */
+        uint32_t track_id;       /**< フレームをまたいで同じ抵抗に振られるID (1 以上) */
     };
 
     /**
@@ -39,10 +42,12 @@ public:
      * @brief  GUI（操縦者）へ送信するための画像データ
      */
     struct GuiProcessedData {
-        std::vector<uint8_t> image; /**< JPEG圧縮された画像データ (描画処理済み) */
+        std::vector<uint8_t> image; /**< 圧縮された画像データ (描画処理済み) */
         uint32_t width  = 0;        /**< 画像の横幅 [px] */
         uint32_t height = 0;        /**< 画像の高さ [px] */
         bool is_jpeg = false;       /**< データ形式がJPEGか否か */
+        bool is_h264 = false;       /**< データ形式がH.264 (Annex-B) か否か */
+        bool is_keyframe = false;   /**< 単独でデコード可能なフレームか否か */
     };
 
     /**
@@ -50,7 +55,7 @@ public:
      * @brief  AI処理結果および解析用データ
      */
     struct AiProcessedData {
-        std::vector<uint8_t> image; /**< BGR生画像データ (必要に応じて利用) */
+        std::vector<uint8_t> image; /**< BGR生画像データ (全解像度。GUI縮小時は推論フレームでのみ更新) */
         uint32_t width  = 0;        /**< 画像の横幅 [px] */
         uint32_t height = 0;        /**< 画像の高さ [px] */
         uint32_t channels = 3;      /**< チャンネル数 (通常3: BGR) */
@@ -62,7 +67,7 @@ public:
      * @brief コンストラクタ
      * @param model_path   ONNXモデルファイルのパス
      * @param jpeg_quality GUI送信時のJPEG圧縮品質 (1-100)
-     * @param resize_width 画像処理時の基準横幅（YUYV変換時のバッファ確保等に使用）
+     * @param resize_width GUI送信用画像の横幅 [px]。0または入力幅以上なら等倍（AI処理は常に全解像度）
      */
     ImageProcessor(const std::string& model_path, int jpeg_quality, uint32_t resize_width);
 
@@ -71,14 +76,45 @@ public:
      */
     ~ImageProcessor();
 
+    /**
+     * @brief GUI送信用エンコーダを差し替える
+     * @param encoder 使用するエンコーダ（所有権は内部へムーブ）。既定はJpegEncoder
+     */
+    void set_encoder(std::unique_ptr<VideoEncoder> encoder);
+
+    /**
+     * @brief GUI送信用の圧縮品質を変更する（レート制御用）
+     * @param quality 圧縮品質 (1-100)
+     */
+    void set_jpeg_quality(int quality);
+
+    /**
+     * @brief GUI送信用画像の縮小率を変更する（レート制御用）
+     * @param scale 縮小率 (0 < scale <= 1.0)。1.0で等倍
+     */
+    void set_output_scale(double scale);
+
+    /**
+     * @brief 次のフレームをキーフレームにする (送信側が差分フレームを捨てた時用)
+     */
+    void request_keyframe(void);
+
+    /**
+     * @brief GUI送信用画像に検出結果を描画するかを切り替える
+     * @details 検出結果をメタデータで送り、受信側で描画する場合は false にする
+     * @param enabled true で描画する (既定)
+     */
+    void set_draw_overlay(bool enabled);
+
     /**
      * @brief  1フレーム分の画像処理を実行するメイン関数
      * @details
-     * 1. YUYV形式からBGR形式への変換
+     * 1. YUYV形式からBGR形式への変換（全解像度。GUI縮小時は推論フレームのみ）
      * 2. YOLOによる抵抗の物体検出
      * 3. 検出された領域の抵抗値推定（カラーコード読み取り）
-     * 4. 結果の描画（バウンディングボックス、テキスト）
-     * 5. GUI送信用へのJPEG圧縮
+     * 4. GUI用画像の生成（resize_width へ YUYV変換と融合して縮小）
+     * 5. 結果の描画（バウンディングボックス、テキスト。座標はGUI解像度へ換算）
+     * 6. GUI送信用への圧縮 (JPEG または H.264)
      * * @param[in]  yuyv      カメラからの生データ (YUYV形式)
      * @param[in]  width     画像の横幅
      * @param[in]  height    画像の高さ
@@ -95,7 +131,92 @@ public:
                        AiProcessedData& ai_data,
                        bool is_run_ai);
 
+    /**
+     * @brief  カメラが圧縮した MJPEG の1フレームを処理する
+     * @details
+     * 描画なし・等倍・JPEG送信なら、カメラのJPEGをそのままGUIデータにする (パススルー)。
+     * このときデコードは推論フレームだけで行い、再圧縮はしない。
+     * それ以外はデコードしたBGR画像から process_frame() と同じ手順でGUI用画像を作る。
+     * @param[in]  jpeg      カメラからのJPEGデータ
+     * @param[in]  size      JPEGデータのサイズ [byte]
+     * @param[in]  width     画像の横幅
+     * @param[in]  height    画像の高さ
+     * @param[out] gui_data  GUI送信用の処理結果格納先
+     * @param[out] ai_data   AI解析結果の格納先
+     * @param[in]  is_run_ai
+     * @return true  処理成功
+     * @return false 入力不正、またはデコード・圧縮失敗等
+     */
+    bool process_mjpeg_frame(const uint8_t* jpeg,
+                             size_t size,
+                             uint32_t width,
+                             uint32_t height,
+                             GuiProcessedData& gui_data,
+                             AiProcessedData& ai_data,
+                             bool is_run_ai);
+
+    /*
+     * 以下は検出の各段階。process_frame() の中で順に呼ばれるが、
+     * pipeline_bench で段階毎に計測できるよう単独でも呼べるようにしている
+     */
+
+    /**
+     * @brief 推論の入力を作る (INPUT_SIZE へ縮小、1/255 に正規化、BGR -> RGB)
+     * @param[in] image 入力画像 (BGR)
+     */
+    void prepare_input(const cv::Mat& image);
+
+    /**
+     * @brief prepare_input() で作った入力で推論する
+     * @param[out] outputs ネットワークの出力
+     * @return true 成功 / false モデルが読み込めていない
+     */
+    bool run_inference(std::vector<cv::Mat>& outputs);
+
+    /**
+     * @brief YOLOv8 の出力を検出結果に直し、NMS で重なりを除く
+     * @param[in]  output        run_inference() の出力の先頭
+     * @param[in]  image_width   推論した画像の横幅 [px]
+     * @param[in]  image_height  推論した画像の高さ [px]
+     * @param[out] out_resistors 検出結果のリスト (クリアしてから追加される。座標は推論した画像のもの)
+     */
+    void decode_detections(const cv::Mat& output,
+                           int image_width,
+                           int image_height,
+                           std::vector<ResistorInfo>& out_resistors) const;
+
+    /**
+     * @brief 検出結果（枠線や数値）を画像に描画する
+     * @param[in,out] image      描画対象の画像 (BGR)
+     * @param[in]     resistors  描画する抵抗情報のリスト（座標は全解像度）
+     * @param[in]     scale      全解像度に対する描画先画像の倍率
+     */
+    void draw_results(cv::Mat& image, const std::vector<ResistorInfo>& resistors, double scale);
+
 private:
+    /**
+     * @brief 全解像度のBGR画像で推論・抵抗値推定・追跡を行う
+     * @param[in]  image     入力画像 (BGR、全解像度)
+     * @param[out] resistors 検出結果
+     */
+    void analyze(const cv::Mat& image, std::vector<ResistorInfo>& resistors);
+
+    /**
+     * @brief GUI用画像を縮小・描画・圧縮する (process_frame の手順4-6)
+     * @param[in]  gui_mat      GUI用画像の元 (全解像度または融合縮小済み。描画で書き換わる)
+     * @param[in]  width        全解像度の横幅
+     * @param[in]  height       全解像度の高さ
+     * @param[in]  target_scale 全解像度に対するGUI用画像の倍率
+     * @param[in]  resistors    描画する検出結果
+     * @param[out] gui_data     GUI送信用の処理結果格納先
+     */
+    bool encode_gui(cv::Mat* gui_mat,
+                    uint32_t width,
+                    uint32_t height,
+                    double target_scale,
+                    const std::vector<ResistorInfo>& resistors,
+                    GuiProcessedData& gui_data);
+
     /**
      * @brief AI推論を実行し、抵抗の位置を検出する
      * @param[in]  input_image   入力画像 (BGR)
@@ -112,26 +233,9 @@ private:
      */
     double estimate_resistance_value(const cv::Mat& full_image, const cv::Rect& box);
 
-    /**
-     * @brief 検出結果（枠線や数値）を画像に描画する
-     * @param[in,out] image      描画対象の画像 (BGR)
-     * @param[in]     resistors  描画する抵抗情報のリスト
-     */
-    void draw_results(cv::Mat& image, const std::vector<ResistorInfo>& resistors);
-
-    /**
-     * @brief BGR画像をTurboJPEGを使用して高速にJPEG圧縮する
-     * @param[in]  bgr_mat 入力画像 (OpenCV Mat)
-     * @param[in]  quality 圧縮品質 (1-100)
-     * @param[out] jpeg    圧縮データの出力先ベクタ
-     * @return true 成功 / false 失敗
-     */
-    bool bgr_to_jpeg(const cv::Mat& bgr_mat, int quality, std::vector<uint8_t>& jpeg);
-
     cv::Mat get_roi_resistor_image(const cv::Mat& base_image, const cv::Rect& box);
 
-    int jpeg_quality_;          /**< JPEG圧縮品質 */
-    uint32_t resize_width_;     /**< リサイズ幅 (現在未使用だが拡張用に保持) */
+    uint32_t resize_width_;     /**< GUI送信用画像の横幅 (0 = 等倍) */
 
     // AIモデル関連
     cv::dnn::Net net_;          /**< OpenCV DNN ネットワークインスタンス */
@@ -140,9 +244,21 @@ private:
     const float CONF_THRESHOLD = 0.45f; /**< 検出信頼度の閾値 */
     const float NMS_THRESHOLD  = 0.50f; /**< NMS（重なり除去）の閾値 */
     const int INPUT_SIZE = 640;         /**< YOLOv8モデルの入力サイズ (640x640) */
+    const float TRACK_IOU_THRESHOLD = 0.30f;    /**< 前回の検出と同じ抵抗とみなす重なり */
+    const uint32_t TRACK_MAX_MISSED = 3;        /**< 見失ってもIDを残す推論回数 */
 
     cv::Mat blob_;
-    tjhandle tj_instance_;
+    cv::Mat gui_fused_;         /**< YUYVから融合縮小したGUI送信用画像の再利用バッファ */
+    cv::Mat scaled_;            /**< 縮小したGUI送信用画像の再利用バッファ */
+    std::vector<cv::Rect> gui_rois_;    /**< GUI解像度での抵抗領域（領域別画質用） */
+    double output_scale_;       /**< GUI送信用画像の縮小率 */
+    bool draw_overlay_;         /**< GUI送信用画像に検出結果を描画する */
+    std::unique_ptr<VideoEncoder> encoder_;    /**< GUI送信用エンコーダ */
+    tjhandle tj_decompress_;    /**< MJPEG 入力用の TurboJPEG 展開ハンドル */
+
+    IouTracker tracker_;                /**< 検出結果のトラッカ */
+    std::vector<cv::Rect> track_boxes_; /**< トラッカへ渡す矩形の再利用バッファ */
+    std::vector<uint32_t> track_ids_;   /**< トラッカの結果の再利用バッファ */
 };
 
 #endif // IMAGE_PROCESSOR_HPP_
@@ -0,0 +1,69 @@
+/**
+ * @file    iou_tracker.hpp
+ * @brief   矩形の重なり (IoU) で検出結果にフレームをまたぐIDを振るトラッカ
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef IOU_TRACKER_HPP_
+#define IOU_TRACKER_HPP_
+
+#include <cstdint>
+#include <vector>
+
+#include <opencv2/core.hpp>
+
+/**
+ * @brief 前回の矩形と最も重なる検出に同じIDを引き継ぐ簡易トラッカ
+ * @details 重なりの大きい組から順に貪欲に対応付ける。対応しなかった検出には新しいIDを振り、
+ *          max_missed 回続けて見つからなかったトラックは消す
+ */
+class IouTracker {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] iou_threshold 同じ物体とみなす最小の IoU (0-1)
+     * @param[in] max_missed    見失ってもトラックを残す更新回数
+     */
+    IouTracker(float iou_threshold, uint32_t max_missed);
+
+    /**
+     * @brief 新しい検出結果でトラックを更新し、各検出のIDを返す
+     * @param[in]  boxes 検出矩形
+     * @param[out] ids   boxes と同じ順のトラックID (1 以上)
+     */
+    void update(const std::vector<cv::Rect>& boxes, std::vector<uint32_t>& ids);
+
+    /**
+     * @brief 全てのトラックを消す (IDの採番は続ける)
+     */
+    void reset();
+
+private:
+    /**
+     * @brief 追跡中の物体
+     */
+    struct Track {
+        uint32_t id = 0;        /**< トラックID */
+        cv::Rect box;           /**< 最後に見つかった矩形 */
+        uint32_t missed = 0;    /**< 続けて見つからなかった回数 */
+    };
+
+    /**
+     * @brief 対応付けの候補
+     */
+    struct Candidate {
+        float iou;
+        size_t track;
+        size_t box;
+    };
+
+    float iou_threshold_;
+    uint32_t max_missed_;
+    uint32_t next_id_;
+    std::vector<Track> tracks_;
+    std::vector<Candidate> candidates_;     /**< 再利用バッファ */
+    std::vector<bool> track_matched_;       /**< 再利用バッファ */
+};
+
+#endif
@@ -0,0 +1,82 @@
+/**
+ * @file    rate_controller.hpp
+ * @brief   目標ビットレート・フレームレートに合わせてJPEG品質と出力解像度を調整するクラス
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef RATE_CONTROLLER_HPP_
+#define RATE_CONTROLLER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class RateController
+ * @brief 圧縮サイズと送信側のフィードバックから毎フレーム品質と縮小率を決める閉ループ制御
+ * @details
+ * - 1フレームあたりの予算 = 目標ビットレート / 目標フレームレート
+ * - 圧縮サイズの移動平均が予算を超えれば品質を下げ、品質が下限に達したら解像度を下げる
+ * - 送信バッファ溢れ（パケット破棄）や送信時間超過はAIMDで予算自体を一時的に絞る
+ */
+class RateController {
+public:
+    /**
+     * @struct Config
+     * @brief  制御パラメータ
+     */
+    struct Config {
+        uint32_t target_bitrate_kbps = 20000;   /**< 目標ビットレート [kbps] */
+        uint32_t target_fps = 15;               /**< 目標フレームレート [fps] */
+        int min_quality = 40;                   /**< JPEG品質の下限 */
+        int max_quality = 90;                   /**< JPEG品質の上限 */
+        double min_scale = 0.5;                 /**< 出力縮小率の下限 (1.0 = 等倍) */
+    };
+
+    /**
+     * @struct Feedback
+     * @brief  送信側から得られる1フレーム分の観測値
+     */
+    struct Feedback {
+        size_t encoded_bytes = 0;       /**< 今回の圧縮サイズ [byte] */
+        uint64_t send_time_us = 0;      /**< 直近フレームの送信所要時間 [us] */
+        uint64_t dropped_packets = 0;   /**< 前回更新以降に破棄されたパケット数 */
+        double loss_fraction = 0.0;     /**< 前回更新以降に届いた RTCP 受信者レポートのロス率 (0-1、届いていなければ 0) */
+    };
+
+    /**
+     * @brief コンストラクタ
+     * @param[in] config        制御パラメータ
+     * @param[in] initial_quality 初期JPEG品質
+     */
+    RateController(const Config& config, int initial_quality);
+
+    /**
+     * @brief 1フレーム分の観測値で制御量を更新する
+     * @param[in] feedback 観測値
+     */
+    void update(const Feedback& feedback);
+
+    /**
+     * @brief 次フレームに使うJPEG品質
+     */
+    int quality() const { return quality_; }
+
+    /**
+     * @brief 次フレームに使う出力縮小率 (1.0 = 等倍)
+     */
+    double scale() const { return scale_; }
+
+private:
+    Config config_;
+
+    int quality_;
+    double scale_;
+
+    double frame_budget_bytes_;     /**< 目標から求めた1フレームの予算 [byte] */
+    double budget_gain_;            /**< 輻輳時に予算へ掛ける係数 (AIMD, 0-1) */
+    double avg_bytes_;              /**< 圧縮サイズの指数移動平均 [byte] */
+    uint32_t hold_frames_;          /**< 解像度変更直後に制御を止めるフレーム数 */
+};
+
+#endif // RATE_CONTROLLER_HPP_
@@ -0,0 +1,215 @@
+/**
+ * @file    video_encoder.hpp
+ * @brief   GUI送信用画像エンコーダの抽象クラスと実装（TurboJPEG / H.264）
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef VIDEO_ENCODER_HPP_
+#define VIDEO_ENCODER_HPP_
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <turbojpeg.h>
+
+#include <opencv2/core.hpp>
+
+/**
+ * @class VideoEncoder
+ * @brief 描画済みBGR画像を送信用のバイト列へ圧縮するエンコーダの基底クラス
+ */
+class VideoEncoder {
+public:
+    /**
+     * @brief 出力コーデック種別
+     */
+    enum class Codec {
+        JPEG,   /**< 1フレーム1枚のJPEG (MJPEG) */
+        H264    /**< H.264 Annex-B バイトストリーム */
+    };
+
+    virtual ~VideoEncoder() = default;
+
+    /**
+     * @brief 1フレームを圧縮する
+     * @param[in]  bgr         入力画像 (BGR, 8bit 3ch)
+     * @param[out] out         圧縮データの出力先
+     * @param[out] is_keyframe 単独でデコード可能なフレームならtrue
+     * @return true 成功 / false 失敗
+     */
+    virtual bool encode(const cv::Mat& bgr, std::vector<uint8_t>& out, bool& is_keyframe) = 0;
+
+    /**
+     * @brief 出力コーデック種別を取得する
+     */
+    virtual Codec codec() const = 0;
+
+    /**
+     * @brief 次フレームをキーフレームにする（JPEGは常にキーフレームなので何もしない）
+     */
+    virtual void request_keyframe() {}
+
+    /**
+     * @brief 圧縮品質を変更する（品質指定を持たないエンコーダでは何もしない）
+     * @param quality 圧縮品質 (1-100)
+     */
+    virtual void set_quality(int quality) { (void)quality; }
+
+    /**
+     * @brief 高画質を維持する領域を指定する（領域別画質に対応しないエンコーダでは何もしない）
+     * @param rois 高画質領域のリスト（エンコード対象画像の座標系。画像外にはみ出した部分は無視する）
+     */
+    virtual void set_regions_of_interest(const std::vector<cv::Rect>& rois) { (void)rois; }
+};
+
+/**
+ * @class JpegEncoder
+ * @brief TurboJPEGによるJPEGエンコーダ
+ * @details
+ * 領域別画質モードでは、全体を quality で圧縮した後、TurboJPEGの可逆変換
+ * (tjTransform) の customFilter でROI外の 16x16 マクロブロックのDCT係数を
+ * background_quality の量子化テーブル相当に再量子化する。
+ * 量子化テーブルは高画質のままなので、ROI内 (抵抗のカラーコード) の画質は落ちない。
+ */
+class JpegEncoder : public VideoEncoder {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param quality            JPEG圧縮品質 (1-100)。領域別画質モードではROI内の品質
+     * @param background_quality ROI外の品質 (1-100)。0なら領域別画質モードを使わない
+     * @param subsampling        色差の間引き (TJSAMP_444 / TJSAMP_422 / TJSAMP_420)
+     */
+    explicit JpegEncoder(int quality, int background_quality = 0, int subsampling = TJSAMP_444);
+
+    /**
+     * @brief 色差の間引きを文字列から変換する ("444" / "422" / "420")
+     * @param[in]  name        間引き名
+     * @param[out] subsampling 変換結果 (TJSAMP_*)
+     * @return true 成功 / false 未知の名前
+     */
+    static bool parse_subsampling(const std::string& name, int& subsampling);
+
+    ~JpegEncoder() override;
+
+    JpegEncoder(const JpegEncoder&) = delete;
+    JpegEncoder& operator=(const JpegEncoder&) = delete;
+
+    bool encode(const cv::Mat& bgr, std::vector<uint8_t>& out, bool& is_keyframe) override;
+
+    Codec codec() const override { return Codec::JPEG; }
+
+    void set_quality(int quality) override;
+
+    void set_regions_of_interest(const std::vector<cv::Rect>& rois) override;
+
+private:
+    /**
+     * @brief ROI外のブロックを再量子化する (tjtransform::customFilter)
+     */
+    static int requantize_filter(short* coeffs,
+                                 tjregion array_region,
+                                 tjregion plane_region,
+                                 int component_index,
+                                 int transform_index,
+                                 tjtransform* transform);
+
+    /**
+     * @brief 現在の quality_ / background_quality_ から再量子化の比率表を作る
+     */
+    void update_requantize_table();
+
+    int quality_;               /**< JPEG圧縮品質 */
+    int subsampling_;           /**< 色差の間引き (TJSAMP_*) */
+    tjhandle tj_instance_;      /**< TurboJPEG圧縮ハンドル */
+
+    int background_quality_;    /**< ROI外の品質 (0 = 領域別画質モード無効) */
+    tjhandle tj_transform_;     /**< TurboJPEG変換ハンドル (領域別画質モード時のみ) */
+
+    int width_ = 0;             /**< エンコード中の画像幅 [px] */
+    int height_ = 0;            /**< エンコード中の画像高さ [px] */
+    int mask_cols_ = 0;         /**< ROIマスクの横マクロブロック数 */
+    std::vector<uint8_t> roi_mask_;     /**< 16x16マクロブロック単位のROIマスク */
+    std::vector<cv::Rect> rois_;        /**< 次フレームのROI */
+
+    int requantize_quality_ = -1;       /**< 比率表を作った時の quality_ */
+    float requantize_ratio_[2][64];     /**< 低画質テーブル / 高画質テーブル (輝度, 色差) */
+};
+
+#if defined(ENABLE_H264)
+
+struct AVCodecContext;
+struct AVFrame;
+struct AVPacket;
+struct SwsContext;
+
+/**
+ * @class H264Encoder
+ * @brief libavcodec (libx264 ultrafast / zerolatency) による低遅延H.264エンコーダ
+ * @note  Bフレームは使用しない。SPS/PPSはキーフレーム毎にインバンドで出力される。
+ */
+class H264Encoder : public VideoEncoder {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param bitrate_kbps 目標ビットレート [kbps]
+     * @param gop          キーフレーム間隔 [frame]
+     * @param fps          想定フレームレート（レート制御の基準）
+     */
+    H264Encoder(uint32_t bitrate_kbps, uint32_t gop, uint32_t fps);
+
+    ~H264Encoder() override;
+
+    H264Encoder(const H264Encoder&) = delete;
+    H264Encoder& operator=(const H264Encoder&) = delete;
+
+    bool encode(const cv::Mat& bgr, std::vector<uint8_t>& out, bool& is_keyframe) override;
+
+    Codec codec() const override { return Codec::H264; }
+
+    void request_keyframe() override { force_keyframe_ = true; }
+
+private:
+    /**
+     * @brief 画像サイズに合わせてコーデックを(再)初期化する
+     */
+    bool open_codec(int width, int height);
+    void close_codec();
+
+    uint32_t bitrate_kbps_;
+    uint32_t gop_;
+    uint32_t fps_;
+
+    AVCodecContext* codec_ctx_ = nullptr;
+    AVFrame* frame_ = nullptr;
+    AVPacket* packet_ = nullptr;
+    SwsContext* sws_ctx_ = nullptr;
+
+    int64_t next_pts_ = 0;
+    bool force_keyframe_ = false;
+};
+
+#endif // ENABLE_H264
+
+/**
+ * @brief 設定値からエンコーダを生成する
+ * @param codec        "jpeg" または "h264"
+ * @param jpeg_quality JPEG圧縮品質 (1-100)
+ * @param bitrate_kbps H.264 目標ビットレート [kbps]
+ * @param gop          H.264 キーフレーム間隔 [frame]
+ * @param fps          H.264 想定フレームレート
+ * @param background_quality JPEG 領域別画質モードのROI外品質 (0 = 無効)
+ * @param jpeg_subsampling   JPEG の色差の間引き (TJSAMP_*)
+ * @return 生成したエンコーダ。H.264が無効なビルドでは警告を出してJPEGを返す
+ */
+std::unique_ptr<VideoEncoder> create_video_encoder(const std::string& codec,
+                                                   int jpeg_quality,
+                                                   uint32_t bitrate_kbps,
+                                                   uint32_t gop,
+                                                   uint32_t fps,
+                                                   int background_quality = 0,
+                                                   int jpeg_subsampling = TJSAMP_444);
+
+#endif // VIDEO_ENCODER_HPP_
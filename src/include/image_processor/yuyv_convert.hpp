@@ -0,0 +1,58 @@
+/**
+ * @file    yuyv_convert.hpp
+ * @brief   YUYV -> BGR 変換と面積平均縮小を1パスで行う関数
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef YUYV_CONVERT_HPP_
+#define YUYV_CONVERT_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 融合縮小に使える縮小係数を求める
+ * @details 2のべき乗 (2, 4, 8) かつ width, height を割り切れる係数のうち、
+ *          max_factor 以下で最大のものを返す
+ * @param[in] width      入力画像の横幅 [px]
+ * @param[in] height     入力画像の高さ [px]
+ * @param[in] max_factor 許容する最大の縮小係数
+ * @return 縮小係数。融合縮小できない場合は 1
+ */
+uint32_t yuyv_downscale_factor(uint32_t width, uint32_t height, double max_factor);
+
+/**
+ * @brief YUYV画像を factor x factor の面積平均で縮小しながらBGRへ変換する
+ * @details
+ * 縦方向の画素加算をSIMD (GCCベクタ拡張: NEON / SSE2) で行い、
+ * 横方向の加算と色変換 (BT.601 limited range, cv::COLOR_YUV2BGR_YUYV と同じ係数) は
+ * 縮小後の画素数だけ計算する。全解像度のBGR画像を経由しないため、
+ * 変換と縮小を別々に行うよりメモリ帯域が小さい。
+ * @param[in]  yuyv    入力画像 (YUYV, 行ピッチ = width * 2)
+ * @param[in]  width   入力画像の横幅 [px]
+ * @param[in]  height  入力画像の高さ [px]
+ * @param[in]  factor  縮小係数 (yuyv_downscale_factor() の戻り値、2以上)
+ * @param[out] bgr     出力先 (width / factor x height / factor, BGR)
+ * @param[in]  bgr_step 出力の行ピッチ [byte]
+ * @return true 成功 / false 係数または画像サイズが不正
+ */
+bool yuyv_to_bgr_downscale(const uint8_t* yuyv,
+                           uint32_t width,
+                           uint32_t height,
+                           uint32_t factor,
+                           uint8_t* bgr,
+                           size_t bgr_step);
+
+/**
+ * @brief BGR画像をYUYVへ変換する（保存画像の再生・テストパターン用）
+ * @details BT.601 limited range (yuyv_to_bgr_downscale() の逆変換)。色差は横2画素の平均
+ * @param[in]  bgr      入力画像 (BGR)
+ * @param[in]  bgr_step 入力の行ピッチ [byte]
+ * @param[in]  width    横幅 [px] (偶数)
+ * @param[in]  height   高さ [px]
+ * @param[out] yuyv     出力先 (行ピッチ = width * 2)
+ */
+void bgr_to_yuyv(const uint8_t* bgr, size_t bgr_step, uint32_t width, uint32_t height, uint8_t* yuyv);
+
+#endif // YUYV_CONVERT_HPP_
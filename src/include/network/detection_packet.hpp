@@ -0,0 +1,209 @@
+/**
+ * @file    detection_packet.hpp
+ * @brief   検出結果メタデータパケット (独自形式 v1) の読み書きヘルパ
+ * @details
+ * 1フレーム分の検出結果を1データグラムで映像と同じ送信先へ送る。
+ * 受信側は先頭のマジックで映像のチャンク ("WF") と見分け、枠や抵抗値を自分で描画する。
+ * 対応する画像とはキャプチャ時刻で突き合わせる (フレームIDは送信スレッドが後で振るため)。
+ * マルチバイト値はネットワークバイトオーダ。
+ *
+ * | offset | size | 内容                                          |
+ * |-------:|-----:|-----------------------------------------------|
+ * |      0 |    2 | マジック 0x5744 ("WD")                        |
+ * |      2 |    1 | バージョン (1)                                |
+ * |      3 |    1 | 予約 (0)                                      |
+ * |      4 |    2 | ストリームID (カメラ毎)                       |
+ * |      6 |    2 | 検出数 n                                      |
+ * |      8 |    4 | キャプチャ番号 (カメラから取得した順で +1)    |
+ * |     12 |    8 | キャプチャ時刻 [us] (映像と同じ値)            |
+ * |     20 |    2 | 座標の基準にした画像の横幅 [px]               |
+ * |     22 |    2 | 座標の基準にした画像の高さ [px]               |
+ * |     24 | 20*n | 検出結果の列                                  |
+ *
+ * 検出結果1個
+ *
+ * | offset | size | 内容                                          |
+ * |-------:|-----:|-----------------------------------------------|
+ * |      0 |    4 | トラックID (フレームをまたいで同じ物体に同じ値、0 = 未追跡) |
+ * |      4 |    2 | 左上 x [px]                                   |
+ * |      6 |    2 | 左上 y [px]                                   |
+ * |      8 |    2 | 横幅 [px]                                     |
+ * |     10 |    2 | 高さ [px]                                     |
+ * |     12 |    2 | 確信度 (0-65535 で 0.0-1.0)                   |
+ * |     14 |    2 | 予約 (0)                                      |
+ * |     16 |    4 | 抵抗値 [Ω] (IEEE 754 単精度、負 = 不明)       |
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef DETECTION_PACKET_HPP_
+#define DETECTION_PACKET_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+/** @brief 固定部の長さ [byte] */
+constexpr size_t DETECTION_PACKET_HEADER_SIZE = 24;
+
+/** @brief 検出結果1個の長さ [byte] */
+constexpr size_t DETECTION_RECORD_SIZE = 20;
+
+/** @brief マジック ("WD") */
+constexpr uint16_t DETECTION_PACKET_MAGIC = 0x5744;
+
+/** @brief バージョン */
+constexpr uint8_t DETECTION_PACKET_VERSION = 1;
+
+/** @brief 1パケットに入れる検出結果の最大数 (1400 byte のペイロードに収まる数) */
+constexpr size_t DETECTION_PACKET_MAX_COUNT = 64;
+
+/**
+ * @brief 検出結果1個
+ */
+struct DetectionRecord {
+    uint32_t track_id = 0;          /**< トラックID (0 = 未追跡) */
+    uint16_t x = 0;                 /**< 左上 x [px] */
+    uint16_t y = 0;                 /**< 左上 y [px] */
+    uint16_t width = 0;             /**< 横幅 [px] */
+    uint16_t height = 0;            /**< 高さ [px] */
+    float confidence = 0.0f;        /**< 確信度 (0.0 - 1.0) */
+    float resistance_value = -1.0f; /**< 抵抗値 [Ω] (負 = 不明) */
+};
+
+/**
+ * @brief 1フレーム分の検出結果
+ */
+struct DetectionPacket {
+    uint16_t stream_id = 0;         /**< ストリームID */
+    uint32_t capture_index = 0;     /**< キャプチャ番号 */
+    uint64_t timestamp_us = 0;      /**< キャプチャ時刻 [us] */
+    uint16_t image_width = 0;       /**< 座標の基準にした画像の横幅 [px] */
+    uint16_t image_height = 0;      /**< 座標の基準にした画像の高さ [px] */
+    std::vector<DetectionRecord> detections;    /**< 検出結果 */
+};
+
+/**
+ * @brief 検出結果パケットをネットワークバイトオーダで書き込む
+ * @param[out] dst    書き込み先 (必要な長さに変更される)
+ * @param[in]  packet 検出結果 (DETECTION_PACKET_MAX_COUNT を超える分は切り捨てる)
+ * @return 書き込んだ長さ [byte]
+ */
+inline size_t write_detection_packet(std::vector<uint8_t>& dst, const DetectionPacket& packet)
+{
+    const size_t count = (packet.detections.size() < DETECTION_PACKET_MAX_COUNT)
+                       ? packet.detections.size() : DETECTION_PACKET_MAX_COUNT;
+    const size_t length = DETECTION_PACKET_HEADER_SIZE + DETECTION_RECORD_SIZE * count;
+
+    dst.resize(length);
+    uint8_t* p = dst.data();
+
+    p[0] = static_cast<uint8_t>(DETECTION_PACKET_MAGIC >> 8);
+    p[1] = static_cast<uint8_t>(DETECTION_PACKET_MAGIC);
+    p[2] = DETECTION_PACKET_VERSION;
+    p[3] = 0;
+    p[4] = static_cast<uint8_t>(packet.stream_id >> 8);
+    p[5] = static_cast<uint8_t>(packet.stream_id);
+    p[6] = static_cast<uint8_t>(count >> 8);
+    p[7] = static_cast<uint8_t>(count);
+    p[8] = static_cast<uint8_t>(packet.capture_index >> 24);
+    p[9] = static_cast<uint8_t>(packet.capture_index >> 16);
+    p[10] = static_cast<uint8_t>(packet.capture_index >> 8);
+    p[11] = static_cast<uint8_t>(packet.capture_index);
+    for (int i = 0; i < 8; ++i) {
+        p[12 + i] = static_cast<uint8_t>(packet.timestamp_us >> (56 - 8 * i));
+    }
+    p[20] = static_cast<uint8_t>(packet.image_width >> 8);
+    p[21] = static_cast<uint8_t>(packet.image_width);
+    p[22] = static_cast<uint8_t>(packet.image_height >> 8);
+    p[23] = static_cast<uint8_t>(packet.image_height);
+
+    for (size_t i = 0; i < count; ++i) {
+        const DetectionRecord& d = packet.detections[i];
+        uint8_t* r = p + DETECTION_PACKET_HEADER_SIZE + DETECTION_RECORD_SIZE * i;
+
+        const float clamped = (d.confidence < 0.0f) ? 0.0f : (d.confidence > 1.0f) ? 1.0f : d.confidence;
+        const uint16_t confidence = static_cast<uint16_t>(clamped * 65535.0f + 0.5f);
+
+        uint32_t resistance_bits;
+        std::memcpy(&resistance_bits, &d.resistance_value, sizeof(resistance_bits));
+
+        r[0] = static_cast<uint8_t>(d.track_id >> 24);
+        r[1] = static_cast<uint8_t>(d.track_id >> 16);
+        r[2] = static_cast<uint8_t>(d.track_id >> 8);
+        r[3] = static_cast<uint8_t>(d.track_id);
+        r[4] = static_cast<uint8_t>(d.x >> 8);
+        r[5] = static_cast<uint8_t>(d.x);
+        r[6] = static_cast<uint8_t>(d.y >> 8);
+        r[7] = static_cast<uint8_t>(d.y);
+        r[8] = static_cast<uint8_t>(d.width >> 8);
+        r[9] = static_cast<uint8_t>(d.width);
+        r[10] = static_cast<uint8_t>(d.height >> 8);
+        r[11] = static_cast<uint8_t>(d.height);
+        r[12] = static_cast<uint8_t>(confidence >> 8);
+        r[13] = static_cast<uint8_t>(confidence);
+        r[14] = 0;
+        r[15] = 0;
+        r[16] = static_cast<uint8_t>(resistance_bits >> 24);
+        r[17] = static_cast<uint8_t>(resistance_bits >> 16);
+        r[18] = static_cast<uint8_t>(resistance_bits >> 8);
+        r[19] = static_cast<uint8_t>(resistance_bits);
+    }
+
+    return length;
+}
+
+/**
+ * @brief 検出結果パケットを読み出す
+ * @param[in]  src    データグラム先頭
+ * @param[in]  length データグラム長 [byte]
+ * @param[out] packet 読み出した検出結果
+ * @return true 成功 / false 長さ不足・マジックまたはバージョン不一致
+ */
+inline bool read_detection_packet(const uint8_t* src, size_t length, DetectionPacket& packet)
+{
+    if (length < DETECTION_PACKET_HEADER_SIZE) {
+        return false;
+    }
+    if (((src[0] << 8) | src[1]) != DETECTION_PACKET_MAGIC || src[2] != DETECTION_PACKET_VERSION) {
+        return false;
+    }
+
+    const size_t count = static_cast<size_t>((src[6] << 8) | src[7]);
+    if (length < DETECTION_PACKET_HEADER_SIZE + DETECTION_RECORD_SIZE * count) {
+        return false;
+    }
+
+    packet.stream_id = static_cast<uint16_t>((src[4] << 8) | src[5]);
+    packet.capture_index = (static_cast<uint32_t>(src[8]) << 24) | (static_cast<uint32_t>(src[9]) << 16)
+                         | (static_cast<uint32_t>(src[10]) << 8) | src[11];
+    packet.timestamp_us = 0;
+    for (int i = 0; i < 8; ++i) {
+        packet.timestamp_us = (packet.timestamp_us << 8) | src[12 + i];
+    }
+    packet.image_width = static_cast<uint16_t>((src[20] << 8) | src[21]);
+    packet.image_height = static_cast<uint16_t>((src[22] << 8) | src[23]);
+
+    packet.detections.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* r = src + DETECTION_PACKET_HEADER_SIZE + DETECTION_RECORD_SIZE * i;
+        DetectionRecord& d = packet.detections[i];
+
+        d.track_id = (static_cast<uint32_t>(r[0]) << 24) | (static_cast<uint32_t>(r[1]) << 16)
+                   | (static_cast<uint32_t>(r[2]) << 8) | r[3];
+        d.x = static_cast<uint16_t>((r[4] << 8) | r[5]);
+        d.y = static_cast<uint16_t>((r[6] << 8) | r[7]);
+        d.width = static_cast<uint16_t>((r[8] << 8) | r[9]);
+        d.height = static_cast<uint16_t>((r[10] << 8) | r[11]);
+        d.confidence = static_cast<float>((r[12] << 8) | r[13]) / 65535.0f;
+
+        const uint32_t resistance_bits = (static_cast<uint32_t>(r[16]) << 24) | (static_cast<uint32_t>(r[17]) << 16)
+                                       | (static_cast<uint32_t>(r[18]) << 8) | r[19];
+        std::memcpy(&d.resistance_value, &resistance_bits, sizeof(d.resistance_value));
+    }
+
+    return true;
+}
+
+#endif
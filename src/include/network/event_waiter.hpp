@@ -0,0 +1,69 @@
+/**
+ * @file    event_waiter.hpp
+ * @brief   eventfd による消費者スレッドの起床通知
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef EVENT_WAITER_HPP_
+#define EVENT_WAITER_HPP_
+
+#include <atomic>
+
+/**
+ * @brief ロックフリーの列と組み合わせて使う、1消費者スレッドの待機・起床
+ * @details 消費者は眠る前に「眠る」と宣言してから列を確かめ直し、生産者は列に入れた後で
+ *          宣言を見た時だけ eventfd に書く。消費者が起きている間はシステムコールを使わない
+ */
+class EventWaiter {
+public:
+    EventWaiter();
+    ~EventWaiter();
+
+    EventWaiter(const EventWaiter&) = delete;
+    EventWaiter& operator=(const EventWaiter&) = delete;
+
+    /**
+     * @brief 消費者を起こす（生産者スレッド・任意のスレッドから呼び出し可。列に入れた後に呼ぶ）
+     */
+    void notify(void);
+
+    /**
+     * @brief has_work() が true になるか、通知・タイムアウトまで待つ（消費者スレッドのみ）
+     * @param[in] timeout_ms 最大待ち時間 [ms] (-1 = 無期限)
+     * @param[in] has_work   待つ必要がないかを返す関数
+     */
+    template <typename Predicate>
+    void wait(int timeout_ms, Predicate has_work)
+    {
+        if (has_work()) {
+            return;
+        }
+
+        sleeping_.store(true, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // 宣言の前に入った要素の通知は来ないので、宣言後にもう一度確かめる
+        if (!has_work()) {
+            wait_event(timeout_ms);
+        }
+
+        sleeping_.store(false, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief 初期化に成功したか
+     */
+    bool is_valid(void) const { return event_fd_ >= 0; }
+
+private:
+    /**
+     * @brief eventfd が読めるまで待ち、カウンタを読み捨てる
+     */
+    void wait_event(int timeout_ms);
+
+    int event_fd_;
+    std::atomic<bool> sleeping_;    /**< 消費者が eventfd で待とうとしている */
+};
+
+#endif
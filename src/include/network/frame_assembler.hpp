@@ -0,0 +1,160 @@
+/**
+ * @file    frame_assembler.hpp
+ * @brief   分割送信されたフレーム (独自形式 v1) を再構成するクラス
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef FRAME_ASSEMBLER_HPP_
+#define FRAME_ASSEMBLER_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "network/frame_packet.hpp"
+
+/**
+ * @brief フレームID毎にチャンクを集め、全チャンクが揃ったフレームを返すクラス
+ * @details 再構成用のバッファ (スロット) は起動時に確保し、フレーム毎の確保はしない。
+ *          チャンクは届いた時点でスロット内の最終位置に直接書き込む。
+ *          パリティパケットがあれば、グループ内で1個だけ欠けたチャンクを XOR で復元する。
+ *          欠けたチャンクは collect_nacks() で再送要求 (NACK) にまとめる
+ */
+class FrameAssembler {
+public:
+    /**
+     * @brief 再構成の設定
+     */
+    struct Config {
+        size_t max_frame_size = 2 * 1024 * 1024;   /**< 受け付けるフレームの最大長 [byte] (スロット1個の大きさ) */
+        size_t max_pending_frames = 4;              /**< 同時に再構成中にしておくフレーム数 (スロット数) */
+        uint32_t frame_timeout_ms = 500;            /**< 最後のパケットからこの時間 [ms] 経っても揃わないフレームは捨てる */
+        uint32_t nack_delay_ms = 10;                /**< 後続フレームが来ていなくても、この時間 [ms] 更新が無ければ再送を要求する */
+        uint32_t nack_retry_interval_ms = 20;       /**< 同じフレームへの再要求の間隔 [ms] */
+        int nack_max_retries = 2;                   /**< 1フレームあたりの最大要求回数 */
+    };
+
+    /**
+     * @brief 再構成したフレーム
+     */
+    struct Frame {
+        uint16_t stream_id = 0;         /**< ストリームID */
+        uint32_t frame_id = 0;          /**< フレームID */
+        uint64_t timestamp_us = 0;      /**< キャプチャ時刻 [us] (送信側の CLOCK_MONOTONIC) */
+        std::vector<uint8_t> data;      /**< フレームデータ (容量は呼び出し側で再利用する) */
+    };
+
+    /**
+     * @brief 再構成の統計
+     */
+    struct Stats {
+        uint64_t packets = 0;           /**< 取り込んだデータグラム数 */
+        uint64_t invalid_packets = 0;   /**< ヘッダ不正・大きさ超過で捨てたデータグラム数 */
+        uint64_t duplicate_packets = 0; /**< 重複・完成済みフレーム宛てのデータグラム数 */
+        uint64_t completed_frames = 0;  /**< 完成したフレーム数 */
+        uint64_t discarded_frames = 0;  /**< 揃わずに捨てたフレーム数 */
+        uint64_t lost_frames = 0;       /**< 完成したフレームIDの飛び (捨てたフレーム・全く届かなかったフレーム) */
+        uint64_t recovered_chunks = 0;  /**< FEC で復元したチャンク数 */
+    };
+
+    /**
+     * @brief コンストラクタ（再構成用バッファの確保）
+     * @param[in] config 再構成の設定
+     */
+    explicit FrameAssembler(const Config& config);
+
+    /**
+     * @brief データグラム1個を取り込む
+     * @param[in]  data   データグラム先頭
+     * @param[in]  length データグラム長 [byte]
+     * @param[out] frame  フレームが完成した場合の内容
+     * @return true フレームが完成した / false まだ揃っていない・不正なデータグラム
+     */
+    bool push(const uint8_t* data, size_t length, Frame& frame);
+
+    /**
+     * @brief 再送を要求すべきフレームの欠けたチャンクを集める
+     * @details タイムアウトしたフレームもここで捨てるので、パケットが途絶えても定期的に呼ぶこと
+     * @param[out] nacks 再送要求 (容量は呼び出し側で再利用する)
+     * @return 再送要求の数
+     */
+    size_t collect_nacks(std::vector<FrameNack>& nacks);
+
+    /**
+     * @brief 統計を取得する
+     */
+    const Stats& stats() const { return stats_; }
+
+private:
+    /**
+     * @brief 1フレーム分の再構成バッファ
+     */
+    struct Slot {
+        bool used = false;
+        uint16_t stream_id = 0;
+        uint32_t frame_id = 0;
+        uint64_t timestamp_us = 0;
+        uint32_t total_size = 0;
+        uint16_t chunk_count = 0;
+        uint16_t received = 0;          /**< 揃ったチャンク数 */
+        size_t chunk_size = 0;          /**< 最終以外のチャンク長 (0 = まだ不明) */
+        size_t last_chunk_length = 0;   /**< チャンク長が分かる前に届いた最終チャンクの長さ (0 = なし) */
+        uint16_t parity_groups = 0;     /**< パリティのグループ数 (0 = パリティ未着) */
+        int nacks = 0;                  /**< 再送を要求した回数 */
+        std::chrono::steady_clock::time_point updated;
+        std::chrono::steady_clock::time_point last_nack;
+        uint8_t* data = nullptr;        /**< フレームデータ (arena_ 内) */
+        uint8_t* parity = nullptr;      /**< パリティ (グループ番号 * chunk_size の位置、parity_arena_ 内) */
+        std::vector<uint8_t> has_chunk;     /**< チャンク毎の受信済みフラグ */
+        std::vector<uint8_t> has_parity;    /**< グループ毎のパリティ受信済みフラグ */
+    };
+
+    /**
+     * @brief ストリーム毎の状態
+     */
+    struct StreamState {
+        bool has_completed = false;
+        uint32_t last_completed = 0;    /**< 最後に完成させたフレームID */
+        bool has_newest = false;
+        uint32_t newest = 0;            /**< 受信した中で最も新しいフレームID (has_newest の時のみ有効) */
+    };
+
+    /**
+     * @brief フレームのスロットを探し、無ければ割り当てる
+     * @return スロット (割り当てられなければ nullptr)
+     */
+    Slot* find_slot(const FramePacketHeader& header, std::chrono::steady_clock::time_point now);
+
+    /**
+     * @brief チャンク長が分かった時に、スロットの大きさに収まるか確かめる
+     * @details 先に届いていた最終チャンクの長さが合わなければ、そのチャンクを捨てて再送を待つ
+     */
+    bool set_chunk_size(Slot& slot, size_t chunk_size);
+
+    /**
+     * @brief グループ内で欠けているチャンクが1個だけなら、パリティとの XOR で復元する
+     */
+    void recover(Slot& slot, uint16_t group);
+
+    /**
+     * @brief チャンク index の長さ
+     */
+    static size_t chunk_length(const Slot& slot, size_t index);
+
+    /**
+     * @brief スロットを空きにする
+     */
+    void release(Slot& slot);
+
+    Config config_;
+    std::vector<uint8_t> arena_;            /**< フレームデータ用 (max_frame_size * スロット数) */
+    std::vector<uint8_t> parity_arena_;     /**< パリティ用 (スロット毎に max_frame_size + 最大データグラム長) */
+    std::vector<Slot> slots_;
+    std::unordered_map<uint16_t, StreamState> streams_;
+    Stats stats_;
+};
+
+#endif
@@ -0,0 +1,231 @@
+/**
+ * @file    frame_packet.hpp
+ * @brief   フレーム分割送信用パケットヘッダ (独自形式 v1) の読み書きヘルパ
+ * @details
+ * 1フレーム (JPEG等) を複数のデータグラムに分割し、各データグラムの先頭に
+ * 以下のヘッダを付ける。マルチバイト値はネットワークバイトオーダ。
+ *
+ * | offset | size | 内容                                          |
+ * |-------:|-----:|-----------------------------------------------|
+ * |      0 |    2 | マジック 0x5746 ("WF")                        |
+ * |      2 |    1 | バージョン (1)                                |
+ * |      3 |    1 | フラグ (FRAME_PACKET_FLAG_*)                  |
+ * |      4 |    2 | ストリームID (カメラ毎)                       |
+ * |      6 |    2 | チャンク番号 (0 始まり)                       |
+ * |      8 |    2 | チャンク総数                                  |
+ * |     10 |    2 | パリティのグループ数 (パリティパケットのみ)   |
+ * |     12 |    4 | フレームID (ストリーム毎に送信順で +1)        |
+ * |     16 |    4 | フレーム総バイト数                            |
+ * |     20 |    8 | キャプチャ時刻 [us] (送信側の CLOCK_MONOTONIC) |
+ *
+ * チャンク k のペイロードはフレーム先頭から k * (チャンク長) の位置に入る。
+ * チャンク長は最終チャンクを除いて全て同じ。
+ *
+ * FEC: FRAME_PACKET_FLAG_PARITY 付きのパケットはパリティで、チャンク番号 g、
+ * グループ数 n のとき、チャンク g, g + n, g + 2n, ... のペイロード
+ * (チャンク長まで0詰め) の XOR を運ぶ。グループ内で1個までの欠落を復元できる。
+ * グループをチャンク番号のとびとびに取るので、n 個までの連続した欠落にも耐える。
+ *
+ * NACK: 受信側は欠けたチャンク番号を送信元 (送信ソケットのアドレス) へ返す。
+ *
+ * | offset | size      | 内容                     |
+ * |-------:|----------:|--------------------------|
+ * |      0 |         2 | マジック 0x574E ("WN")   |
+ * |      2 |         1 | バージョン (1)           |
+ * |      3 |         1 | 予約 (0)                 |
+ * |      4 |         2 | ストリームID             |
+ * |      6 |         2 | チャンク番号の個数 m     |
+ * |      8 |         4 | フレームID               |
+ * |     12 |     2 * m | 欠けたチャンク番号の列   |
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef FRAME_PACKET_HPP_
+#define FRAME_PACKET_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** @brief ヘッダ長 [byte] */
+constexpr size_t FRAME_PACKET_HEADER_SIZE = 28;
+
+/** @brief マジック ("WF") */
+constexpr uint16_t FRAME_PACKET_MAGIC = 0x5746;
+
+/** @brief ヘッダのバージョン */
+constexpr uint8_t FRAME_PACKET_VERSION = 1;
+
+/** @brief フラグ: フレームの最終チャンク */
+constexpr uint8_t FRAME_PACKET_FLAG_LAST = 0x01;
+
+/** @brief フラグ: FEC パリティパケット */
+constexpr uint8_t FRAME_PACKET_FLAG_PARITY = 0x02;
+
+/** @brief NACKパケットの固定部の長さ [byte] */
+constexpr size_t FRAME_NACK_HEADER_SIZE = 12;
+
+/** @brief NACKのマジック ("WN") */
+constexpr uint16_t FRAME_NACK_MAGIC = 0x574E;
+
+/** @brief NACK 1パケットに入れるチャンク番号の最大数 */
+constexpr size_t FRAME_NACK_MAX_CHUNKS = 512;
+
+/**
+ * @brief パケットヘッダの内容
+ */
+struct FramePacketHeader {
+    uint8_t flags = 0;              /**< FRAME_PACKET_FLAG_* の組み合わせ */
+    uint16_t stream_id = 0;         /**< ストリームID */
+    uint16_t chunk_index = 0;       /**< チャンク番号 */
+    uint16_t chunk_count = 0;       /**< チャンク総数 */
+    uint16_t parity_groups = 0;     /**< パリティのグループ数 (パリティパケットのみ) */
+    uint32_t frame_id = 0;          /**< フレームID */
+    uint32_t total_size = 0;        /**< フレーム総バイト数 */
+    uint64_t timestamp_us = 0;      /**< キャプチャ時刻 [us] */
+};
+
+/**
+ * @brief パケットヘッダをネットワークバイトオーダで書き込む
+ * @param[out] dst    書き込み先 (FRAME_PACKET_HEADER_SIZE バイト以上)
+ * @param[in]  header ヘッダの内容
+ */
+inline void write_frame_packet_header(uint8_t* dst, const FramePacketHeader& header)
+{
+    dst[0] = static_cast<uint8_t>(FRAME_PACKET_MAGIC >> 8);
+    dst[1] = static_cast<uint8_t>(FRAME_PACKET_MAGIC);
+    dst[2] = FRAME_PACKET_VERSION;
+    dst[3] = header.flags;
+    dst[4] = static_cast<uint8_t>(header.stream_id >> 8);
+    dst[5] = static_cast<uint8_t>(header.stream_id);
+    dst[6] = static_cast<uint8_t>(header.chunk_index >> 8);
+    dst[7] = static_cast<uint8_t>(header.chunk_index);
+    dst[8] = static_cast<uint8_t>(header.chunk_count >> 8);
+    dst[9] = static_cast<uint8_t>(header.chunk_count);
+    dst[10] = static_cast<uint8_t>(header.parity_groups >> 8);
+    dst[11] = static_cast<uint8_t>(header.parity_groups);
+    dst[12] = static_cast<uint8_t>(header.frame_id >> 24);
+    dst[13] = static_cast<uint8_t>(header.frame_id >> 16);
+    dst[14] = static_cast<uint8_t>(header.frame_id >> 8);
+    dst[15] = static_cast<uint8_t>(header.frame_id);
+    dst[16] = static_cast<uint8_t>(header.total_size >> 24);
+    dst[17] = static_cast<uint8_t>(header.total_size >> 16);
+    dst[18] = static_cast<uint8_t>(header.total_size >> 8);
+    dst[19] = static_cast<uint8_t>(header.total_size);
+
+    for (int i = 0; i < 8; ++i) {
+        dst[20 + i] = static_cast<uint8_t>(header.timestamp_us >> (56 - 8 * i));
+    }
+}
+
+/**
+ * @brief パケットヘッダを読み出す
+ * @param[in]  src    データグラム先頭
+ * @param[in]  length データグラム長 [byte]
+ * @param[out] header 読み出したヘッダ
+ * @return true 成功 / false 長さ不足・マジックまたはバージョン不一致
+ */
+inline bool read_frame_packet_header(const uint8_t* src, size_t length, FramePacketHeader& header)
+{
+    if (length < FRAME_PACKET_HEADER_SIZE) {
+        return false;
+    }
+    if (((src[0] << 8) | src[1]) != FRAME_PACKET_MAGIC || src[2] != FRAME_PACKET_VERSION) {
+        return false;
+    }
+
+    header.flags = src[3];
+    header.stream_id = static_cast<uint16_t>((src[4] << 8) | src[5]);
+    header.chunk_index = static_cast<uint16_t>((src[6] << 8) | src[7]);
+    header.chunk_count = static_cast<uint16_t>((src[8] << 8) | src[9]);
+    header.parity_groups = static_cast<uint16_t>((src[10] << 8) | src[11]);
+    header.frame_id = (static_cast<uint32_t>(src[12]) << 24) | (static_cast<uint32_t>(src[13]) << 16)
+                    | (static_cast<uint32_t>(src[14]) << 8) | src[15];
+    header.total_size = (static_cast<uint32_t>(src[16]) << 24) | (static_cast<uint32_t>(src[17]) << 16)
+                      | (static_cast<uint32_t>(src[18]) << 8) | src[19];
+
+    header.timestamp_us = 0;
+    for (int i = 0; i < 8; ++i) {
+        header.timestamp_us = (header.timestamp_us << 8) | src[20 + i];
+    }
+
+    return true;
+}
+
+/**
+ * @brief NACK (再送要求) の内容
+ */
+struct FrameNack {
+    uint16_t stream_id = 0;             /**< ストリームID */
+    uint32_t frame_id = 0;              /**< 再送を求めるフレームID */
+    std::vector<uint16_t> chunks;       /**< 欠けたチャンク番号 */
+};
+
+/**
+ * @brief NACKパケットをネットワークバイトオーダで書き込む
+ * @param[out] dst  書き込み先 (FRAME_NACK_HEADER_SIZE + 2 * FRAME_NACK_MAX_CHUNKS バイト以上)
+ * @param[in]  nack NACKの内容 (FRAME_NACK_MAX_CHUNKS を超えるチャンク番号は切り捨てる)
+ * @return 書き込んだ長さ [byte]
+ */
+inline size_t write_frame_nack(uint8_t* dst, const FrameNack& nack)
+{
+    const size_t count = (nack.chunks.size() < FRAME_NACK_MAX_CHUNKS) ? nack.chunks.size() : FRAME_NACK_MAX_CHUNKS;
+
+    dst[0] = static_cast<uint8_t>(FRAME_NACK_MAGIC >> 8);
+    dst[1] = static_cast<uint8_t>(FRAME_NACK_MAGIC);
+    dst[2] = FRAME_PACKET_VERSION;
+    dst[3] = 0;
+    dst[4] = static_cast<uint8_t>(nack.stream_id >> 8);
+    dst[5] = static_cast<uint8_t>(nack.stream_id);
+    dst[6] = static_cast<uint8_t>(count >> 8);
+    dst[7] = static_cast<uint8_t>(count);
+    dst[8] = static_cast<uint8_t>(nack.frame_id >> 24);
+    dst[9] = static_cast<uint8_t>(nack.frame_id >> 16);
+    dst[10] = static_cast<uint8_t>(nack.frame_id >> 8);
+    dst[11] = static_cast<uint8_t>(nack.frame_id);
+
+    for (size_t i = 0; i < count; ++i) {
+        uint8_t* p = dst + FRAME_NACK_HEADER_SIZE + 2 * i;
+        p[0] = static_cast<uint8_t>(nack.chunks[i] >> 8);
+        p[1] = static_cast<uint8_t>(nack.chunks[i]);
+    }
+
+    return FRAME_NACK_HEADER_SIZE + 2 * count;
+}
+
+/**
+ * @brief NACKパケットを読み出す
+ * @param[in]  src    データグラム先頭
+ * @param[in]  length データグラム長 [byte]
+ * @param[out] nack   読み出した内容
+ * @return true 成功 / false 長さ不足・マジックまたはバージョン不一致
+ */
+inline bool read_frame_nack(const uint8_t* src, size_t length, FrameNack& nack)
+{
+    if (length < FRAME_NACK_HEADER_SIZE) {
+        return false;
+    }
+    if (((src[0] << 8) | src[1]) != FRAME_NACK_MAGIC || src[2] != FRAME_PACKET_VERSION) {
+        return false;
+    }
+
+    const size_t count = static_cast<size_t>((src[6] << 8) | src[7]);
+    if (count > FRAME_NACK_MAX_CHUNKS || length < FRAME_NACK_HEADER_SIZE + 2 * count) {
+        return false;
+    }
+
+    nack.stream_id = static_cast<uint16_t>((src[4] << 8) | src[5]);
+    nack.frame_id = (static_cast<uint32_t>(src[8]) << 24) | (static_cast<uint32_t>(src[9]) << 16)
+                  | (static_cast<uint32_t>(src[10]) << 8) | src[11];
+
+    nack.chunks.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const uint8_t* p = src + FRAME_NACK_HEADER_SIZE + 2 * i;
+        nack.chunks[i] = static_cast<uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,33 @@
+/**
+ * @file    qdisc_probe.hpp
+ * @brief   送信先への送出インターフェースのキューイング規則 (qdisc) を調べるヘルパ
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef QDISC_PROBE_HPP_
+#define QDISC_PROBE_HPP_
+
+#include <netinet/in.h>
+#include <string>
+
+/**
+ * @brief 送信先へのパケットが出ていくインターフェース名を調べる
+ * @details UDP ソケットを送信先へ connect して経路を引き、選ばれた送信元アドレスを持つ
+ *          インターフェースを探す（パケットは送らない）
+ * @param[in]  dest      送信先アドレス
+ * @param[out] interface インターフェース名
+ * @return true 成功 / false 経路なし・該当インターフェースなし
+ */
+bool find_egress_interface(const struct sockaddr_in& dest, std::string& interface);
+
+/**
+ * @brief インターフェースに fq qdisc が付いているか調べる
+ * @details netlink で qdisc 一覧を取得し、ルート直下 (mq の子を含む) に "fq" があるか見る。
+ *          SO_MAX_PACING_RATE による UDP のペーシングは fq qdisc が行う
+ * @param[in] interface インターフェース名
+ * @return true fq あり / false fq なし・取得失敗
+ */
+bool interface_has_fq_qdisc(const std::string& interface);
+
+#endif
@@ -0,0 +1,86 @@
+/**
+ * @file    rtcp_session.hpp
+ * @brief   RTP送信側の RTCP (RFC 3550) 送信者レポート送信・受信者レポート受信クラス
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef RTCP_SESSION_HPP_
+#define RTCP_SESSION_HPP_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <netinet/in.h>
+
+/**
+ * @brief 1つのRTP送信ストリームに対する RTCP の送受信
+ * @details 送信者レポート (SR) で RTP タイムスタンプと壁時計 (NTP) の対応を知らせ、
+ *          受信側が同じソケットのアドレスへ返す受信者レポート (RR) からロス率・ジッタ・RTT を得る。
+ *          SR は RTP パケットと同じキャプチャ時刻 (CLOCK_MONOTONIC) 基準のタイムスタンプを使う
+ */
+class RtcpSession {
+public:
+    /**
+     * @brief 受信者レポートから得た受信状況
+     */
+    struct ReceptionStats {
+        uint64_t reports = 0;           /**< 受け取った受信者レポートの累計数 */
+        double fraction_lost = 0.0;     /**< 直近レポートのロス率 (前回レポート以降、0-1) */
+        int32_t cumulative_lost = 0;    /**< 直近レポートの累計ロス数 */
+        double jitter_ms = 0.0;         /**< 直近レポートの到着間隔ジッタ [ms] */
+        double rtt_ms = -1.0;           /**< 直近レポートから求めた往復時間 [ms] (-1 = 不明) */
+    };
+
+    /**
+     * @brief コンストラクタ（ソケットの作成とアドレス設定）
+     * @param[in] ip         RTCP の送信先IPアドレス (RTP の送信先)
+     * @param[in] port       RTCP の送信先ポート番号 (通常 RTP ポート + 1)
+     * @param[in] ssrc       RTP ストリームの SSRC
+     * @param[in] clock_rate RTP タイムスタンプのクロック [Hz]
+     */
+    RtcpSession(const std::string& ip, uint16_t port, uint32_t ssrc, uint32_t clock_rate);
+
+    /**
+     * @brief デストラクタ（ソケットを閉じる）
+     */
+    ~RtcpSession();
+
+    RtcpSession(const RtcpSession&) = delete;
+    RtcpSession& operator=(const RtcpSession&) = delete;
+
+    /**
+     * @brief 送信者レポートと SDES (CNAME) を送る
+     * @param[in] packet_count これまでに送った RTP パケット数
+     * @param[in] octet_count  これまでに送った RTP ペイロードの累計 [byte]
+     * @return true 送信成功 / false 送信失敗
+     */
+    bool send_sender_report(uint32_t packet_count, uint32_t octet_count);
+
+    /**
+     * @brief 届いている受信者レポートを全て読む（ブロックしない）
+     * @return 読んだレポートブロックのうち自分の SSRC 宛ての数
+     */
+    size_t poll_receiver_reports();
+
+    /**
+     * @brief 受信状況を取得する
+     */
+    const ReceptionStats& stats() const { return stats_; }
+
+private:
+    /**
+     * @brief RR / SR パケット内のレポートブロックを読む
+     */
+    size_t read_report_blocks(const uint8_t* data, size_t length, size_t block_count);
+
+    int sock_fd_;               /**< ソケットファイルディスクリプタ */
+    struct sockaddr_in addr_;   /**< RTCP 送信先アドレス */
+    uint32_t ssrc_;             /**< 自ストリームの SSRC */
+    uint32_t clock_rate_;       /**< RTP タイムスタンプのクロック [Hz] */
+    std::string cname_;         /**< SDES CNAME (user@host) */
+    ReceptionStats stats_;      /**< 受信状況 */
+    std::vector<uint8_t> buffer_;   /**< 送受信バッファ */
+};
+
+#endif
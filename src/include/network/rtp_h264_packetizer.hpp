@@ -0,0 +1,59 @@
+/**
+ * @file    rtp_h264_packetizer.hpp
+ * @brief   H.264 Annex-B ストリームをRTPパケットへ分割するクラス (RFC 6184)
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef RTP_H264_PACKETIZER_HPP_
+#define RTP_H264_PACKETIZER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @brief 1アクセスユニット分のH.264データをRTPパケット列に変換するクラス
+ * @note  パケタイゼーションモード1相当。MTUに収まるNALはSingle NAL Unit、
+ *        収まらないNALはFU-Aで分割する。アクセスユニット最終パケットにマーカビットを立てる。
+ */
+class RtpH264Packetizer {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] payload_type     RTPペイロードタイプ (動的: 96-127)
+     * @param[in] ssrc             同期送信元識別子
+     * @param[in] max_payload_size RTPヘッダを除いた1パケットの最大ペイロード [byte]
+     */
+    RtpH264Packetizer(uint8_t payload_type, uint32_t ssrc, size_t max_payload_size);
+
+    /**
+     * @brief 1アクセスユニットをRTPパケット列に変換する
+     * @param[in]  data      Annex-B 形式のアクセスユニット
+     * @param[in]  size      データサイズ [byte]
+     * @param[in]  timestamp RTPタイムスタンプ (90kHz)
+     * @param[out] packets   生成したRTPパケット (外側/内側ベクタの容量は再利用される)
+     * @return 生成したパケット数
+     */
+    size_t packetize(const uint8_t* data,
+                     size_t size,
+                     uint32_t timestamp,
+                     std::vector<std::vector<uint8_t>>& packets);
+
+private:
+    /**
+     * @brief 次に使う出力パケットを確保してRTPヘッダを書き込む
+     * @return ペイロード書き込み位置
+     */
+    uint8_t* begin_packet(std::vector<std::vector<uint8_t>>& packets,
+                          size_t& count,
+                          size_t payload_size,
+                          uint32_t timestamp);
+
+    uint8_t payload_type_;
+    uint32_t ssrc_;
+    size_t max_payload_size_;
+    uint16_t sequence_;
+};
+
+#endif
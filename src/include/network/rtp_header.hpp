@@ -0,0 +1,50 @@
+/**
+ * @file    rtp_header.hpp
+ * @brief   RTP固定ヘッダ (RFC 3550) の書き込みヘルパ
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef RTP_HEADER_HPP_
+#define RTP_HEADER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+
+/** @brief RTP固定ヘッダ長 [byte] (CSRCなし) */
+constexpr size_t RTP_HEADER_SIZE = 12;
+
+/** @brief RTPのメディアクロック [Hz] (映像は90kHz) */
+constexpr uint32_t RTP_VIDEO_CLOCK_RATE = 90000;
+
+/**
+ * @brief RTP固定ヘッダをネットワークバイトオーダで書き込む
+ * @param[out] dst          書き込み先 (RTP_HEADER_SIZE バイト以上)
+ * @param[in]  payload_type ペイロードタイプ (0-127)
+ * @param[in]  marker       マーカビット (映像ではフレーム最終パケットで1)
+ * @param[in]  sequence     シーケンス番号
+ * @param[in]  timestamp    RTPタイムスタンプ
+ * @param[in]  ssrc         同期送信元識別子
+ */
+inline void write_rtp_header(uint8_t* dst,
+                             uint8_t payload_type,
+                             bool marker,
+                             uint16_t sequence,
+                             uint32_t timestamp,
+                             uint32_t ssrc)
+{
+    dst[0] = 0x80;  // V=2, P=0, X=0, CC=0
+    dst[1] = static_cast<uint8_t>((marker ? 0x80 : 0x00) | (payload_type & 0x7f));
+    dst[2] = static_cast<uint8_t>(sequence >> 8);
+    dst[3] = static_cast<uint8_t>(sequence);
+    dst[4] = static_cast<uint8_t>(timestamp >> 24);
+    dst[5] = static_cast<uint8_t>(timestamp >> 16);
+    dst[6] = static_cast<uint8_t>(timestamp >> 8);
+    dst[7] = static_cast<uint8_t>(timestamp);
+    dst[8] = static_cast<uint8_t>(ssrc >> 24);
+    dst[9] = static_cast<uint8_t>(ssrc >> 16);
+    dst[10] = static_cast<uint8_t>(ssrc >> 8);
+    dst[11] = static_cast<uint8_t>(ssrc);
+}
+
+#endif
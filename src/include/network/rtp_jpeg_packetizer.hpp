@@ -0,0 +1,83 @@
+/**
+ * @file    rtp_jpeg_packetizer.hpp
+ * @brief   ベースラインJPEGをRTPパケットへ分割するクラス (RFC 2435)
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef RTP_JPEG_PACKETIZER_HPP_
+#define RTP_JPEG_PACKETIZER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/** @brief RTP/JPEG の静的ペイロードタイプ (RFC 3551) */
+constexpr uint8_t RTP_PAYLOAD_TYPE_JPEG = 26;
+
+/**
+ * @brief 1枚のJPEGをRTPパケット列に変換するクラス
+ * @details JPEGのマーカを解析し、スキャンデータ (エントロピー符号化部) だけを分割して送る。
+ *          受信側は RTP/JPEG ヘッダの Type・Q・幅・高さから JPEG ヘッダを作り直す。
+ *          量子化テーブルが RFC 2435 の標準テーブル (IJG の品質スケーリング) と一致する場合は
+ *          Q = 品質 (1-99) を送るだけでテーブルは送らない。一致しない場合は Q = 255 とし、
+ *          各フレームの先頭パケットにテーブルを載せる。
+ * @note  対応するのは 8bit ベースライン、YCbCr 3成分、サンプリング 4:2:2 (Type 0) / 4:2:0 (Type 1)、
+ *        幅・高さ 2040px 以下のJPEG。ハフマンテーブルは標準 (ITU-T T.81 Annex K) であること
+ *        (受信側は標準テーブルで復号する)。TurboJPEG の既定の出力はこれを満たす
+ */
+class RtpJpegPacketizer {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] ssrc             同期送信元識別子
+     * @param[in] max_payload_size RTPヘッダを除いた1パケットの最大ペイロード [byte]
+     */
+    RtpJpegPacketizer(uint32_t ssrc, size_t max_payload_size);
+
+    /**
+     * @brief 1枚のJPEGをRTPパケット列に変換する
+     * @param[in]  data      JPEGデータ (SOI から EOI まで)
+     * @param[in]  size      データサイズ [byte]
+     * @param[in]  timestamp RTPタイムスタンプ (90kHz)
+     * @param[out] packets   生成したRTPパケット (外側/内側ベクタの容量は再利用される)
+     * @return 生成したパケット数 (0 = 非対応のJPEG)
+     */
+    size_t packetize(const uint8_t* data,
+                     size_t size,
+                     uint32_t timestamp,
+                     std::vector<std::vector<uint8_t>>& packets);
+
+private:
+    /**
+     * @brief packetize() に必要なJPEGの情報
+     */
+    struct JpegInfo {
+        uint8_t type = 0;               /**< RTP/JPEG Type (0: 4:2:2, 1: 4:2:0, +64: リスタートマーカあり) */
+        uint16_t width = 0;             /**< 幅 [px] */
+        uint16_t height = 0;            /**< 高さ [px] */
+        uint16_t restart_interval = 0;  /**< リスタート間隔 [MCU] (0 = なし) */
+        const uint8_t* tables[2] = { nullptr, nullptr };    /**< 輝度・色差の量子化テーブル (ジグザグ順 64byte) */
+        const uint8_t* scan = nullptr;  /**< スキャンデータ先頭 */
+        size_t scan_size = 0;           /**< スキャンデータ長 (EOI を除く) */
+    };
+
+    /**
+     * @brief JPEGのマーカを解析する
+     * @return true 対応形式 / false 非対応・破損
+     */
+    bool parse(const uint8_t* data, size_t size, JpegInfo& info) const;
+
+    /**
+     * @brief 量子化テーブルに一致する RFC 2435 の Q 値を求める
+     * @return 1-99 一致した品質 / 255 一致しない (テーブルを送る)
+     */
+    static uint8_t find_q(const JpegInfo& info);
+
+    uint32_t ssrc_;
+    size_t max_payload_size_;
+    uint16_t sequence_;
+    bool warned_;               /**< 非対応JPEGの警告を出したか */
+};
+
+#endif
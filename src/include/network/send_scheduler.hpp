@@ -0,0 +1,140 @@
+/**
+ * @file    send_scheduler.hpp
+ * @brief   送信待ちフレーム・メタデータの順番を決めるスケジューラ
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef SEND_SCHEDULER_HPP_
+#define SEND_SCHEDULER_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <vector>
+
+/**
+ * @brief 1ストリーム分の送信待ち列
+ * @details メタデータ (検出結果など) は画像フレームより優先して送る。
+ *          画像フレームは方針 (QueuePolicy) に従って溜め・捨て・送信中フレームの打ち切りを決める。
+ *          スレッドセーフではないので、呼び出し側 (UDPSenderThread) が排他する
+ */
+class SendScheduler {
+public:
+    /**
+     * @brief 画像フレームの待ち方
+     */
+    enum class QueuePolicy {
+        LATEST,     /**< 最新1枚だけを残す。新しいフレームが来たら送信中のフレームも打ち切る (JPEG 向け) */
+        FIFO,       /**< 最大 queue_depth 枚を順に送る。溢れたら古いものから捨てる。打ち切らない */
+        KEYFRAME    /**< 最大 queue_depth 枚を順に送る。溢れたら差分フレームを捨て、次のキーフレームまで差分を送らない (H.264 向け) */
+    };
+
+    /**
+     * @brief 送信待ちの画像フレーム
+     */
+    struct Frame {
+        std::vector<uint8_t> data;      /**< 送信するバイト列 */
+        uint64_t timestamp_us = 0;      /**< キャプチャ時刻 [us] */
+        bool keyframe = true;           /**< 単独でデコードできるフレームか (JPEG は常に true) */
+    };
+
+    /**
+     * @brief 方針を文字列から変換する ("latest" / "fifo" / "keyframe")
+     * @param[in]  name   方針名
+     * @param[out] policy 変換結果
+     * @return true 成功 / false 未知の名前
+     */
+    static bool parse_policy(const std::string& name, QueuePolicy& policy);
+
+    /**
+     * @brief コンストラクタ
+     * @param[in] policy      画像フレームの待ち方
+     * @param[in] queue_depth FIFO / KEYFRAME で溜める最大フレーム数 (LATEST では 1)
+     */
+    SendScheduler(QueuePolicy policy, size_t queue_depth);
+
+    /**
+     * @brief 画像フレームを送信待ちに加える
+     * @param[in]  frame     追加するフレーム（所有権は内部へムーブ）
+     * @param[out] discarded 方針により捨てたフレームのバッファ (再利用のため返す、追加される)
+     */
+    void push_frame(Frame&& frame, std::vector<std::vector<uint8_t>>& discarded);
+
+    /**
+     * @brief 次に送る画像フレームを取り出す
+     * @return true 取り出した / false 送信待ちなし
+     */
+    bool pop_frame(Frame& frame);
+
+    /**
+     * @brief メタデータのデータグラムを送信待ちに加える (溢れたら古いものから捨てる)
+     */
+    void push_metadata(std::vector<uint8_t>&& datagram);
+
+    /**
+     * @brief 送信待ちのメタデータを全て取り出す
+     * @param[out] datagrams 取り出したデータグラム (先頭から count 個、容量は再利用される)
+     * @return 取り出した数
+     */
+    size_t pop_metadata(std::vector<std::vector<uint8_t>>& datagrams);
+
+    /**
+     * @brief 送信待ちの画像フレームがあるか
+     */
+    bool has_frame() const { return !frames_.empty(); }
+
+    /**
+     * @brief 送信待ちのメタデータがあるか
+     */
+    bool has_metadata() const { return !metadata_.empty(); }
+
+    /**
+     * @brief 送信中のフレームを打ち切って次のフレームに移るべきか
+     * @details LATEST で新しいフレームが待っている時だけ true
+     */
+    bool should_preempt() const { return policy_ == QueuePolicy::LATEST && !frames_.empty(); }
+
+    /**
+     * @brief 差分フレームを捨てたのでキーフレームが必要になったか (読むと下ろす)
+     */
+    bool take_keyframe_request();
+
+    /**
+     * @brief 全ての送信待ちを捨てる
+     */
+    void clear();
+
+    /**
+     * @brief 方針により捨てた画像フレームの累計数
+     */
+    uint64_t dropped_frames() const { return dropped_frames_; }
+
+    /**
+     * @brief 溢れて捨てたメタデータの累計数
+     */
+    uint64_t dropped_metadata() const { return dropped_metadata_; }
+
+    /**
+     * @brief 画像フレームの待ち方
+     */
+    QueuePolicy policy() const { return policy_; }
+
+private:
+    /**
+     * @brief フレームを捨てたものとして数え、バッファを discarded へ移す (列からは取り除かない)
+     */
+    void discard(Frame& frame, std::vector<std::vector<uint8_t>>& discarded);
+
+    QueuePolicy policy_;
+    size_t queue_depth_;
+    std::deque<Frame> frames_;                  /**< 送信待ちの画像フレーム (古い順) */
+    std::deque<std::vector<uint8_t>> metadata_; /**< 送信待ちのメタデータ (古い順) */
+    bool waiting_for_keyframe_;                 /**< KEYFRAME: 差分を捨てたので次のキーフレームまで差分を送らない */
+    bool keyframe_requested_;                   /**< キーフレームが必要になった (未読) */
+    uint64_t dropped_frames_;
+    uint64_t dropped_metadata_;
+};
+
+#endif
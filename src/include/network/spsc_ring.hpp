@@ -0,0 +1,110 @@
+/**
+ * @file    spsc_ring.hpp
+ * @brief   1スレッドが書き1スレッドが読むロックフリーのリングバッファ
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef SPSC_RING_HPP_
+#define SPSC_RING_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#define SPSC_CACHE_LINE_SIZE 64     /**< 書き込み位置と読み出し位置を別のキャッシュラインに置くための幅 */
+
+/**
+ * @brief 単一生産者・単一消費者のリングバッファ
+ * @details try_push() は生産者スレッドだけ、try_pop() は消費者スレッドだけが呼ぶ。
+ *          どちらもブロックせず、満杯・空なら false を返す。
+ *          要素はムーブで出し入れするので、std::vector を入れればバッファの所有権だけが移る
+ * @tparam T 要素の型 (デフォルト構築・ムーブ代入できること)
+ */
+template <typename T>
+class SpscRing {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] capacity 格納できる最大要素数 (2の冪に切り上げる)
+     */
+    explicit SpscRing(size_t capacity)
+        : mask_(round_up_pow2(capacity) - 1),
+          slots_(mask_ + 1),
+          head_(0),
+          tail_(0)
+    {
+    }
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    /**
+     * @brief 要素を追加する（生産者スレッドのみ）
+     * @param[in,out] value 追加する要素。成功した時だけムーブされる
+     * @return true 追加した / false 満杯
+     */
+    bool try_push(T& value)
+    {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+
+        if (tail - head_.load(std::memory_order_acquire) > mask_) {
+            return false;
+        }
+
+        slots_[tail & mask_] = std::move(value);
+        tail_.store(tail + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief 先頭の要素を取り出す（消費者スレッドのみ）
+     * @param[out] value 取り出した要素
+     * @return true 取り出した / false 空
+     */
+    bool try_pop(T& value)
+    {
+        const size_t head = head_.load(std::memory_order_relaxed);
+
+        if (head == tail_.load(std::memory_order_acquire)) {
+            return false;
+        }
+
+        value = std::move(slots_[head & mask_]);
+        head_.store(head + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    /**
+     * @brief 空か（どちらのスレッドからも呼び出し可。相手側の操作中は目安）
+     */
+    bool empty() const
+    {
+        return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief 格納できる最大要素数
+     */
+    size_t capacity() const { return mask_ + 1; }
+
+private:
+    static size_t round_up_pow2(size_t value)
+    {
+        size_t pow2 = 1;
+        while (pow2 < value) {
+            pow2 <<= 1;
+        }
+        return pow2;
+    }
+
+    const size_t mask_;
+    std::vector<T> slots_;
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> head_;   /**< 次に読む位置 (消費者が進める) */
+    alignas(SPSC_CACHE_LINE_SIZE) std::atomic<size_t> tail_;   /**< 次に書く位置 (生産者が進める) */
+};
+
+#endif
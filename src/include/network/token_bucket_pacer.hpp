@@ -0,0 +1,63 @@
+/**
+ * @file    token_bucket_pacer.hpp
+ * @brief   トークンバケットによる送信レート制御クラス
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef TOKEN_BUCKET_PACER_HPP_
+#define TOKEN_BUCKET_PACER_HPP_
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief 平均レートとバースト量で送信を間引くトークンバケット
+ * @details
+ * トークン (バイト) はレートに応じて溜まり、バースト量で頭打ちになる。
+ * 送信前に acquire() を呼ぶと、トークンが足りるまで待ってから消費する。
+ * 待ちは sleep で大半を過ごし、最後の短い区間だけ時刻をスピンで確認するので、
+ * スケジューラの粒度 (数十us〜) に左右されず送信間隔が揃う。
+ */
+class TokenBucketPacer {
+public:
+    /**
+     * @brief コンストラクタ
+     * @param[in] rate_mbps   平均レート [Mbit/s] (0 = 制限なし)
+     * @param[in] burst_bytes バースト量 (バケット容量) [byte]
+     */
+    TokenBucketPacer(uint32_t rate_mbps, size_t burst_bytes);
+
+    /**
+     * @brief レート制限が有効か
+     */
+    bool enabled() const { return bytes_per_second_ > 0.0; }
+
+    /**
+     * @brief バースト量を取得する [byte]
+     */
+    size_t burst_bytes() const { return burst_bytes_; }
+
+    /**
+     * @brief bytes を送信できるまで待ち、トークンを消費する
+     * @details バースト量を超える送信は、バケットが満杯になるまで待ってから送る
+     *          (不足分は借りとして次の送信の待ちに回す)
+     * @param[in] bytes 送信するバイト数
+     * @return 待った時間 [us]
+     */
+    uint64_t acquire(size_t bytes);
+
+private:
+    /**
+     * @brief 指定時刻まで待つ（終盤はスピンで精度を出す）
+     */
+    static void wait_until(std::chrono::steady_clock::time_point deadline);
+
+    double bytes_per_second_;       /**< 平均レート [byte/s] */
+    size_t burst_bytes_;            /**< バケット容量 [byte] */
+    double tokens_;                 /**< 現在のトークン [byte] (負 = 借り) */
+    std::chrono::steady_clock::time_point last_refill_;    /**< 最後にトークンを補充した時刻 */
+};
+
+#endif
@@ -0,0 +1,123 @@
+/**
+ * @file    udp_receiver.hpp
+ * @brief   UDPデータグラムをまとめて受信するクラス
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef UDP_RECEIVER_HPP_
+#define UDP_RECEIVER_HPP_
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+/**
+ * @brief 指定したポートでUDPデータグラムを受信するクラス
+ * @details 受信バッファは起動時に確保し、recvmmsg (MSG_WAITFORONE) で1回のシステムコールで
+ *          最大 batch_size 個を受け取る。受信ソケットの溢れ (SO_RXQ_OVFL) も数える。
+ *          同じソケットから送信元へ返信 (再送要求など) できる
+ */
+class UDPReceiver {
+public:
+    /**
+     * @brief 受信設定
+     */
+    struct Config {
+        size_t batch_size = 64;                 /**< recvmmsg 1回あたりの最大受信数 */
+        size_t max_datagram_size = 2048;        /**< 1データグラムの最大長 [byte] (超えた分は切り捨て、truncated_datagrams() に数える) */
+        int recv_buffer_bytes = 8 * 1024 * 1024;    /**< ソケット受信バッファ [byte] */
+        int poll_timeout_ms = 5;                /**< receive() がデータグラムを待つ最大時間 [ms] */
+        std::string multicast_group;            /**< 参加するマルチキャストグループ (空 = 参加しない) */
+        std::string multicast_interface;        /**< マルチキャストを受けるインターフェースのIP (空 = 経路表に従う) */
+    };
+
+    /**
+     * @brief コンストラクタ（ソケットの作成とバインド）
+     * @param[in] bind_ip 待ち受けIPアドレス
+     * @param[in] port    待ち受けポート番号
+     * @param[in] config  受信設定
+     */
+    UDPReceiver(const std::string& bind_ip, uint16_t port, const Config& config);
+
+    /**
+     * @brief デストラクタ（ソケットを閉じる）
+     */
+    ~UDPReceiver();
+
+    UDPReceiver(const UDPReceiver&) = delete;
+    UDPReceiver& operator=(const UDPReceiver&) = delete;
+
+    /**
+     * @brief ソケットが使用可能か
+     */
+    bool is_valid() const { return sock_fd_ >= 0; }
+
+    /**
+     * @brief データグラムをまとめて受信する
+     * @details 1個届くまで最大 poll_timeout_ms 待ち、その時点で届いている分を batch_size 個まで受け取る
+     * @return 受信したデータグラム数 (0 = タイムアウト、-1 = エラー)
+     */
+    int receive();
+
+    /**
+     * @brief 直前の receive() で受け取った i 番目のデータグラム
+     */
+    const uint8_t* data(size_t i) const { return buffers_.data() + i * config_.max_datagram_size; }
+
+    /**
+     * @brief 直前の receive() で受け取った i 番目のデータグラムの長さ [byte]
+     */
+    size_t length(size_t i) const { return msgs_[i].msg_len; }
+
+    /**
+     * @brief 直前の receive() で受け取った i 番目のデータグラムの送信元
+     */
+    const struct sockaddr_in& source(size_t i) const { return sources_[i]; }
+
+    /**
+     * @brief 受信ソケットから送信する
+     * @param[in] data   送信データ
+     * @param[in] length データ長 [byte]
+     * @param[in] dest   送信先
+     * @return true 送信成功 / false 送信失敗
+     */
+    bool send_to(const uint8_t* data, size_t length, const struct sockaddr_in& dest);
+
+    /**
+     * @brief recvmmsg の呼び出し回数 (タイムアウトを除く)
+     */
+    uint64_t receive_calls() const { return receive_calls_; }
+
+    /**
+     * @brief 受信ソケットが溢れてカーネルが捨てたデータグラム数 (SO_RXQ_OVFL、非対応なら 0)
+     */
+    uint32_t kernel_drops() const { return kernel_drops_; }
+
+    /**
+     * @brief max_datagram_size より長く、切り詰めて受け取ったデータグラム数 (MSG_TRUNC)
+     */
+    uint64_t truncated_datagrams() const { return truncated_datagrams_; }
+
+private:
+    /**
+     * @brief マルチキャストグループに参加する
+     */
+    bool join_multicast();
+
+    Config config_;
+    int sock_fd_;                               /**< ソケットファイルディスクリプタ */
+    std::vector<uint8_t> buffers_;              /**< 受信バッファ (max_datagram_size * batch_size) */
+    std::vector<uint8_t> control_;              /**< 補助データ (SO_RXQ_OVFL) 用 */
+    std::vector<struct iovec> iovecs_;
+    std::vector<struct mmsghdr> msgs_;
+    std::vector<struct sockaddr_in> sources_;
+    uint64_t receive_calls_;
+    uint32_t kernel_drops_;
+    uint64_t truncated_datagrams_;
+};
+
+#endif
@@ -9,39 +9,357 @@
 #define UDP_SENDER_HPP_
 
 #include <string>
+#include <vector>
+#include <deque>
+#include <memory>
 #include <cstdint>
-#include <netinet/in.h> 
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "network/frame_packet.hpp"
+#include "network/token_bucket_pacer.hpp"
+#include "network/send_scheduler.hpp"
+#include "event_loop/io_uring_queue.hpp"
 
 /**
  * @brief 指定したIPとポートにUDPデータを送信するクラス
+ * @details 1フレーム分のデータグラムをまとめて組み立て、sendmmsg でバッチ送信する。
+ *          GSO (UDP_SEGMENT) が使える場合は同じ長さのデータグラムを1メッセージにまとめ、
+ *          分割をカーネル (またはNIC) に任せる。
+ *          送信先が複数ある場合は、同じデータグラムを送信先毎のメッセージにして1回の sendmmsg で送る。
+ *          送信先にはマルチキャストグループも指定できる
  */
 class UDPSender {
 public:
     /**
-     * @brief コンストラクタ（ソケットの作成とアドレス設定）
+     * @brief 送信方式
+     */
+    enum class SendMode {
+        GSO,        /**< UDP_SEGMENT で複数データグラムを1メッセージにまとめ、カーネルに分割させる */
+        SENDMMSG,   /**< データグラム毎のメッセージを sendmmsg でまとめて送る */
+        SENDMSG,    /**< データグラム毎に sendmsg を呼ぶ */
+        IO_URING    /**< データグラム毎の sendmsg を io_uring にまとめて投入し、1回の io_uring_enter で完了まで待つ */
+    };
+
+    /**
+     * @brief 送信設定
+     */
+    struct Config {
+        size_t max_payload_size = 1400;         /**< 1データグラムのペイロード最大長 [byte] (ヘッダ除く) */
+        size_t batch_size = 64;                 /**< sendmmsg 1回あたりの最大メッセージ数 */
+        uint32_t max_rate_mbps = 0;             /**< 送信レート上限 [Mbit/s] (0 = 制限なし) */
+        size_t burst_bytes = 65536;             /**< レート制限時に続けて送ってよい最大バイト数 (トークンバケット容量) */
+        bool kernel_pacing = true;              /**< 送出インターフェースに fq qdisc があれば SO_MAX_PACING_RATE でカーネルにペーシングさせる */
+        SendMode send_mode = SendMode::SENDMMSG; /**< 送信方式 (GSO・io_uring 非対応なら SENDMMSG に切り替える) */
+        bool zerocopy = false;                  /**< send() を MSG_ZEROCOPY で送る (非対応なら通常送信) */
+        uint16_t stream_id = 0;                 /**< send() のパケットヘッダに入れるストリームID */
+        size_t fec_group_size = 0;              /**< send() で何チャンク毎にXORパリティを1個付けるか (0 = FECなし) */
+        size_t retransmit_cache_frames = 0;     /**< NACK 再送用に保持する直近フレーム数 (0 = 再送なし、UDPSenderThread が使用) */
+        uint32_t retransmit_deadline_ms = 100;  /**< 送信からこの時間 [ms] を過ぎたフレームは再送しない */
+        std::vector<std::string> extra_destinations;    /**< 追加の送信先IP (ポートは共通、マルチキャストグループ可) */
+        int multicast_ttl = 1;                  /**< マルチキャストの TTL (1 = 同一セグメント内のみ) */
+        bool multicast_loopback = false;        /**< マルチキャストを自ホストの受信ソケットにも配送する */
+        std::string multicast_interface;        /**< マルチキャストを送出するインターフェース名またはそのIP (空 = 経路表に従う) */
+        bool rtcp = true;                       /**< RTP 送信時に RTCP の送信者レポートを送り、受信者レポートを受ける (UDPSenderThread が使用) */
+        uint16_t rtcp_port = 0;                 /**< RTCP の送信先ポート (0 = RTP ポート + 1) */
+        SendScheduler::QueuePolicy queue_policy = SendScheduler::QueuePolicy::LATEST; /**< 送信待ちフレームの方針 (UDPSenderThread が使用) */
+        size_t queue_depth = 4;                 /**< queue_policy が FIFO / KEYFRAME の時に溜める最大フレーム数 */
+        size_t send_slice_chunks = 32;          /**< レート制限時、何チャンク毎に新しいフレーム・メタデータを確かめるか (0 = 1回で送る) */
+    };
+
+    /**
+     * @brief 送信方式を文字列から変換する ("gso" / "sendmmsg" / "sendmsg" / "io_uring")
+     * @param[in]  name 送信方式名
+     * @param[out] mode 変換結果
+     * @return true 成功 / false 未知の名前
+     */
+    static bool parse_send_mode(const std::string& name, SendMode& mode);
+
+    /**
+     * @brief コンストラクタ（ソケットの作成とアドレス設定、送信設定は既定値）
      * @param[in] ip   送信先IPアドレス
-     * @param[in] port 送信先ポート番号 
+     * @param[in] port 送信先ポート番号
      */
     UDPSender(const std::string& ip, uint16_t port);
 
+    /**
+     * @brief コンストラクタ（ソケットの作成とアドレス設定）
+     * @param[in] ip     送信先IPアドレス
+     * @param[in] port   送信先ポート番号
+     * @param[in] config 送信設定
+     */
+    UDPSender(const std::string& ip, uint16_t port, const Config& config);
+
     /**
      * @brief デストラクタ（ソケットを閉じる）
      */
     ~UDPSender();
 
+    UDPSender(const UDPSender&) = delete;
+    UDPSender& operator=(const UDPSender&) = delete;
+
+    /**
+     * @brief 1フレームを分割して送信する（各データグラム先頭に FramePacketHeader を付ける）
+     * @details fec_group_size > 0 の場合、データチャンクの後ろにXORパリティパケットを付ける
+     * @note  ゼロコピー送信が有効な場合、カーネルは送信完了まで data を直接参照する。
+     *        呼び出し側は送信直後の zerocopy_boundary() を控えておき、
+     *        is_zerocopy_completed() が true になるまで data を書き換え・解放してはならない
+     * @param[in] data         送信データへのポインタ
+     * @param[in] size         送信データのサイズ (バイト)
+     * @param[in] frame_id     フレームID
+     * @param[in] timestamp_us キャプチャ時刻 [us]
+     * @return true 送信成功
+     * @return false 送信失敗
+     */
+    bool send(const void* data, size_t size, uint32_t frame_id, uint64_t timestamp_us);
+
+    /**
+     * @brief send() と同じ分割のうち、チャンク first_chunk から count 個だけを送信する
+     * @details フレームを何回かに分けて送り、間で他の送信を挟んだり打ち切ったりするために使う。
+     *          最終チャンクを含む呼び出しでパリティパケットを付ける。ゼロコピーの扱いは send() と同じ
+     * @param[in] data         送信データへのポインタ
+     * @param[in] size         送信データのサイズ (バイト)
+     * @param[in] frame_id     フレームID
+     * @param[in] timestamp_us キャプチャ時刻 [us]
+     * @param[in] first_chunk  最初に送るチャンク番号
+     * @param[in] count        送るチャンク数 (フレームの終わりで切り詰める)
+     * @return true 送信成功
+     * @return false 送信失敗
+     */
+    bool send_chunks(const void* data,
+                     size_t size,
+                     uint32_t frame_id,
+                     uint64_t timestamp_us,
+                     size_t first_chunk,
+                     size_t count);
+
     /**
-     * @brief データを送信する
-     * @param[in] data 送信データへのポインタ
+     * @brief send() でのフレームのチャンク数
      * @param[in] size 送信データのサイズ (バイト)
+     */
+    size_t chunk_count(size_t size) const { return (size + config_.max_payload_size - 1) / config_.max_payload_size; }
+
+    /**
+     * @brief send() で送ったフレームの指定チャンクだけを再送する（パリティは付けない）
+     * @param[in] data         send() に渡したものと同じ送信データ
+     * @param[in] size         送信データのサイズ (バイト)
+     * @param[in] frame_id     フレームID
+     * @param[in] timestamp_us キャプチャ時刻 [us]
+     * @param[in] chunks       再送するチャンク番号（範囲外は無視）
+     * @param[in] requester    再送先 (receive_nack() で受け取った NACK の送信元)
      * @return true 送信成功
      * @return false 送信失敗
      */
-    bool send(const void* data, size_t size);
+    bool resend_chunks(const void* data,
+                       size_t size,
+                       uint32_t frame_id,
+                       uint64_t timestamp_us,
+                       const std::vector<uint16_t>& chunks,
+                       const struct sockaddr_in& requester);
+
+    /**
+     * @brief 送信先から届いたNACKを1個受け取る（ブロックしない）
+     * @details ユニキャストの送信先IP以外からのパケット、形式の合わないパケットは読み捨てる。
+     *          マルチキャストの送信先がある場合は受信者を特定できないので、どこからでも受け付ける
+     * @param[out] nack      受け取ったNACK
+     * @param[out] requester NACK の送信元 (ポートは送信先ポート)
+     * @return true 受け取った / false 届いていない
+     */
+    bool receive_nack(FrameNack& nack, struct sockaddr_in& requester);
+
+    /**
+     * @brief 送信先の数を取得する
+     */
+    size_t destination_count() const { return destinations_.size(); }
+
+    /**
+     * @brief 組み立て済みのデータグラム列をそのまま送信する（分割・フラグ付与なし）
+     * @param[in] packets 送信するデータグラム（RTPパケット等、ヘッダ込み）
+     * @param[in] count   packets の先頭から送信する個数
+     * @return true 送信成功
+     * @return false 送信失敗
+     */
+    bool send_packets(const std::vector<std::vector<uint8_t>>& packets, size_t count);
+
+    /**
+     * @brief 送信バッファ溢れで破棄したパケットの累計数を取得する
+     */
+    uint64_t dropped_packets() const { return dropped_packets_; }
+
+    /**
+     * @brief 送信に使ったシステムコールの累計回数を取得する
+     */
+    uint64_t syscall_count() const { return syscall_count_; }
+
+    /**
+     * @brief 送信したデータグラムの累計数を取得する
+     */
+    uint64_t sent_packets() const { return sent_packets_; }
+
+    /**
+     * @brief 送信したFECパリティパケットの累計数を取得する
+     */
+    uint64_t parity_packets() const { return parity_packets_; }
+
+    /**
+     * @brief NACK で再送したデータグラムの累計数を取得する
+     */
+    uint64_t retransmitted_packets() const { return retransmitted_packets_; }
+
+    /**
+     * @brief 実際に使用している送信方式を取得する（GSO 非対応時は切り替え後の方式）
+     */
+    SendMode send_mode() const { return send_mode_; }
+
+    /**
+     * @brief ゼロコピー送信が有効かどうか（非対応・常にコピーされる環境では途中で無効になる）
+     */
+    bool zerocopy_enabled() const { return zerocopy_enabled_; }
+
+    /**
+     * @brief レート制限をカーネル (fq qdisc + SO_MAX_PACING_RATE) が行っているか
+     */
+    bool kernel_pacing_enabled() const { return kernel_pacing_; }
+
+    /**
+     * @brief これまでに行ったゼロコピー送信の境界（次に割り当てられる送信ID）を取得する
+     */
+    uint32_t zerocopy_boundary() const { return zerocopy_next_id_; }
+
+    /**
+     * @brief boundary より前のゼロコピー送信が全て完了したか
+     * @param[in] boundary zerocopy_boundary() で取得した値
+     */
+    bool is_zerocopy_completed(uint32_t boundary) const;
+
+    /**
+     * @brief ソケットのエラーキューから送信完了通知を回収する
+     * @param[in] timeout_ms 通知が無い場合に待つ最大時間 [ms] (0 = 待たない)
+     */
+    void reap_zerocopy_completions(int timeout_ms);
 
 private:
+    /**
+     * @brief 送信待ちデータグラム1個分の情報
+     */
+    struct Packet {
+        size_t header_offset;       /**< headers_ 内のヘッダ位置 */
+        size_t header_length;       /**< ヘッダ長 (0 = ヘッダなし) */
+        const uint8_t* payload;     /**< ペイロード先頭 */
+        size_t payload_length;      /**< ペイロード長 */
+    };
+
+    /**
+     * @brief 1回の送信メッセージ（GSO では複数データグラム分）
+     */
+    struct Message {
+        size_t first_packet;        /**< 先頭データグラムの packets_ 内の位置 */
+        size_t packet_count;        /**< まとめたデータグラム数 */
+        size_t bytes;               /**< 合計バイト数 */
+    };
+
+    /**
+     * @brief GSO の制御メッセージ (UDP_SEGMENT) 1個分の領域
+     */
+    union GsoControl {
+        char buffer[CMSG_SPACE(sizeof(uint16_t))];
+        struct cmsghdr align;       /**< アライメント確保用 */
+    };
+
+    /**
+     * @brief 送信待ちデータグラムを1個追加する
+     */
+    void add_packet(const void* header, size_t header_length, const void* payload, size_t payload_length);
+
+    /**
+     * @brief 送信待ちデータグラムを sendmmsg でバッチ送信し、送信待ちを空にする
+     * @param[in] zerocopy MSG_ZEROCOPY で送信する
+     * @param[in] only     この宛先にだけ送る (nullptr = 全ての送信先)
+     * @return true 全て送信 / false 途中で失敗（残りは破棄）
+     */
+    bool flush_packets(bool zerocopy, const struct sockaddr_in* only = nullptr);
+
+    /**
+     * @brief ゼロコピー送信の完了ID範囲 [lo, hi] を記録し、完了済みの先頭を進める
+     */
+    void complete_zerocopy(uint32_t lo, uint32_t hi, bool copied);
+
+    /**
+     * @brief データチャンク1個をヘッダ付きで送信待ちに追加する
+     * @param[in]     data   フレーム先頭
+     * @param[in]     size   フレームのバイト数
+     * @param[in,out] header チャンク共通のヘッダ内容 (chunk_index, flags を書き換える)
+     * @param[in]     index  チャンク番号
+     */
+    void add_chunk_packet(const uint8_t* data, size_t size, FramePacketHeader& header, size_t index);
+
+    /**
+     * @brief データチャンクのXORパリティを headers_ に作り、送信待ちに追加する
+     * @param[in] data   フレーム先頭
+     * @param[in] size   フレームのバイト数
+     * @param[in] header データチャンクと共通のヘッダ内容
+     */
+    void add_parity_packets(const uint8_t* data, size_t size, const FramePacketHeader& header);
+
+    /**
+     * @brief packets_ の first_packet 以降から送信メッセージ (msgs_) を組み立てる
+     * @param[in] first_packet 組み立てを始めるデータグラムの位置
+     * @param[in] zerocopy     ゼロコピー送信用（1メッセージが参照するページ数を制限する）
+     * @param[in] only         この宛先にだけ送る (nullptr = 全ての送信先、メッセージ毎に送信先を順に並べる)
+     */
+    void build_messages(size_t first_packet, bool zerocopy, const struct sockaddr_in* only);
+
+    /**
+     * @brief 送信先を1個追加する
+     * @return true 成功 / false IPアドレスが不正
+     */
+    bool add_destination(const std::string& ip, uint16_t port);
+
+    /**
+     * @brief マルチキャストの TTL・ループバック・送出インターフェースを設定する
+     */
+    void setup_multicast();
+
+    /**
+     * @brief 送出インターフェースに fq qdisc があれば SO_MAX_PACING_RATE を設定する
+     * @return true カーネルがペーシングする / false ユーザ空間でペーシングする
+     */
+    bool enable_kernel_pacing();
+
     int sock_fd_;               /**< ソケットファイルディスクリプタ */
-    struct sockaddr_in addr_;   /**< 送信先アドレス情報 */
+    std::vector<struct sockaddr_in> destinations_;  /**< 送信先アドレス (先頭が dest_ip) */
+    bool has_multicast_;        /**< 送信先にマルチキャストグループを含む */
     bool is_valid_;             /**< 初期化成功フラグ */
+    Config config_;             /**< 送信設定 */
+    SendMode send_mode_;        /**< 実際に使用している送信方式 */
+    std::unique_ptr<IoUringQueue> uring_;   /**< IO_URING 送信用のリング (他の方式では nullptr) */
+
+    std::vector<Packet> packets_;           /**< 送信待ちデータグラム */
+    std::vector<uint8_t> headers_;          /**< 送信待ちデータグラムのヘッダ領域 */
+    std::vector<struct iovec> iovecs_;      /**< 送信用 iovec (2個/データグラム) */
+    std::vector<struct mmsghdr> msgs_;      /**< sendmmsg 用メッセージヘッダ */
+    std::vector<Message> messages_;         /**< msgs_ と対応する送信メッセージ情報 */
+    std::vector<GsoControl> controls_;      /**< msgs_ と対応する GSO 制御メッセージ */
+
+    TokenBucketPacer pacer_;    /**< ユーザ空間のペーシング (カーネルがペーシングする場合は無効) */
+    bool kernel_pacing_;        /**< SO_MAX_PACING_RATE でカーネルがペーシング中 */
+
+    /* ---------- ゼロコピー送信 ---------- */
+    bool zerocopy_enabled_;                 /**< MSG_ZEROCOPY を使用中 */
+    uint32_t zerocopy_next_id_;             /**< 次のゼロコピー送信に割り当てられるID (カーネルと同じ採番) */
+    uint32_t zerocopy_completed_id_;        /**< このIDより前は全て送信完了 */
+    std::vector<std::pair<uint32_t, uint32_t>> zerocopy_pending_;   /**< 順不同で届いた完了ID範囲 */
+    uint32_t zerocopy_copied_streak_;       /**< カーネル内でコピーにフォールバックした連続回数 */
+    std::deque<std::pair<uint32_t, std::vector<uint8_t>>> zerocopy_headers_; /**< 送信中フレームのヘッダ領域 (完了境界, ヘッダ) */
+    std::vector<std::vector<uint8_t>> spare_headers_;   /**< 再利用するヘッダ領域 */
+
+    uint64_t dropped_packets_;  /**< 破棄したパケットの累計数 */
+    uint64_t syscall_count_;    /**< 送信システムコールの累計回数 */
+    uint64_t sent_packets_;     /**< 送信したデータグラムの累計数 */
+    uint64_t parity_packets_;   /**< 送信したFECパリティパケットの累計数 */
+    uint64_t retransmitted_packets_; /**< NACK で再送したデータグラムの累計数 */
+    std::vector<uint8_t> nack_buffer_;  /**< NACK 受信バッファ */
 };
 
-#endif
\ No newline at end of file
+#endif
@@ -9,27 +9,72 @@
 #ifndef UDP_SENDER_THREAD_HPP_
 #define UDP_SENDER_THREAD_HPP_
 
+#include <atomic>
 #include <thread>
-#include <mutex>
-#include <condition_variable>
-#include <queue>
+#include <deque>
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <chrono>
+#include <memory>
 
 #include "network/udp_sender.hpp"
+#include "network/rtp_h264_packetizer.hpp"
+#include "network/rtp_jpeg_packetizer.hpp"
+#include "network/rtcp_session.hpp"
+#include "network/send_scheduler.hpp"
+#include "network/spsc_ring.hpp"
+#include "network/event_waiter.hpp"
 
 /**
  * @brief 完成済みデータを非同期（別スレッド）でUDP送信するクラス
+ * @details 呼び出し側 (1スレッド) とはロックフリーの SPSC リングでフレーム・メタデータ・再利用バッファを受け渡し、
+ *          送信スレッドが眠っている時だけ eventfd で起こす。enqueue() が送信スレッドを待つことはない。
+ *          送信待ちは送信スレッドの SendScheduler が管理し、メタデータを画像より先に送る。
+ *          レート制限時は分割送信のフレームを send_slice_chunks 毎に区切って送り、
+ *          区切りでメタデータを挟み、方針が LATEST なら新しいフレームの到着で残りを打ち切る
  */
 class UDPSenderThread {
 public:
+    /**
+     * @brief 送信データの形式
+     */
+    enum class PayloadFormat {
+        CHUNKED,    /**< FramePacketHeader 付きで分割送信 (JPEG) */
+        RTP_H264,   /**< RFC 6184 RTPパケットとして送信 (H.264 Annex-B) */
+        RTP_JPEG    /**< RFC 2435 RTPパケットとして送信 (ベースラインJPEG 4:2:2 / 4:2:0) */
+    };
+
+    /**
+     * @brief 送信統計（レート制御のフィードバック用）
+     */
+    struct Stats {
+        uint64_t sent_frames = 0;       /**< 送信完了したフレーム数 */
+        uint64_t sent_bytes = 0;        /**< 送信したペイロードの累計 [byte] */
+        uint64_t dropped_packets = 0;   /**< 送信バッファ溢れで破棄したパケットの累計数 */
+        uint64_t last_send_time_us = 0; /**< 直近フレームの送信所要時間 [us] */
+        uint64_t retransmitted_packets = 0; /**< NACK で再送したパケットの累計数 */
+        uint64_t rtcp_reports = 0;      /**< 受け取った RTCP 受信者レポートの累計数 (RTP 送信時のみ) */
+        double loss_fraction = 0.0;     /**< 直近の受信者レポートのロス率 (0-1) */
+        double jitter_ms = 0.0;         /**< 直近の受信者レポートのジッタ [ms] */
+        double rtt_ms = -1.0;           /**< 直近の受信者レポートから求めた往復時間 [ms] (-1 = 不明) */
+        uint64_t dropped_frames = 0;    /**< 送らずに捨てたフレームの累計数 (送信待ちの方針・受け渡し列の溢れ) */
+        uint64_t preempted_frames = 0;  /**< 新しいフレームが来て送信を打ち切ったフレームの累計数 */
+        uint64_t keyframe_requests = 0; /**< 差分フレームを捨ててキーフレームが必要になった回数 */
+        uint64_t metadata_packets = 0;  /**< 送信したメタデータのデータグラム累計数 */
+    };
+
     /**
      * @brief コンストラクタ
-     * @param[in] ip   送信先IPアドレス
-     * @param[in] port 送信先ポート番号
+     * @param[in] ip     送信先IPアドレス
+     * @param[in] port   送信先ポート番号
+     * @param[in] format 送信データの形式
+     * @param[in] config 送信設定（バッチサイズ・レート上限等）
      */
-    UDPSenderThread(const std::string& ip, uint16_t port);
+    UDPSenderThread(const std::string& ip,
+                    uint16_t port,
+                    PayloadFormat format = PayloadFormat::CHUNKED,
+                    const UDPSender::Config& config = UDPSender::Config());
 
     ~UDPSenderThread();
 
@@ -44,10 +89,40 @@ public:
     void stop(void);
 
     /**
-     * @brief 送信キューにデータを追加する
-     * @param[in] data 送信するバイト列（所有権は内部へムーブ）
+     * @brief 送信キューにデータを追加する（enqueue 系・acquire_buffer は同じ1スレッドから呼ぶ）
+     * @details ブロックしない。送信スレッドが止まっていて受け渡し列が満杯なら、このフレームを捨てる
+     * @param[in] data         送信するバイト列（所有権は内部へムーブ）
+     * @param[in] timestamp_us キャプチャ時刻 [us] (CLOCK_MONOTONIC)
+     * @param[in] keyframe     単独でデコードできるフレームか (方針 KEYFRAME で使用)
+     */
+    void enqueue(std::vector<uint8_t>&& data, uint64_t timestamp_us, bool keyframe = true);
+
+    /**
+     * @brief メタデータのデータグラムを送信キューに追加する
+     * @details 画像フレームより優先し、送信中のフレームの区切りにも割り込んで、そのまま送信先へ送る
+     * @param[in] datagram 送信するデータグラム（所有権は内部へムーブ）
+     */
+    void enqueue_metadata(std::vector<uint8_t>&& datagram);
+
+    /**
+     * @brief 送信済みバッファを再利用のために取り出す（enqueue() と同じスレッドから呼び出す）
+     * @details ゼロコピー送信時は、カーネルの送信完了通知を受けたバッファだけが戻ってくる。
+     *          エンコード先に使えば毎フレームのメモリ確保を省ける
+     * @return 空 (size 0) で容量を確保済みのバッファ。プールが空なら新しい空バッファ
+     */
+    std::vector<uint8_t> acquire_buffer(void);
+
+    /**
+     * @brief 送信済みのメタデータのバッファを再利用のために取り出す（enqueue_metadata() と同じスレッドから呼び出す）
+     * @details 次のデータグラムの組み立て先に使えば毎回のメモリ確保を省ける
+     * @return 空 (size 0) で容量を確保済みのバッファ。プールが空なら新しい空バッファ
      */
-    void enqueue(std::vector<uint8_t>&& data);
+    std::vector<uint8_t> acquire_metadata_buffer(void);
+
+    /**
+     * @brief 送信統計を取得する（任意のスレッドから呼び出し可）
+     */
+    Stats get_stats(void) const;
 
 private:
     /**
@@ -55,15 +130,138 @@ private:
      */
     void send_loop(void);
 
+    /**
+     * @brief NACK 再送用に保持している送信済みフレーム
+     */
+    struct CachedFrame {
+        uint32_t frame_id = 0;                          /**< フレームID */
+        uint64_t timestamp_us = 0;                      /**< キャプチャ時刻 [us] */
+        std::chrono::steady_clock::time_point sent_at;  /**< 送信した時刻 */
+        uint32_t zerocopy_boundary = 0;                 /**< 送信直後の UDPSender::zerocopy_boundary() */
+        std::vector<uint8_t> data;                      /**< 送信データ */
+    };
+
+    /**
+     * @brief 受け渡し列に届いたフレーム・メタデータを scheduler_ へ移す
+     */
+    void drain_mailbox(void);
+
+    /**
+     * @brief 分割送信のフレームを区切りながら送信する
+     * @param[in] data         送信するフレーム
+     * @param[in] frame_id     フレームID
+     * @param[in] timestamp_us キャプチャ時刻 [us]
+     * @param[in] preemptible  新しいフレームが来たら打ち切ってよいか
+     * @return true 全て送った / false 新しいフレームが来たので打ち切った
+     */
+    bool send_chunked_frame(const std::vector<uint8_t>& data, uint32_t frame_id, uint64_t timestamp_us, bool preemptible);
+
+    /**
+     * @brief 送信待ちのメタデータを全て送信する
+     */
+    void send_metadata(void);
+
+    /**
+     * @brief 届いているNACKを全て処理し、キャッシュにあるフレームのチャンクを再送する
+     */
+    void process_nacks(void);
+
+    /**
+     * @brief 保持数・期限を超えたキャッシュのフレームを手放す
+     * @param[in] max_frames 残すフレーム数
+     */
+    void expire_cache(size_t max_frames);
+
+    /**
+     * @brief 送信済みフレームのバッファを手放す（ゼロコピー送信中なら完了を待つ列へ）
+     */
+    void retire_frame(CachedFrame&& frame);
+
+    /**
+     * @brief H.264アクセスユニットをRTPパケットに分割して送信する
+     * @param[in] data         Annex-B 形式のアクセスユニット
+     * @param[in] timestamp_us キャプチャ時刻 [us]
+     */
+    void send_rtp_h264(const std::vector<uint8_t>& data, uint64_t timestamp_us);
+
+    /**
+     * @brief JPEGをRTPパケットに分割して送信する
+     * @param[in] data         ベースラインJPEG
+     * @param[in] timestamp_us キャプチャ時刻 [us]
+     */
+    void send_rtp_jpeg(const std::vector<uint8_t>& data, uint64_t timestamp_us);
+
+    /**
+     * @brief rtp_packets_ の先頭 count 個を送信し、RTCP 用の送信数を数える
+     */
+    void send_rtp_packets(size_t count);
+
+    /**
+     * @brief 受信者レポートを読み、周期が来ていれば送信者レポートを送る
+     */
+    void process_rtcp(void);
+
+    /**
+     * @brief 送信が終わったバッファをプールへ戻す
+     */
+    void release_buffer(std::vector<uint8_t>&& buffer);
+
+    /**
+     * @brief ゼロコピー送信中のバッファのうち、送信完了したものをプールへ戻す
+     * @param[in] timeout_ms 完了通知を待つ最大時間 [ms] (0 = 待たない)
+     */
+    void reap_in_flight(int timeout_ms);
+
     UDPSender sender_;
+    PayloadFormat format_;
+    size_t cache_frames_;                               /**< NACK 再送用に保持するフレーム数 (0 = 再送なし) */
+    std::chrono::milliseconds retransmit_deadline_;     /**< 再送する期限 (送信からの経過時間) */
+    std::deque<CachedFrame> cache_;                     /**< 再送用の送信済みフレーム (古い順) */
+    FrameNack nack_;                                    /**< NACK 受信用 */
+    struct sockaddr_in nack_requester_;                 /**< 受信した NACK の送信元 (再送先) */
+
+    uint32_t rtp_ssrc_;                                 /**< RTP ストリームの SSRC */
+    RtpH264Packetizer rtp_packetizer_;
+    RtpJpegPacketizer rtp_jpeg_packetizer_;
+    std::vector<std::vector<uint8_t>> rtp_packets_;     /**< RTPパケットの再利用バッファ */
+    std::unique_ptr<RtcpSession> rtcp_;                 /**< RTCP (RTP 送信時のみ) */
+    uint32_t rtp_packet_count_;                         /**< 送信した RTP パケット数 (SR 用) */
+    uint32_t rtp_octet_count_;                          /**< 送信した RTP ペイロードの累計 [byte] (SR 用) */
+    std::chrono::steady_clock::time_point next_rtcp_report_;    /**< 次に SR を送る時刻 */
 
     std::thread send_thread_;
-    std::mutex mutex_;
-    std::condition_variable cond_var_;
+    EventWaiter wakeup_;                                /**< 送信スレッドの起床通知 */
+    SpscRing<SendScheduler::Frame> frame_mailbox_;      /**< 呼び出し側 -> 送信スレッドのフレーム */
+    SpscRing<std::vector<uint8_t>> metadata_mailbox_;   /**< 呼び出し側 -> 送信スレッドのメタデータ */
+    SpscRing<std::vector<uint8_t>> buffer_pool_;        /**< 送信スレッド -> 呼び出し側の再利用できる送信済みバッファ */
+    SpscRing<std::vector<uint8_t>> metadata_pool_;      /**< 送信スレッド -> 呼び出し側の再利用できる送信済みメタデータ */
+    bool producer_waiting_for_keyframe_;                /**< 受け渡し列溢れで差分を捨てたので次のキーフレームを待つ (呼び出し側のみ使用) */
+
+    SendScheduler scheduler_;                           /**< 送信待ち (送信スレッドのみ使用) */
+    std::vector<std::vector<uint8_t>> discarded_;       /**< scheduler_ が捨てたバッファの受け取り用 (送信スレッドのみ使用) */
+    size_t slice_chunks_;                               /**< 分割送信の区切り [チャンク] (0 = 区切らない) */
+    bool last_preempted_;                               /**< 直前のフレームを打ち切った (送信スレッドのみ使用) */
+    std::vector<std::vector<uint8_t>> metadata_packets_;    /**< 送信するメタデータ (送信スレッドのみ使用) */
+    uint32_t next_frame_id_;    /**< 次に送信するフレームのID (送信スレッドのみ使用) */
+
+    std::deque<std::pair<uint32_t, std::vector<uint8_t>>> in_flight_; /**< ゼロコピー送信中 (完了境界, バッファ) */
 
-    std::queue<std::vector<uint8_t>> send_queue_;
+    std::atomic<bool> running_;
 
-    bool running_;
+    std::atomic<uint64_t> stat_sent_frames_;
+    std::atomic<uint64_t> stat_sent_bytes_;
+    std::atomic<uint64_t> stat_dropped_packets_;
+    std::atomic<uint64_t> stat_last_send_time_us_;
+    std::atomic<uint64_t> stat_retransmitted_packets_;
+    std::atomic<uint64_t> stat_rtcp_reports_;
+    std::atomic<double> stat_loss_fraction_;
+    std::atomic<double> stat_jitter_ms_;
+    std::atomic<double> stat_rtt_ms_;
+    std::atomic<uint64_t> stat_dropped_frames_;
+    std::atomic<uint64_t> stat_rejected_frames_;        /**< 受け渡し列が満杯で捨てたフレーム数 */
+    std::atomic<uint64_t> stat_preempted_frames_;
+    std::atomic<uint64_t> stat_keyframe_requests_;
+    std::atomic<uint64_t> stat_metadata_packets_;
 };
 
 #endif
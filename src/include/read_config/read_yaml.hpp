@@ -9,6 +9,7 @@
 #define READ_YAML_HPP_
 
 #include <string>
+#include <vector>
 #include <cstdint>
 
 struct AppConfigData {
@@ -16,19 +17,100 @@ struct AppConfigData {
         std::string dest_ip;
         uint16_t top_view_port;
         uint16_t bottom_view_port;
+        uint32_t max_payload_size;  /**< 1データグラムのペイロード最大長 [byte] */
+        uint32_t batch_size;        /**< sendmmsg 1回あたりのデータグラム数 */
+        uint32_t max_rate_mbps;     /**< 送信レート上限 [Mbit/s] (0 = 制限なし) */
+        uint32_t burst_bytes;       /**< レート制限時に続けて送ってよい最大バイト数 */
+        bool kernel_pacing;         /**< fq qdisc があれば SO_MAX_PACING_RATE でペーシングする */
+        std::string send_mode;      /**< 送信方式 ("gso" / "sendmmsg" / "sendmsg" / "io_uring") */
+        bool zerocopy;              /**< MSG_ZEROCOPY で送信する */
+        uint32_t fec_group_size;    /**< 何チャンク毎にXORパリティを1個付けるか (0 = FECなし) */
+        uint32_t retransmit_cache_frames;   /**< NACK 再送用に保持する直近フレーム数 (0 = 再送なし) */
+        uint32_t retransmit_deadline_ms;    /**< 送信からこの時間 [ms] を過ぎたフレームは再送しない */
+        std::vector<std::string> extra_dest_ips;    /**< 追加の送信先IP (マルチキャストグループ可) */
+        int multicast_ttl;                  /**< マルチキャストの TTL */
+        bool multicast_loopback;            /**< マルチキャストを自ホストにも配送する */
+        std::string multicast_interface;    /**< マルチキャストの送出インターフェース名またはIP (空 = 経路表に従う) */
+        std::string jpeg_payload;   /**< JPEG の送信形式 ("chunked" = 独自ヘッダ / "rtp" = RFC 2435) */
+        bool rtcp;                  /**< RTP 送信時に RTCP (SR/RR) を使う */
+        uint16_t rtcp_port;         /**< RTCP の送信先ポート (0 = RTP ポート + 1) */
+        std::string send_queue_policy;  /**< 送信待ちの方針 ("latest" / "fifo" / "keyframe") */
+        uint32_t send_queue_depth;      /**< fifo / keyframe で溜める最大フレーム数 */
+        uint32_t send_slice_chunks;     /**< レート制限時、何チャンク毎に新しいフレーム・メタデータを確かめるか (0 = 区切らない) */
+        bool detection_metadata;        /**< 検出結果をメタデータパケットで映像と一緒に送る (chunked のみ) */
     } network;
 
     struct Camera {
         std::string top_view_device;
         std::string bottom_view_device;
+        bool bottom_view_enabled;   /**< 下カメラも取得して bottom_view_port へ送る */
+        std::string source;         /**< 上カメラの取得元 ("v4l2" / "file" / "synthetic") */
         uint32_t width;
         uint32_t height;
+        std::string pixel_format;   /**< カメラから取得する形式 ("yuyv" / "mjpeg" / "auto") */
+        std::string event_loop;     /**< キャプチャを待つ仕組み ("io_uring" / "epoll") */
+
+        struct Mode {
+            std::string policy;         /**< 取得モードの選び方 ("exact" / "max_fps" / "max_resolution") */
+            uint32_t min_width;         /**< max_fps で必要な最小幅 (0 = width) */
+            double min_fps;             /**< max_resolution で必要な最低フレームレート */
+            bool list;                  /**< 起動時に対応しているモードを一覧表示する */
+        } mode;
+
+        struct Replay {
+            std::string path;           /**< source: file で再生するファイル・ディレクトリ */
+            std::string pacing;         /**< フレームを出す間隔 ("realtime" / "fast") */
+            double fps;                 /**< realtime のフレームレート */
+            bool loop;                  /**< 最後まで再生したら先頭に戻る */
+            uint32_t start_frame;       /**< 最初に出すフレームの位置 */
+        } replay;
+
+        struct Recovery {
+            uint32_t initial_backoff_ms;    /**< 抜けたカメラを最初に開き直すまでの時間 [ms] (失敗する度に倍) */
+            uint32_t max_backoff_ms;        /**< 開き直しの間隔の上限 [ms] */
+        } recovery;
+
+        struct Controls {
+            bool list;                  /**< 起動時に対応しているコントロールを一覧表示する */
+            uint32_t frame_rate;        /**< フレーム間隔を 1/frame_rate 秒に固定する (0 = 変更しない) */
+            int32_t exposure;           /**< 露光時間 [100us] (負 = 自動露光のまま) */
+            int32_t exposure_auto_priority; /**< 0 = 自動露光でもフレームレートを保つ / 1 = 落としてよい (負 = 変更しない) */
+            int32_t gain;               /**< ゲイン (負 = 変更しない) */
+            int32_t white_balance;      /**< 色温度 [K] (負 = 自動ホワイトバランスのまま) */
+            int32_t focus;              /**< フォーカス位置 (負 = オートフォーカスのまま) */
+        } controls;
     } camera;
 
     struct ImageProcessor {
         uint8_t jpeg_quality;
         double resize_width;
+        std::string codec;          /**< "jpeg" または "h264" */
+        int roi_background_quality; /**< JPEG 領域別画質モードのROI外品質 (0 = 無効) */
+        std::string jpeg_subsampling;   /**< JPEG の色差の間引き ("444" / "422" / "420") */
+        bool draw_overlay;          /**< GUI送信用画像に検出結果を描画する */
+
+        struct H264 {
+            uint32_t bitrate_kbps;
+            uint32_t gop;
+            uint32_t fps;
+        } h264;
     } image_processor;
+
+    struct RateControl {
+        bool enabled;
+        uint32_t target_bitrate_kbps;
+        uint32_t target_fps;
+        int min_quality;
+        int max_quality;
+        double min_scale;
+    } rate_control;
+
+    struct Recorder {
+        bool enabled;               /**< 上カメラのフレームをそのまま記録する */
+        std::string directory;      /**< 記録を置くディレクトリ (起動毎に日時のディレクトリを作る) */
+        uint32_t segment_size_mb;   /**< 1セグメントファイルの大きさ [MiB] */
+        uint32_t queue_frames;      /**< 記録スレッドへ渡せるフレーム数 (溢れたフレームは記録しない) */
+    } recorder;
 };
 
 /**
@@ -0,0 +1,152 @@
+/**
+ * @file    frame_recorder.hpp
+ * @brief   カメラのフレームをそのまま (YUYV / MJPEG) ファイルへ記録する
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef FRAME_RECORDER_HPP_
+#define FRAME_RECORDER_HPP_
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "camera/frame_source.hpp"
+#include "network/event_waiter.hpp"
+#include "network/spsc_ring.hpp"
+#include "recorder/recording_index.hpp"
+
+/**
+ * @class FrameRecorder
+ * @brief キャプチャしたフレームを、記録スレッドで mmap したセグメントファイルへ書く
+ * @details record() (キャプチャスレッド) はフレームを再利用バッファへコピーして SPSC リングで渡すだけで、
+ *          ディスクを待たない。バッファか列が空いていなければそのフレームは記録せずに数える。
+ *          記録スレッドはセグメントを fallocate で確保して mmap し、前から詰めて書き、索引 (recording_index.hpp) に1行足す。
+ *          書いた所は一定量毎に書き出しを始め、書き出し済みの所はページキャッシュから外す (記録中にメモリを食い潰さない)。
+ *          記録は start() 毎に directory の下の日時のディレクトリへ作り、FileFrameSource でそのまま再生できる
+ */
+class FrameRecorder {
+public:
+    /**
+     * @brief 記録の統計
+     */
+    struct Stats {
+        uint64_t recorded_frames = 0;   /**< 書いたフレーム数 */
+        uint64_t recorded_bytes = 0;    /**< 書いたフレームの合計 [byte] */
+        uint64_t dropped_frames = 0;    /**< 記録が追いつかずに捨てたフレーム数 */
+        uint32_t segments = 0;          /**< 作ったセグメント数 */
+    };
+
+    /**
+     * @brief コンストラクタ
+     * @param[in] directory       記録を置くディレクトリ (無ければ作る)
+     * @param[in] segment_size_mb 1セグメントの大きさ [MiB]
+     * @param[in] queue_frames    記録スレッドへ渡せるフレーム数 (この数だけバッファを持つ)
+     */
+    FrameRecorder(const std::string& directory, size_t segment_size_mb, size_t queue_frames);
+
+    ~FrameRecorder();
+
+    FrameRecorder(const FrameRecorder&) = delete;
+    FrameRecorder& operator=(const FrameRecorder&) = delete;
+
+    /**
+     * @brief 記録ディレクトリと索引を作り、記録スレッドを開始する
+     * @return true 成功 / false ディレクトリ・索引を作れない
+     */
+    bool start();
+
+    /**
+     * @brief 渡したフレームを全て書いてから記録スレッドを止め、ファイルを閉じる
+     */
+    void stop();
+
+    /**
+     * @brief フレームを記録スレッドへ渡す（キャプチャスレッド1つからのみ呼び出し可。ブロックしない）
+     * @param[in] frame フレーム (呼び出し中にコピーするので、戻ったら返却してよい)
+     * @return true 渡した / false 記録していない・追いつかずに捨てた・幅か高さが 65535 を超える
+     */
+    bool record(const FrameSource::Frame& frame);
+
+    /**
+     * @brief 統計を取得する（任意のスレッドから呼び出し可）
+     */
+    Stats get_stats() const;
+
+    /**
+     * @brief 今回の記録のディレクトリ (start() 前は空)
+     */
+    const std::string& recording_directory() const { return recording_directory_; }
+
+private:
+    /**
+     * @brief 記録スレッドへ渡すフレーム1枚
+     */
+    struct PendingFrame {
+        std::vector<uint8_t> data;
+        RecordingIndexEntry entry;
+    };
+
+    /**
+     * @brief 記録スレッドの本体
+     */
+    void write_loop();
+
+    /**
+     * @brief フレーム1枚をセグメントに書き、索引に1行足す（記録スレッド）
+     */
+    bool write_frame(PendingFrame& pending);
+
+    /**
+     * @brief 次のセグメントを確保して mmap する（記録スレッド）
+     * @param[in] min_size 少なくとも必要な大きさ [byte]
+     */
+    bool open_segment(size_t min_size);
+
+    /**
+     * @brief セグメントを書いた所までに縮めて閉じる
+     */
+    void close_segment();
+
+    /**
+     * @brief 書いた所の書き出しを始め、書き出し済みの所をページキャッシュから外す（記録スレッド）
+     */
+    void write_back();
+
+    std::string directory_;
+    size_t segment_size_;
+    size_t queue_frames_;
+    std::string recording_directory_;
+
+    std::thread write_thread_;
+    std::atomic<bool> running_;
+    bool failed_;                               /**< 書き込みに失敗した (記録スレッドのみ) */
+
+    SpscRing<PendingFrame> mailbox_;            /**< キャプチャ → 記録スレッド */
+    SpscRing<std::vector<uint8_t>> buffer_pool_;/**< 記録スレッド → キャプチャ (書き終えたバッファ) */
+    EventWaiter wakeup_;
+    uint32_t sequence_;                         /**< record() を呼ばれた回数 (キャプチャスレッドのみ) */
+    std::vector<uint8_t> spare_buffer_;         /**< 列に入れられず手元に残したバッファ (キャプチャスレッドのみ) */
+    bool has_spare_buffer_;                     /**< spare_buffer_ を持っているか (キャプチャスレッドのみ) */
+    bool size_warned_;                          /**< 索引に収まらない大きさを警告した (キャプチャスレッドのみ) */
+
+    int index_fd_;
+    int segment_fd_;
+    uint8_t* segment_map_;
+    size_t segment_capacity_;                   /**< 確保したセグメントの大きさ [byte] */
+    uint32_t segment_number_;                   /**< 今のセグメントの番号 */
+    size_t write_pos_;                          /**< 今のセグメントの書いた所 [byte] */
+    size_t flushed_pos_;                        /**< 書き出しを始めた所 [byte] */
+    size_t released_pos_;                       /**< ページキャッシュから外した所 [byte] */
+
+    std::atomic<uint64_t> stat_recorded_frames_;
+    std::atomic<uint64_t> stat_recorded_bytes_;
+    std::atomic<uint64_t> stat_dropped_frames_;
+    std::atomic<uint32_t> stat_segments_;
+};
+
+#endif // FRAME_RECORDER_HPP_
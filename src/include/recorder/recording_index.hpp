@@ -0,0 +1,111 @@
+/**
+ * @file    recording_index.hpp
+ * @brief   生フレーム記録 (FrameRecorder) のディレクトリ構成と索引ファイルの読み書きヘルパ
+ * @details
+ * 1回の記録は1ディレクトリで、フレームの中身を前から詰めたセグメントファイル (segment_000000.raw, ...) と、
+ * 1フレーム1行の索引ファイル (index.bin) からなる。索引の行は固定長なので、n 番目のフレームは
+ * 索引の HEADER + n * ENTRY の位置を読めば、どのセグメントのどこにあるか分かる (途中からの再生・前後の移動)。
+ * 索引はフレームの中身をセグメントに書いた後に追記するので、途中で止まっても索引にあるフレームは全て読める。
+ * マルチバイト値はリトルエンディアン。
+ *
+ * 索引ファイルの先頭
+ *
+ * | offset | size | 内容                                          |
+ * |-------:|-----:|-----------------------------------------------|
+ * |      0 |    4 | マジック "RRIX"                               |
+ * |      4 |    2 | バージョン (1)                                |
+ * |      6 |    2 | 1行の長さ (40)                                |
+ * |      8 |    8 | 予約 (0)                                      |
+ *
+ * 1フレーム分の行
+ *
+ * | offset | size | 内容                                          |
+ * |-------:|-----:|-----------------------------------------------|
+ * |      0 |    8 | キャプチャ時刻 [us] (CLOCK_MONOTONIC)         |
+ * |      8 |    8 | セグメント内の位置 [byte]                     |
+ * |     16 |    4 | セグメント番号                                |
+ * |     20 |    4 | 長さ [byte]                                   |
+ * |     24 |    4 | 記録を要求された順の番号 (捨てたフレームの分は飛ぶ) |
+ * |     28 |    4 | ピクセルフォーマット (V4L2 fourcc)            |
+ * |     32 |    2 | 横幅 [px]                                     |
+ * |     34 |    2 | 高さ [px]                                     |
+ * |     36 |    4 | 予約 (0)                                      |
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#ifndef RECORDING_INDEX_HPP_
+#define RECORDING_INDEX_HPP_
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** @brief 索引ファイル名 */
+#define RECORDING_INDEX_FILE "index.bin"
+
+/** @brief 索引ファイルの先頭の長さ [byte] */
+constexpr size_t RECORDING_INDEX_HEADER_SIZE = 16;
+
+/** @brief 索引1行の長さ [byte] */
+constexpr size_t RECORDING_INDEX_ENTRY_SIZE = 40;
+
+/** @brief マジック ("RRIX") */
+constexpr uint32_t RECORDING_INDEX_MAGIC = 0x58495252;
+
+/** @brief バージョン */
+constexpr uint16_t RECORDING_INDEX_VERSION = 1;
+
+/**
+ * @brief 索引1行 (記録したフレーム1枚)
+ */
+struct RecordingIndexEntry {
+    uint64_t timestamp_us = 0;  /**< キャプチャ時刻 [us] */
+    uint64_t offset = 0;        /**< セグメント内の位置 [byte] */
+    uint32_t segment = 0;       /**< セグメント番号 */
+    uint32_t size = 0;          /**< 長さ [byte] */
+    uint32_t sequence = 0;      /**< 記録を要求された順の番号 */
+    uint32_t fourcc = 0;        /**< ピクセルフォーマット */
+    uint16_t width = 0;         /**< 横幅 [px] */
+    uint16_t height = 0;        /**< 高さ [px] */
+};
+
+/**
+ * @brief セグメントファイルのパス
+ * @param[in] directory 記録ディレクトリ
+ * @param[in] segment   セグメント番号
+ */
+std::string recording_segment_path(const std::string& directory, uint32_t segment);
+
+/**
+ * @brief 索引ファイルの先頭を書き出す
+ * @param[out] out RECORDING_INDEX_HEADER_SIZE バイトの出力先
+ */
+void write_recording_index_header(uint8_t* out);
+
+/**
+ * @brief 索引1行を書き出す
+ * @param[in]  entry 行
+ * @param[out] out   RECORDING_INDEX_ENTRY_SIZE バイトの出力先
+ */
+void write_recording_index_entry(const RecordingIndexEntry& entry, uint8_t* out);
+
+/**
+ * @brief 記録ディレクトリの索引を全て読む
+ * @details 最後の行が書きかけ (途中で止まった記録) なら、その行は捨てる
+ * @param[in]  directory 記録ディレクトリ
+ * @param[out] entries   記録順の行
+ * @return true 成功 / false 索引が無い・形式が違う
+ */
+bool read_recording_index(const std::string& directory, std::vector<RecordingIndexEntry>& entries);
+
+/**
+ * @brief キャプチャ時刻が timestamp_us 以降の最初の行を探す (二分探索)
+ * @param[in] entries      read_recording_index() の結果
+ * @param[in] timestamp_us キャプチャ時刻 [us]
+ * @return 行の位置 (全て前なら entries.size())
+ */
+size_t find_recording_entry(const std::vector<RecordingIndexEntry>& entries, uint64_t timestamp_us);
+
+#endif // RECORDING_INDEX_HPP_
@@ -0,0 +1,233 @@
+/**
+ * @file    capture_loop.cpp
+ * @brief   複数カメラのフレーム待ち・振り分けの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cstdio>
+
+#include "camera/capture_loop.hpp"
+#include "logger/logger.hpp"
+
+CaptureLoop::CaptureLoop(IoReactor& reactor, uint32_t stall_timeout_ms)
+    : reactor_(reactor),
+      stall_timeout_ms_(stall_timeout_ms),
+      recovery_policy_(),
+      stall_timer_(-1),
+      entries_()
+{
+    stall_timer_ = reactor_.add_timer(stall_timeout_ms_, [this]() { check_stalls(); });
+}
+
+CaptureLoop::~CaptureLoop()
+{
+    for (Entry& entry : entries_) {
+        if (entry.camera != nullptr) {
+            remove_camera(*entry.camera);
+        }
+    }
+
+    reactor_.cancel_timer(stall_timer_);
+}
+
+bool CaptureLoop::add_camera(const std::string& name, FrameSource& camera, FrameHandler handler)
+{
+    if (camera.fd() < 0) {
+        LOG_E("Camera %s is not initialized", name.c_str());
+
+        return false;
+    }
+
+    const size_t index = entries_.size();
+
+    Entry entry;
+    entry.name = name;
+    entry.camera = &camera;
+    entry.fd = camera.fd();
+    entry.handler = std::move(handler);
+    entries_.push_back(std::move(entry));
+
+    if (!reactor_.add_reader(camera.fd(), [this, index]() { on_readable(index); })) {
+        LOG_E("Failed to register camera %s", name.c_str());
+
+        entries_[index].camera = nullptr;
+
+        return false;
+    }
+
+    return true;
+}
+
+void CaptureLoop::remove_camera(FrameSource& camera)
+{
+    for (Entry& entry : entries_) {
+        if (entry.camera != &camera) {
+            continue;
+        }
+
+        if (entry.recovering) {
+            stop_recovery(entry);
+        } else {
+            reactor_.remove_reader(entry.fd);
+        }
+        entry.camera = nullptr;
+
+        return;
+    }
+}
+
+uint64_t CaptureLoop::frame_count(const FrameSource& camera) const
+{
+    for (const Entry& entry : entries_) {
+        if (entry.camera == &camera) {
+            return entry.frames;
+        }
+    }
+
+    return 0;
+}
+
+void CaptureLoop::on_readable(size_t index)
+{
+    Entry& entry = entries_[index];
+    if (entry.camera == nullptr) {
+        return;
+    }
+
+    // 1回に1フレームだけ処理する (残りは次の待機ですぐに通知され、他のカメラと交互になる)
+    FrameSource::Frame frame;
+    if (!entry.camera->dequeue_frame(frame)) {
+        // 抜けたカメラの fd はエラーで読み込み可能になり続けるので、すぐに外す
+        if (entry.camera->is_disconnected()) {
+            start_recovery(index);
+        } else if (entry.camera->is_finished()) {
+            finish(index);
+        }
+
+        return;
+    }
+
+    entry.received = true;
+    entry.frames += 1;
+
+    FrameSource* camera = entry.camera;
+    entry.handler(frame);
+
+    // 処理関数の中で登録を外されても、取り出したバッファは返す
+    camera->release_frame(frame);
+}
+
+void CaptureLoop::check_stalls()
+{
+    for (Entry& entry : entries_) {
+        if (entry.camera == nullptr || entry.recovering) {
+            continue;
+        }
+
+        if (!entry.received) {
+            LOG_W("No frame from %s camera for %u ms", entry.name.c_str(), stall_timeout_ms_);
+        }
+        entry.received = false;
+    }
+}
+
+void CaptureLoop::start_recovery(size_t index)
+{
+    Entry& entry = entries_[index];
+
+    // fd を閉じる前に監視を外す (閉じた番号が再利用されても通知が混ざらないように)
+    reactor_.remove_reader(entry.fd);
+    entry.camera->close();
+
+    entry.recovering = true;
+    entry.backoff_ms = recovery_policy_.initial_backoff_ms;
+
+    // ノードが作り直されたらすぐに試す (監視できなくてもタイマで試し続ける)
+    entry.watcher = std::make_unique<DeviceWatcher>(entry.camera->name());
+    if (entry.watcher->is_valid()) {
+        reactor_.add_reader(entry.watcher->fd(), [this, index]() { on_device_event(index); });
+    }
+
+    entry.retry_timer = reactor_.add_timer(entry.backoff_ms, [this, index]() { try_reconnect(index); });
+
+    LOG_W("Lost %s camera, waiting for %s", entry.name.c_str(), entry.camera->name().c_str());
+}
+
+void CaptureLoop::on_device_event(size_t index)
+{
+    Entry& entry = entries_[index];
+    if (!entry.recovering || entry.watcher == nullptr) {
+        return;
+    }
+
+    if (entry.watcher->consume()) {
+        try_reconnect(index);
+    }
+}
+
+void CaptureLoop::try_reconnect(size_t index)
+{
+    Entry& entry = entries_[index];
+    if (!entry.recovering) {
+        return;
+    }
+
+    // 成功・失敗どちらでも今のタイマは止める (失敗なら間隔を伸ばして予約し直す)
+    reactor_.cancel_timer(entry.retry_timer);
+    entry.retry_timer = -1;
+
+    if (!entry.camera->reconnect()) {
+        entry.backoff_ms = std::min(entry.backoff_ms * 2, recovery_policy_.max_backoff_ms);
+        entry.retry_timer = reactor_.add_timer(entry.backoff_ms, [this, index]() { try_reconnect(index); });
+
+        LOG_W("Failed to reopen %s camera, retrying in %u ms", entry.name.c_str(), entry.backoff_ms);
+
+        return;
+    }
+
+    stop_recovery(entry);
+
+    entry.fd = entry.camera->fd();
+    if (!reactor_.add_reader(entry.fd, [this, index]() { on_readable(index); })) {
+        LOG_E("Failed to register camera %s", entry.name.c_str());
+
+        entry.camera = nullptr;
+    }
+}
+
+void CaptureLoop::stop_recovery(Entry& entry)
+{
+    if (entry.retry_timer >= 0) {
+        reactor_.cancel_timer(entry.retry_timer);
+        entry.retry_timer = -1;
+    }
+
+    if (entry.watcher != nullptr) {
+        if (entry.watcher->is_valid()) {
+            reactor_.remove_reader(entry.watcher->fd());
+        }
+        entry.watcher.reset();
+    }
+
+    entry.recovering = false;
+}
+
+void CaptureLoop::finish(size_t index)
+{
+    Entry& entry = entries_[index];
+
+    LOG_I("%s source finished after %llu frames", entry.name.c_str(), static_cast<unsigned long long>(entry.frames));
+
+    remove_camera(*entry.camera);
+
+    // 取得元が全て終わったら、それ以上待つものはない
+    for (const Entry& other : entries_) {
+        if (other.camera != nullptr) {
+            return;
+        }
+    }
+
+    reactor_.stop();
+}
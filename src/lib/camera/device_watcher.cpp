@@ -0,0 +1,73 @@
+/**
+ * @file    device_watcher.cpp
+ * @brief   デバイスノード監視の実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/inotify.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "camera/device_watcher.hpp"
+#include "logger/logger.hpp"
+
+DeviceWatcher::DeviceWatcher(const std::string& device_path)
+    : directory_("."),
+      name_(device_path),
+      inotify_fd_(-1),
+      watch_(-1)
+{
+    const size_t slash = device_path.rfind('/');
+    if (slash != std::string::npos) {
+        directory_ = (slash == 0) ? "/" : device_path.substr(0, slash);
+        name_ = device_path.substr(slash + 1);
+    }
+
+    inotify_fd_ = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (inotify_fd_ < 0) {
+        LOG_W("inotify_init1 failed: %s", strerror(errno));
+
+        return;
+    }
+
+    watch_ = inotify_add_watch(inotify_fd_, directory_.c_str(), IN_CREATE | IN_ATTRIB | IN_MOVED_TO);
+    if (watch_ < 0) {
+        LOG_W("Failed to watch %s: %s", directory_.c_str(), strerror(errno));
+    }
+}
+
+DeviceWatcher::~DeviceWatcher()
+{
+    if (inotify_fd_ >= 0) {
+        close(inotify_fd_);
+    }
+}
+
+bool DeviceWatcher::consume()
+{
+    // inotify_event は名前の長さが可変なので、境界を揃えたバッファにまとめて読む
+    alignas(struct inotify_event) char buffer[4096];
+    bool matched = false;
+
+    for (;;) {
+        const ssize_t length = read(inotify_fd_, buffer, sizeof(buffer));
+        if (length <= 0) {
+            break;
+        }
+
+        for (ssize_t offset = 0; offset < length; ) {
+            const struct inotify_event* event = reinterpret_cast<const struct inotify_event*>(buffer + offset);
+
+            if (event->len > 0 && name_ == event->name) {
+                matched = true;
+            }
+
+            offset += sizeof(struct inotify_event) + event->len;
+        }
+    }
+
+    return matched;
+}
@@ -0,0 +1,512 @@
+/**
+ * @file    file_frame_source.cpp
+ * @brief   保存したフレーム (YUYV / MJPEG / 画像ディレクトリ) の再生の実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <linux/videodev2.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <opencv2/imgcodecs.hpp>
+
+#include "camera/frame_source.hpp"
+#include "image_processor/yuyv_convert.hpp"
+#include "logger/logger.hpp"
+#include "recorder/recording_index.hpp"
+
+static uint64_t monotonic_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+/**
+ * @brief 拡張子を小文字で取得する (ドットなし)
+ */
+static std::string lower_extension(const std::string& path)
+{
+    const size_t dot = path.rfind('.');
+    const size_t slash = path.rfind('/');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash)) {
+        return "";
+    }
+
+    std::string extension = path.substr(dot + 1);
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(std::tolower(c)); });
+
+    return extension;
+}
+
+/**
+ * @brief data の先頭の JPEG 1枚の長さと画像サイズを求める
+ * @details マーカーセグメントを長さで読み飛ばし、SOS の後の符号化データは 0xFF 0x00 (スタッフィング) と
+ *          RSTn 以外のマーカーまで走査する。EOI で終わる。プログレッシブ (SOS が複数) にも対応する
+ * @param[in]  data   JPEG の先頭 (SOI)
+ * @param[in]  size   data 以降のバイト数
+ * @param[out] width  横幅 [px]
+ * @param[out] height 高さ [px]
+ * @return JPEG の長さ [byte] (壊れている・途中で切れている場合は 0)
+ */
+static size_t parse_jpeg(const uint8_t* data, size_t size, uint32_t& width, uint32_t& height)
+{
+    width = 0;
+    height = 0;
+
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return 0;
+    }
+
+    size_t pos = 2;
+    while (pos + 2 <= size) {
+        if (data[pos] != 0xFF) {
+            return 0;
+        }
+
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            // 詰め物の 0xFF
+            pos += 1;
+            continue;
+        }
+        if (marker == 0xD9) {
+            return pos + 2;
+        }
+        if ((marker >= 0xD0 && marker <= 0xD7) || marker == 0x01) {
+            pos += 2;
+            continue;
+        }
+
+        if (pos + 4 > size) {
+            return 0;
+        }
+
+        const size_t length = (static_cast<size_t>(data[pos + 2]) << 8) | data[pos + 3];
+        if (length < 2 || pos + 2 + length > size) {
+            return 0;
+        }
+
+        // SOF0〜SOF15 (DHT / JPG / DAC を除く) に画像サイズがある
+        if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC && length >= 7) {
+            height = (static_cast<uint32_t>(data[pos + 5]) << 8) | data[pos + 6];
+            width = (static_cast<uint32_t>(data[pos + 7]) << 8) | data[pos + 8];
+        }
+
+        pos += 2 + length;
+
+        if (marker == 0xDA) {
+            while (pos + 1 < size) {
+                const uint8_t next = data[pos + 1];
+                if (data[pos] == 0xFF && next != 0x00 && next != 0xFF && !(next >= 0xD0 && next <= 0xD7)) {
+                    break;
+                }
+                pos += 1;
+            }
+        }
+    }
+
+    return 0;
+}
+
+FileFrameSource::FileFrameSource(const std::string& path,
+                                 uint32_t width,
+                                 uint32_t height,
+                                 FramePacer::Mode pacing,
+                                 double fps,
+                                 bool loop)
+    : path_(path),
+      width_(width),
+      height_(height),
+      pacer_(pacing, fps),
+      loop_(loop),
+      mappings_(),
+      images_(),
+      frames_(),
+      next_(0),
+      finished_(false),
+      dropped_(0)
+{
+}
+
+FileFrameSource::~FileFrameSource()
+{
+    unload();
+}
+
+bool FileFrameSource::initialize()
+{
+    if (frames_.empty()) {
+        struct stat st;
+        if (stat(path_.c_str(), &st) < 0) {
+            LOG_E("Failed to open %s: %s", path_.c_str(), strerror(errno));
+
+            return false;
+        }
+
+        const std::string extension = lower_extension(path_);
+        bool loaded = false;
+
+        if (S_ISDIR(st.st_mode) && access((path_ + "/" + RECORDING_INDEX_FILE).c_str(), F_OK) == 0) {
+            loaded = load_recording();
+        } else if (S_ISDIR(st.st_mode)) {
+            loaded = load_image_directory();
+        } else if (extension == "mjpeg" || extension == "mjpg" || extension == "jpg" || extension == "jpeg") {
+            loaded = load_mjpeg_stream();
+        } else {
+            loaded = load_raw_yuyv();
+        }
+
+        if (!loaded || frames_.empty()) {
+            LOG_E("No frames in %s", path_.c_str());
+
+            unload();
+
+            return false;
+        }
+
+        LOG_I("Replay source %s: %zu frames, first %.4s %ux%u%s", path_.c_str(), frames_.size(),
+              reinterpret_cast<const char*>(&frames_[0].fourcc), frames_[0].width, frames_[0].height,
+              loop_ ? " (loop)" : "");
+    }
+
+    next_ = 0;
+    finished_ = false;
+
+    return pacer_.start();
+}
+
+bool FileFrameSource::dequeue_frame(Frame& frame)
+{
+    if (finished_ || frames_.empty()) {
+        return false;
+    }
+
+    const uint64_t ticks = pacer_.take();
+    if (ticks == 0) {
+        return false;
+    }
+
+    // 処理が間に合わずに過ぎた周期の分は、カメラと同じように飛ばす
+    if (ticks > 1) {
+        dropped_ += ticks - 1;
+        next_ += ticks - 1;
+    }
+
+    if (next_ >= frames_.size()) {
+        if (!loop_) {
+            finished_ = true;
+
+            return false;
+        }
+        next_ %= frames_.size();
+    }
+
+    const StoredFrame& stored = frames_[next_];
+
+    frame.data = stored.data;
+    frame.size = stored.size;
+    frame.width = stored.width;
+    frame.height = stored.height;
+    frame.fourcc = stored.fourcc;
+    frame.buffer_index = static_cast<int>(next_);
+    frame.timestamp_us = monotonic_us();
+
+    next_ += 1;
+
+    return true;
+}
+
+void FileFrameSource::release_frame(Frame& frame)
+{
+    frame.buffer_index = -1;
+    frame.data = nullptr;
+}
+
+bool FileFrameSource::seek(size_t index)
+{
+    if (index >= frames_.size()) {
+        LOG_W("%s: cannot seek to frame %zu of %zu", path_.c_str(), index, frames_.size());
+
+        return false;
+    }
+
+    next_ = index;
+    finished_ = false;
+
+    return true;
+}
+
+uint8_t* FileFrameSource::map_file(const std::string& file, bool populate, size_t& size)
+{
+    size = 0;
+
+    const int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        LOG_E("Failed to open %s: %s", file.c_str(), strerror(errno));
+
+        return nullptr;
+    }
+
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        LOG_E("%s is empty", file.c_str());
+
+        ::close(fd);
+
+        return nullptr;
+    }
+
+    // 処理側がフレームに書き込んでもファイルは変わらない (MAP_PRIVATE)
+    const size_t file_size = static_cast<size_t>(st.st_size);
+    void* mapping = mmap(nullptr, file_size, PROT_READ | PROT_WRITE,
+                         MAP_PRIVATE | (populate ? MAP_POPULATE : 0), fd, 0);
+    ::close(fd);
+
+    if (mapping == MAP_FAILED) {
+        LOG_E("mmap %s failed: %s", file.c_str(), strerror(errno));
+
+        return nullptr;
+    }
+
+    mappings_.emplace_back(mapping, file_size);
+    size = file_size;
+
+    return static_cast<uint8_t*>(mapping);
+}
+
+bool FileFrameSource::load_raw_yuyv()
+{
+    const size_t frame_bytes = static_cast<size_t>(width_ & ~1u) * height_ * 2;
+    if (frame_bytes == 0) {
+        LOG_E("Raw YUYV replay needs camera.width and camera.height");
+
+        return false;
+    }
+
+    // 再生中にディスクを読まないよう、全体を先に読み込んでおく
+    size_t mapping_size = 0;
+    uint8_t* base = map_file(path_, true, mapping_size);
+    if (base == nullptr) {
+        return false;
+    }
+
+    const size_t count = mapping_size / frame_bytes;
+    if (mapping_size % frame_bytes != 0) {
+        LOG_W("%s: ignoring %zu trailing bytes (not a multiple of %ux%u YUYV)",
+              path_.c_str(), mapping_size % frame_bytes, width_, height_);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        StoredFrame stored;
+        stored.data = base + i * frame_bytes;
+        stored.size = static_cast<uint32_t>(frame_bytes);
+        stored.width = width_ & ~1u;
+        stored.height = height_;
+        stored.fourcc = V4L2_PIX_FMT_YUYV;
+        frames_.push_back(stored);
+    }
+
+    return true;
+}
+
+bool FileFrameSource::load_mjpeg_stream()
+{
+    size_t mapping_size = 0;
+    uint8_t* base = map_file(path_, true, mapping_size);
+    if (base == nullptr) {
+        return false;
+    }
+
+    size_t pos = 0;
+    size_t broken = 0;
+
+    while (pos + 4 <= mapping_size) {
+        // フレーム間の余分なバイトは SOI まで飛ばす
+        if (base[pos] != 0xFF || base[pos + 1] != 0xD8) {
+            pos += 1;
+            continue;
+        }
+
+        uint32_t width = 0;
+        uint32_t height = 0;
+        const size_t length = parse_jpeg(base + pos, mapping_size - pos, width, height);
+        if (length == 0 || width == 0 || height == 0) {
+            broken += 1;
+            pos += 2;
+            continue;
+        }
+
+        StoredFrame stored;
+        stored.data = base + pos;
+        stored.size = static_cast<uint32_t>(length);
+        stored.width = width;
+        stored.height = height;
+        stored.fourcc = V4L2_PIX_FMT_MJPEG;
+        frames_.push_back(stored);
+
+        pos += length;
+    }
+
+    if (broken > 0) {
+        LOG_W("%s: skipped %zu broken JPEG frames", path_.c_str(), broken);
+    }
+
+    return true;
+}
+
+bool FileFrameSource::load_image_directory()
+{
+    DIR* dir = opendir(path_.c_str());
+    if (dir == nullptr) {
+        LOG_E("Failed to open %s: %s", path_.c_str(), strerror(errno));
+
+        return false;
+    }
+
+    std::vector<std::string> names;
+    while (const struct dirent* entry = readdir(dir)) {
+        if (entry->d_name[0] != '.') {
+            names.push_back(entry->d_name);
+        }
+    }
+    closedir(dir);
+
+    std::sort(names.begin(), names.end());
+
+    std::vector<StoredFrame> stored_frames;
+
+    for (const std::string& name : names) {
+        const std::string file = path_ + "/" + name;
+        const std::string extension = lower_extension(name);
+        StoredFrame stored;
+
+        if (extension == "jpg" || extension == "jpeg") {
+            // JPEG はデコードせずにカメラの MJPEG と同じように渡す
+            std::ifstream in(file, std::ios::binary);
+            std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+            if (parse_jpeg(bytes.data(), bytes.size(), stored.width, stored.height) == 0
+                || stored.width == 0 || stored.height == 0) {
+                LOG_W("Skipping broken JPEG %s", file.c_str());
+                continue;
+            }
+
+            stored.size = static_cast<uint32_t>(bytes.size());
+            stored.fourcc = V4L2_PIX_FMT_MJPEG;
+            images_.push_back(std::move(bytes));
+        } else {
+            // それ以外の画像 (BMP / PNG 等) はカメラの YUYV と同じ形にする。読めないファイルは飛ばす
+            const cv::Mat bgr = cv::imread(file, cv::IMREAD_COLOR);
+            if (bgr.empty() || bgr.cols < 2) {
+                continue;
+            }
+
+            stored.width = static_cast<uint32_t>(bgr.cols) & ~1u;
+            stored.height = static_cast<uint32_t>(bgr.rows);
+            stored.size = stored.width * stored.height * 2;
+            stored.fourcc = V4L2_PIX_FMT_YUYV;
+
+            std::vector<uint8_t> yuyv(stored.size);
+            bgr_to_yuyv(bgr.data, bgr.step, stored.width, stored.height, yuyv.data());
+            images_.push_back(std::move(yuyv));
+        }
+
+        stored_frames.push_back(stored);
+    }
+
+    // images_ の追加が終わってから位置を決める
+    for (size_t i = 0; i < stored_frames.size(); ++i) {
+        stored_frames[i].data = images_[i].data();
+        frames_.push_back(stored_frames[i]);
+    }
+
+    return true;
+}
+
+bool FileFrameSource::load_recording()
+{
+    std::vector<RecordingIndexEntry> entries;
+    if (!read_recording_index(path_, entries)) {
+        LOG_E("%s: unreadable %s", path_.c_str(), RECORDING_INDEX_FILE);
+
+        return false;
+    }
+
+    // 記録は RAM より大きいことがあるので、セグメントは先読みだけ頼んで必要な所をその都度読む
+    std::vector<std::pair<uint8_t*, size_t>> segments;
+    size_t broken = 0;
+
+    for (size_t i = 0; i < entries.size(); ++i) {
+        const RecordingIndexEntry& entry = entries[i];
+
+        // セグメント番号は1ずつしか増えない。飛んだ所・ファイルが無い所で記録は終わったとみなす
+        if (entry.segment > segments.size()) {
+            LOG_W("%s: index jumps to segment %u, ignoring the last %zu entries",
+                  path_.c_str(), entry.segment, entries.size() - i);
+            break;
+        }
+        if (entry.segment == segments.size()) {
+            const std::string file = recording_segment_path(path_, entry.segment);
+
+            size_t size = 0;
+            uint8_t* base = map_file(file, false, size);
+            if (base == nullptr) {
+                LOG_W("%s: recording ends at missing segment %u, ignoring the last %zu entries",
+                      path_.c_str(), entry.segment, entries.size() - i);
+                break;
+            }
+            madvise(base, size, MADV_WILLNEED);
+            segments.emplace_back(base, size);
+        }
+
+        // YUYV は width * height * 2 バイトを読むので、その長さが無い行も捨てる
+        const std::pair<uint8_t*, size_t>& segment = segments[entry.segment];
+        const bool is_yuyv = (entry.fourcc == V4L2_PIX_FMT_YUYV);
+        if (entry.size == 0 || entry.offset > segment.second || entry.size > segment.second - entry.offset
+            || (is_yuyv && (entry.width == 0 || entry.height == 0
+                            || entry.size < static_cast<uint64_t>(entry.width) * entry.height * 2))) {
+            broken += 1;
+            continue;
+        }
+
+        StoredFrame stored;
+        stored.data = segment.first + entry.offset;
+        stored.size = entry.size;
+        stored.width = entry.width;
+        stored.height = entry.height;
+        stored.fourcc = entry.fourcc;
+        frames_.push_back(stored);
+    }
+
+    if (broken > 0) {
+        LOG_W("%s: skipped %zu frames outside their segments or shorter than their size", path_.c_str(), broken);
+    }
+
+    return true;
+}
+
+void FileFrameSource::unload()
+{
+    pacer_.stop();
+
+    frames_.clear();
+    images_.clear();
+
+    for (const std::pair<void*, size_t>& mapping : mappings_) {
+        munmap(mapping.first, mapping.second);
+    }
+    mappings_.clear();
+}
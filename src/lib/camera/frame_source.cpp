@@ -0,0 +1,263 @@
+/**
+ * @file    frame_source.cpp
+ * @brief   フレーム取得元の共通処理・間隔生成・テストパターンの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <linux/videodev2.h>
+#include <poll.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#include "camera/frame_source.hpp"
+#include "image_processor/yuyv_convert.hpp"
+#include "logger/logger.hpp"
+
+#define DEFAULT_PACING_FPS 30.0     /**< fps が不正な時に使うフレームレート */
+#define PATTERN_BAR_COUNT 8         /**< カラーバーの本数 */
+
+static uint64_t monotonic_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+bool FrameSource::get_once_frame(Frame& frame)
+{
+    pollfd pfd{};
+    pfd.fd = fd();
+    pfd.events = POLLIN;
+
+    int ret = poll(&pfd, 1, 1000);
+    if (ret <= 0) {
+        return false;
+    }
+
+    return dequeue_frame(frame);
+}
+
+bool FramePacer::parse_mode(const std::string& name, Mode& mode)
+{
+    if (name == "realtime") {
+        mode = Mode::REAL_TIME;
+    } else if (name == "fast") {
+        mode = Mode::AS_FAST_AS_POSSIBLE;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+FramePacer::FramePacer(Mode mode, double fps)
+    : mode_(mode),
+      fps_(fps),
+      fd_(-1)
+{
+}
+
+FramePacer::~FramePacer()
+{
+    stop();
+}
+
+bool FramePacer::start()
+{
+    if (fd_ >= 0) {
+        return true;
+    }
+
+    if (mode_ == Mode::AS_FAST_AS_POSSIBLE) {
+        // 値を読まないので、ずっと読み込み可能のまま
+        fd_ = eventfd(1, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (fd_ < 0) {
+            LOG_E("eventfd failed: %s", strerror(errno));
+
+            return false;
+        }
+
+        return true;
+    }
+
+    if (fps_ <= 0.0) {
+        LOG_W("Invalid replay fps %.2f, using %.0f", fps_, DEFAULT_PACING_FPS);
+        fps_ = DEFAULT_PACING_FPS;
+    }
+
+    fd_ = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (fd_ < 0) {
+        LOG_E("timerfd_create failed: %s", strerror(errno));
+
+        return false;
+    }
+
+    const uint64_t interval_ns = static_cast<uint64_t>(1e9 / fps_);
+
+    itimerspec spec{};
+    spec.it_interval.tv_sec = static_cast<time_t>(interval_ns / 1000000000);
+    spec.it_interval.tv_nsec = static_cast<long>(interval_ns % 1000000000);
+    spec.it_value = spec.it_interval;
+
+    if (timerfd_settime(fd_, 0, &spec, nullptr) < 0) {
+        LOG_E("timerfd_settime failed: %s", strerror(errno));
+
+        stop();
+
+        return false;
+    }
+
+    return true;
+}
+
+void FramePacer::stop()
+{
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+uint64_t FramePacer::take()
+{
+    if (fd_ < 0) {
+        return 0;
+    }
+
+    if (mode_ == Mode::AS_FAST_AS_POSSIBLE) {
+        return 1;
+    }
+
+    uint64_t expirations = 0;
+    if (read(fd_, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return 0;
+    }
+
+    return expirations;
+}
+
+SyntheticFrameSource::SyntheticFrameSource(uint32_t width, uint32_t height, FramePacer::Mode pacing, double fps)
+    : name_("synthetic"),
+      width_(width & ~1u),
+      height_(height),
+      pacer_(pacing, fps),
+      background_(),
+      in_use_{false, false},
+      sequence_(0)
+{
+}
+
+bool SyntheticFrameSource::initialize()
+{
+    if (width_ == 0 || height_ == 0) {
+        LOG_E("Invalid synthetic frame size %ux%u", width_, height_);
+
+        return false;
+    }
+
+    if (background_.empty()) {
+        // 75% のカラーバー (白・黄・シアン・緑・マゼンタ・赤・青・黒) を1行作り、全ての行に写す
+        static const uint8_t BAR_BGR[PATTERN_BAR_COUNT][3] = {
+            {191, 191, 191}, {0, 191, 191}, {191, 191, 0}, {0, 191, 0},
+            {191, 0, 191},   {0, 0, 191},   {191, 0, 0},   {0, 0, 0},
+        };
+
+        std::vector<uint8_t> bgr_row(static_cast<size_t>(width_) * 3);
+        for (uint32_t x = 0; x < width_; ++x) {
+            const uint8_t* color = BAR_BGR[x * PATTERN_BAR_COUNT / width_];
+            std::memcpy(&bgr_row[static_cast<size_t>(x) * 3], color, 3);
+        }
+
+        const size_t row_bytes = static_cast<size_t>(width_) * 2;
+        background_.resize(row_bytes * height_);
+        bgr_to_yuyv(bgr_row.data(), bgr_row.size(), width_, 1, background_.data());
+
+        for (uint32_t y = 1; y < height_; ++y) {
+            std::memcpy(&background_[y * row_bytes], background_.data(), row_bytes);
+        }
+
+        for (std::vector<uint8_t>& buffer : buffers_) {
+            buffer.resize(background_.size());
+        }
+    }
+
+    if (!pacer_.start()) {
+        return false;
+    }
+
+    LOG_I("Synthetic source: YUYV %ux%u", width_, height_);
+
+    return true;
+}
+
+bool SyntheticFrameSource::dequeue_frame(Frame& frame)
+{
+    const uint64_t ticks = pacer_.take();
+    if (ticks == 0) {
+        return false;
+    }
+
+    int index = -1;
+    for (int i = 0; i < 2; ++i) {
+        if (!in_use_[i]) {
+            index = i;
+            break;
+        }
+    }
+    if (index < 0) {
+        return false;
+    }
+
+    // 処理が間に合わずに過ぎた周期の分も四角を進める (カメラで取りこぼしたのと同じ見え方)
+    sequence_ += ticks;
+
+    std::vector<uint8_t>& buffer = buffers_[index];
+    std::memcpy(buffer.data(), background_.data(), background_.size());
+
+    // 白い四角を斜めに動かす (横位置は YUYV のマクロピクセルに揃える)
+    const uint32_t box = std::max<uint32_t>(2, (height_ / 6) & ~1u);
+    if (box < width_ && box < height_) {
+        const uint32_t box_x = static_cast<uint32_t>((sequence_ * 8) % (width_ - box)) & ~1u;
+        const uint32_t box_y = static_cast<uint32_t>((sequence_ * 4) % (height_ - box));
+        const size_t row_bytes = static_cast<size_t>(width_) * 2;
+
+        for (uint32_t y = box_y; y < box_y + box; ++y) {
+            uint8_t* dst = &buffer[y * row_bytes + static_cast<size_t>(box_x) * 2];
+            for (uint32_t x = 0; x < box; x += 2) {
+                dst[0] = 235;
+                dst[1] = 128;
+                dst[2] = 235;
+                dst[3] = 128;
+                dst += 4;
+            }
+        }
+    }
+
+    in_use_[index] = true;
+
+    frame.data = buffer.data();
+    frame.size = static_cast<uint32_t>(buffer.size());
+    frame.width = width_;
+    frame.height = height_;
+    frame.fourcc = V4L2_PIX_FMT_YUYV;
+    frame.buffer_index = index;
+    frame.timestamp_us = monotonic_us();
+
+    return true;
+}
+
+void SyntheticFrameSource::release_frame(Frame& frame)
+{
+    if (frame.buffer_index >= 0 && frame.buffer_index < 2) {
+        in_use_[frame.buffer_index] = false;
+    }
+
+    frame.buffer_index = -1;
+    frame.data = nullptr;
+}
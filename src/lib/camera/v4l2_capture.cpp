@@ -9,10 +9,11 @@
 #include <unistd.h>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
-#include <poll.h>
 #include <linux/videodev2.h>
 #include <cstring>
 #include <cerrno>
+#include <chrono>
+#include <algorithm>
 
 #include "camera/v4l2_capture.hpp"
 #include "logger/logger.hpp"
@@ -26,13 +27,185 @@ static int xioctl(int fd, unsigned long req, void* arg)
     return r;
 }
 
+#define FPS_EPSILON 0.01    /**< フレームレートを同じとみなす差 [fps] */
+
+static uint64_t monotonic_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static const char* mode_policy_name(V4L2Capture::ModePolicy policy)
+{
+    switch (policy) {
+    case V4L2Capture::ModePolicy::MAX_FPS:
+        return "max_fps";
+    case V4L2Capture::ModePolicy::MAX_RESOLUTION:
+        return "max_resolution";
+    default:
+        return "exact";
+    }
+}
+
+// a が b より policy にとって良いモードか
+static bool is_better_mode(const V4L2Capture::Mode& a, const V4L2Capture::Mode& b, V4L2Capture::ModePolicy policy)
+{
+    const uint64_t area_a = static_cast<uint64_t>(a.width) * a.height;
+    const uint64_t area_b = static_cast<uint64_t>(b.width) * b.height;
+    const double fps_diff = a.fps() - b.fps();
+    const bool same_fps = fps_diff < FPS_EPSILON && fps_diff > -FPS_EPSILON;
+
+    if (policy == V4L2Capture::ModePolicy::MAX_RESOLUTION) {
+        if (area_a != area_b) {
+            return area_a > area_b;
+        }
+        if (!same_fps) {
+            return fps_diff > 0.0;
+        }
+    } else {
+        if (!same_fps) {
+            return fps_diff > 0.0;
+        }
+        // 同じフレームレートなら、推論・圧縮の軽い小さい解像度
+        if (policy == V4L2Capture::ModePolicy::MAX_FPS && area_a != area_b) {
+            return area_a < area_b;
+        }
+    }
+
+    // 最後は JPEG のデコードが要らない YUYV
+    return a.fourcc == V4L2_PIX_FMT_YUYV && b.fourcc != V4L2_PIX_FMT_YUYV;
+}
+
+// width × height で取れるフレーム間隔を modes に追加する
+static void append_intervals(int fd,
+                             uint32_t fourcc,
+                             uint32_t width,
+                             uint32_t height,
+                             std::vector<V4L2Capture::Mode>& modes)
+{
+    V4L2Capture::Mode mode;
+    mode.fourcc = fourcc;
+    mode.width = width;
+    mode.height = height;
+
+    v4l2_frmivalenum interval{};
+    interval.pixel_format = fourcc;
+    interval.width = width;
+    interval.height = height;
+
+    for (interval.index = 0; xioctl(fd, VIDIOC_ENUM_FRAMEINTERVALS, &interval) == 0; ++interval.index) {
+        if (interval.type == V4L2_FRMIVAL_TYPE_DISCRETE) {
+            mode.interval_numerator = interval.discrete.numerator;
+            mode.interval_denominator = interval.discrete.denominator;
+            modes.push_back(mode);
+
+            continue;
+        }
+
+        // STEPWISE / CONTINUOUS は1個目に範囲だけが入る。最速と最遅を候補にする
+        mode.interval_numerator = interval.stepwise.min.numerator;
+        mode.interval_denominator = interval.stepwise.min.denominator;
+        modes.push_back(mode);
+
+        mode.interval_numerator = interval.stepwise.max.numerator;
+        mode.interval_denominator = interval.stepwise.max.denominator;
+        modes.push_back(mode);
+
+        return;
+    }
+
+    // フレーム間隔を列挙できないドライバでは、フレームレート不明のモードとして残す
+    if (interval.index == 0) {
+        modes.push_back(mode);
+    }
+}
+
 V4L2Capture::V4L2Capture(const std::string& device_name,
                          uint32_t width,
-                         uint32_t height)
+                         uint32_t height,
+                         uint32_t fourcc)
     : device_name_(device_name),
       width_(width),
-      height_(height)
+      height_(height),
+      fourcc_(fourcc),
+      controls_(),
+      mode_request_(),
+      mode_()
+{
+}
+
+bool V4L2Capture::parse_pixel_format(const std::string& name, uint32_t& fourcc)
 {
+    if (name == "yuyv") {
+        fourcc = V4L2_PIX_FMT_YUYV;
+    } else if (name == "mjpeg") {
+        fourcc = V4L2_PIX_FMT_MJPEG;
+    } else if (name == "auto") {
+        fourcc = 0;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool V4L2Capture::parse_mode_policy(const std::string& name, ModePolicy& policy)
+{
+    if (name == "exact") {
+        policy = ModePolicy::EXACT;
+    } else if (name == "max_fps") {
+        policy = ModePolicy::MAX_FPS;
+    } else if (name == "max_resolution") {
+        policy = ModePolicy::MAX_RESOLUTION;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+bool V4L2Capture::select_mode(const std::vector<Mode>& modes,
+                              uint32_t fourcc,
+                              uint32_t width,
+                              uint32_t height,
+                              const ModeRequest& request,
+                              Mode& chosen)
+{
+    const uint32_t min_width = (request.min_width > 0) ? request.min_width : width;
+    const Mode* best = nullptr;
+
+    for (const Mode& mode : modes) {
+        // auto では取得後に扱える YUYV と MJPEG だけを候補にする
+        if (fourcc != 0) {
+            if (mode.fourcc != fourcc) {
+                continue;
+            }
+        } else if (mode.fourcc != V4L2_PIX_FMT_YUYV && mode.fourcc != V4L2_PIX_FMT_MJPEG) {
+            continue;
+        }
+
+        if (request.policy == ModePolicy::EXACT && (mode.width != width || mode.height != height)) {
+            continue;
+        }
+        if (request.policy == ModePolicy::MAX_FPS && mode.width < min_width) {
+            continue;
+        }
+        if (request.policy == ModePolicy::MAX_RESOLUTION && mode.fps() + FPS_EPSILON < request.min_fps) {
+            continue;
+        }
+
+        if (best == nullptr || is_better_mode(mode, *best, request.policy)) {
+            best = &mode;
+        }
+    }
+
+    if (best == nullptr) {
+        return false;
+    }
+
+    chosen = *best;
+
+    return true;
 }
 
 V4L2Capture::~V4L2Capture()
@@ -49,12 +222,47 @@ bool V4L2Capture::initialize()
         return false;
     }
 
-    if (!set_frame_format(width_, height_, V4L2_PIX_FMT_YUYV)) {
+    // 再初期化では前回決めたモードをそのまま使う
+    Mode target = mode_;
+    if (target.fourcc == 0) {
+        negotiate_mode(target);
+    }
+
+    if (!set_frame_format(target.width, target.height, target.fourcc)) {
         close_device();
 
         return false;
     }
 
+    // フレームレート・コントロールが固定できなくても取得は続ける (ログで知らせる)
+    if (controls_.frame_rate > 0) {
+        set_frame_interval(1, controls_.frame_rate);
+    } else if (target.interval_numerator > 0) {
+        set_frame_interval(target.interval_numerator, target.interval_denominator);
+    }
+    apply_controls(controls_);
+
+    // ドライバが丸めた後の実際のモードを記録し、選んだモードと違えば知らせる
+    const double expected_fps = (controls_.frame_rate > 0) ? controls_.frame_rate : target.fps();
+
+    mode_.fourcc = fourcc_;
+    mode_.width = width_;
+    mode_.height = height_;
+
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if (xioctl(device_fd_, VIDIOC_G_PARM, &parm) == 0) {
+        mode_.interval_numerator = parm.parm.capture.timeperframe.numerator;
+        mode_.interval_denominator = parm.parm.capture.timeperframe.denominator;
+    }
+
+    LOG_I("%s: %.4s %ux%u @ %.2f fps", device_name_.c_str(),
+          reinterpret_cast<const char*>(&mode_.fourcc), mode_.width, mode_.height, mode_.fps());
+
+    if (expected_fps > 0.0 && mode_.fps() + FPS_EPSILON < expected_fps) {
+        LOG_W("%s runs at %.2f fps instead of %.2f fps", device_name_.c_str(), mode_.fps(), expected_fps);
+    }
+
     v4l2_requestbuffers req{};
     req.count  = 2;
     req.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
@@ -166,28 +374,43 @@ bool V4L2Capture::set_frame_format(uint32_t width, uint32_t height, uint32_t fou
         return false;
     }
 
+    // 対応していないフォーマットはドライバが別のものに置き換える
+    if (fmt.fmt.pix.pixelformat != fourcc) {
+        LOG_E("Pixel format %.4s is not supported by %s", reinterpret_cast<const char*>(&fourcc),
+              device_name_.c_str());
+
+        return false;
+    }
+
+    // 対応していない解像度は近いものに丸められる
+    if (fmt.fmt.pix.width != width || fmt.fmt.pix.height != height) {
+        LOG_W("%s does not support %ux%u, using %ux%u", device_name_.c_str(),
+              width, height, fmt.fmt.pix.width, fmt.fmt.pix.height);
+    }
+
+    fourcc_ = fourcc;
     width_ = fmt.fmt.pix.width;
     height_ = fmt.fmt.pix.height;
 
     return true;
 }
 
-bool V4L2Capture::get_once_frame(Frame& frame)
+bool V4L2Capture::dequeue_frame(Frame& frame)
 {
-    pollfd pfd{};
-    pfd.fd = device_fd_;
-    pfd.events = POLLIN;
-
-    int ret = poll(&pfd, 1, 1000);
-    if (ret <= 0) {
-        return false;
-    }
-
     v4l2_buffer buf{};
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buf.memory = V4L2_MEMORY_MMAP;
 
     if (xioctl(device_fd_, VIDIOC_DQBUF, &buf) < 0) {
+        // 抜けたデバイスは ENODEV (転送の途中なら EIO) を返し続ける
+        if ((errno == ENODEV || errno == EIO) && !disconnected_) {
+            LOG_E("%s disconnected: %s", device_name_.c_str(), strerror(errno));
+
+            disconnected_ = true;
+            disconnected_at_us_ = monotonic_us();
+            recovery_stats_.disconnects += 1;
+        }
+
         return false;
     }
 
@@ -195,9 +418,47 @@ bool V4L2Capture::get_once_frame(Frame& frame)
     frame.size = buf.bytesused;
     frame.width = width_;
     frame.height = height_;
-    frame.fourcc = V4L2_PIX_FMT_YUYV;
+    frame.fourcc = fourcc_;
     frame.buffer_index = buf.index;
 
+    // ドライバが CLOCK_MONOTONIC の時刻を付けていればそれを使う
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC
+        && (buf.timestamp.tv_sec != 0 || buf.timestamp.tv_usec != 0)) {
+        frame.timestamp_us = static_cast<uint64_t>(buf.timestamp.tv_sec) * 1000000
+                           + static_cast<uint64_t>(buf.timestamp.tv_usec);
+    } else {
+        frame.timestamp_us = monotonic_us();
+    }
+
+    return true;
+}
+
+void V4L2Capture::close()
+{
+    close_device();
+}
+
+bool V4L2Capture::reconnect()
+{
+    close_device();
+
+    // mode_ が決まっているので、モードは選び直さずに同じものを設定する
+    if (!initialize()) {
+        recovery_stats_.failed_reconnects += 1;
+
+        return false;
+    }
+
+    recovery_stats_.reconnects += 1;
+
+    if (disconnected_) {
+        const uint64_t downtime_ms = (monotonic_us() - disconnected_at_us_) / 1000;
+        recovery_stats_.downtime_ms += downtime_ms;
+
+        LOG_I("%s reconnected after %llu ms", device_name_.c_str(), static_cast<unsigned long long>(downtime_ms));
+    }
+    disconnected_ = false;
+
     return true;
 }
 
@@ -217,3 +478,287 @@ void V4L2Capture::release_frame(Frame& frame)
     frame.buffer_index = -1;
     frame.data = nullptr;
 }
+
+void V4L2Capture::negotiate_mode(Mode& target)
+{
+    target = Mode();
+    target.fourcc = (fourcc_ != 0) ? fourcc_ : V4L2_PIX_FMT_YUYV;
+    target.width = width_;
+    target.height = height_;
+
+    std::vector<Mode> modes;
+    if (!enumerate_modes(modes)) {
+        // 列挙に対応していないドライバには要求をそのまま渡す (S_FMT が近い解像度に丸める)
+        LOG_W("Failed to enumerate modes of %s, requesting %ux%u", device_name_.c_str(), width_, height_);
+
+        return;
+    }
+
+    if (!select_mode(modes, fourcc_, width_, height_, mode_request_, target)) {
+        LOG_W("No mode of %s matches %s (%ux%u, min width %u, min %.2f fps), requesting %ux%u",
+              device_name_.c_str(), mode_policy_name(mode_request_.policy), width_, height_,
+              mode_request_.min_width, mode_request_.min_fps, width_, height_);
+
+        return;
+    }
+
+    LOG_I("%s: selected %.4s %ux%u @ %.2f fps out of %zu modes (%s)",
+          device_name_.c_str(), reinterpret_cast<const char*>(&target.fourcc),
+          target.width, target.height, target.fps(), modes.size(), mode_policy_name(mode_request_.policy));
+}
+
+bool V4L2Capture::enumerate_modes(std::vector<Mode>& modes)
+{
+    modes.clear();
+
+    v4l2_fmtdesc format{};
+    format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    for (format.index = 0; xioctl(device_fd_, VIDIOC_ENUM_FMT, &format) == 0; ++format.index) {
+        v4l2_frmsizeenum size{};
+        size.pixel_format = format.pixelformat;
+
+        for (size.index = 0; xioctl(device_fd_, VIDIOC_ENUM_FRAMESIZES, &size) == 0; ++size.index) {
+            if (size.type == V4L2_FRMSIZE_TYPE_DISCRETE) {
+                append_intervals(device_fd_, format.pixelformat, size.discrete.width, size.discrete.height, modes);
+
+                continue;
+            }
+
+            // STEPWISE / CONTINUOUS は1個目に範囲だけが入る。最小・最大と、範囲内なら要求した解像度を候補にする
+            const v4l2_frmsize_stepwise& range = size.stepwise;
+            append_intervals(device_fd_, format.pixelformat, range.min_width, range.min_height, modes);
+            append_intervals(device_fd_, format.pixelformat, range.max_width, range.max_height, modes);
+
+            const bool width_fits = width_ > range.min_width && width_ < range.max_width
+                                 && (range.step_width == 0 || (width_ - range.min_width) % range.step_width == 0);
+            const bool height_fits = height_ > range.min_height && height_ < range.max_height
+                                  && (range.step_height == 0 || (height_ - range.min_height) % range.step_height == 0);
+            if (width_fits && height_fits) {
+                append_intervals(device_fd_, format.pixelformat, width_, height_, modes);
+            }
+
+            break;
+        }
+    }
+
+    return !modes.empty();
+}
+
+void V4L2Capture::log_modes()
+{
+    std::vector<Mode> modes;
+    if (!enumerate_modes(modes)) {
+        LOG_W("Failed to enumerate modes of %s", device_name_.c_str());
+
+        return;
+    }
+
+    LOG_I("%s: %zu modes", device_name_.c_str(), modes.size());
+
+    for (const Mode& m : modes) {
+        LOG_I("  %.4s %4ux%-4u %6.2f fps (%u/%u s)", reinterpret_cast<const char*>(&m.fourcc),
+              m.width, m.height, m.fps(), m.interval_numerator, m.interval_denominator);
+    }
+}
+
+bool V4L2Capture::set_frame_interval(uint32_t numerator, uint32_t denominator)
+{
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (xioctl(device_fd_, VIDIOC_G_PARM, &parm) < 0) {
+        LOG_W("VIDIOC_G_PARM failed: %s", strerror(errno));
+
+        return false;
+    }
+
+    if (!(parm.parm.capture.capability & V4L2_CAP_TIMEPERFRAME)) {
+        LOG_W("%s does not support setting the frame rate", device_name_.c_str());
+
+        return false;
+    }
+
+    parm.parm.capture.timeperframe.numerator = numerator;
+    parm.parm.capture.timeperframe.denominator = denominator;
+
+    // uvcvideo 等はストリーム開始後の変更を EBUSY で拒否する
+    if (xioctl(device_fd_, VIDIOC_S_PARM, &parm) < 0) {
+        LOG_W("VIDIOC_S_PARM failed: %s", strerror(errno));
+
+        return false;
+    }
+
+    // ドライバは対応している中で一番近い間隔に丸める
+    const v4l2_fract& interval = parm.parm.capture.timeperframe;
+    LOG_I("%s frame interval locked to %u/%u s (requested %u/%u)",
+          device_name_.c_str(), interval.numerator, interval.denominator, numerator, denominator);
+
+    return true;
+}
+
+double V4L2Capture::frame_rate()
+{
+    v4l2_streamparm parm{};
+    parm.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+
+    if (xioctl(device_fd_, VIDIOC_G_PARM, &parm) < 0 || parm.parm.capture.timeperframe.numerator == 0) {
+        return 0.0;
+    }
+
+    return static_cast<double>(parm.parm.capture.timeperframe.denominator)
+         / parm.parm.capture.timeperframe.numerator;
+}
+
+bool V4L2Capture::has_control(uint32_t id)
+{
+    v4l2_queryctrl query{};
+    query.id = id;
+
+    return xioctl(device_fd_, VIDIOC_QUERYCTRL, &query) == 0 && !(query.flags & V4L2_CTRL_FLAG_DISABLED);
+}
+
+bool V4L2Capture::set_control(uint32_t id, int32_t value)
+{
+    v4l2_queryctrl query{};
+    query.id = id;
+
+    if (xioctl(device_fd_, VIDIOC_QUERYCTRL, &query) < 0 || (query.flags & V4L2_CTRL_FLAG_DISABLED)) {
+        LOG_W("Control 0x%08x is not supported by %s", id, device_name_.c_str());
+
+        return false;
+    }
+
+    if (query.flags & V4L2_CTRL_FLAG_READ_ONLY) {
+        LOG_W("Control %s of %s is read-only", reinterpret_cast<const char*>(query.name), device_name_.c_str());
+
+        return false;
+    }
+
+    // 範囲外・刻みに合わない値はドライバによって ERANGE になるので、先に丸める
+    int32_t rounded = std::clamp(value, query.minimum, query.maximum);
+    if (query.step > 1) {
+        const int64_t steps = (static_cast<int64_t>(rounded) - query.minimum + query.step / 2) / query.step;
+        rounded = static_cast<int32_t>(std::min<int64_t>(query.minimum + steps * query.step, query.maximum));
+    }
+
+    v4l2_control control{};
+    control.id = id;
+    control.value = rounded;
+
+    if (xioctl(device_fd_, VIDIOC_S_CTRL, &control) < 0) {
+        LOG_W("Failed to set %s = %d on %s: %s",
+              reinterpret_cast<const char*>(query.name), rounded, device_name_.c_str(), strerror(errno));
+
+        return false;
+    }
+
+    if (rounded != value) {
+        LOG_W("%s of %s rounded from %d to %d (range %d..%d, step %d)",
+              reinterpret_cast<const char*>(query.name), device_name_.c_str(), value, rounded,
+              query.minimum, query.maximum, query.step);
+    }
+
+    return true;
+}
+
+bool V4L2Capture::get_control(uint32_t id, int32_t& value)
+{
+    v4l2_control control{};
+    control.id = id;
+
+    if (xioctl(device_fd_, VIDIOC_G_CTRL, &control) < 0) {
+        return false;
+    }
+
+    value = control.value;
+
+    return true;
+}
+
+bool V4L2Capture::apply_controls(const Controls& controls)
+{
+    bool ok = true;
+
+    // 手動値は自動制御を切ってからでないと受け付けられない (INACTIVE のまま無視される)
+    if (controls.exposure >= 0) {
+        ok &= set_control(V4L2_CID_EXPOSURE_AUTO, V4L2_EXPOSURE_MANUAL);
+        ok &= set_control(V4L2_CID_EXPOSURE_ABSOLUTE, controls.exposure);
+    }
+
+    // 暗い所で自動露光が露光時間を伸ばし、フレームレートが黙って落ちるのを防ぐ
+    if (controls.exposure_auto_priority >= 0) {
+        ok &= set_control(V4L2_CID_EXPOSURE_AUTO_PRIORITY, controls.exposure_auto_priority ? 1 : 0);
+    }
+
+    if (controls.gain >= 0) {
+        if (has_control(V4L2_CID_AUTOGAIN)) {
+            ok &= set_control(V4L2_CID_AUTOGAIN, 0);
+        }
+        ok &= set_control(V4L2_CID_GAIN, controls.gain);
+    }
+
+    // 自動ホワイトバランスは抵抗のカラーコードの色味を場面毎に変えてしまう
+    if (controls.white_balance >= 0) {
+        ok &= set_control(V4L2_CID_AUTO_WHITE_BALANCE, 0);
+        ok &= set_control(V4L2_CID_WHITE_BALANCE_TEMPERATURE, controls.white_balance);
+    }
+
+    if (controls.focus >= 0) {
+        ok &= set_control(V4L2_CID_FOCUS_AUTO, 0);
+        ok &= set_control(V4L2_CID_FOCUS_ABSOLUTE, controls.focus);
+    }
+
+    return ok;
+}
+
+bool V4L2Capture::query_controls(std::vector<ControlInfo>& controls)
+{
+    controls.clear();
+
+    v4l2_queryctrl query{};
+    query.id = V4L2_CTRL_FLAG_NEXT_CTRL;
+
+    while (xioctl(device_fd_, VIDIOC_QUERYCTRL, &query) == 0) {
+        if (!(query.flags & V4L2_CTRL_FLAG_DISABLED) && query.type != V4L2_CTRL_TYPE_CTRL_CLASS) {
+            ControlInfo info;
+            info.id = query.id;
+            info.name = reinterpret_cast<const char*>(query.name);
+            info.type = query.type;
+            info.minimum = query.minimum;
+            info.maximum = query.maximum;
+            info.step = query.step;
+            info.default_value = query.default_value;
+            info.flags = query.flags;
+
+            if (!get_control(query.id, info.value)) {
+                info.value = query.default_value;
+            }
+
+            controls.push_back(info);
+        }
+
+        query.id |= V4L2_CTRL_FLAG_NEXT_CTRL;
+    }
+
+    // 列挙の終わりは EINVAL
+    return errno == EINVAL;
+}
+
+void V4L2Capture::log_controls()
+{
+    std::vector<ControlInfo> controls;
+    if (!query_controls(controls)) {
+        LOG_W("Failed to enumerate controls of %s: %s", device_name_.c_str(), strerror(errno));
+
+        return;
+    }
+
+    LOG_I("%s: %zu controls, frame rate %.2f fps", device_name_.c_str(), controls.size(), frame_rate());
+
+    for (const ControlInfo& c : controls) {
+        LOG_I("  %-32s 0x%08x min %d max %d step %d default %d value %d%s",
+              c.name.c_str(), c.id, c.minimum, c.maximum, c.step, c.default_value, c.value,
+              (c.flags & V4L2_CTRL_FLAG_INACTIVE) ? " (inactive)" : "");
+    }
+}
@@ -0,0 +1,457 @@
+/**
+ * @file    io_reactor.cpp
+ * @brief   io_uring / epoll によるイベントループの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "event_loop/io_reactor.hpp"
+#include "logger/logger.hpp"
+
+#define URING_QUEUE_ENTRIES 64      /**< io_uring の投入キューの大きさ */
+#define EPOLL_MAX_EVENTS 16         /**< epoll_wait 1回で受け取る最大イベント数 */
+#define REMOVE_TOKEN UINT64_MAX     /**< 監視の取り消し (IORING_OP_POLL_REMOVE) 自身の完了 */
+#define NO_SLOT SIZE_MAX            /**< dispatching_slot_ がどこも指していない */
+
+static uint64_t monotonic_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000 + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+bool IoReactor::parse_backend(const std::string& name, Backend& backend)
+{
+    if (name == "io_uring") {
+        backend = Backend::IO_URING;
+    } else if (name == "epoll") {
+        backend = Backend::EPOLL;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+const char* IoReactor::backend_name(Backend backend)
+{
+    return (backend == Backend::IO_URING) ? "io_uring" : "epoll";
+}
+
+IoReactor::IoReactor(Backend preferred)
+    : backend_(Backend::EPOLL),
+      uring_(),
+      epoll_fd_(-1),
+      wakeup_fd_(-1),
+      readers_(),
+      timers_(),
+      dispatching_slot_(NO_SLOT),
+      posted_mutex_(),
+      posted_(),
+      running_posted_(),
+      stopped_(false),
+      stats_()
+{
+    if (preferred == Backend::IO_URING) {
+        uring_ = std::make_unique<IoUringQueue>(URING_QUEUE_ENTRIES);
+
+        if (!uring_->is_valid()) {
+            LOG_W("io_uring is not available, falling back to epoll");
+            uring_.reset();
+        } else if (!uring_->has_ext_arg()) {
+            // 待ち時間を io_uring_enter に渡せないと、タイマ用の投入を別に管理する必要がある
+            LOG_W("io_uring without IORING_FEAT_EXT_ARG (Linux < 5.11), falling back to epoll");
+            uring_.reset();
+        } else {
+            backend_ = Backend::IO_URING;
+        }
+    }
+
+    if (backend_ == Backend::EPOLL) {
+        epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+        if (epoll_fd_ < 0) {
+            LOG_E("epoll_create1 failed: %s", std::strerror(errno));
+
+            return;
+        }
+    }
+
+    wakeup_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd_ < 0) {
+        LOG_E("Failed to create eventfd: %s", std::strerror(errno));
+
+        return;
+    }
+
+    add_reader(wakeup_fd_, [this]() { drain_wakeup(); });
+
+    LOG_I("IoReactor initialized (backend %s)", backend_name(backend_));
+}
+
+IoReactor::~IoReactor()
+{
+    // io_uring の監視はリングを閉じれば全て外れる
+    uring_.reset();
+
+    if (epoll_fd_ >= 0) {
+        close(epoll_fd_);
+    }
+    if (wakeup_fd_ >= 0) {
+        close(wakeup_fd_);
+    }
+}
+
+bool IoReactor::add_reader(int fd, Callback callback)
+{
+    if (fd < 0) {
+        return false;
+    }
+
+    size_t slot = readers_.size();
+    for (size_t i = 0; i < readers_.size(); ++i) {
+        if (readers_[i].fd == fd) {
+            LOG_W("fd %d is already registered", fd);
+
+            return false;
+        }
+        if (readers_[i].fd < 0 && i != dispatching_slot_ && slot == readers_.size()) {
+            slot = i;
+        }
+    }
+
+    if (slot == readers_.size()) {
+        readers_.emplace_back();
+    }
+
+    Reader& reader = readers_[slot];
+    reader.fd = fd;
+    reader.generation += 1;
+    reader.armed = false;
+    reader.callback = std::move(callback);
+
+    if (backend_ == Backend::EPOLL) {
+        struct epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN;
+        event.data.u64 = make_token(slot, reader.generation);
+
+        stats_.syscalls += 1;
+        if (epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) < 0) {
+            LOG_E("epoll_ctl(ADD, %d) failed: %s", fd, std::strerror(errno));
+
+            reader.fd = -1;
+            reader.callback = nullptr;
+
+            return false;
+        }
+    }
+
+    // io_uring は次の run_once() で監視を投入する
+
+    return true;
+}
+
+void IoReactor::remove_reader(int fd)
+{
+    for (size_t slot = 0; slot < readers_.size(); ++slot) {
+        Reader& reader = readers_[slot];
+        if (reader.fd != fd) {
+            continue;
+        }
+
+        if (backend_ == Backend::EPOLL) {
+            stats_.syscalls += 1;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+        } else if (reader.armed) {
+            // fd を閉じた後もリングがファイルを参照し続けないよう、すぐに取り消す
+            struct io_uring_sqe* sqe = uring_->get_sqe();
+            if (sqe == nullptr) {
+                stats_.syscalls += 1;
+                uring_->submit(0);
+                sqe = uring_->get_sqe();
+            }
+            if (sqe != nullptr) {
+                sqe->opcode = IORING_OP_POLL_REMOVE;
+                sqe->fd = -1;
+                sqe->addr = make_token(slot, reader.generation);
+                sqe->user_data = REMOVE_TOKEN;
+
+                stats_.syscalls += 1;
+                uring_->submit(0);
+            }
+        }
+
+        // 遅れて届く通知は世代が合わないので捨てられる
+        reader.fd = -1;
+        reader.generation += 1;
+        reader.armed = false;
+        if (slot != dispatching_slot_) {
+            reader.callback = nullptr;
+        }
+
+        return;
+    }
+}
+
+int IoReactor::add_timer(uint32_t interval_ms, Callback callback)
+{
+    size_t id = timers_.size();
+    for (size_t i = 0; i < timers_.size(); ++i) {
+        if (!timers_[i].active && !timers_[i].callback) {
+            id = i;
+            break;
+        }
+    }
+
+    if (id == timers_.size()) {
+        timers_.emplace_back();
+    }
+
+    Timer& timer = timers_[id];
+    timer.active = true;
+    timer.interval_us = static_cast<uint64_t>((interval_ms > 0) ? interval_ms : 1) * 1000;
+    timer.deadline_us = monotonic_us() + timer.interval_us;
+    timer.callback = std::move(callback);
+
+    return static_cast<int>(id);
+}
+
+void IoReactor::cancel_timer(int timer_id)
+{
+    if (timer_id < 0 || static_cast<size_t>(timer_id) >= timers_.size()) {
+        return;
+    }
+
+    // コールバック実行中かもしれないので、関数の破棄は run_timers() に任せる
+    timers_[timer_id].active = false;
+}
+
+void IoReactor::stop()
+{
+    stopped_.store(true, std::memory_order_relaxed);
+    wakeup();
+}
+
+void IoReactor::post(Callback callback)
+{
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex_);
+        posted_.push_back(std::move(callback));
+    }
+    wakeup();
+}
+
+void IoReactor::wakeup()
+{
+    const uint64_t one = 1;
+    ssize_t ret = write(wakeup_fd_, &one, sizeof(one));
+    (void)ret;
+}
+
+void IoReactor::drain_wakeup()
+{
+    uint64_t count = 0;
+
+    stats_.syscalls += 1;
+    ssize_t ret = read(wakeup_fd_, &count, sizeof(count));
+    (void)ret;
+
+    {
+        std::lock_guard<std::mutex> lock(posted_mutex_);
+        running_posted_.swap(posted_);
+    }
+
+    for (Callback& callback : running_posted_) {
+        callback();
+    }
+    running_posted_.clear();
+}
+
+int64_t IoReactor::time_to_next_timer_us(uint64_t now_us) const
+{
+    int64_t nearest = -1;
+
+    for (const Timer& timer : timers_) {
+        if (!timer.active) {
+            continue;
+        }
+
+        const int64_t remaining = (timer.deadline_us > now_us) ? static_cast<int64_t>(timer.deadline_us - now_us) : 0;
+        if (nearest < 0 || remaining < nearest) {
+            nearest = remaining;
+        }
+    }
+
+    return nearest;
+}
+
+void IoReactor::run_timers()
+{
+    const uint64_t now_us = monotonic_us();
+
+    for (size_t i = 0; i < timers_.size(); ++i) {
+        if (!timers_[i].active) {
+            timers_[i].callback = nullptr;
+            continue;
+        }
+        if (timers_[i].deadline_us > now_us) {
+            continue;
+        }
+
+        // 処理が遅れて何周期も過ぎていたら、まとめて1回だけ呼ぶ
+        timers_[i].deadline_us += timers_[i].interval_us;
+        if (timers_[i].deadline_us <= now_us) {
+            timers_[i].deadline_us = now_us + timers_[i].interval_us;
+        }
+
+        stats_.timer_fires += 1;
+        timers_[i].callback();
+    }
+}
+
+void IoReactor::dispatch(uint64_t token)
+{
+    const size_t slot = static_cast<size_t>(token & 0xFFFFFFFFu);
+    const uint32_t generation = static_cast<uint32_t>(token >> 32);
+
+    if (slot >= readers_.size() || readers_[slot].fd < 0 || readers_[slot].generation != generation) {
+        return;
+    }
+
+    readers_[slot].armed = false;
+
+    stats_.dispatched += 1;
+    dispatching_slot_ = slot;
+    readers_[slot].callback();
+    dispatching_slot_ = NO_SLOT;
+
+    // コールバック内で外された
+    if (readers_[slot].fd < 0) {
+        readers_[slot].callback = nullptr;
+    }
+}
+
+void IoReactor::run_once(int timeout_ms)
+{
+    if (!is_valid()) {
+        return;
+    }
+
+    int64_t timeout_us = (timeout_ms < 0) ? -1 : static_cast<int64_t>(timeout_ms) * 1000;
+    const int64_t timer_us = time_to_next_timer_us(monotonic_us());
+    if (timer_us >= 0 && (timeout_us < 0 || timer_us < timeout_us)) {
+        timeout_us = timer_us;
+    }
+
+    if (stopped_.load(std::memory_order_relaxed)) {
+        timeout_us = 0;
+    }
+
+    stats_.waits += 1;
+
+    if (backend_ == Backend::IO_URING) {
+        wait_io_uring(timeout_us);
+    } else {
+        wait_epoll(timeout_us);
+    }
+
+    run_timers();
+}
+
+void IoReactor::run()
+{
+    while (!stopped_.load(std::memory_order_relaxed)) {
+        run_once(-1);
+    }
+}
+
+void IoReactor::wait_io_uring(int64_t timeout_us)
+{
+    // 前回の通知で外れた監視を、待機と同じ io_uring_enter で投入し直す
+    for (size_t slot = 0; slot < readers_.size(); ++slot) {
+        Reader& reader = readers_[slot];
+        if (reader.fd < 0 || reader.armed) {
+            continue;
+        }
+
+        struct io_uring_sqe* sqe = uring_->get_sqe();
+        if (sqe == nullptr) {
+            stats_.syscalls += 1;
+            uring_->submit(0);
+            sqe = uring_->get_sqe();
+            if (sqe == nullptr) {
+                break;
+            }
+        }
+
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = reader.fd;
+        sqe->poll32_events = POLLIN;
+        sqe->user_data = make_token(slot, reader.generation);
+        reader.armed = true;
+    }
+
+    // 完了が溜まっていれば待たない
+    const int64_t timeout_ns = (uring_->peek_cqe() != nullptr) ? 0 : (timeout_us < 0) ? -1 : timeout_us * 1000;
+
+    stats_.syscalls += 1;
+    const int ret = uring_->submit(1, timeout_ns);
+    if (ret < 0 && ret != -ETIME && ret != -EINTR && ret != -EBUSY) {
+        LOG_W("io_uring_enter failed: %s", std::strerror(-ret));
+    }
+
+    struct io_uring_cqe* cqe;
+    while ((cqe = uring_->peek_cqe()) != nullptr) {
+        const uint64_t token = cqe->user_data;
+        const int res = cqe->res;
+        uring_->cqe_seen();
+
+        if (token == REMOVE_TOKEN) {
+            continue;
+        }
+
+        if (res < 0) {
+            const size_t slot = static_cast<size_t>(token & 0xFFFFFFFFu);
+            if (slot < readers_.size() && readers_[slot].generation == static_cast<uint32_t>(token >> 32)
+                && readers_[slot].fd >= 0) {
+                // 監視自体が失敗した (fd が閉じられた等)。繰り返さないよう登録を外す
+                LOG_W("io_uring poll on fd %d failed: %s", readers_[slot].fd, std::strerror(-res));
+                remove_reader(readers_[slot].fd);
+            }
+            continue;
+        }
+
+        dispatch(token);
+    }
+}
+
+void IoReactor::wait_epoll(int64_t timeout_us)
+{
+    // epoll_wait はミリ秒単位なので、タイマより早く起きないよう切り上げる
+    const int timeout_ms = (timeout_us < 0) ? -1 : static_cast<int>((timeout_us + 999) / 1000);
+
+    struct epoll_event events[EPOLL_MAX_EVENTS];
+
+    stats_.syscalls += 1;
+    const int count = epoll_wait(epoll_fd_, events, EPOLL_MAX_EVENTS, timeout_ms);
+    if (count < 0) {
+        if (errno != EINTR) {
+            LOG_W("epoll_wait failed: %s", std::strerror(errno));
+        }
+        return;
+    }
+
+    for (int i = 0; i < count; ++i) {
+        dispatch(events[i].data.u64);
+    }
+}
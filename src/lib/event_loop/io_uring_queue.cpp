@@ -0,0 +1,345 @@
+/**
+ * @file    io_uring_queue.cpp
+ * @brief   io_uring の投入キュー・完了キューの薄いラッパの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+
+#include "event_loop/io_uring_queue.hpp"
+#include "logger/logger.hpp"
+
+#define MAX_QUEUE_ENTRIES 4096  /**< 投入キューの最大の大きさ */
+
+static int io_uring_setup(unsigned entries, struct io_uring_params* params)
+{
+    return static_cast<int>(syscall(__NR_io_uring_setup, entries, params));
+}
+
+static int io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags,
+                          const void* arg, size_t arg_size)
+{
+    return static_cast<int>(syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+IoUringQueue::IoUringQueue(unsigned entries)
+    : ring_fd_(-1),
+      features_(0),
+      sq_ring_(MAP_FAILED),
+      sq_ring_size_(0),
+      cq_ring_(MAP_FAILED),
+      cq_ring_size_(0),
+      sqes_(static_cast<struct io_uring_sqe*>(MAP_FAILED)),
+      sqes_size_(0),
+      sq_head_(nullptr),
+      sq_tail_(nullptr),
+      sq_mask_(nullptr),
+      sq_array_(nullptr),
+      sq_entries_(0),
+      sq_local_tail_(0),
+      cq_head_(nullptr),
+      cq_tail_(nullptr),
+      cq_mask_(nullptr),
+      cqes_(nullptr),
+      enter_count_(0)
+{
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+
+    const int fd = io_uring_setup(std::clamp<unsigned>(entries, 1, MAX_QUEUE_ENTRIES), &params);
+    if (fd < 0) {
+        // seccomp やコンテナ、kernel.io_uring_disabled で拒否されることがある
+        LOG_W("io_uring_setup failed: %s", std::strerror(errno));
+
+        return;
+    }
+
+    ring_fd_ = fd;
+    features_ = params.features;
+
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+    const bool single_mmap = (features_ & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ = mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    ring_fd_, IORING_OFF_SQ_RING);
+    if (sq_ring_ == MAP_FAILED) {
+        LOG_E("io_uring SQ ring mmap failed: %s", std::strerror(errno));
+        close_ring();
+
+        return;
+    }
+
+    if (single_mmap) {
+        cq_ring_ = sq_ring_;
+    } else {
+        cq_ring_ = mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        ring_fd_, IORING_OFF_CQ_RING);
+        if (cq_ring_ == MAP_FAILED) {
+            LOG_E("io_uring CQ ring mmap failed: %s", std::strerror(errno));
+            close_ring();
+
+            return;
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    sqes_ = static_cast<struct io_uring_sqe*>(mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE,
+                                                   MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES));
+    if (sqes_ == MAP_FAILED) {
+        LOG_E("io_uring SQE mmap failed: %s", std::strerror(errno));
+        close_ring();
+
+        return;
+    }
+
+    uint8_t* sq = static_cast<uint8_t*>(sq_ring_);
+    sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask_ = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    sq_entries_ = params.sq_entries;
+    sq_local_tail_ = *sq_tail_;
+
+    uint8_t* cq = static_cast<uint8_t*>(cq_ring_);
+    cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask_ = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoUringQueue::~IoUringQueue()
+{
+    close_ring();
+}
+
+void IoUringQueue::close_ring()
+{
+    if (sqes_ != MAP_FAILED) {
+        munmap(sqes_, sqes_size_);
+        sqes_ = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+    }
+    if (cq_ring_ != MAP_FAILED && cq_ring_ != sq_ring_) {
+        munmap(cq_ring_, cq_ring_size_);
+    }
+    cq_ring_ = MAP_FAILED;
+    if (sq_ring_ != MAP_FAILED) {
+        munmap(sq_ring_, sq_ring_size_);
+        sq_ring_ = MAP_FAILED;
+    }
+    if (ring_fd_ >= 0) {
+        close(ring_fd_);
+        ring_fd_ = -1;
+    }
+}
+
+struct io_uring_sqe* IoUringQueue::get_sqe()
+{
+    if (ring_fd_ < 0) {
+        return nullptr;
+    }
+
+    // カーネルが読み終えた位置 (head) から sq_entries_ 個までしか埋められない
+    const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    if (sq_local_tail_ - head >= sq_entries_) {
+        return nullptr;
+    }
+
+    const unsigned index = sq_local_tail_ & *sq_mask_;
+    sq_array_[index] = index;
+    sq_local_tail_ += 1;
+
+    struct io_uring_sqe* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+
+    return sqe;
+}
+
+int IoUringQueue::submit(unsigned wait_nr, int64_t timeout_ns)
+{
+    if (ring_fd_ < 0) {
+        return -EBADF;
+    }
+
+    const unsigned to_submit = sq_local_tail_ - *sq_tail_;
+
+    // 埋めた投入エントリをカーネルへ公開する
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    if (to_submit == 0 && wait_nr == 0) {
+        return 0;
+    }
+
+    unsigned flags = (wait_nr > 0) ? IORING_ENTER_GETEVENTS : 0;
+    const void* arg = nullptr;
+    size_t arg_size = 0;
+
+#ifdef IORING_FEAT_EXT_ARG
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg getevents_arg;
+
+    if (wait_nr > 0 && timeout_ns >= 0 && has_ext_arg()) {
+        ts.tv_sec = timeout_ns / 1000000000;
+        ts.tv_nsec = timeout_ns % 1000000000;
+
+        std::memset(&getevents_arg, 0, sizeof(getevents_arg));
+        getevents_arg.ts = reinterpret_cast<uint64_t>(&ts);
+
+        flags |= IORING_ENTER_EXT_ARG;
+        arg = &getevents_arg;
+        arg_size = sizeof(getevents_arg);
+    }
+#else
+    (void)timeout_ns;
+#endif
+
+    const int ret = io_uring_enter(ring_fd_, to_submit, wait_nr, flags, arg, arg_size);
+    enter_count_ += 1;
+
+    return (ret < 0) ? -errno : ret;
+}
+
+struct io_uring_cqe* IoUringQueue::peek_cqe()
+{
+    if (ring_fd_ < 0) {
+        return nullptr;
+    }
+
+    const unsigned head = *cq_head_;
+    if (head == __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE)) {
+        return nullptr;
+    }
+
+    return &cqes_[head & *cq_mask_];
+}
+
+void IoUringQueue::cqe_seen()
+{
+    __atomic_store_n(cq_head_, *cq_head_ + 1, __ATOMIC_RELEASE);
+}
+
+int IoUringQueue::send_messages(int fd, struct mmsghdr* msgs, unsigned count, int flags)
+{
+    count = std::min(count, sq_entries_);
+    if (count == 0) {
+        return 0;
+    }
+
+    struct io_uring_sqe* last = nullptr;
+
+    for (unsigned i = 0; i < count; ++i) {
+        struct io_uring_sqe* sqe = get_sqe();
+        if (sqe == nullptr) {
+            // 前の呼び出しの投入が残っていた。ここまでの分で送る
+            if (last != nullptr) {
+                last->flags = 0;
+            }
+            count = i;
+            break;
+        }
+        last = sqe;
+
+        sqe->opcode = IORING_OP_SENDMSG;
+        sqe->fd = fd;
+        sqe->addr = reinterpret_cast<uint64_t>(&msgs[i].msg_hdr);
+        sqe->len = 1;
+        sqe->msg_flags = static_cast<uint32_t>(flags);
+        sqe->user_data = i;
+        sqe->flags = (i + 1 < count) ? IOSQE_IO_LINK : 0;
+    }
+
+    if (count == 0) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    // 繋いだ投入は先頭から順に実行され、失敗した所から後ろは -ECANCELED で完了する
+    unsigned completed = 0;
+    unsigned sent = count;
+    int error = 0;
+
+    while (completed < count) {
+        const int ret = submit(count - completed);
+        if (ret < 0 && ret != -EINTR) {
+            LOG_E("io_uring_enter failed: %s", std::strerror(-ret));
+
+            // 残った完了が次の呼び出しの完了と混ざらないよう、この一括分を片付けてから戻る
+            discard_batch(count, completed);
+            errno = -ret;
+
+            return -1;
+        }
+
+        struct io_uring_cqe* cqe;
+        while ((cqe = peek_cqe()) != nullptr) {
+            const unsigned index = static_cast<unsigned>(cqe->user_data);
+            const int res = cqe->res;
+            cqe_seen();
+
+            if (index >= count) {
+                continue;
+            }
+            completed += 1;
+
+            if (res >= 0) {
+                msgs[index].msg_len = static_cast<unsigned>(res);
+            } else if (index < sent) {
+                sent = index;
+                error = -res;
+            }
+        }
+    }
+
+    if (sent == 0) {
+        errno = error;
+        return -1;
+    }
+
+    return static_cast<int>(sent);
+}
+
+void IoUringQueue::discard_batch(unsigned count, unsigned completed)
+{
+    // 一括分は投入キューの末尾にある。まだカーネルが読んでいない分は末尾を戻して取り消す
+    // (SQPOLL を使わないので、io_uring_enter の外でカーネルが読み進めることはない)
+    const unsigned head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    const unsigned unsubmitted = std::min(sq_local_tail_ - head, count);
+
+    sq_local_tail_ -= unsubmitted;
+    __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+
+    // 投入済みの分はカーネルが msgs を参照しているので、完了を待って捨てる
+    unsigned outstanding = count - unsubmitted - std::min(completed, count - unsubmitted);
+
+    while (outstanding > 0) {
+        struct io_uring_cqe* cqe;
+        while (outstanding > 0 && (cqe = peek_cqe()) != nullptr) {
+            if (cqe->user_data < count) {
+                outstanding -= 1;
+            }
+            cqe_seen();
+        }
+
+        if (outstanding == 0) {
+            break;
+        }
+
+        const int ret = submit(outstanding);
+        if (ret < 0 && ret != -EINTR) {
+            LOG_E("Failed to reap io_uring completions: %s", std::strerror(-ret));
+            break;
+        }
+    }
+}
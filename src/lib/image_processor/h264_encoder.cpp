@@ -0,0 +1,185 @@
+/**
+ * @file    h264_encoder.cpp
+ * @brief   libavcodecによる低遅延H.264エンコーダの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#if defined(ENABLE_H264)
+
+#include "image_processor/video_encoder.hpp"
+#include "logger/logger.hpp"
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+#include <libswscale/swscale.h>
+}
+
+H264Encoder::H264Encoder(uint32_t bitrate_kbps, uint32_t gop, uint32_t fps) :
+    bitrate_kbps_(bitrate_kbps),
+    gop_(gop),
+    fps_(fps == 0 ? 30 : fps)
+{
+}
+
+H264Encoder::~H264Encoder()
+{
+    close_codec();
+}
+
+bool H264Encoder::open_codec(int width, int height)
+{
+    close_codec();
+
+    // libx264を優先し、無ければ標準のH.264エンコーダを使う
+    const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+    if (!codec) {
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    }
+    if (!codec) {
+        LOG_E("[H264Encoder] H.264 encoder not found");
+
+        return false;
+    }
+
+    codec_ctx_ = avcodec_alloc_context3(codec);
+    if (!codec_ctx_) {
+        return false;
+    }
+
+    codec_ctx_->width = width;
+    codec_ctx_->height = height;
+    codec_ctx_->pix_fmt = AV_PIX_FMT_YUV420P;
+    codec_ctx_->time_base = AVRational{1, static_cast<int>(fps_)};
+    codec_ctx_->framerate = AVRational{static_cast<int>(fps_), 1};
+    codec_ctx_->gop_size = static_cast<int>(gop_);
+    codec_ctx_->max_b_frames = 0;   // Bフレームは遅延の原因になるため使用しない
+    codec_ctx_->bit_rate = static_cast<int64_t>(bitrate_kbps_) * 1000;
+    codec_ctx_->rc_max_rate = codec_ctx_->bit_rate;
+    codec_ctx_->rc_buffer_size = static_cast<int>(codec_ctx_->bit_rate / fps_ * 2);
+    codec_ctx_->thread_count = 1;   // フレーム並列は遅延が増えるため1スレッド
+
+    // 低遅延設定 (libx264以外では無視される)
+    av_opt_set(codec_ctx_->priv_data, "preset", "ultrafast", 0);
+    av_opt_set(codec_ctx_->priv_data, "tune", "zerolatency", 0);
+
+    if (avcodec_open2(codec_ctx_, codec, nullptr) < 0) {
+        LOG_E("[H264Encoder] avcodec_open2 failed");
+
+        close_codec();
+
+        return false;
+    }
+
+    frame_ = av_frame_alloc();
+    packet_ = av_packet_alloc();
+    if (!frame_ || !packet_) {
+        close_codec();
+
+        return false;
+    }
+
+    frame_->format = codec_ctx_->pix_fmt;
+    frame_->width = width;
+    frame_->height = height;
+
+    if (av_frame_get_buffer(frame_, 0) < 0) {
+        close_codec();
+
+        return false;
+    }
+
+    sws_ctx_ = sws_getContext(width, height, AV_PIX_FMT_BGR24,
+                              width, height, AV_PIX_FMT_YUV420P,
+                              SWS_FAST_BILINEAR, nullptr, nullptr, nullptr);
+    if (!sws_ctx_) {
+        close_codec();
+
+        return false;
+    }
+
+    next_pts_ = 0;
+
+    LOG_I("[H264Encoder] %s opened (%dx%d)", codec->name, width, height);
+
+    return true;
+}
+
+void H264Encoder::close_codec()
+{
+    if (sws_ctx_) {
+        sws_freeContext(sws_ctx_);
+        sws_ctx_ = nullptr;
+    }
+
+    av_packet_free(&packet_);
+    av_frame_free(&frame_);
+    avcodec_free_context(&codec_ctx_);
+}
+
+bool H264Encoder::encode(const cv::Mat& bgr, std::vector<uint8_t>& out, bool& is_keyframe)
+{
+    if (bgr.empty()) return false;
+
+    if (!codec_ctx_ || codec_ctx_->width != bgr.cols || codec_ctx_->height != bgr.rows) {
+        if (!open_codec(bgr.cols, bgr.rows)) {
+            return false;
+        }
+    }
+
+    if (av_frame_make_writable(frame_) < 0) {
+        return false;
+    }
+
+    // BGR -> YUV420P
+    const uint8_t* src_planes[1] = { bgr.data };
+    const int src_strides[1] = { static_cast<int>(bgr.step) };
+
+    sws_scale(sws_ctx_, src_planes, src_strides, 0, bgr.rows,
+              frame_->data, frame_->linesize);
+
+    frame_->pts = next_pts_++;
+
+    if (force_keyframe_) {
+        frame_->pict_type = AV_PICTURE_TYPE_I;
+        force_keyframe_ = false;
+    } else {
+        frame_->pict_type = AV_PICTURE_TYPE_NONE;
+    }
+
+    if (avcodec_send_frame(codec_ctx_, frame_) < 0) {
+        LOG_E("[H264Encoder] avcodec_send_frame failed");
+
+        return false;
+    }
+
+    out.clear();
+    is_keyframe = false;
+
+    // zerolatencyでは1フレーム入力につき1パケット出力される
+    while (true) {
+        int ret = avcodec_receive_packet(codec_ctx_, packet_);
+        if (ret == AVERROR(EAGAIN) || ret == AVERROR_EOF) {
+            break;
+        }
+        if (ret < 0) {
+            LOG_E("[H264Encoder] avcodec_receive_packet failed");
+
+            return false;
+        }
+
+        out.insert(out.end(), packet_->data, packet_->data + packet_->size);
+
+        if (packet_->flags & AV_PKT_FLAG_KEY) {
+            is_keyframe = true;
+        }
+
+        av_packet_unref(packet_);
+    }
+
+    return !out.empty();
+}
+
+#endif // ENABLE_H264
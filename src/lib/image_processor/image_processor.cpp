@@ -1,11 +1,12 @@
 /**
  * @file    image_processor.cpp
- * @brief   画像処理クラスの実装（YUYV変換, YOLO推論, TurboJPEG圧縮）
+ * @brief   画像処理クラスの実装（YUYV変換, YOLO推論, GUI用圧縮）
  * @author  sawada souta
  * @date    2025-12-18
  */
 
 #include "image_processor/image_processor.hpp"
+#include "image_processor/yuyv_convert.hpp"
 #include "logger/logger.hpp"
 
 #include <iostream>
@@ -13,15 +14,22 @@
 #include <algorithm>
 #include <ctime>
 #include <cstdio>
-#include <turbojpeg.h>
 #include <opencv2/imgproc.hpp>
 #include <opencv2/opencv.hpp>
 
 // コンストラクタ
 ImageProcessor::ImageProcessor(const std::string& model_path, int jpeg_quality, uint32_t resize_width) :
-    jpeg_quality_(jpeg_quality),
-    resize_width_(resize_width)
+    resize_width_(resize_width),
+    output_scale_(1.0),
+    draw_overlay_(true),
+    encoder_(std::make_unique<JpegEncoder>(jpeg_quality)),
+    tj_decompress_(tjInitDecompress()),
+    tracker_(TRACK_IOU_THRESHOLD, TRACK_MAX_MISSED)
 {
+    if (tj_decompress_ == nullptr) {
+        LOG_W("[ImageProcessor] TurboJPEG decompressor unavailable: MJPEG input disabled");
+    }
+
     try {
         LOG_I("[ImageProcessor] Loading AI Model from: ");
         
@@ -37,14 +45,41 @@ ImageProcessor::ImageProcessor(const std::string& model_path, int jpeg_quality,
 
         exit(-1);
     }
-
-    tj_instance_ = tjInitCompress();
 }
 
 // デストラクタ
 ImageProcessor::~ImageProcessor()
 {
-    tjDestroy(tj_instance_);
+    if (tj_decompress_ != nullptr) {
+        tjDestroy(tj_decompress_);
+    }
+}
+
+void ImageProcessor::set_encoder(std::unique_ptr<VideoEncoder> encoder)
+{
+    if (encoder) {
+        encoder_ = std::move(encoder);
+    }
+}
+
+void ImageProcessor::set_jpeg_quality(int quality)
+{
+    encoder_->set_quality(quality);
+}
+
+void ImageProcessor::request_keyframe(void)
+{
+    encoder_->request_keyframe();
+}
+
+void ImageProcessor::set_draw_overlay(bool enabled)
+{
+    draw_overlay_ = enabled;
+}
+
+void ImageProcessor::set_output_scale(double scale)
+{
+    output_scale_ = std::clamp(scale, 0.1, 1.0);
 }
 
 bool ImageProcessor::process_frame(const uint8_t* yuyv,
@@ -58,19 +93,33 @@ bool ImageProcessor::process_frame(const uint8_t* yuyv,
         return false;
     }
 
+    /* ---------- 0. GUI出力サイズの決定 ---------- */
+    // resize_width (0 または入力幅以上なら等倍) にレート制御の縮小率を掛けたものを目標幅とする
+    const double base_width = (resize_width_ > 0 && resize_width_ < width) ? resize_width_ : width;
+    const double target_width = std::max(2.0, base_width * output_scale_);
+    const double target_scale = target_width / width;
+
+    // 2のべき乗で割り切れる分はYUYV変換と融合して縮小し、残りはcv::resizeで縮小する
+    const uint32_t fused_factor = yuyv_downscale_factor(width, height, width / target_width);
+
+    // AI推論・抵抗値推定は常に全解像度で行う。GUIを縮小する場合、非推論フレームでは全解像度変換を省く
+    const bool need_full_bgr = is_run_ai || fused_factor == 1;
+
     /* ---------- 1. YUYV -> BGR 変換 (OpenCV) ---------- */
-    // YUYVデータ(2ch)としてMatを作成（コピーなし）
-    cv::Mat src_mat(height, width, CV_8UC2, (void*)yuyv);
-    
     size_t bgr_size = width * height * 3;
     if (ai_data.image.size() != bgr_size) {
         ai_data.image.resize(bgr_size);
     }
     // ai_data.imageのメモリ領域を直接使うMatを作成
     cv::Mat dst_mat(height, width, CV_8UC3, ai_data.image.data());
-    
-    // 色空間変換 (NEON最適化が効く)
-    cv::cvtColor(src_mat, dst_mat, cv::COLOR_YUV2BGR_YUYV);
+
+    if (need_full_bgr) {
+        // YUYVデータ(2ch)としてMatを作成（コピーなし）
+        cv::Mat src_mat(height, width, CV_8UC2, (void*)yuyv);
+
+        // 色空間変換 (NEON最適化が効く)
+        cv::cvtColor(src_mat, dst_mat, cv::COLOR_YUV2BGR_YUYV);
+    }
 
     // AIデータヘッダ情報更新
     ai_data.width = width;
@@ -78,28 +127,154 @@ bool ImageProcessor::process_frame(const uint8_t* yuyv,
     ai_data.channels = 3;
 
     if (is_run_ai) {
-	    /* ---------- 2. 抵抗検出 (YOLO) ---------- */
-	    detect_resistors(dst_mat, ai_data.resistors);
-	
-	    /* ---------- 3. 抵抗値推定 & 結果格納 ---------- */
-	    for (auto& resistor : ai_data.resistors) {
-	        resistor.resistance_value = estimate_resistance_value(dst_mat, resistor.box);
-	    }
+        /* ---------- 2-3. 抵抗検出 (YOLO)・抵抗値推定・追跡 ---------- */
+        analyze(dst_mat, ai_data.resistors);
     }
 
-    /* ---------- 4. GUI用に結果を描画 ---------- */
-    // 受信側で確認しやすいよう、画像自体に枠線や数値を書き込む
-    draw_results(dst_mat, ai_data.resistors);
+    /* ---------- 4. GUI用画像の生成 ---------- */
+    cv::Mat* gui_mat = &dst_mat;
 
-    /* ---------- 5. JPEG圧縮 (TurboJPEG) ---------- */
-    // 描画済みの画像を圧縮してGUIデータとする
-    if (!bgr_to_jpeg(dst_mat, jpeg_quality_, gui_data.image)) {
+    if (fused_factor >= 2) {
+        // YUYV -> BGR + 面積平均縮小 (SIMD) を1パスで行う
+        gui_fused_.create(height / fused_factor, width / fused_factor, CV_8UC3);
+        yuyv_to_bgr_downscale(yuyv, width, height, fused_factor, gui_fused_.data, gui_fused_.step);
+        gui_mat = &gui_fused_;
+    }
+
+    return encode_gui(gui_mat, width, height, target_scale, ai_data.resistors, gui_data);
+}
+
+bool ImageProcessor::process_mjpeg_frame(const uint8_t* jpeg,
+                                         size_t size,
+                                         uint32_t width,
+                                         uint32_t height,
+                                         GuiProcessedData& gui_data,
+                                         AiProcessedData& ai_data,
+                                         bool is_run_ai)
+{
+    if (!jpeg || size == 0 || width == 0 || height == 0 || tj_decompress_ == nullptr) {
         return false;
     }
-    
+
+    const double base_width = (resize_width_ > 0 && resize_width_ < width) ? resize_width_ : width;
+    const double target_width = std::max(2.0, base_width * output_scale_);
+    const double target_scale = target_width / width;
+
+    // 描画も縮小もせずJPEGで送るなら、カメラのJPEGをそのまま使える
+    const bool passthrough = !draw_overlay_
+                          && encoder_->codec() == VideoEncoder::Codec::JPEG
+                          && target_width >= width;
+
+    ai_data.width = width;
+    ai_data.height = height;
+    ai_data.channels = 3;
+
+    if (is_run_ai || !passthrough) {
+        int jpeg_width = 0;
+        int jpeg_height = 0;
+        int subsampling = 0;
+        int colorspace = 0;
+
+        if (tjDecompressHeader3(tj_decompress_, jpeg, static_cast<unsigned long>(size),
+                                &jpeg_width, &jpeg_height, &subsampling, &colorspace) != 0
+            || static_cast<uint32_t>(jpeg_width) != width || static_cast<uint32_t>(jpeg_height) != height) {
+            LOG_W("Invalid MJPEG frame (%zu bytes)", size);
+            return false;
+        }
+
+        ai_data.image.resize(static_cast<size_t>(width) * height * 3);
+        if (tjDecompress2(tj_decompress_, jpeg, static_cast<unsigned long>(size), ai_data.image.data(),
+                          width, 0, height, TJPF_BGR, TJFLAG_FASTDCT) != 0) {
+            LOG_W("MJPEG decode failed: %s", tjGetErrorStr2(tj_decompress_));
+            return false;
+        }
+
+        cv::Mat dst_mat(height, width, CV_8UC3, ai_data.image.data());
+
+        if (is_run_ai) {
+            analyze(dst_mat, ai_data.resistors);
+        }
+
+        if (!passthrough) {
+            return encode_gui(&dst_mat, width, height, target_scale, ai_data.resistors, gui_data);
+        }
+    }
+
+    gui_data.image.assign(jpeg, jpeg + size);
     gui_data.width = width;
     gui_data.height = height;
     gui_data.is_jpeg = true;
+    gui_data.is_h264 = false;
+    gui_data.is_keyframe = true;
+
+    return true;
+}
+
+void ImageProcessor::analyze(const cv::Mat& image, std::vector<ResistorInfo>& resistors)
+{
+    /* ---------- 2. 抵抗検出 (YOLO) ---------- */
+    detect_resistors(image, resistors);
+
+    /* ---------- 3. 抵抗値推定 & 結果格納 ---------- */
+    for (auto& resistor : resistors) {
+        resistor.resistance_value = estimate_resistance_value(image, resistor.box);
+    }
+
+    // 受信側で同じ抵抗を見分けられるよう、前回の推論結果と対応付けてIDを振る
+    track_boxes_.clear();
+    for (const auto& resistor : resistors) {
+        track_boxes_.push_back(resistor.box);
+    }
+    tracker_.update(track_boxes_, track_ids_);
+
+    for (size_t i = 0; i < resistors.size(); ++i) {
+        resistors[i].track_id = track_ids_[i];
+    }
+}
+
+bool ImageProcessor::encode_gui(cv::Mat* gui_mat,
+                                uint32_t width,
+                                uint32_t height,
+                                double target_scale,
+                                const std::vector<ResistorInfo>& resistors,
+                                GuiProcessedData& gui_data)
+{
+    // H.264 (4:2:0) でも扱えるよう偶数サイズにそろえる
+    const int out_w = std::max(2, static_cast<int>(width * target_scale) & ~1);
+    const int out_h = std::max(2, static_cast<int>(height * target_scale) & ~1);
+
+    if (gui_mat->cols != out_w || gui_mat->rows != out_h) {
+        cv::resize(*gui_mat, scaled_, cv::Size(out_w, out_h), 0, 0, cv::INTER_AREA);
+        gui_mat = &scaled_;
+    }
+
+    /* ---------- 5. GUI用に結果を描画 ---------- */
+    // 受信側で確認しやすいよう、画像自体に枠線や数値を書き込む（座標はGUI解像度へ換算）
+    const double gui_scale = static_cast<double>(gui_mat->cols) / width;
+    if (draw_overlay_) {
+        draw_results(*gui_mat, resistors, gui_scale);
+    }
+
+    // 抵抗の領域は高画質で送る（領域別画質に対応したエンコーダのみ有効）
+    gui_rois_.clear();
+    for (const auto& r : resistors) {
+        gui_rois_.emplace_back(static_cast<int>(r.box.x * gui_scale),
+                               static_cast<int>(r.box.y * gui_scale),
+                               static_cast<int>(r.box.width * gui_scale),
+                               static_cast<int>(r.box.height * gui_scale));
+    }
+    encoder_->set_regions_of_interest(gui_rois_);
+
+    /* ---------- 6. 圧縮 (TurboJPEG / H.264) ---------- */
+    // 描画済みの画像を圧縮してGUIデータとする
+    if (!encoder_->encode(*gui_mat, gui_data.image, gui_data.is_keyframe)) {
+        return false;
+    }
+    
+    gui_data.width = gui_mat->cols;
+    gui_data.height = gui_mat->rows;
+    gui_data.is_jpeg = (encoder_->codec() == VideoEncoder::Codec::JPEG);
+    gui_data.is_h264 = (encoder_->codec() == VideoEncoder::Codec::H264);
 
     return true;
 }
@@ -112,12 +287,6 @@ void ImageProcessor::detect_resistors(const cv::Mat& input_image, std::vector<Re
     // モデルがロードできていなければ何もしない
     if (net_.empty()) return;
 
-    // 前処理: 画像をYOLOの入力サイズにリサイズし、正規化(1/255)する
-
-    if (blob_.empty()) {
-        blob_.create(1, 3 * INPUT_SIZE * INPUT_SIZE, CV_32F);
-    }
-
     if (input_image.empty()) {
         LOG_E("input image is empty");
 
@@ -127,15 +296,46 @@ void ImageProcessor::detect_resistors(const cv::Mat& input_image, std::vector<Re
     LOG_I("DNN input : %dx%d ch = %d", input_image.cols, input_image.rows, \
                                         input_image.channels());
 
-    cv::dnn::blobFromImage(input_image, blob_, 1.0/255.0, cv::Size(INPUT_SIZE, INPUT_SIZE), cv::Scalar(), true, false);
-    net_.setInput(blob_);
+    // 前処理: 画像をYOLOの入力サイズにリサイズし、正規化(1/255)する
+    prepare_input(input_image);
 
     // 推論実行
     std::vector<cv::Mat> outputs;
-    net_.forward(outputs, net_.getUnconnectedOutLayersNames());
+    if (!run_inference(outputs) || outputs.empty()) {
+        return;
+    }
 
     // 後処理
-    const cv::Mat& out = outputs[0];
+    decode_detections(outputs[0], input_image.cols, input_image.rows, out_resistors);
+}
+
+void ImageProcessor::prepare_input(const cv::Mat& image)
+{
+    if (blob_.empty()) {
+        blob_.create(1, 3 * INPUT_SIZE * INPUT_SIZE, CV_32F);
+    }
+
+    cv::dnn::blobFromImage(image, blob_, 1.0/255.0, cv::Size(INPUT_SIZE, INPUT_SIZE), cv::Scalar(), true, false);
+}
+
+bool ImageProcessor::run_inference(std::vector<cv::Mat>& outputs)
+{
+    if (net_.empty()) {
+        return false;
+    }
+
+    net_.setInput(blob_);
+    net_.forward(outputs, net_.getUnconnectedOutLayersNames());
+
+    return true;
+}
+
+void ImageProcessor::decode_detections(const cv::Mat& out,
+                                       int image_width,
+                                       int image_height,
+                                       std::vector<ResistorInfo>& out_resistors) const
+{
+    out_resistors.clear();
 
     const int rows = out.size[2];
     const int dims = out.size[1];
@@ -155,8 +355,8 @@ void ImageProcessor::detect_resistors(const cv::Mat& input_image, std::vector<Re
     boxes.reserve(128);
     confidences.reserve(128);
 
-    const float x_factor = static_cast<float>(input_image.cols) / INPUT_SIZE;
-    const float y_factor = static_cast<float>(input_image.rows) / INPUT_SIZE;
+    const float x_factor = static_cast<float>(image_width) / INPUT_SIZE;
+    const float y_factor = static_cast<float>(image_height) / INPUT_SIZE;
 
     for (int i = 0; i < rows; ++i) {
         float confidence = data[rows * 4 + i];
@@ -195,6 +395,7 @@ void ImageProcessor::detect_resistors(const cv::Mat& input_image, std::vector<Re
         info.box = boxes[idx];
         info.confidence = confidences[idx];
         info.resistance_value = -1.0;
+        info.track_id = 0;
         out_resistors.push_back(info);
     }
 }
@@ -229,14 +430,20 @@ double ImageProcessor::estimate_resistance_value(const cv::Mat& full_image, cons
     return 1000.0; 
 }
 
-void ImageProcessor::draw_results(cv::Mat& image, const std::vector<ResistorInfo>& resistors)
+void ImageProcessor::draw_results(cv::Mat& image, const std::vector<ResistorInfo>& resistors, double scale)
 {
     const cv::Scalar COLOR_GREEN(0, 255, 0); // BGR
     const cv::Scalar COLOR_BLACK(0, 0, 0);
 
     for (const auto& r : resistors) {
+        // 検出座標(全解像度)を描画先の解像度へ換算
+        const cv::Rect box(static_cast<int>(r.box.x * scale),
+                           static_cast<int>(r.box.y * scale),
+                           static_cast<int>(r.box.width * scale),
+                           static_cast<int>(r.box.height * scale));
+
         // バウンディングボックス描画
-        cv::rectangle(image, r.box, COLOR_GREEN, 2);
+        cv::rectangle(image, box, COLOR_GREEN, 2);
 
         // ラベルテキストの作成
         std::string label = "Resistor";
@@ -250,61 +457,17 @@ void ImageProcessor::draw_results(cv::Mat& image, const std::vector<ResistorInfo
         cv::Size labelSize = cv::getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &baseLine);
         
         cv::Rect labelBackground(
-            cv::Point(r.box.x, r.box.y - labelSize.height),
+            cv::Point(box.x, box.y - labelSize.height),
             cv::Size(labelSize.width, labelSize.height + baseLine)
         );
         cv::rectangle(image, labelBackground, COLOR_GREEN, cv::FILLED);
 
         // テキスト描画
-        cv::putText(image, label, cv::Point(r.box.x, r.box.y),
+        cv::putText(image, label, cv::Point(box.x, box.y),
                     cv::FONT_HERSHEY_SIMPLEX, 0.5, COLOR_BLACK, 1);
     }
 }
 
-bool ImageProcessor::bgr_to_jpeg(const cv::Mat& bgr_mat, int quality, std::vector<uint8_t>& jpeg)
-{
-    if (bgr_mat.empty()) return false;
-
-    // TurboJPEG インスタンス初期化
-
-    unsigned char* outbuf = nullptr; // TurboJPEGが内部で確保するバッファ
-    unsigned long outsize = 0;
-
-    // 圧縮実行
-    int ret = tjCompress2(
-        tj_instance_,
-        bgr_mat.data,   // 入力バッファ
-        bgr_mat.cols,   // 幅
-        0,              // pitch (0=自動計算)
-        bgr_mat.rows,   // 高さ
-        TJPF_BGR,       // 入力ピクセルフォーマット
-        &outbuf,        // 出力バッファアドレスへのポインタ
-        &outsize,       // 出力サイズへのポインタ
-        TJSAMP_444,     // サブサンプリング (444は高画質)
-        quality,        // 画質 (1-100)
-        TJFLAG_FASTDCT  // 高速DCTアルゴリズム使用
-    );
-
-    if (ret != 0) {
-        // 圧縮失敗時、確保されたバッファがあれば解放
-        if (outbuf) tjFree(outbuf);
-        return false;
-    }
-
-    // std::vector にコピー（またはムーブしたいがAPI仕様上コピーが安全）
-    try {
-        jpeg.assign(outbuf, outbuf + outsize);
-    } catch (...) {
-        tjFree(outbuf);
-        return false;
-    }
-
-    // TurboJPEG確保メモリの解放
-    tjFree(outbuf);
-
-    return true;
-}
-
 cv::Mat get_roi_resistor_image(const cv::Mat& base_image, const cv::Rect& box)
 {
     cv::Rect safe_box = box & cv::Rect(0, 0, base_image.cols, base_image.rows);
@@ -0,0 +1,101 @@
+/**
+ * @file    iou_tracker.cpp
+ * @brief   矩形の重なり (IoU) で検出結果にフレームをまたぐIDを振るトラッカの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+
+#include "image_processor/iou_tracker.hpp"
+
+/**
+ * @brief 2つの矩形の IoU (共通部分の面積 / 和集合の面積)
+ */
+static float intersection_over_union(const cv::Rect& a, const cv::Rect& b)
+{
+    const int intersection = (a & b).area();
+    if (intersection <= 0) {
+        return 0.0f;
+    }
+
+    return static_cast<float>(intersection) / static_cast<float>(a.area() + b.area() - intersection);
+}
+
+IouTracker::IouTracker(float iou_threshold, uint32_t max_missed)
+    : iou_threshold_(iou_threshold),
+      max_missed_(max_missed),
+      next_id_(1),
+      tracks_(),
+      candidates_(),
+      track_matched_()
+{
+}
+
+void IouTracker::update(const std::vector<cv::Rect>& boxes, std::vector<uint32_t>& ids)
+{
+    ids.assign(boxes.size(), 0);
+    track_matched_.assign(tracks_.size(), false);
+
+    candidates_.clear();
+    for (size_t t = 0; t < tracks_.size(); ++t) {
+        for (size_t b = 0; b < boxes.size(); ++b) {
+            const float iou = intersection_over_union(tracks_[t].box, boxes[b]);
+            if (iou >= iou_threshold_) {
+                candidates_.push_back(Candidate{iou, t, b});
+            }
+        }
+    }
+
+    // 重なりの大きい組から確定する
+    std::sort(candidates_.begin(), candidates_.end(),
+              [](const Candidate& lhs, const Candidate& rhs) { return lhs.iou > rhs.iou; });
+
+    for (const Candidate& c : candidates_) {
+        if (track_matched_[c.track] || ids[c.box] != 0) {
+            continue;
+        }
+
+        track_matched_[c.track] = true;
+        ids[c.box] = tracks_[c.track].id;
+        tracks_[c.track].box = boxes[c.box];
+        tracks_[c.track].missed = 0;
+    }
+
+    // 見つからなかったトラックは猶予を過ぎたら消す
+    size_t kept = 0;
+    for (size_t t = 0; t < tracks_.size(); ++t) {
+        if (!track_matched_[t]) {
+            tracks_[t].missed += 1;
+            if (tracks_[t].missed > max_missed_) {
+                continue;
+            }
+        }
+        tracks_[kept++] = tracks_[t];
+    }
+    tracks_.resize(kept);
+
+    for (size_t b = 0; b < boxes.size(); ++b) {
+        if (ids[b] != 0) {
+            continue;
+        }
+
+        Track track;
+        track.id = next_id_;
+        track.box = boxes[b];
+        tracks_.push_back(track);
+
+        ids[b] = next_id_;
+
+        // 0 は「未追跡」に使うので飛ばす
+        next_id_ += 1;
+        if (next_id_ == 0) {
+            next_id_ = 1;
+        }
+    }
+}
+
+void IouTracker::reset()
+{
+    tracks_.clear();
+}
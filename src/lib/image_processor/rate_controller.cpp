@@ -0,0 +1,102 @@
+/**
+ * @file    rate_controller.cpp
+ * @brief   JPEG品質・出力解像度の閉ループ制御の実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+#include "image_processor/rate_controller.hpp"
+#include "logger/logger.hpp"
+
+static const double EMA_ALPHA = 0.3;            /**< 圧縮サイズ移動平均の重み */
+static const double OVER_BUDGET = 1.10;         /**< これを超えたら品質を下げる (予算比) */
+static const double UNDER_BUDGET = 0.80;        /**< これを下回ったら品質を上げる (予算比) */
+static const double SCALE_STEP = 0.8;           /**< 解像度変更1段あたりの倍率 */
+static const double CONGESTION_BACKOFF = 0.7;   /**< 輻輳検出時の予算係数の乗算減少 */
+static const double CONGESTION_RECOVERY = 0.02; /**< 1フレームあたりの予算係数の加算回復 */
+static const uint32_t HOLD_FRAMES = 5;          /**< 解像度変更後に様子を見るフレーム数 */
+static const double LOSS_THRESHOLD = 0.02;      /**< 受信側のロス率がこれを超えたら輻輳とみなす */
+
+RateController::RateController(const Config& config, int initial_quality)
+    : config_(config),
+      quality_(std::clamp(initial_quality, config.min_quality, config.max_quality)),
+      scale_(1.0),
+      frame_budget_bytes_(0.0),
+      budget_gain_(1.0),
+      avg_bytes_(0.0),
+      hold_frames_(0)
+{
+    const uint32_t fps = std::max<uint32_t>(config_.target_fps, 1);
+
+    frame_budget_bytes_ = config_.target_bitrate_kbps * 1000.0 / 8.0 / fps;
+
+    LOG_I("[RateController] target %u kbps @ %u fps (%.0f bytes/frame)",
+          config_.target_bitrate_kbps, fps, frame_budget_bytes_);
+}
+
+void RateController::update(const Feedback& feedback)
+{
+    if (feedback.encoded_bytes == 0) {
+        return;
+    }
+
+    /* ---------- 1. 輻輳判定 (AIMD) ---------- */
+    // 送信バッファ溢れ、1フレームの送信が1フレーム周期に収まらない、受信側でロスが多い場合は輻輳とみなす
+    const double frame_interval_us = 1e6 / std::max<uint32_t>(config_.target_fps, 1);
+    const bool congested = (feedback.dropped_packets > 0)
+                        || (feedback.send_time_us > frame_interval_us)
+                        || (feedback.loss_fraction > LOSS_THRESHOLD);
+
+    if (congested) {
+        budget_gain_ = std::max(0.1, budget_gain_ * CONGESTION_BACKOFF);
+    } else {
+        budget_gain_ = std::min(1.0, budget_gain_ + CONGESTION_RECOVERY);
+    }
+
+    /* ---------- 2. 圧縮サイズの移動平均 ---------- */
+    const double bytes = static_cast<double>(feedback.encoded_bytes);
+    avg_bytes_ = (avg_bytes_ == 0.0) ? bytes : (EMA_ALPHA * bytes + (1.0 - EMA_ALPHA) * avg_bytes_);
+
+    if (hold_frames_ > 0) {
+        hold_frames_ -= 1;
+        return;
+    }
+
+    const double budget = frame_budget_bytes_ * budget_gain_;
+    const double ratio = avg_bytes_ / budget;
+
+    /* ---------- 3. 品質調整 ---------- */
+    if (ratio > OVER_BUDGET) {
+        // 超過が大きいほど大きく下げる (1-10)
+        const int step = std::clamp(static_cast<int>((ratio - 1.0) * 10.0), 1, 10);
+
+        if (quality_ > config_.min_quality) {
+            quality_ = std::max(config_.min_quality, quality_ - step);
+        } else if (scale_ > config_.min_scale) {
+            // 品質が下限なら解像度を落とす（サイズはおおよそ面積に比例）
+            scale_ = std::max(config_.min_scale, scale_ * SCALE_STEP);
+            avg_bytes_ *= SCALE_STEP * SCALE_STEP;
+            hold_frames_ = HOLD_FRAMES;
+
+            LOG_I("[RateController] scale down -> %.2f", scale_);
+        }
+    } else if (ratio < UNDER_BUDGET) {
+        // 解像度を戻しても予算内に収まる見込みがあれば先に解像度を戻す
+        const double next_scale = std::min(1.0, scale_ / SCALE_STEP);
+        const double area_gain = (next_scale * next_scale) / (scale_ * scale_);
+
+        if (scale_ < 1.0 && ratio * area_gain < UNDER_BUDGET) {
+            scale_ = next_scale;
+            avg_bytes_ *= area_gain;
+            hold_frames_ = HOLD_FRAMES;
+
+            LOG_I("[RateController] scale up -> %.2f", scale_);
+        } else if (quality_ < config_.max_quality) {
+            quality_ += 1;
+        }
+    }
+}
@@ -0,0 +1,300 @@
+/**
+ * @file    video_encoder.cpp
+ * @brief   TurboJPEGエンコーダの実装とエンコーダ生成関数
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cmath>
+
+#include "image_processor/video_encoder.hpp"
+#include "logger/logger.hpp"
+
+#define ROI_MACROBLOCK_SIZE 16  /**< ROIマスクの単位 [px] */
+#define ROI_MARGIN 8            /**< ROIの周囲に広げる余白 [px] */
+#define ROI_COORD_MAX 65535     /**< ROIの座標の上限 [px] (JPEG の最大の大きさ) */
+
+/** @brief JPEG標準 輝度量子化テーブル (ITU-T T.81 Annex K, 自然順) */
+static const int STD_LUMA_QUANT[64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+/** @brief JPEG標準 色差量子化テーブル (ITU-T T.81 Annex K, 自然順) */
+static const int STD_CHROMA_QUANT[64] = {
+    17,  18,  24,  47,  99,  99,  99,  99,
+    18,  21,  26,  66,  99,  99,  99,  99,
+    24,  26,  56,  99,  99,  99,  99,  99,
+    47,  66,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99
+};
+
+/**
+ * @brief IJG (libjpeg) と同じ方法で品質から量子化値を求める
+ */
+static int scaled_quant(int base, int quality)
+{
+    quality = std::clamp(quality, 1, 100);
+
+    const int scale = (quality < 50) ? (5000 / quality) : (200 - quality * 2);
+
+    return std::clamp((base * scale + 50) / 100, 1, 255);
+}
+
+JpegEncoder::JpegEncoder(int quality, int background_quality, int subsampling) :
+    quality_(quality),
+    subsampling_(subsampling),
+    background_quality_(background_quality),
+    tj_transform_(nullptr)
+{
+    tj_instance_ = tjInitCompress();
+
+    if (background_quality_ > 0) {
+        tj_transform_ = tjInitTransform();
+
+        LOG_I("[JpegEncoder] ROI mode: quality %d inside, %d outside", quality_, background_quality_);
+    }
+}
+
+JpegEncoder::~JpegEncoder()
+{
+    tjDestroy(tj_instance_);
+
+    if (tj_transform_) {
+        tjDestroy(tj_transform_);
+    }
+}
+
+bool JpegEncoder::parse_subsampling(const std::string& name, int& subsampling)
+{
+    if (name == "444") {
+        subsampling = TJSAMP_444;
+    } else if (name == "422") {
+        subsampling = TJSAMP_422;
+    } else if (name == "420") {
+        subsampling = TJSAMP_420;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+void JpegEncoder::set_quality(int quality)
+{
+    quality_ = std::clamp(quality, 1, 100);
+}
+
+void JpegEncoder::set_regions_of_interest(const std::vector<cv::Rect>& rois)
+{
+    // 検出枠は画像外にはみ出すことがあるので、JPEG の最大の大きさに収めて空の枠は捨てる
+    const cv::Rect limit(0, 0, ROI_COORD_MAX, ROI_COORD_MAX);
+
+    rois_.clear();
+    for (const auto& roi : rois) {
+        const cv::Rect clipped = roi & limit;
+        if (!clipped.empty()) {
+            rois_.push_back(clipped);
+        }
+    }
+}
+
+void JpegEncoder::update_requantize_table()
+{
+    // ROI外は background_quality と現在の品質のうち低い方に合わせる
+    const int low_quality = std::min(background_quality_, quality_);
+
+    for (int k = 0; k < 64; ++k) {
+        requantize_ratio_[0][k] = static_cast<float>(scaled_quant(STD_LUMA_QUANT[k], low_quality))
+                                / scaled_quant(STD_LUMA_QUANT[k], quality_);
+        requantize_ratio_[1][k] = static_cast<float>(scaled_quant(STD_CHROMA_QUANT[k], low_quality))
+                                / scaled_quant(STD_CHROMA_QUANT[k], quality_);
+    }
+
+    requantize_quality_ = quality_;
+}
+
+int JpegEncoder::requantize_filter(short* coeffs,
+                                   tjregion array_region,
+                                   tjregion plane_region,
+                                   int component_index,
+                                   int transform_index,
+                                   tjtransform* transform)
+{
+    (void)transform_index;
+
+    const JpegEncoder* self = static_cast<const JpegEncoder*>(transform->data);
+    const float* ratio = self->requantize_ratio_[component_index == 0 ? 0 : 1];
+
+    // 色差間引きがあれば成分平面は画像より小さい。1ブロックが覆う画素数を求める
+    const int sub_x = std::max(1, static_cast<int>(std::lround(static_cast<double>(self->width_) / plane_region.w)));
+    const int sub_y = std::max(1, static_cast<int>(std::lround(static_cast<double>(self->height_) / plane_region.h)));
+
+    const int mask_rows = static_cast<int>(self->roi_mask_.size()) / std::max(self->mask_cols_, 1);
+    const int blocks_per_row = array_region.w / 8;
+
+    for (int by = 0; by < array_region.h / 8; ++by) {
+        const int py = (array_region.y + by * 8) * sub_y;
+        const int my = std::min(py / ROI_MACROBLOCK_SIZE, mask_rows - 1);
+
+        for (int bx = 0; bx < blocks_per_row; ++bx) {
+            const int px = (array_region.x + bx * 8) * sub_x;
+            const int mx = std::min(px / ROI_MACROBLOCK_SIZE, self->mask_cols_ - 1);
+
+            if (mx >= 0 && my >= 0 && self->roi_mask_[my * self->mask_cols_ + mx]) {
+                continue;   // ROI内はそのまま
+            }
+
+            // 低画質テーブルで量子化し直した値を、元の(高画質)テーブルの単位に戻す
+            short* block = coeffs + (by * blocks_per_row + bx) * 64;
+            for (int k = 0; k < 64; ++k) {
+                if (block[k] == 0) {
+                    continue;
+                }
+
+                const float level = std::nearbyint(block[k] / ratio[k]);
+                block[k] = static_cast<short>(std::nearbyint(level * ratio[k]));
+            }
+        }
+    }
+
+    return 0;
+}
+
+bool JpegEncoder::encode(const cv::Mat& bgr, std::vector<uint8_t>& out, bool& is_keyframe)
+{
+    if (bgr.empty()) return false;
+
+    unsigned char* outbuf = nullptr; // TurboJPEGが内部で確保するバッファ
+    unsigned long outsize = 0;
+
+    // 圧縮実行
+    int ret = tjCompress2(
+        tj_instance_,
+        bgr.data,       // 入力バッファ
+        bgr.cols,       // 幅
+        0,              // pitch (0=自動計算)
+        bgr.rows,       // 高さ
+        TJPF_BGR,       // 入力ピクセルフォーマット
+        &outbuf,        // 出力バッファアドレスへのポインタ
+        &outsize,       // 出力サイズへのポインタ
+        subsampling_,   // サブサンプリング (444は高画質、RTP/JPEG は 422 か 420)
+        quality_,       // 画質 (1-100)
+        TJFLAG_FASTDCT  // 高速DCTアルゴリズム使用
+    );
+
+    if (ret != 0) {
+        // 圧縮失敗時、確保されたバッファがあれば解放
+        if (outbuf) tjFree(outbuf);
+        return false;
+    }
+
+    /* ---------- 領域別画質: ROI外のDCT係数を再量子化 ---------- */
+    if (tj_transform_ && background_quality_ < quality_) {
+        if (requantize_quality_ != quality_) {
+            update_requantize_table();
+        }
+
+        width_ = bgr.cols;
+        height_ = bgr.rows;
+        mask_cols_ = (width_ + ROI_MACROBLOCK_SIZE - 1) / ROI_MACROBLOCK_SIZE;
+        const int mask_rows = (height_ + ROI_MACROBLOCK_SIZE - 1) / ROI_MACROBLOCK_SIZE;
+
+        roi_mask_.assign(static_cast<size_t>(mask_cols_) * mask_rows, 0);
+
+        const cv::Rect frame_rect(0, 0, width_, height_);
+
+        for (const auto& roi : rois_) {
+            // 余白を付けてから画像内に収める。画像外の枠は何もしない
+            const cv::Rect area = cv::Rect(roi.x - ROI_MARGIN, roi.y - ROI_MARGIN,
+                                           roi.width + 2 * ROI_MARGIN, roi.height + 2 * ROI_MARGIN) & frame_rect;
+            if (area.empty()) {
+                continue;
+            }
+
+            const int x0 = area.x / ROI_MACROBLOCK_SIZE;
+            const int y0 = area.y / ROI_MACROBLOCK_SIZE;
+            const int x1 = (area.x + area.width - 1) / ROI_MACROBLOCK_SIZE;
+            const int y1 = (area.y + area.height - 1) / ROI_MACROBLOCK_SIZE;
+
+            for (int my = y0; my <= y1; ++my) {
+                std::fill(roi_mask_.begin() + my * mask_cols_ + x0,
+                          roi_mask_.begin() + my * mask_cols_ + x1 + 1, 1);
+            }
+        }
+
+        tjtransform xform{};
+        xform.op = TJXOP_NONE;
+        xform.options = TJXOPT_COPYNONE;
+        xform.data = this;
+        xform.customFilter = &JpegEncoder::requantize_filter;
+
+        unsigned char* roi_buf = nullptr;
+        unsigned long roi_size = 0;
+
+        if (tjTransform(tj_transform_, outbuf, outsize, 1, &roi_buf, &roi_size, &xform, 0) == 0) {
+            tjFree(outbuf);
+            outbuf = roi_buf;
+            outsize = roi_size;
+        } else {
+            // 変換に失敗した場合は全体高画質のまま送る
+            LOG_W("[JpegEncoder] tjTransform failed: %s", tjGetErrorStr2(tj_transform_));
+
+            if (roi_buf) tjFree(roi_buf);
+        }
+    }
+
+    // std::vector にコピー（またはムーブしたいがAPI仕様上コピーが安全）
+    try {
+        out.assign(outbuf, outbuf + outsize);
+    } catch (...) {
+        tjFree(outbuf);
+        return false;
+    }
+
+    // TurboJPEG確保メモリの解放
+    tjFree(outbuf);
+
+    is_keyframe = true;
+
+    return true;
+}
+
+std::unique_ptr<VideoEncoder> create_video_encoder(const std::string& codec,
+                                                   int jpeg_quality,
+                                                   uint32_t bitrate_kbps,
+                                                   uint32_t gop,
+                                                   uint32_t fps,
+                                                   int background_quality,
+                                                   int jpeg_subsampling)
+{
+    if (codec == "h264") {
+#if defined(ENABLE_H264)
+        LOG_I("[VideoEncoder] H.264 %u kbps, GOP %u, %u fps", bitrate_kbps, gop, fps);
+
+        return std::make_unique<H264Encoder>(bitrate_kbps, gop, fps);
+#else
+        (void)bitrate_kbps;
+        (void)gop;
+        (void)fps;
+
+        LOG_W("[VideoEncoder] H.264 is not enabled in this build, fallback to JPEG");
+#endif
+    } else if (codec != "jpeg") {
+        LOG_W("[VideoEncoder] Unknown codec \"%s\", fallback to JPEG", codec.c_str());
+    }
+
+    LOG_I("[VideoEncoder] JPEG quality %d", jpeg_quality);
+
+    return std::make_unique<JpegEncoder>(jpeg_quality, background_quality, jpeg_subsampling);
+}
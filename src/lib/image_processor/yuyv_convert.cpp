@@ -0,0 +1,181 @@
+/**
+ * @file    yuyv_convert.cpp
+ * @brief   YUYV -> BGR 融合縮小変換の実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "image_processor/yuyv_convert.hpp"
+
+/* BT.601 limited range の変換係数 (14bit固定小数点) */
+#define YUV_SHIFT 14
+#define YUV_CY    19071     /**< 1.164 */
+#define YUV_CVR   26149     /**< 1.596 */
+#define YUV_CVG  (-13320)   /**< -0.813 */
+#define YUV_CUG  (-6406)    /**< -0.391 */
+#define YUV_CUB   33063     /**< 2.018 */
+
+/** @brief uint16 x 8 のSIMDベクタ (NEON: uint16x8_t, SSE2: __m128i 相当) */
+typedef uint16_t u16x8 __attribute__((vector_size(16)));
+/** @brief uint8 x 8 のベクタ (u16x8 への拡張ロード用) */
+typedef uint8_t u8x8 __attribute__((vector_size(8)));
+
+/**
+ * @brief 1行分のYUYVバイト列を16bitアキュムレータへ加算する（縦方向の面積加算）
+ * @param[in,out] acc  アキュムレータ (length 要素)
+ * @param[in]     src  YUYV 1行
+ * @param[in]     length バイト数
+ */
+static void accumulate_row(uint16_t* __restrict acc, const uint8_t* __restrict src, size_t length)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= length; i += 8) {
+        u8x8 s;
+        u16x8 a;
+        std::memcpy(&s, src + i, sizeof(s));
+        std::memcpy(&a, acc + i, sizeof(a));
+
+        a += __builtin_convertvector(s, u16x8);
+
+        std::memcpy(acc + i, &a, sizeof(a));
+    }
+
+    for (; i < length; ++i) {
+        acc[i] = static_cast<uint16_t>(acc[i] + src[i]);
+    }
+}
+
+static inline uint8_t clamp_u8(int v)
+{
+    return static_cast<uint8_t>(std::min(std::max(v, 0), 255));
+}
+/**
+ * @brief 縦加算済みの1行を横方向に加算し、BGRへ変換する
+ * @note  AArch64 ではマクロピクセルの読み出しが ld4、BGR書き込みが st3 として
+ *        自動ベクトル化される（分岐のないループ本体にしておくこと）
+ * @tparam FACTOR 縮小係数 (2, 4, 8)。定数化して内側ループを展開させる
+ * @param[in]  acc       縦加算済みYUYV (16bit)
+ * @param[out] dst       出力BGR 1行
+ * @param[in]  out_width 出力画素数
+ */
+template <uint32_t FACTOR>
+static void convert_row(const uint16_t* __restrict acc, uint8_t* __restrict dst, uint32_t out_width)
+{
+    // Y は FACTOR*FACTOR 画素、U/V は FACTOR*(FACTOR/2) 画素の平均
+    constexpr int LOG2 = (FACTOR == 2) ? 1 : (FACTOR == 4) ? 2 : 3;
+    constexpr int SHIFT_Y = 2 * LOG2;
+    constexpr int SHIFT_C = 2 * LOG2 - 1;
+    constexpr uint32_t HALF_MACRO = FACTOR / 2;   // 出力1画素あたりのマクロピクセル数
+
+    for (uint32_t ox = 0; ox < out_width; ++ox) {
+        // マクロピクセル [Y0 U Y1 V] を HALF_MACRO 個まとめる
+        const uint16_t* m = acc + static_cast<size_t>(ox) * FACTOR * 2;
+
+        int sum_y = 0;
+        int sum_u = 0;
+        int sum_v = 0;
+        for (uint32_t j = 0; j < HALF_MACRO; ++j) {
+            sum_y += m[4 * j] + m[4 * j + 2];
+            sum_u += m[4 * j + 1];
+            sum_v += m[4 * j + 3];
+        }
+
+        const int y = (sum_y + (1 << (SHIFT_Y - 1))) >> SHIFT_Y;
+        const int u = ((sum_u + (1 << (SHIFT_C - 1))) >> SHIFT_C) - 128;
+        const int v = ((sum_v + (1 << (SHIFT_C - 1))) >> SHIFT_C) - 128;
+
+        const int cy = std::max(y - 16, 0) * YUV_CY + (1 << (YUV_SHIFT - 1));
+
+        dst[3 * ox + 0] = clamp_u8((cy + YUV_CUB * u) >> YUV_SHIFT);
+        dst[3 * ox + 1] = clamp_u8((cy + YUV_CVG * v + YUV_CUG * u) >> YUV_SHIFT);
+        dst[3 * ox + 2] = clamp_u8((cy + YUV_CVR * v) >> YUV_SHIFT);
+    }
+}
+
+uint32_t yuyv_downscale_factor(uint32_t width, uint32_t height, double max_factor)
+{
+    uint32_t factor = 1;
+
+    for (uint32_t f = 2; f <= 8; f *= 2) {
+        if (f > max_factor + 1e-6) {
+            break;
+        }
+        if (width % f != 0 || height % f != 0) {
+            break;
+        }
+        factor = f;
+    }
+
+    return factor;
+}
+
+bool yuyv_to_bgr_downscale(const uint8_t* yuyv,
+                           uint32_t width,
+                           uint32_t height,
+                           uint32_t factor,
+                           uint8_t* bgr,
+                           size_t bgr_step)
+{
+    if (!yuyv || !bgr || factor < 2 || factor > 8 || (factor & (factor - 1)) != 0) {
+        return false;
+    }
+    if (width % factor != 0 || height % factor != 0) {
+        return false;
+    }
+
+    const uint32_t out_width = width / factor;
+    const uint32_t out_height = height / factor;
+    const size_t row_bytes = static_cast<size_t>(width) * 2;
+
+    static thread_local std::vector<uint16_t> acc;
+    acc.resize(row_bytes);
+
+    for (uint32_t oy = 0; oy < out_height; ++oy) {
+        /* ---------- 1. 縦方向: factor 行を加算 (SIMD) ---------- */
+        std::fill(acc.begin(), acc.end(), 0);
+
+        const uint8_t* src = yuyv + static_cast<size_t>(oy) * factor * row_bytes;
+        for (uint32_t r = 0; r < factor; ++r) {
+            accumulate_row(acc.data(), src + r * row_bytes, row_bytes);
+        }
+
+        /* ---------- 2. 横方向の加算 + YUV -> BGR ---------- */
+        uint8_t* dst = bgr + static_cast<size_t>(oy) * bgr_step;
+
+        switch (factor) {
+        case 2: convert_row<2>(acc.data(), dst, out_width); break;
+        case 4: convert_row<4>(acc.data(), dst, out_width); break;
+        default: convert_row<8>(acc.data(), dst, out_width); break;
+        }
+    }
+
+    return true;
+}
+
+void bgr_to_yuyv(const uint8_t* bgr, size_t bgr_step, uint32_t width, uint32_t height, uint8_t* yuyv)
+{
+    for (uint32_t y = 0; y < height; ++y) {
+        const uint8_t* src = bgr + static_cast<size_t>(y) * bgr_step;
+        uint8_t* dst = yuyv + static_cast<size_t>(y) * width * 2;
+
+        for (uint32_t x = 0; x + 1 < width; x += 2) {
+            const int b0 = src[0], g0 = src[1], r0 = src[2];
+            const int b1 = src[3], g1 = src[4], r1 = src[5];
+            const int b = b0 + b1, g = g0 + g1, r = r0 + r1;
+
+            /* 8bit固定小数点 (Y = 16 + 0.257R + 0.504G + 0.098B 等)、色差は2画素の和から */
+            dst[0] = clamp_u8(16 + ((66 * r0 + 129 * g0 + 25 * b0 + 128) >> 8));
+            dst[1] = clamp_u8(128 + ((-38 * r - 74 * g + 112 * b + 256) >> 9));
+            dst[2] = clamp_u8(16 + ((66 * r1 + 129 * g1 + 25 * b1 + 128) >> 8));
+            dst[3] = clamp_u8(128 + ((112 * r - 94 * g - 18 * b + 256) >> 9));
+
+            src += 6;
+            dst += 4;
+        }
+    }
+}
@@ -0,0 +1,63 @@
+/**
+ * @file    event_waiter.cpp
+ * @brief   eventfd による消費者スレッドの起床通知の実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/eventfd.h>
+#include <poll.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstdint>
+#include <cstring>
+
+#include "network/event_waiter.hpp"
+#include "logger/logger.hpp"
+
+EventWaiter::EventWaiter()
+    : event_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)),
+      sleeping_(false)
+{
+    if (event_fd_ < 0) {
+        LOG_E("Failed to create eventfd: %s", std::strerror(errno));
+    }
+}
+
+EventWaiter::~EventWaiter()
+{
+    if (event_fd_ >= 0) {
+        close(event_fd_);
+    }
+}
+
+void EventWaiter::notify(void)
+{
+    // 列への書き込みと sleeping_ の読み出しの順序を保証する (wait() 側の fence と対)
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    if (!sleeping_.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    const uint64_t one = 1;
+    if (write(event_fd_, &one, sizeof(one)) < 0 && errno != EAGAIN) {
+        LOG_W("eventfd write failed: %s", std::strerror(errno));
+    }
+}
+
+void EventWaiter::wait_event(int timeout_ms)
+{
+    struct pollfd pfd;
+    pfd.fd = event_fd_;
+    pfd.events = POLLIN;
+    pfd.revents = 0;
+
+    if (poll(&pfd, 1, timeout_ms) > 0) {
+        uint64_t count = 0;
+        if (read(event_fd_, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+            LOG_W("eventfd read failed: %s", std::strerror(errno));
+        }
+    }
+}
@@ -0,0 +1,382 @@
+/**
+ * @file    frame_assembler.cpp
+ * @brief   分割送信されたフレームを再構成するクラスの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "network/frame_assembler.hpp"
+
+#define MAX_DATAGRAM_PAYLOAD 65507      /**< UDP データグラムのペイロード最大長 [byte] */
+#define STREAM_RESTART_FRAMES 256       /**< これ以上古いフレームIDが来たら送信側が再起動したとみなす */
+
+/**
+ * @brief フレームID a が b より新しいか (32bit の一周を考慮)
+ */
+static bool is_newer(uint32_t a, uint32_t b)
+{
+    const uint32_t diff = a - b;
+
+    return diff != 0 && diff < 0x80000000u;
+}
+
+FrameAssembler::FrameAssembler(const Config& config)
+    : config_(config),
+      arena_(),
+      parity_arena_(),
+      slots_(std::max<size_t>(config.max_pending_frames, 1)),
+      streams_(),
+      stats_()
+{
+    const size_t parity_size = config_.max_frame_size + MAX_DATAGRAM_PAYLOAD;
+
+    arena_.resize(config_.max_frame_size * slots_.size());
+    parity_arena_.resize(parity_size * slots_.size());
+
+    for (size_t i = 0; i < slots_.size(); ++i) {
+        slots_[i].data = arena_.data() + i * config_.max_frame_size;
+        slots_[i].parity = parity_arena_.data() + i * parity_size;
+    }
+}
+
+bool FrameAssembler::push(const uint8_t* data, size_t length, Frame& frame)
+{
+    stats_.packets += 1;
+
+    FramePacketHeader header;
+    if (!read_frame_packet_header(data, length, header)
+        || header.chunk_count == 0 || header.chunk_index >= header.chunk_count
+        || header.total_size == 0 || header.total_size > config_.max_frame_size) {
+        stats_.invalid_packets += 1;
+
+        return false;
+    }
+
+    StreamState& stream = streams_[header.stream_id];
+
+    if (stream.has_completed && !is_newer(header.frame_id, stream.last_completed)) {
+        if (stream.last_completed - header.frame_id < STREAM_RESTART_FRAMES) {
+            // 完成済み以前のフレームに遅れて届いたパケット (余ったパリティ・重複した再送等)
+            stats_.duplicate_packets += 1;
+
+            return false;
+        }
+
+        // 大きく戻った場合は送信側が再起動してフレームIDが振り直された
+        stream = StreamState();
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    Slot* slot = find_slot(header, now);
+    if (slot == nullptr) {
+        stats_.invalid_packets += 1;
+
+        return false;
+    }
+
+    if (!stream.has_newest || is_newer(header.frame_id, stream.newest)) {
+        stream.has_newest = true;
+        stream.newest = header.frame_id;
+    }
+
+    slot->updated = now;
+
+    const uint8_t* payload = data + FRAME_PACKET_HEADER_SIZE;
+    const size_t payload_length = length - FRAME_PACKET_HEADER_SIZE;
+
+    if (header.flags & FRAME_PACKET_FLAG_PARITY) {
+        const uint16_t group = header.chunk_index;
+
+        if (header.parity_groups == 0 || group >= header.parity_groups
+            || (slot->parity_groups != 0 && slot->parity_groups != header.parity_groups)
+            || !set_chunk_size(*slot, payload_length)
+            || static_cast<size_t>(header.parity_groups) * payload_length
+               > config_.max_frame_size + MAX_DATAGRAM_PAYLOAD) {
+            stats_.invalid_packets += 1;
+
+            return false;
+        }
+
+        if (slot->parity_groups == 0) {
+            slot->parity_groups = header.parity_groups;
+            slot->has_parity.assign(header.parity_groups, 0);
+        }
+
+        if (slot->has_parity[group]) {
+            stats_.duplicate_packets += 1;
+
+            return false;
+        }
+
+        std::memcpy(slot->parity + group * slot->chunk_size, payload, payload_length);
+        slot->has_parity[group] = 1;
+
+        recover(*slot, group);
+    } else {
+        const uint16_t index = header.chunk_index;
+
+        if (slot->has_chunk[index]) {
+            stats_.duplicate_packets += 1;
+
+            return false;
+        }
+
+        size_t offset;
+        if (index + 1 < slot->chunk_count) {
+            if (!set_chunk_size(*slot, payload_length)) {
+                stats_.invalid_packets += 1;
+
+                return false;
+            }
+            offset = index * slot->chunk_size;
+        } else {
+            // 最終チャンクはフレームの末尾に揃える (チャンク長がまだ分からなくても置ける)
+            if (payload_length == 0 || payload_length > slot->total_size
+                || (slot->chunk_count == 1 && payload_length != slot->total_size)
+                || (slot->chunk_size != 0 && payload_length != chunk_length(*slot, index))) {
+                stats_.invalid_packets += 1;
+
+                return false;
+            }
+            if (slot->chunk_size == 0) {
+                slot->last_chunk_length = payload_length;   // チャンク長が分かった時に確かめる
+            }
+            offset = slot->total_size - payload_length;
+        }
+
+        std::memcpy(slot->data + offset, payload, payload_length);
+        slot->has_chunk[index] = 1;
+        slot->received += 1;
+
+        if (slot->parity_groups != 0) {
+            recover(*slot, static_cast<uint16_t>(index % slot->parity_groups));
+        }
+    }
+
+    if (slot->received != slot->chunk_count) {
+        return false;
+    }
+
+    frame.stream_id = slot->stream_id;
+    frame.frame_id = slot->frame_id;
+    frame.timestamp_us = slot->timestamp_us;
+    frame.data.assign(slot->data, slot->data + slot->total_size);
+
+    if (stream.has_completed) {
+        stats_.lost_frames += slot->frame_id - stream.last_completed - 1;
+    }
+    stream.has_completed = true;
+    stream.last_completed = slot->frame_id;
+
+    release(*slot);
+    stats_.completed_frames += 1;
+
+    // これより古い未完成フレームはもう表示しないので捨てる
+    for (Slot& other : slots_) {
+        if (other.used && other.stream_id == frame.stream_id && !is_newer(other.frame_id, frame.frame_id)) {
+            release(other);
+            stats_.discarded_frames += 1;
+        }
+    }
+
+    return true;
+}
+
+size_t FrameAssembler::collect_nacks(std::vector<FrameNack>& nacks)
+{
+    const auto now = std::chrono::steady_clock::now();
+    const auto timeout = std::chrono::milliseconds(config_.frame_timeout_ms);
+    const auto delay = std::chrono::milliseconds(config_.nack_delay_ms);
+    const auto retry_interval = std::chrono::milliseconds(config_.nack_retry_interval_ms);
+
+    size_t count = 0;
+
+    for (Slot& slot : slots_) {
+        if (!slot.used) {
+            continue;
+        }
+
+        if (now - slot.updated > timeout) {
+            release(slot);
+            stats_.discarded_frames += 1;
+            continue;
+        }
+
+        if (slot.nacks >= config_.nack_max_retries || now - slot.last_nack < retry_interval) {
+            continue;
+        }
+
+        // 後続フレームが届き始めた = このフレームの送信は終わっている
+        const bool newer_seen = streams_[slot.stream_id].newest != slot.frame_id;
+        if (!newer_seen && now - slot.updated < delay) {
+            continue;
+        }
+
+        if (nacks.size() <= count) {
+            nacks.resize(count + 1);
+        }
+
+        FrameNack& nack = nacks[count];
+        nack.stream_id = slot.stream_id;
+        nack.frame_id = slot.frame_id;
+        nack.chunks.clear();
+
+        for (size_t i = 0; i < slot.chunk_count && nack.chunks.size() < FRAME_NACK_MAX_CHUNKS; ++i) {
+            if (!slot.has_chunk[i]) {
+                nack.chunks.push_back(static_cast<uint16_t>(i));
+            }
+        }
+
+        if (nack.chunks.empty()) {
+            continue;
+        }
+
+        slot.nacks += 1;
+        slot.last_nack = now;
+        count += 1;
+    }
+
+    return count;
+}
+
+FrameAssembler::Slot* FrameAssembler::find_slot(const FramePacketHeader& header,
+                                                std::chrono::steady_clock::time_point now)
+{
+    Slot* free_slot = nullptr;
+    Slot* oldest = nullptr;
+
+    for (Slot& slot : slots_) {
+        if (!slot.used) {
+            if (free_slot == nullptr) {
+                free_slot = &slot;
+            }
+            continue;
+        }
+
+        if (slot.stream_id == header.stream_id && slot.frame_id == header.frame_id) {
+            if (slot.chunk_count != header.chunk_count || slot.total_size != header.total_size) {
+                return nullptr;
+            }
+
+            return &slot;
+        }
+
+        if (oldest == nullptr || slot.updated < oldest->updated) {
+            oldest = &slot;
+        }
+    }
+
+    // 空きが無ければ、一番長く更新されていないフレームを捨てる
+    Slot* slot = free_slot;
+    if (slot == nullptr) {
+        slot = oldest;
+        release(*slot);
+        stats_.discarded_frames += 1;
+    }
+
+    slot->used = true;
+    slot->stream_id = header.stream_id;
+    slot->frame_id = header.frame_id;
+    slot->timestamp_us = header.timestamp_us;
+    slot->total_size = header.total_size;
+    slot->chunk_count = header.chunk_count;
+    slot->received = 0;
+    slot->chunk_size = 0;
+    slot->last_chunk_length = 0;
+    slot->parity_groups = 0;
+    slot->nacks = 0;
+    slot->updated = now;
+    slot->last_nack = std::chrono::steady_clock::time_point();
+    slot->has_chunk.assign(header.chunk_count, 0);
+    slot->has_parity.clear();
+
+    return slot;
+}
+
+bool FrameAssembler::set_chunk_size(Slot& slot, size_t chunk_size)
+{
+    if (slot.chunk_size != 0) {
+        return slot.chunk_size == chunk_size;
+    }
+
+    // 最終チャンクを除いて同じ長さなので、総バイト数と整合する長さだけを受け付ける
+    const size_t total = slot.total_size;
+    const size_t count = slot.chunk_count;
+    if (chunk_size == 0 || (count - 1) * chunk_size >= total || count * chunk_size < total) {
+        return false;
+    }
+
+    slot.chunk_size = chunk_size;
+
+    // 先に置いた最終チャンクの長さが合わなければ、受信していないことにして再送を待つ
+    const size_t last = count - 1;
+    if (slot.last_chunk_length != 0 && slot.has_chunk[last] && slot.last_chunk_length != chunk_length(slot, last)) {
+        slot.has_chunk[last] = 0;
+        slot.received -= 1;
+        stats_.invalid_packets += 1;
+    }
+    slot.last_chunk_length = 0;
+
+    return true;
+}
+
+void FrameAssembler::recover(Slot& slot, uint16_t group)
+{
+    if (slot.parity_groups == 0 || !slot.has_parity[group]) {
+        return;
+    }
+
+    size_t missing = slot.chunk_count;
+    for (size_t i = group; i < slot.chunk_count; i += slot.parity_groups) {
+        if (!slot.has_chunk[i]) {
+            if (missing != slot.chunk_count) {
+                return;     // 2個以上欠けている
+            }
+            missing = i;
+        }
+    }
+
+    if (missing == slot.chunk_count) {
+        return;
+    }
+
+    // パリティは (チャンク長まで0詰めした) 各チャンクの XOR なので、他のチャンクを XOR すれば残る
+    const size_t length = chunk_length(slot, missing);
+    uint8_t* dst = slot.data + missing * slot.chunk_size;
+
+    std::memcpy(dst, slot.parity + group * slot.chunk_size, length);
+
+    for (size_t i = group; i < slot.chunk_count; i += slot.parity_groups) {
+        if (i == missing) {
+            continue;
+        }
+
+        const uint8_t* src = slot.data + i * slot.chunk_size;
+        const size_t n = std::min(length, chunk_length(slot, i));
+        for (size_t k = 0; k < n; ++k) {
+            dst[k] ^= src[k];
+        }
+    }
+
+    slot.has_chunk[missing] = 1;
+    slot.received += 1;
+    stats_.recovered_chunks += 1;
+}
+
+size_t FrameAssembler::chunk_length(const Slot& slot, size_t index)
+{
+    if (index + 1 < slot.chunk_count) {
+        return slot.chunk_size;
+    }
+
+    return slot.total_size - (slot.chunk_count - 1) * slot.chunk_size;
+}
+
+void FrameAssembler::release(Slot& slot)
+{
+    slot.used = false;
+}
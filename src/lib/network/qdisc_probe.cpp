@@ -0,0 +1,145 @@
+/**
+ * @file    qdisc_probe.cpp
+ * @brief   送信先への送出インターフェースのキューイング規則 (qdisc) を調べるヘルパの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <ifaddrs.h>
+#include <net/if.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+#include <cstring>
+#include <cerrno>
+
+#include <vector>
+
+#include "network/qdisc_probe.hpp"
+#include "logger/logger.hpp"
+
+#define NETLINK_RECV_BUFFER_SIZE 32768  /**< netlink 応答の受信バッファ [byte] */
+
+bool find_egress_interface(const struct sockaddr_in& dest, std::string& interface)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    // UDP の connect は経路を引くだけでパケットは出ない
+    struct sockaddr_in local;
+    socklen_t length = sizeof(local);
+
+    const bool routed = connect(fd, reinterpret_cast<const struct sockaddr*>(&dest), sizeof(dest)) == 0
+                     && getsockname(fd, reinterpret_cast<struct sockaddr*>(&local), &length) == 0;
+    close(fd);
+
+    if (!routed) {
+        return false;
+    }
+
+    struct ifaddrs* addrs = nullptr;
+    if (getifaddrs(&addrs) < 0) {
+        return false;
+    }
+
+    bool found = false;
+    for (struct ifaddrs* ifa = addrs; ifa != nullptr; ifa = ifa->ifa_next) {
+        if (ifa->ifa_addr == nullptr || ifa->ifa_addr->sa_family != AF_INET) {
+            continue;
+        }
+
+        const auto* addr = reinterpret_cast<const struct sockaddr_in*>(ifa->ifa_addr);
+        if (addr->sin_addr.s_addr == local.sin_addr.s_addr) {
+            interface = ifa->ifa_name;
+            found = true;
+            break;
+        }
+    }
+
+    freeifaddrs(addrs);
+
+    return found;
+}
+
+bool interface_has_fq_qdisc(const std::string& interface)
+{
+    const unsigned int ifindex = if_nametoindex(interface.c_str());
+    if (ifindex == 0) {
+        return false;
+    }
+
+    int fd = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (fd < 0) {
+        LOG_W("Failed to open netlink socket: %s", std::strerror(errno));
+
+        return false;
+    }
+
+    struct {
+        struct nlmsghdr header;
+        struct tcmsg tc;
+    } request;
+
+    std::memset(&request, 0, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct tcmsg));
+    request.header.nlmsg_type = RTM_GETQDISC;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = 1;
+    request.tc.tcm_family = AF_UNSPEC;
+    request.tc.tcm_ifindex = static_cast<int>(ifindex);
+
+    if (send(fd, &request, request.header.nlmsg_len, 0) < 0) {
+        close(fd);
+
+        return false;
+    }
+
+    std::vector<uint8_t> buffer(NETLINK_RECV_BUFFER_SIZE);
+    bool has_fq = false;
+    bool done = false;
+
+    while (!done) {
+        ssize_t received = recv(fd, buffer.data(), buffer.size(), 0);
+        if (received < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            break;
+        }
+
+        int remaining = static_cast<int>(received);
+        for (auto* msg = reinterpret_cast<struct nlmsghdr*>(buffer.data());
+             NLMSG_OK(msg, remaining);
+             msg = NLMSG_NEXT(msg, remaining)) {
+            if (msg->nlmsg_type == NLMSG_DONE || msg->nlmsg_type == NLMSG_ERROR) {
+                done = true;
+                break;
+            }
+            if (msg->nlmsg_type != RTM_NEWQDISC) {
+                continue;
+            }
+
+            // 古いカーネルは tcm_ifindex で絞り込まないので、ここで見る
+            const auto* tc = static_cast<const struct tcmsg*>(NLMSG_DATA(msg));
+            if (tc->tcm_ifindex != static_cast<int>(ifindex)) {
+                continue;
+            }
+
+            int attr_length = static_cast<int>(msg->nlmsg_len - NLMSG_LENGTH(sizeof(struct tcmsg)));
+            for (auto* attr = TCA_RTA(tc); RTA_OK(attr, attr_length); attr = RTA_NEXT(attr, attr_length)) {
+                if (attr->rta_type == TCA_KIND
+                    && std::strcmp(static_cast<const char*>(RTA_DATA(attr)), "fq") == 0) {
+                    has_fq = true;
+                }
+            }
+        }
+    }
+
+    close(fd);
+
+    return has_fq;
+}
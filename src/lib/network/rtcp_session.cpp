@@ -0,0 +1,250 @@
+/**
+ * @file    rtcp_session.cpp
+ * @brief   RTCP 送信者レポート送信・受信者レポート受信クラスの実装 (RFC 3550)
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <time.h>
+#include <cstring>
+#include <cerrno>
+
+#include <algorithm>
+
+#include "network/rtcp_session.hpp"
+#include "logger/logger.hpp"
+
+#define RTCP_VERSION 2
+#define RTCP_PT_SR 200          /**< 送信者レポート */
+#define RTCP_PT_RR 201          /**< 受信者レポート */
+#define RTCP_PT_SDES 202        /**< 送信元記述 */
+#define RTCP_SDES_CNAME 1       /**< SDES 項目: CNAME */
+#define RTCP_SR_SIZE 28         /**< レポートブロックなしの SR 長 [byte] */
+#define RTCP_REPORT_BLOCK_SIZE 24 /**< レポートブロック長 [byte] */
+#define RTCP_BUFFER_SIZE 1500   /**< 送受信バッファ長 [byte] */
+#define NTP_UNIX_OFFSET 2208988800ULL   /**< 1900-01-01 から 1970-01-01 までの秒数 */
+
+/**
+ * @brief ビッグエンディアンで書き込む
+ */
+static void write_u16(uint8_t* p, uint16_t value)
+{
+    p[0] = static_cast<uint8_t>(value >> 8);
+    p[1] = static_cast<uint8_t>(value);
+}
+
+static void write_u32(uint8_t* p, uint32_t value)
+{
+    p[0] = static_cast<uint8_t>(value >> 24);
+    p[1] = static_cast<uint8_t>(value >> 16);
+    p[2] = static_cast<uint8_t>(value >> 8);
+    p[3] = static_cast<uint8_t>(value);
+}
+
+/**
+ * @brief ビッグエンディアンの32bit値を読む
+ */
+static uint32_t read_u32(const uint8_t* p)
+{
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+         | (static_cast<uint32_t>(p[2]) << 8) | p[3];
+}
+
+/**
+ * @brief 現在の壁時計を NTP 形式 (上位32bit 秒、下位32bit 秒の小数) で返す
+ */
+static uint64_t ntp_now()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+
+    const uint64_t seconds = static_cast<uint64_t>(ts.tv_sec) + NTP_UNIX_OFFSET;
+    const uint64_t fraction = (static_cast<uint64_t>(ts.tv_nsec) << 32) / 1000000000ULL;
+
+    return (seconds << 32) | fraction;
+}
+
+/**
+ * @brief キャプチャ時刻と同じ時計 (CLOCK_MONOTONIC) の現在時刻 [us]
+ */
+static uint64_t monotonic_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+RtcpSession::RtcpSession(const std::string& ip, uint16_t port, uint32_t ssrc, uint32_t clock_rate)
+    : sock_fd_(-1),
+      ssrc_(ssrc),
+      clock_rate_(clock_rate),
+      cname_(),
+      stats_(),
+      buffer_(RTCP_BUFFER_SIZE)
+{
+    std::memset(&addr_, 0, sizeof(addr_));
+    addr_.sin_family = AF_INET;
+    addr_.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) <= 0) {
+        LOG_E("[RTCP] Invalid IP address: %s", ip.c_str());
+
+        return;
+    }
+
+    // 受信側は SR の送信元アドレスへ RR を返すので、このソケットで受ける
+    sock_fd_ = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (sock_fd_ < 0) {
+        LOG_E("[RTCP] Failed to create socket: %s", std::strerror(errno));
+
+        return;
+    }
+
+    char host[64] = "localhost";
+    gethostname(host, sizeof(host) - 1);
+    cname_ = std::string("webcam@") + host;
+
+    LOG_I("[RTCP] Sender reports to %s:%d (SSRC %08x)", ip.c_str(), port, ssrc_);
+}
+
+RtcpSession::~RtcpSession()
+{
+    if (sock_fd_ >= 0) {
+        close(sock_fd_);
+    }
+}
+
+bool RtcpSession::send_sender_report(uint32_t packet_count, uint32_t octet_count)
+{
+    if (sock_fd_ < 0) {
+        return false;
+    }
+
+    uint8_t* p = buffer_.data();
+
+    /* ---------- SR (レポートブロックなし) ---------- */
+    const uint64_t ntp = ntp_now();
+    const uint32_t rtp_timestamp = static_cast<uint32_t>(monotonic_now_us() * clock_rate_ / 1000000);
+
+    p[0] = RTCP_VERSION << 6;
+    p[1] = RTCP_PT_SR;
+    write_u16(p + 2, RTCP_SR_SIZE / 4 - 1);
+    write_u32(p + 4, ssrc_);
+    write_u32(p + 8, static_cast<uint32_t>(ntp >> 32));
+    write_u32(p + 12, static_cast<uint32_t>(ntp));
+    write_u32(p + 16, rtp_timestamp);
+    write_u32(p + 20, packet_count);
+    write_u32(p + 24, octet_count);
+    p += RTCP_SR_SIZE;
+
+    /* ---------- SDES (CNAME のみ) ---------- */
+    // 複合パケットには CNAME が必須 (RFC 3550 6.1)
+    const size_t cname_length = std::min<size_t>(cname_.size(), 255);
+    const size_t chunk_length = 4 + 2 + cname_length + 1;     // SSRC + 項目 + END
+    const size_t sdes_length = 4 + (chunk_length + 3) / 4 * 4;
+
+    std::memset(p, 0, sdes_length);
+    p[0] = (RTCP_VERSION << 6) | 1;
+    p[1] = RTCP_PT_SDES;
+    write_u16(p + 2, static_cast<uint16_t>(sdes_length / 4 - 1));
+    write_u32(p + 4, ssrc_);
+    p[8] = RTCP_SDES_CNAME;
+    p[9] = static_cast<uint8_t>(cname_length);
+    std::memcpy(p + 10, cname_.data(), cname_length);
+    p += sdes_length;
+
+    const size_t length = static_cast<size_t>(p - buffer_.data());
+
+    if (sendto(sock_fd_, buffer_.data(), length, 0,
+               reinterpret_cast<const struct sockaddr*>(&addr_), sizeof(addr_)) < 0) {
+        LOG_W("[RTCP] Failed to send sender report: %s", std::strerror(errno));
+
+        return false;
+    }
+
+    return true;
+}
+
+size_t RtcpSession::poll_receiver_reports()
+{
+    if (sock_fd_ < 0) {
+        return 0;
+    }
+
+    size_t found = 0;
+
+    while (true) {
+        const ssize_t received = recv(sock_fd_, buffer_.data(), buffer_.size(), MSG_DONTWAIT);
+        if (received < 0) {
+            break;
+        }
+
+        // 複合パケットを先頭から順に読む
+        size_t pos = 0;
+        const size_t total = static_cast<size_t>(received);
+
+        while (pos + 4 <= total) {
+            const uint8_t* p = buffer_.data() + pos;
+            const size_t length = (static_cast<size_t>((p[2] << 8) | p[3]) + 1) * 4;
+
+            if ((p[0] >> 6) != RTCP_VERSION || pos + length > total) {
+                break;
+            }
+
+            const size_t block_count = p[0] & 0x1F;
+
+            if (p[1] == RTCP_PT_RR && length >= 8) {
+                found += read_report_blocks(p + 8, length - 8, block_count);
+            } else if (p[1] == RTCP_PT_SR && length >= RTCP_SR_SIZE) {
+                found += read_report_blocks(p + RTCP_SR_SIZE, length - RTCP_SR_SIZE, block_count);
+            }
+
+            pos += length;
+        }
+    }
+
+    return found;
+}
+
+size_t RtcpSession::read_report_blocks(const uint8_t* data, size_t length, size_t block_count)
+{
+    size_t found = 0;
+
+    for (size_t i = 0; i < block_count && (i + 1) * RTCP_REPORT_BLOCK_SIZE <= length; ++i) {
+        const uint8_t* block = data + i * RTCP_REPORT_BLOCK_SIZE;
+
+        if (read_u32(block) != ssrc_) {
+            continue;
+        }
+
+        // 累計ロス数は 24bit の符号付き
+        int32_t cumulative = static_cast<int32_t>((block[5] << 16) | (block[6] << 8) | block[7]);
+        if (cumulative & 0x800000) {
+            cumulative -= 0x1000000;
+        }
+
+        stats_.reports += 1;
+        stats_.fraction_lost = block[4] / 256.0;
+        stats_.cumulative_lost = cumulative;
+        stats_.jitter_ms = read_u32(block + 12) * 1000.0 / clock_rate_;
+
+        // RTT = 到着時刻 - LSR - DLSR (単位 1/65536 秒、NTP の中央32bit)
+        const uint32_t lsr = read_u32(block + 16);
+        const uint32_t dlsr = read_u32(block + 20);
+
+        if (lsr != 0) {
+            const uint32_t arrival = static_cast<uint32_t>(ntp_now() >> 16);
+            const uint32_t rtt = arrival - lsr - dlsr;
+
+            stats_.rtt_ms = static_cast<int32_t>(rtt) >= 0 ? rtt * 1000.0 / 65536.0 : -1.0;
+        }
+
+        found += 1;
+    }
+
+    return found;
+}
@@ -0,0 +1,131 @@
+/**
+ * @file    rtp_h264_packetizer.cpp
+ * @brief   H.264 RTPパケタイザの実装 (RFC 6184 Single NAL / FU-A)
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cstring>
+
+#include "network/rtp_h264_packetizer.hpp"
+#include "network/rtp_header.hpp"
+
+/**
+ * @brief Annex-B のスタートコード (00 00 01 / 00 00 00 01) を探す
+ * @param[in]  data  検索対象
+ * @param[in]  size  検索範囲 [byte]
+ * @param[out] code_length 見つかったスタートコードの長さ
+ * @return スタートコードの位置。見つからなければ size
+ */
+static size_t find_start_code(const uint8_t* data, size_t size, size_t& code_length)
+{
+    for (size_t i = 0; i + 3 <= size; ++i) {
+        if (data[i] == 0 && data[i + 1] == 0) {
+            if (data[i + 2] == 1) {
+                code_length = 3;
+                return i;
+            }
+            if (i + 4 <= size && data[i + 2] == 0 && data[i + 3] == 1) {
+                code_length = 4;
+                return i;
+            }
+        }
+    }
+
+    code_length = 0;
+    return size;
+}
+
+RtpH264Packetizer::RtpH264Packetizer(uint8_t payload_type, uint32_t ssrc, size_t max_payload_size)
+    : payload_type_(payload_type),
+      ssrc_(ssrc),
+      max_payload_size_(std::max<size_t>(max_payload_size, 16)),
+      sequence_(0)
+{
+}
+
+uint8_t* RtpH264Packetizer::begin_packet(std::vector<std::vector<uint8_t>>& packets,
+                                         size_t& count,
+                                         size_t payload_size,
+                                         uint32_t timestamp)
+{
+    if (packets.size() <= count) {
+        packets.resize(count + 1);
+    }
+
+    std::vector<uint8_t>& packet = packets[count];
+    packet.resize(RTP_HEADER_SIZE + payload_size);
+
+    write_rtp_header(packet.data(), payload_type_, false, sequence_++, timestamp, ssrc_);
+
+    count += 1;
+
+    return packet.data() + RTP_HEADER_SIZE;
+}
+
+size_t RtpH264Packetizer::packetize(const uint8_t* data,
+                                    size_t size,
+                                    uint32_t timestamp,
+                                    std::vector<std::vector<uint8_t>>& packets)
+{
+    size_t count = 0;
+    size_t code_length = 0;
+    size_t pos = find_start_code(data, size, code_length);
+
+    while (pos < size) {
+        const size_t nal_begin = pos + code_length;
+        size_t next_code_length = 0;
+        size_t next = nal_begin + find_start_code(data + nal_begin, size - nal_begin, next_code_length);
+
+        // 次のスタートコード直前の末尾ゼロ (trailing_zero_8bits) は除く
+        size_t nal_end = next;
+        while (nal_end > nal_begin && next < size && data[nal_end - 1] == 0) {
+            nal_end -= 1;
+        }
+
+        const uint8_t* nal = data + nal_begin;
+        const size_t nal_size = nal_end - nal_begin;
+
+        if (nal_size > 0 && nal_size <= max_payload_size_) {
+            /* ---------- Single NAL Unit Packet ---------- */
+            uint8_t* payload = begin_packet(packets, count, nal_size, timestamp);
+            std::memcpy(payload, nal, nal_size);
+        } else if (nal_size > 0) {
+            /* ---------- FU-A ---------- */
+            const uint8_t nal_header = nal[0];
+            const uint8_t fu_indicator = (nal_header & 0xe0) | 28;   // F, NRI + type 28
+            const size_t fragment_max = max_payload_size_ - 2;
+
+            size_t offset = 1;  // NALヘッダはFUヘッダで運ぶ
+            while (offset < nal_size) {
+                const size_t fragment = std::min(fragment_max, nal_size - offset);
+
+                uint8_t fu_header = nal_header & 0x1f;
+                if (offset == 1) {
+                    fu_header |= 0x80;  // Start
+                }
+                if (offset + fragment == nal_size) {
+                    fu_header |= 0x40;  // End
+                }
+
+                uint8_t* payload = begin_packet(packets, count, fragment + 2, timestamp);
+                payload[0] = fu_indicator;
+                payload[1] = fu_header;
+                std::memcpy(payload + 2, nal + offset, fragment);
+
+                offset += fragment;
+            }
+        }
+
+        pos = next;
+        code_length = next_code_length;
+    }
+
+    // アクセスユニット最終パケットにマーカビット
+    if (count > 0) {
+        packets[count - 1][1] |= 0x80;
+    }
+
+    return count;
+}
@@ -0,0 +1,318 @@
+/**
+ * @file    rtp_jpeg_packetizer.cpp
+ * @brief   RTP/JPEG パケタイザの実装 (RFC 2435)
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#include "network/rtp_jpeg_packetizer.hpp"
+#include "network/rtp_header.hpp"
+#include "logger/logger.hpp"
+
+#define RTP_JPEG_HEADER_SIZE 8          /**< RTP/JPEG 主ヘッダ長 [byte] */
+#define RTP_JPEG_RESTART_HEADER_SIZE 4  /**< リスタートマーカヘッダ長 [byte] */
+#define RTP_JPEG_QTABLE_HEADER_SIZE 4   /**< 量子化テーブルヘッダ長 [byte] */
+#define RTP_JPEG_TYPE_RESTART 64        /**< Type に加えるとリスタートマーカあり */
+#define RTP_JPEG_Q_DYNAMIC 255          /**< テーブルを毎フレーム送る Q 値 */
+#define RTP_JPEG_MAX_DIMENSION 2040     /**< 幅・高さの上限 (8px 単位で 1byte) */
+
+/** @brief ジグザグ順 → 自然順の位置 (ITU-T T.81 Figure A.6) */
+static const uint8_t ZIGZAG_TO_NATURAL[64] = {
+     0,  1,  8, 16,  9,  2,  3, 10,
+    17, 24, 32, 25, 18, 11,  4,  5,
+    12, 19, 26, 33, 40, 48, 41, 34,
+    27, 20, 13,  6,  7, 14, 21, 28,
+    35, 42, 49, 56, 57, 50, 43, 36,
+    29, 22, 15, 23, 30, 37, 44, 51,
+    58, 59, 52, 45, 38, 31, 39, 46,
+    53, 60, 61, 54, 47, 55, 62, 63
+};
+
+/** @brief RFC 2435 Appendix A の輝度量子化テーブル (自然順) */
+static const uint8_t RFC2435_LUMA_QUANT[64] = {
+    16,  11,  10,  16,  24,  40,  51,  61,
+    12,  12,  14,  19,  26,  58,  60,  55,
+    14,  13,  16,  24,  40,  57,  69,  56,
+    14,  17,  22,  29,  51,  87,  80,  62,
+    18,  22,  37,  56,  68, 109, 103,  77,
+    24,  35,  55,  64,  81, 104, 113,  92,
+    49,  64,  78,  87, 103, 121, 120, 101,
+    72,  92,  95,  98, 112, 100, 103,  99
+};
+
+/** @brief RFC 2435 Appendix A の色差量子化テーブル (自然順) */
+static const uint8_t RFC2435_CHROMA_QUANT[64] = {
+    17,  18,  24,  47,  99,  99,  99,  99,
+    18,  21,  26,  66,  99,  99,  99,  99,
+    24,  26,  56,  99,  99,  99,  99,  99,
+    47,  66,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99,
+    99,  99,  99,  99,  99,  99,  99,  99
+};
+
+/**
+ * @brief RFC 2435 の MakeTables() と同じ方法で Q からテーブルの1要素を求める
+ */
+static int scaled_quant(int base, int q)
+{
+    const int factor = (q < 50) ? (5000 / q) : (200 - q * 2);
+
+    return std::clamp((base * factor + 50) / 100, 1, 255);
+}
+
+/**
+ * @brief ビッグエンディアンの16bit値を読む
+ */
+static uint16_t read_u16(const uint8_t* p)
+{
+    return static_cast<uint16_t>((p[0] << 8) | p[1]);
+}
+
+RtpJpegPacketizer::RtpJpegPacketizer(uint32_t ssrc, size_t max_payload_size)
+    : ssrc_(ssrc),
+      // 主ヘッダ + リスタートヘッダ + 量子化テーブルを載せてもスキャンデータが入る大きさにする
+      max_payload_size_(std::max<size_t>(max_payload_size,
+                                         RTP_JPEG_HEADER_SIZE + RTP_JPEG_RESTART_HEADER_SIZE
+                                         + RTP_JPEG_QTABLE_HEADER_SIZE + 128 + 64)),
+      sequence_(0),
+      warned_(false)
+{
+}
+
+bool RtpJpegPacketizer::parse(const uint8_t* data, size_t size, JpegInfo& info) const
+{
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    const uint8_t* tables[4] = { nullptr, nullptr, nullptr, nullptr };
+    uint8_t component_tables[3] = { 0, 0, 0 };
+    bool has_frame = false;
+    size_t pos = 2;
+
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+
+        const uint8_t marker = data[pos + 1];
+        if (marker == 0xFF) {
+            pos += 1;   // 詰め物の 0xFF
+            continue;
+        }
+        if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD7)) {
+            pos += 2;   // 長さを持たないマーカ
+            continue;
+        }
+
+        const size_t length = read_u16(data + pos + 2);
+        const uint8_t* segment = data + pos + 4;
+        if (length < 2 || pos + 2 + length > size) {
+            return false;
+        }
+        const size_t segment_size = length - 2;
+
+        switch (marker) {
+        case 0xDB: {    // DQT
+            for (size_t i = 0; i + 65 <= segment_size; i += 65) {
+                const uint8_t precision = segment[i] >> 4;
+                const uint8_t id = segment[i] & 0x0F;
+
+                if (precision != 0 || id > 3) {
+                    return false;   // 16bit テーブルは RTP/JPEG の静的 Type では扱えない
+                }
+                tables[id] = segment + i + 1;
+            }
+            break;
+        }
+        case 0xC0: {    // SOF0 (ベースライン)
+            if (segment_size < 15 || segment[0] != 8 || segment[5] != 3) {
+                return false;
+            }
+
+            info.height = read_u16(segment + 1);
+            info.width = read_u16(segment + 3);
+
+            const uint8_t luma_sampling = segment[7];
+            if (luma_sampling == 0x21) {
+                info.type = 0;
+            } else if (luma_sampling == 0x22) {
+                info.type = 1;
+            } else {
+                return false;
+            }
+            if (segment[10] != 0x11 || segment[13] != 0x11) {
+                return false;
+            }
+
+            component_tables[0] = segment[8];
+            component_tables[1] = segment[11];
+            component_tables[2] = segment[14];
+            has_frame = true;
+            break;
+        }
+        case 0xC1: case 0xC2: case 0xC3: case 0xC5: case 0xC6: case 0xC7:
+        case 0xC9: case 0xCA: case 0xCB: case 0xCD: case 0xCE: case 0xCF:
+            return false;   // ベースライン以外
+        case 0xDD:      // DRI
+            if (segment_size < 2) {
+                return false;
+            }
+            info.restart_interval = read_u16(segment);
+            break;
+        case 0xDA: {    // SOS: この後ろがスキャンデータ
+            info.scan = segment + segment_size;
+
+            const uint8_t* end = data + size;
+            if (size >= 2 && end[-2] == 0xFF && end[-1] == 0xD9) {
+                end -= 2;
+            }
+            if (end <= info.scan || !has_frame) {
+                return false;
+            }
+            info.scan_size = static_cast<size_t>(end - info.scan);
+
+            // 色差2成分は同じテーブルを使うこと (RTP/JPEG はテーブル2枚)
+            if (component_tables[1] != component_tables[2]
+                || component_tables[0] > 3 || component_tables[1] > 3) {
+                return false;
+            }
+            info.tables[0] = tables[component_tables[0]];
+            info.tables[1] = tables[component_tables[1]];
+            if (info.tables[0] == nullptr || info.tables[1] == nullptr) {
+                return false;
+            }
+
+            if (info.restart_interval > 0) {
+                info.type += RTP_JPEG_TYPE_RESTART;
+            }
+
+            return info.width > 0 && info.height > 0
+                && info.width <= RTP_JPEG_MAX_DIMENSION && info.height <= RTP_JPEG_MAX_DIMENSION;
+        }
+        default:
+            break;      // APPn / COM / DHT は送らない
+        }
+
+        pos += 2 + length;
+    }
+
+    return false;
+}
+
+uint8_t RtpJpegPacketizer::find_q(const JpegInfo& info)
+{
+    // 同じ品質なら輝度テーブルの先頭が一致するので、候補を絞ってから全体を比べる
+    for (int q = 1; q <= 99; ++q) {
+        if (info.tables[0][0] != scaled_quant(RFC2435_LUMA_QUANT[0], q)) {
+            continue;
+        }
+
+        bool match = true;
+        for (int k = 0; k < 64 && match; ++k) {
+            const uint8_t natural = ZIGZAG_TO_NATURAL[k];
+
+            match = info.tables[0][k] == scaled_quant(RFC2435_LUMA_QUANT[natural], q)
+                 && info.tables[1][k] == scaled_quant(RFC2435_CHROMA_QUANT[natural], q);
+        }
+
+        if (match) {
+            return static_cast<uint8_t>(q);
+        }
+    }
+
+    return RTP_JPEG_Q_DYNAMIC;
+}
+
+size_t RtpJpegPacketizer::packetize(const uint8_t* data,
+                                    size_t size,
+                                    uint32_t timestamp,
+                                    std::vector<std::vector<uint8_t>>& packets)
+{
+    JpegInfo info;
+
+    if (!parse(data, size, info)) {
+        if (!warned_) {
+            LOG_W("[RtpJpegPacketizer] unsupported JPEG (needs baseline 4:2:2 / 4:2:0, up to %dpx)",
+                  RTP_JPEG_MAX_DIMENSION);
+            warned_ = true;
+        }
+
+        return 0;
+    }
+
+    const uint8_t q = find_q(info);
+    const bool has_restart = info.restart_interval > 0;
+
+    size_t count = 0;
+    size_t offset = 0;
+
+    while (offset < info.scan_size) {
+        const bool with_tables = (offset == 0 && q == RTP_JPEG_Q_DYNAMIC);
+
+        size_t header_size = RTP_JPEG_HEADER_SIZE;
+        if (has_restart) {
+            header_size += RTP_JPEG_RESTART_HEADER_SIZE;
+        }
+        if (with_tables) {
+            header_size += RTP_JPEG_QTABLE_HEADER_SIZE + 128;
+        }
+
+        const size_t chunk_size = std::min(max_payload_size_ - header_size, info.scan_size - offset);
+        const bool last = (offset + chunk_size == info.scan_size);
+
+        if (packets.size() <= count) {
+            packets.resize(count + 1);
+        }
+
+        std::vector<uint8_t>& packet = packets[count];
+        packet.resize(RTP_HEADER_SIZE + header_size + chunk_size);
+
+        write_rtp_header(packet.data(), RTP_PAYLOAD_TYPE_JPEG, last, sequence_++, timestamp, ssrc_);
+
+        uint8_t* p = packet.data() + RTP_HEADER_SIZE;
+
+        // 主ヘッダ: Type-specific, Fragment Offset (24bit), Type, Q, Width/8, Height/8
+        p[0] = 0;
+        p[1] = static_cast<uint8_t>(offset >> 16);
+        p[2] = static_cast<uint8_t>(offset >> 8);
+        p[3] = static_cast<uint8_t>(offset);
+        p[4] = info.type;
+        p[5] = q;
+        p[6] = static_cast<uint8_t>((info.width + 7) / 8);
+        p[7] = static_cast<uint8_t>((info.height + 7) / 8);
+        p += RTP_JPEG_HEADER_SIZE;
+
+        if (has_restart) {
+            // パケット境界はリスタート区間と揃えないので F = L = 1, Count = 0x3FFF
+            p[0] = static_cast<uint8_t>(info.restart_interval >> 8);
+            p[1] = static_cast<uint8_t>(info.restart_interval);
+            p[2] = 0xFF;
+            p[3] = 0xFF;
+            p += RTP_JPEG_RESTART_HEADER_SIZE;
+        }
+
+        if (with_tables) {
+            p[0] = 0;       // MBZ
+            p[1] = 0;       // Precision (2枚とも 8bit)
+            p[2] = 0;
+            p[3] = 128;     // Length
+            std::memcpy(p + RTP_JPEG_QTABLE_HEADER_SIZE, info.tables[0], 64);
+            std::memcpy(p + RTP_JPEG_QTABLE_HEADER_SIZE + 64, info.tables[1], 64);
+            p += RTP_JPEG_QTABLE_HEADER_SIZE + 128;
+        }
+
+        std::memcpy(p, info.scan + offset, chunk_size);
+
+        offset += chunk_size;
+        count += 1;
+    }
+
+    return count;
+}
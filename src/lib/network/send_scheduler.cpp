@@ -0,0 +1,154 @@
+/**
+ * @file    send_scheduler.cpp
+ * @brief   送信待ちフレーム・メタデータの順番を決めるスケジューラの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+
+#include "network/send_scheduler.hpp"
+
+#define MAX_QUEUED_METADATA 256     /**< 送信待ちにできるメタデータのデータグラム数 */
+
+bool SendScheduler::parse_policy(const std::string& name, QueuePolicy& policy)
+{
+    if (name == "latest") {
+        policy = QueuePolicy::LATEST;
+    } else if (name == "fifo") {
+        policy = QueuePolicy::FIFO;
+    } else if (name == "keyframe") {
+        policy = QueuePolicy::KEYFRAME;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+SendScheduler::SendScheduler(QueuePolicy policy, size_t queue_depth)
+    : policy_(policy),
+      queue_depth_((policy == QueuePolicy::LATEST) ? 1 : std::max<size_t>(queue_depth, 1)),
+      frames_(),
+      metadata_(),
+      waiting_for_keyframe_(false),
+      keyframe_requested_(false),
+      dropped_frames_(0),
+      dropped_metadata_(0)
+{
+}
+
+void SendScheduler::push_frame(Frame&& frame, std::vector<std::vector<uint8_t>>& discarded)
+{
+    switch (policy_) {
+    case QueuePolicy::LATEST:
+        // 常に最新のフレームを送るために捨てる
+        for (Frame& queued : frames_) {
+            discard(queued, discarded);
+        }
+        frames_.clear();
+        frames_.push_back(std::move(frame));
+        break;
+
+    case QueuePolicy::FIFO:
+        frames_.push_back(std::move(frame));
+        while (frames_.size() > queue_depth_) {
+            discard(frames_.front(), discarded);
+            frames_.pop_front();
+        }
+        break;
+
+    case QueuePolicy::KEYFRAME:
+        if (frame.keyframe) {
+            // 新しいキーフレームから復号し直せるので、それより前の待ちは要らない
+            for (Frame& queued : frames_) {
+                discard(queued, discarded);
+            }
+            frames_.clear();
+            waiting_for_keyframe_ = false;
+            frames_.push_back(std::move(frame));
+            break;
+        }
+
+        if (waiting_for_keyframe_) {
+            // 参照先を捨てた差分フレームは受信側で復号できない
+            discard(frame, discarded);
+            break;
+        }
+
+        frames_.push_back(std::move(frame));
+
+        if (frames_.size() > queue_depth_) {
+            // 差分を1枚でも捨てると後続も壊れるので、待ちの差分を全て捨ててキーフレームを待つ
+            for (auto it = frames_.begin(); it != frames_.end();) {
+                if (it->keyframe) {
+                    ++it;
+                } else {
+                    discard(*it, discarded);
+                    it = frames_.erase(it);
+                }
+            }
+            waiting_for_keyframe_ = true;
+            keyframe_requested_ = true;
+        }
+        break;
+    }
+}
+
+bool SendScheduler::pop_frame(Frame& frame)
+{
+    if (frames_.empty()) {
+        return false;
+    }
+
+    frame = std::move(frames_.front());
+    frames_.pop_front();
+
+    return true;
+}
+
+void SendScheduler::push_metadata(std::vector<uint8_t>&& datagram)
+{
+    if (metadata_.size() >= MAX_QUEUED_METADATA) {
+        metadata_.pop_front();
+        dropped_metadata_ += 1;
+    }
+
+    metadata_.push_back(std::move(datagram));
+}
+
+size_t SendScheduler::pop_metadata(std::vector<std::vector<uint8_t>>& datagrams)
+{
+    const size_t count = metadata_.size();
+
+    if (datagrams.size() < count) {
+        datagrams.resize(count);
+    }
+
+    for (size_t i = 0; i < count; ++i) {
+        datagrams[i] = std::move(metadata_.front());
+        metadata_.pop_front();
+    }
+
+    return count;
+}
+
+bool SendScheduler::take_keyframe_request()
+{
+    const bool requested = keyframe_requested_;
+    keyframe_requested_ = false;
+
+    return requested;
+}
+
+void SendScheduler::clear()
+{
+    frames_.clear();
+    metadata_.clear();
+}
+
+void SendScheduler::discard(Frame& frame, std::vector<std::vector<uint8_t>>& discarded)
+{
+    dropped_frames_ += 1;
+    discarded.push_back(std::move(frame.data));
+}
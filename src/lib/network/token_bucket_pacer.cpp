@@ -0,0 +1,68 @@
+/**
+ * @file    token_bucket_pacer.cpp
+ * @brief   トークンバケットによる送信レート制御クラスの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <thread>
+
+#include "network/token_bucket_pacer.hpp"
+
+#define SPIN_THRESHOLD_US 100   /**< 残りがこの時間 [us] を切ったら sleep せずスピンで待つ */
+
+TokenBucketPacer::TokenBucketPacer(uint32_t rate_mbps, size_t burst_bytes)
+    : bytes_per_second_(static_cast<double>(rate_mbps) * 1000000.0 / 8.0),
+      burst_bytes_(std::max<size_t>(burst_bytes, 1)),
+      tokens_(static_cast<double>(burst_bytes_)),
+      last_refill_(std::chrono::steady_clock::now())
+{
+}
+
+uint64_t TokenBucketPacer::acquire(size_t bytes)
+{
+    if (!enabled()) {
+        return 0;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - last_refill_).count();
+
+    tokens_ = std::min(tokens_ + elapsed * bytes_per_second_, static_cast<double>(burst_bytes_));
+    last_refill_ = now;
+
+    // バーストを超える送信でも、バケットが満杯なら送ってよい
+    const double needed = std::min(static_cast<double>(bytes), static_cast<double>(burst_bytes_));
+
+    uint64_t waited_us = 0;
+
+    if (tokens_ < needed) {
+        const double wait_seconds = (needed - tokens_) / bytes_per_second_;
+        const auto deadline = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                        std::chrono::duration<double>(wait_seconds));
+
+        wait_until(deadline);
+
+        tokens_ = needed;
+        last_refill_ = deadline;
+        waited_us = static_cast<uint64_t>(wait_seconds * 1000000.0);
+    }
+
+    tokens_ -= static_cast<double>(bytes);
+
+    return waited_us;
+}
+
+void TokenBucketPacer::wait_until(std::chrono::steady_clock::time_point deadline)
+{
+    const auto spin_from = deadline - std::chrono::microseconds(SPIN_THRESHOLD_US);
+
+    if (std::chrono::steady_clock::now() < spin_from) {
+        std::this_thread::sleep_until(spin_from);
+    }
+
+    while (std::chrono::steady_clock::now() < deadline) {
+        // スピン (残り SPIN_THRESHOLD_US 未満)
+    }
+}
@@ -0,0 +1,214 @@
+/**
+ * @file    udp_receiver.cpp
+ * @brief   UDPデータグラムをまとめて受信するクラスの実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <sys/socket.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+#include <cstring>
+#include <cerrno>
+
+#include <algorithm>
+
+#include "network/udp_receiver.hpp"
+#include "logger/logger.hpp"
+
+/** @brief 1メッセージ分の補助データ領域 (SO_RXQ_OVFL の uint32_t) */
+#define RECV_CONTROL_SIZE CMSG_SPACE(sizeof(uint32_t))
+
+UDPReceiver::UDPReceiver(const std::string& bind_ip, uint16_t port, const Config& config)
+    : config_(config),
+      sock_fd_(-1),
+      buffers_(),
+      control_(),
+      iovecs_(),
+      msgs_(),
+      sources_(),
+      receive_calls_(0),
+      kernel_drops_(0),
+      truncated_datagrams_(0)
+{
+    config_.batch_size = std::max<size_t>(config_.batch_size, 1);
+    config_.max_datagram_size = std::max<size_t>(config_.max_datagram_size, 64);
+
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, bind_ip.c_str(), &addr.sin_addr) <= 0) {
+        LOG_E("[UDPReceiver] Invalid bind address: %s", bind_ip.c_str());
+
+        return;
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        LOG_E("[UDPReceiver] Failed to create socket: %s", std::strerror(errno));
+
+        return;
+    }
+
+    // 受信スレッドが遅れた時に取りこぼさないよう、受信バッファを大きくする
+    if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &config_.recv_buffer_bytes, sizeof(config_.recv_buffer_bytes)) < 0) {
+        LOG_W("[UDPReceiver] Failed to set SO_RCVBUF: %s", std::strerror(errno));
+    }
+
+    const int reuse = 1;
+    setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+
+    const int overflow = 1;
+    if (setsockopt(fd, SOL_SOCKET, SO_RXQ_OVFL, &overflow, sizeof(overflow)) < 0) {
+        LOG_W("[UDPReceiver] SO_RXQ_OVFL not supported: %s", std::strerror(errno));
+    }
+
+    // MSG_WAITFORONE は最初の1個だけ待つので、その待ち時間をタイムアウトにする
+    struct timeval timeout;
+    timeout.tv_sec = config_.poll_timeout_ms / 1000;
+    timeout.tv_usec = (config_.poll_timeout_ms % 1000) * 1000;
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+    if (bind(fd, reinterpret_cast<struct sockaddr*>(&addr), sizeof(addr)) < 0) {
+        LOG_E("[UDPReceiver] Failed to bind %s:%d: %s", bind_ip.c_str(), port, std::strerror(errno));
+        close(fd);
+
+        return;
+    }
+
+    sock_fd_ = fd;
+
+    if (!config_.multicast_group.empty() && !join_multicast()) {
+        close(sock_fd_);
+        sock_fd_ = -1;
+
+        return;
+    }
+
+    const size_t batch = config_.batch_size;
+
+    buffers_.resize(batch * config_.max_datagram_size);
+    control_.resize(batch * RECV_CONTROL_SIZE);
+    iovecs_.resize(batch);
+    msgs_.resize(batch);
+    sources_.resize(batch);
+
+    for (size_t i = 0; i < batch; ++i) {
+        iovecs_[i].iov_base = buffers_.data() + i * config_.max_datagram_size;
+        iovecs_[i].iov_len = config_.max_datagram_size;
+
+        std::memset(&msgs_[i], 0, sizeof(msgs_[i]));
+        msgs_[i].msg_hdr.msg_iov = &iovecs_[i];
+        msgs_[i].msg_hdr.msg_iovlen = 1;
+        msgs_[i].msg_hdr.msg_name = &sources_[i];
+    }
+
+    LOG_I("[UDPReceiver] Listening on %s:%d (batch %zu)", bind_ip.c_str(), port, batch);
+}
+
+UDPReceiver::~UDPReceiver()
+{
+    if (sock_fd_ >= 0) {
+        close(sock_fd_);
+    }
+}
+
+bool UDPReceiver::join_multicast()
+{
+    struct ip_mreq mreq;
+    std::memset(&mreq, 0, sizeof(mreq));
+
+    if (inet_pton(AF_INET, config_.multicast_group.c_str(), &mreq.imr_multiaddr) <= 0) {
+        LOG_E("[UDPReceiver] Invalid multicast group: %s", config_.multicast_group.c_str());
+
+        return false;
+    }
+
+    mreq.imr_interface.s_addr = htonl(INADDR_ANY);
+    if (!config_.multicast_interface.empty()
+        && inet_pton(AF_INET, config_.multicast_interface.c_str(), &mreq.imr_interface) <= 0) {
+        LOG_E("[UDPReceiver] Invalid multicast interface: %s", config_.multicast_interface.c_str());
+
+        return false;
+    }
+
+    if (setsockopt(sock_fd_, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq, sizeof(mreq)) < 0) {
+        LOG_E("[UDPReceiver] Failed to join %s: %s", config_.multicast_group.c_str(), std::strerror(errno));
+
+        return false;
+    }
+
+    LOG_I("[UDPReceiver] Joined multicast group %s", config_.multicast_group.c_str());
+
+    return true;
+}
+
+int UDPReceiver::receive()
+{
+    if (sock_fd_ < 0) {
+        return -1;
+    }
+
+    // カーネルが書き換える長さを毎回戻す
+    for (size_t i = 0; i < msgs_.size(); ++i) {
+        msgs_[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+        msgs_[i].msg_hdr.msg_control = control_.data() + i * RECV_CONTROL_SIZE;
+        msgs_[i].msg_hdr.msg_controllen = RECV_CONTROL_SIZE;
+        msgs_[i].msg_hdr.msg_flags = 0;
+    }
+
+    const int received = recvmmsg(sock_fd_, msgs_.data(), static_cast<unsigned int>(msgs_.size()),
+                                  MSG_WAITFORONE, nullptr);
+    if (received < 0) {
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+            return 0;
+        }
+
+        LOG_E("[UDPReceiver] recvmmsg failed: %s", std::strerror(errno));
+
+        return -1;
+    }
+
+    receive_calls_ += 1;
+
+    // 送信側のペイロード長が受信バッファより大きいと、全て切り詰められて何も組み立てられない
+    for (int i = 0; i < received; ++i) {
+        if (msgs_[i].msg_hdr.msg_flags & MSG_TRUNC) {
+            if (truncated_datagrams_ == 0) {
+                LOG_W("[UDPReceiver] Datagram longer than %zu bytes was truncated (raise max_datagram_size)",
+                      config_.max_datagram_size);
+            }
+            truncated_datagrams_ += 1;
+        }
+    }
+
+    // SO_RXQ_OVFL は累計値なので、最後のメッセージのものだけ見ればよい
+    if (received > 0) {
+        struct msghdr* hdr = &msgs_[received - 1].msg_hdr;
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(hdr); cmsg != nullptr; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SO_RXQ_OVFL) {
+                std::memcpy(&kernel_drops_, CMSG_DATA(cmsg), sizeof(kernel_drops_));
+            }
+        }
+    }
+
+    return received;
+}
+
+bool UDPReceiver::send_to(const uint8_t* data, size_t length, const struct sockaddr_in& dest)
+{
+    if (sock_fd_ < 0) {
+        return false;
+    }
+
+    if (sendto(sock_fd_, data, length, 0, reinterpret_cast<const struct sockaddr*>(&dest), sizeof(dest)) < 0) {
+        LOG_W("[UDPReceiver] sendto failed: %s", std::strerror(errno));
+
+        return false;
+    }
+
+    return true;
+}
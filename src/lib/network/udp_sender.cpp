@@ -8,24 +8,73 @@
 #include <sys/socket.h>
 #include <arpa/inet.h>
 #include <unistd.h>
+#include <poll.h>
+#include <netinet/udp.h>
+#include <net/if.h>
+#include <linux/errqueue.h>
 #include <cstring>
 #include <cerrno>
 
 #include <sys/uio.h>
 #include <algorithm>
-#include <thread>
-#include <chrono>
 
 #include "network/udp_sender.hpp"
+#include "network/qdisc_probe.hpp"
 #include "logger/logger.hpp"
 
+#define MAX_RETRIES 5           /**< 送信バッファ溢れ時の再試行回数 */
+#define RETRY_WAIT_MS 1         /**< 再試行前に送信可能になるのを待つ最大時間 [ms] */
+#define GSO_MAX_SEGMENTS 64     /**< GSO 1メッセージあたりの最大データグラム数 (カーネルの UDP_MAX_SEGMENTS) */
+#define GSO_MAX_BYTES 65000     /**< GSO 1メッセージあたりの最大バイト数 (IPv4 UDP の上限 65507 未満) */
+#define ZEROCOPY_COPIED_LIMIT 64 /**< 連続でコピーにフォールバックしたらゼロコピーをやめる回数 */
+#define ZEROCOPY_MAX_FRAGS 17   /**< ゼロコピー送信1メッセージが参照できるページ断片数 (カーネルの MAX_SKB_FRAGS) */
+#define PAGE_BYTES 4096         /**< ページサイズ (断片数の見積もり用) */
+
+/**
+ * @brief iovec 1個がカーネル内で何個のページ断片になるかを見積もる
+ */
+static size_t count_page_frags(const void* base, size_t length)
+{
+    const uintptr_t begin = reinterpret_cast<uintptr_t>(base);
+    const uintptr_t end = begin + length - 1;
+
+    return (length == 0) ? 0 : (end / PAGE_BYTES) - (begin / PAGE_BYTES) + 1;
+}
+
 UDPSender::UDPSender(const std::string& ip, uint16_t port)
-    : sock_fd_(-1), is_valid_(false)
+    : UDPSender(ip, port, Config())
+{
+}
+
+UDPSender::UDPSender(const std::string& ip, uint16_t port, const Config& config)
+    : sock_fd_(-1),
+      destinations_(),
+      has_multicast_(false),
+      is_valid_(false),
+      config_(config),
+      send_mode_(config.send_mode),
+      uring_(),
+      pacer_(config.max_rate_mbps, config.burst_bytes),
+      kernel_pacing_(false),
+      zerocopy_enabled_(false),
+      zerocopy_next_id_(0),
+      zerocopy_completed_id_(0),
+      zerocopy_copied_streak_(0),
+      dropped_packets_(0),
+      syscall_count_(0),
+      sent_packets_(0),
+      parity_packets_(0),
+      retransmitted_packets_(0),
+      nack_buffer_(FRAME_NACK_HEADER_SIZE + 2 * FRAME_NACK_MAX_CHUNKS)
 {
+    // sendmmsg の vlen 上限 (UIO_MAXIOV) を超えないようにする
+    config_.batch_size = std::clamp<size_t>(config_.batch_size, 1, 1024);
+    config_.max_payload_size = std::clamp<size_t>(config_.max_payload_size, 64, 65000);
+
     sock_fd_ = socket(AF_INET, SOCK_DGRAM, 0);
     if (sock_fd_ < 0) {
         LOG_E("Failed to create UDP socket: %s", std::strerror(errno));
-        
+
         return;
     }
 
@@ -33,22 +82,148 @@ UDPSender::UDPSender(const std::string& ip, uint16_t port)
 
     setsockopt(sock_fd_, SOL_SOCKET, SO_SNDBUF, &sendbuf_size, sizeof(sendbuf_size));
 
-    std::memset(&addr_, 0, sizeof(addr_));
-    addr_.sin_family = AF_INET;
-    addr_.sin_port = htons(port);
-
-    if (inet_pton(AF_INET, ip.c_str(), &addr_.sin_addr) <= 0) {
-        LOG_E("Invalid IP address: %s", ip.c_str());
-
+    if (!add_destination(ip, port)) {
         close(sock_fd_);
         sock_fd_ = -1;
 
         return;
     }
 
+    for (const std::string& extra : config_.extra_destinations) {
+        if (!add_destination(extra, port)) {
+            close(sock_fd_);
+            sock_fd_ = -1;
+
+            return;
+        }
+    }
+
+    if (has_multicast_) {
+        setup_multicast();
+    }
+
+    if (send_mode_ == SendMode::GSO) {
+        // UDP_SEGMENT を知らないカーネル (4.18 未満) では getsockopt が失敗する
+        int gso_size = 0;
+        socklen_t length = sizeof(gso_size);
+
+        if (getsockopt(sock_fd_, SOL_UDP, UDP_SEGMENT, &gso_size, &length) < 0) {
+            LOG_W("UDP GSO is not supported (%s), falling back to sendmmsg", std::strerror(errno));
+
+            send_mode_ = SendMode::SENDMMSG;
+        }
+    }
+
+    if (send_mode_ == SendMode::IO_URING) {
+        uring_ = std::make_unique<IoUringQueue>(static_cast<unsigned>(config_.batch_size));
+
+        if (!uring_->is_valid()) {
+            LOG_W("io_uring is not available, falling back to sendmmsg");
+
+            uring_.reset();
+            send_mode_ = SendMode::SENDMMSG;
+        }
+    }
+
+    if (config_.zerocopy) {
+        // UDP の MSG_ZEROCOPY は Linux 5.0 以降
+        int enable = 1;
+
+        if (setsockopt(sock_fd_, SOL_SOCKET, SO_ZEROCOPY, &enable, sizeof(enable)) < 0) {
+            LOG_W("MSG_ZEROCOPY is not supported (%s), using copying sends", std::strerror(errno));
+        } else {
+            zerocopy_enabled_ = true;
+        }
+    }
+
+    if (config_.max_rate_mbps > 0 && config_.kernel_pacing) {
+        kernel_pacing_ = enable_kernel_pacing();
+    }
+
     is_valid_ = true;
-    
-    LOG_I("UDPSender initialized. Target: %s:%d", ip.c_str(), port);
+
+    LOG_I("UDPSender initialized. Target: %s:%d%s (mode %s, batch %zu, rate limit %u Mbps (%s pacing, burst %zu bytes), zerocopy %s)",
+          ip.c_str(), port,
+          (destinations_.size() > 1) ? (" +" + std::to_string(destinations_.size() - 1) + " more").c_str() : "",
+          (send_mode_ == SendMode::GSO) ? "gso" : (send_mode_ == SendMode::SENDMMSG) ? "sendmmsg"
+          : (send_mode_ == SendMode::IO_URING) ? "io_uring" : "sendmsg",
+          config_.batch_size, config_.max_rate_mbps,
+          kernel_pacing_ ? "kernel" : pacer_.enabled() ? "userspace" : "no",
+          pacer_.burst_bytes(), zerocopy_enabled_ ? "on" : "off");
+}
+
+bool UDPSender::add_destination(const std::string& ip, uint16_t port)
+{
+    struct sockaddr_in addr;
+    std::memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+
+    if (inet_pton(AF_INET, ip.c_str(), &addr.sin_addr) <= 0) {
+        LOG_E("Invalid IP address: %s", ip.c_str());
+
+        return false;
+    }
+
+    if (IN_MULTICAST(ntohl(addr.sin_addr.s_addr))) {
+        has_multicast_ = true;
+    }
+
+    destinations_.push_back(addr);
+
+    return true;
+}
+
+void UDPSender::setup_multicast()
+{
+    const int ttl = std::clamp(config_.multicast_ttl, 0, 255);
+    if (setsockopt(sock_fd_, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl)) < 0) {
+        LOG_W("Failed to set multicast TTL: %s", std::strerror(errno));
+    }
+
+    const int loopback = config_.multicast_loopback ? 1 : 0;
+    if (setsockopt(sock_fd_, IPPROTO_IP, IP_MULTICAST_LOOP, &loopback, sizeof(loopback)) < 0) {
+        LOG_W("Failed to set multicast loopback: %s", std::strerror(errno));
+    }
+
+    if (config_.multicast_interface.empty()) {
+        return;
+    }
+
+    // インターフェース名 (eth0 等) とそのインターフェースのIPのどちらでも指定できる
+    struct ip_mreqn request;
+    std::memset(&request, 0, sizeof(request));
+
+    if (inet_pton(AF_INET, config_.multicast_interface.c_str(), &request.imr_address) <= 0) {
+        request.imr_ifindex = static_cast<int>(if_nametoindex(config_.multicast_interface.c_str()));
+
+        if (request.imr_ifindex == 0) {
+            LOG_W("Unknown multicast interface: %s", config_.multicast_interface.c_str());
+
+            return;
+        }
+    }
+
+    if (setsockopt(sock_fd_, IPPROTO_IP, IP_MULTICAST_IF, &request, sizeof(request)) < 0) {
+        LOG_W("Failed to set multicast interface %s: %s", config_.multicast_interface.c_str(), std::strerror(errno));
+    }
+}
+
+bool UDPSender::parse_send_mode(const std::string& name, SendMode& mode)
+{
+    if (name == "gso") {
+        mode = SendMode::GSO;
+    } else if (name == "sendmmsg") {
+        mode = SendMode::SENDMMSG;
+    } else if (name == "sendmsg") {
+        mode = SendMode::SENDMSG;
+    } else if (name == "io_uring") {
+        mode = SendMode::IO_URING;
+    } else {
+        return false;
+    }
+
+    return true;
 }
 
 UDPSender::~UDPSender()
@@ -60,7 +235,84 @@ UDPSender::~UDPSender()
     }
 }
 
-bool UDPSender::send(const void* data, size_t size)
+bool UDPSender::send(const void* data, size_t size, uint32_t frame_id, uint64_t timestamp_us)
+{
+    return send_chunks(data, size, frame_id, timestamp_us, 0, SIZE_MAX);
+}
+
+bool UDPSender::send_chunks(const void* data,
+                            size_t size,
+                            uint32_t frame_id,
+                            uint64_t timestamp_us,
+                            size_t first_chunk,
+                            size_t count)
+{
+    if (!is_valid_ || sock_fd_ < 0) {
+        LOG_E("Socket is not valid");
+
+        return false;
+    }
+
+    const size_t chunk_count = (size + config_.max_payload_size - 1) / config_.max_payload_size;
+    if (size == 0 || chunk_count > UINT16_MAX || size > UINT32_MAX) {
+        LOG_E("Invalid frame size for chunked send: %zu bytes", size);
+
+        return false;
+    }
+
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+
+    packets_.clear();
+    headers_.clear();
+
+    FramePacketHeader header;
+    header.stream_id = config_.stream_id;
+    header.chunk_count = static_cast<uint16_t>(chunk_count);
+    header.frame_id = frame_id;
+    header.total_size = static_cast<uint32_t>(size);
+    header.timestamp_us = timestamp_us;
+
+    const size_t end_chunk = first_chunk + std::min(count, chunk_count - std::min(first_chunk, chunk_count));
+    for (size_t index = first_chunk; index < end_chunk; ++index) {
+        add_chunk_packet(ptr, size, header, index);
+    }
+
+    // パリティはフレーム全体から作るので、最終チャンクを送る時に付ける
+    if (config_.fec_group_size > 0 && chunk_count > 1 && end_chunk == chunk_count) {
+        add_parity_packets(ptr, size, header);
+    }
+
+    if (packets_.empty()) {
+        return true;
+    }
+
+    if (!zerocopy_enabled_) {
+        return flush_packets(false);
+    }
+
+    const bool result = flush_packets(true);
+
+    // ヘッダ領域もカーネルが参照しているので、送信完了まで取っておく
+    zerocopy_headers_.emplace_back(zerocopy_next_id_, std::move(headers_));
+
+    if (!spare_headers_.empty()) {
+        headers_ = std::move(spare_headers_.back());
+        spare_headers_.pop_back();
+    } else {
+        headers_ = std::vector<uint8_t>();
+    }
+
+    reap_zerocopy_completions(0);
+
+    return result;
+}
+
+bool UDPSender::resend_chunks(const void* data,
+                              size_t size,
+                              uint32_t frame_id,
+                              uint64_t timestamp_us,
+                              const std::vector<uint16_t>& chunks,
+                              const struct sockaddr_in& requester)
 {
     if (!is_valid_ || sock_fd_ < 0) {
         LOG_E("Socket is not valid");
@@ -68,70 +320,524 @@ bool UDPSender::send(const void* data, size_t size)
         return false;
     }
 
+    const size_t chunk_count = (size + config_.max_payload_size - 1) / config_.max_payload_size;
+    if (size == 0 || chunk_count > UINT16_MAX || size > UINT32_MAX) {
+        return false;
+    }
+
     const uint8_t* ptr = static_cast<const uint8_t*>(data);
-    size_t offset = 0;
 
-    const size_t MAX_CHUNK_SIZE = 1400;
+    packets_.clear();
+    headers_.clear();
+
+    FramePacketHeader header;
+    header.stream_id = config_.stream_id;
+    header.chunk_count = static_cast<uint16_t>(chunk_count);
+    header.frame_id = frame_id;
+    header.total_size = static_cast<uint32_t>(size);
+    header.timestamp_us = timestamp_us;
+
+    for (uint16_t index : chunks) {
+        if (index < chunk_count) {
+            add_chunk_packet(ptr, size, header, index);
+        }
+    }
+
+    if (packets_.empty()) {
+        return true;
+    }
+
+    retransmitted_packets_ += packets_.size();
+
+    // 再送はまれなのでゼロコピーにはしない。欠けたのは要求元だけなので他の送信先には送らない
+    return flush_packets(false, &requester);
+}
+
+bool UDPSender::receive_nack(FrameNack& nack, struct sockaddr_in& requester)
+{
+    if (!is_valid_ || sock_fd_ < 0) {
+        return false;
+    }
+
+    while (true) {
+        struct sockaddr_in from;
+        socklen_t from_length = sizeof(from);
+
+        const ssize_t length = recvfrom(sock_fd_, nack_buffer_.data(), nack_buffer_.size(), MSG_DONTWAIT,
+                                        reinterpret_cast<struct sockaddr*>(&from), &from_length);
+        if (length < 0) {
+            return false;
+        }
+
+        if (from.sin_family != AF_INET) {
+            continue;
+        }
+
+        // ユニキャストの送信先以外からのパケットは受け付けない
+        const auto destination = std::find_if(destinations_.begin(), destinations_.end(),
+            [&from](const struct sockaddr_in& addr) { return addr.sin_addr.s_addr == from.sin_addr.s_addr; });
+
+        if (destination == destinations_.end() && !has_multicast_) {
+            continue;
+        }
+
+        if (read_frame_nack(nack_buffer_.data(), static_cast<size_t>(length), nack)
+            && nack.stream_id == config_.stream_id) {
+            // 受信側はフレームを受けるポートで待っているので、ポートは送信先のものにする
+            requester = from;
+            requester.sin_port = destinations_.front().sin_port;
+
+            return true;
+        }
+    }
+}
+
+bool UDPSender::send_packets(const std::vector<std::vector<uint8_t>>& packets, size_t count)
+{
+    if (!is_valid_ || sock_fd_ < 0) {
+        LOG_E("Socket is not valid");
+
+        return false;
+    }
+
+    packets_.clear();
+    headers_.clear();
+
+    count = std::min(count, packets.size());
+    for (size_t i = 0; i < count; ++i) {
+        add_packet(nullptr, 0, packets[i].data(), packets[i].size());
+    }
+
+    // packets は呼び出し側で毎回再利用されるのでゼロコピーにはしない
+    return flush_packets(false);
+}
+
+void UDPSender::add_packet(const void* header, size_t header_length, const void* payload, size_t payload_length)
+{
+    Packet packet;
+    packet.header_offset = headers_.size();
+    packet.header_length = header_length;
+    packet.payload = static_cast<const uint8_t*>(payload);
+    packet.payload_length = payload_length;
+
+    if (header_length > 0) {
+        const uint8_t* h = static_cast<const uint8_t*>(header);
+        headers_.insert(headers_.end(), h, h + header_length);
+    }
+
+    packets_.push_back(packet);
+}
+
+void UDPSender::add_chunk_packet(const uint8_t* data, size_t size, FramePacketHeader& header, size_t index)
+{
+    const size_t offset = index * config_.max_payload_size;
+    const size_t chunk_size = std::min(config_.max_payload_size, size - offset);
+
+    header.chunk_index = static_cast<uint16_t>(index);
+    header.flags = (index + 1 == header.chunk_count) ? FRAME_PACKET_FLAG_LAST : 0;
+
+    uint8_t header_bytes[FRAME_PACKET_HEADER_SIZE];
+    write_frame_packet_header(header_bytes, header);
+
+    add_packet(header_bytes, FRAME_PACKET_HEADER_SIZE, data + offset, chunk_size);
+}
+
+void UDPSender::add_parity_packets(const uint8_t* data, size_t size, const FramePacketHeader& header)
+{
+    const size_t chunk_size = config_.max_payload_size;
+    const size_t chunk_count = header.chunk_count;
+    const size_t group_count = (chunk_count + config_.fec_group_size - 1) / config_.fec_group_size;
+    const size_t packet_size = FRAME_PACKET_HEADER_SIZE + chunk_size;
+
+    // パリティはヘッダ領域に置く（ゼロコピー送信時もフレーム送信完了まで保持される）
+    const size_t base = headers_.size();
+    headers_.resize(base + group_count * packet_size, 0);
+
+    FramePacketHeader parity_header = header;
+    parity_header.flags = FRAME_PACKET_FLAG_PARITY;
+    parity_header.parity_groups = static_cast<uint16_t>(group_count);
+
+    for (size_t group = 0; group < group_count; ++group) {
+        uint8_t* packet = headers_.data() + base + group * packet_size;
+        uint8_t* parity = packet + FRAME_PACKET_HEADER_SIZE;
+
+        parity_header.chunk_index = static_cast<uint16_t>(group);
+        write_frame_packet_header(packet, parity_header);
+
+        // チャンク group, group + n, group + 2n, ... を XOR する (足りない分は0詰め扱い)
+        for (size_t index = group; index < chunk_count; index += group_count) {
+            const uint8_t* chunk = data + index * chunk_size;
+            const size_t length = std::min(chunk_size, size - index * chunk_size);
+
+            for (size_t i = 0; i < length; ++i) {
+                parity[i] ^= chunk[i];
+            }
+        }
+
+        Packet parity_packet;
+        parity_packet.header_offset = base + group * packet_size;
+        parity_packet.header_length = packet_size;
+        parity_packet.payload = nullptr;
+        parity_packet.payload_length = 0;
+        packets_.push_back(parity_packet);
+    }
+
+    parity_packets_ += group_count;
+}
+
+void UDPSender::build_messages(size_t first_packet, bool zerocopy, const struct sockaddr_in* only)
+{
+    const size_t count = packets_.size();
+    const bool use_gso = (send_mode_ == SendMode::GSO);
+    const struct sockaddr_in* targets = only ? only : destinations_.data();
+    const size_t target_count = only ? 1 : destinations_.size();
+
+    // headers_ の再確保が終わってからポインタを確定させる
+    iovecs_.resize(count * 2);
+    msgs_.clear();
+    messages_.clear();
+    controls_.resize(count);
+
+    size_t iov_index = 0;
+    size_t control_index = 0;
+    size_t i = first_packet;
+
+    while (i < count) {
+        Message message;
+        message.first_packet = i;
+        message.packet_count = 0;
+        message.bytes = 0;
+
+        // ゼロコピーではユーザメモリのページを直接 skb に繋ぐため、断片数に上限がある
+        size_t frags = 0;
+
+        // GSO: 先頭と同じ長さのデータグラムを続け、最後の1個だけ短くてよい
+        const size_t segment_size = packets_[i].header_length + packets_[i].payload_length;
+        struct iovec* iov = &iovecs_[iov_index];
+
+        while (i < count) {
+            const Packet& packet = packets_[i];
+            const size_t packet_bytes = packet.header_length + packet.payload_length;
+
+            if (message.packet_count > 0) {
+                if (!use_gso || packet_bytes > segment_size) {
+                    break;
+                }
+                if (message.packet_count >= GSO_MAX_SEGMENTS || message.bytes + packet_bytes > GSO_MAX_BYTES) {
+                    break;
+                }
+            }
 
-    int packet_count = 0;
+            if (zerocopy) {
+                const size_t packet_frags =
+                    count_page_frags(headers_.data() + packet.header_offset, packet.header_length)
+                    + count_page_frags(packet.payload, packet.payload_length);
 
-    while (offset < size) {
-        size_t chunk_size = std::min(MAX_CHUNK_SIZE, size - offset);
+                if (message.packet_count > 0 && frags + packet_frags > ZEROCOPY_MAX_FRAGS) {
+                    break;
+                }
+                frags += packet_frags;
+            }
 
-        uint8_t flag = (offset + chunk_size == size) ? 1 : 0;
+            if (packet.header_length > 0) {
+                iovecs_[iov_index].iov_base = headers_.data() + packet.header_offset;
+                iovecs_[iov_index].iov_len = packet.header_length;
+                iov_index += 1;
+            }
 
-        struct iovec iov[2];
+            if (packet.payload_length > 0) {
+                iovecs_[iov_index].iov_base = const_cast<uint8_t*>(packet.payload);
+                iovecs_[iov_index].iov_len = packet.payload_length;
+                iov_index += 1;
+            }
 
-        iov[0].iov_base = &flag;
-        iov[0].iov_len = 1;
+            message.packet_count += 1;
+            message.bytes += packet_bytes;
+            i += 1;
 
-        iov[1].iov_base = const_cast<uint8_t*>(ptr + offset);
-        iov[1].iov_len = chunk_size;
+            if (packet_bytes < segment_size) {
+                break;
+            }
+        }
 
         // メッセージヘッダの作成
-        struct msghdr msg;
-        std::memset(&msg, 0, sizeof(msg));
-        msg.msg_name = &addr_;             // 送信先アドレス
-        msg.msg_namelen = sizeof(addr_);
+        struct mmsghdr mmsg;
+        std::memset(&mmsg, 0, sizeof(mmsg));
+        struct msghdr& msg = mmsg.msg_hdr;
+        msg.msg_namelen = sizeof(struct sockaddr_in);
         msg.msg_iov = iov;                 // データの配列
-        msg.msg_iovlen = 2;                // 配列の長さ (ヘッダー + 本体)
+        msg.msg_iovlen = (iovecs_.data() + iov_index) - iov;
+
+        if (message.packet_count > 1) {
+            // カーネルに segment_size 毎の分割を指示する
+            GsoControl& control = controls_[control_index++];
+            std::memset(&control, 0, sizeof(control));
+            msg.msg_control = control.buffer;
+            msg.msg_controllen = sizeof(control.buffer);
+
+            struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+            cmsg->cmsg_level = SOL_UDP;
+            cmsg->cmsg_type = UDP_SEGMENT;
+            cmsg->cmsg_len = CMSG_LEN(sizeof(uint16_t));
+
+            const uint16_t gso_size = static_cast<uint16_t>(segment_size);
+            std::memcpy(CMSG_DATA(cmsg), &gso_size, sizeof(gso_size));
+        }
 
-        ssize_t send_bytes;
-        int retry_count = 0;
-        const int MAX_RETRIES = 5;
+        // 同じデータ (iovec・制御メッセージ) を送信先毎に並べ、1回の sendmmsg で全員に送る
+        for (size_t target = 0; target < target_count; ++target) {
+            mmsg.msg_hdr.msg_name = const_cast<struct sockaddr_in*>(&targets[target]);
 
-        do {
-            send_bytes = sendmsg(sock_fd_, &msg, 0); //送信実行 カーネル側
+            msgs_.push_back(mmsg);
+            messages_.push_back(message);
+        }
+    }
+}
 
-            if (send_bytes >= 0) {
+bool UDPSender::flush_packets(bool zerocopy, const struct sockaddr_in* only)
+{
+    build_messages(0, zerocopy, only);
+
+    int flags = zerocopy ? MSG_ZEROCOPY : 0;
+
+    size_t sent = 0;
+    int retry_count = 0;
+
+    while (sent < msgs_.size()) {
+        // SENDMSG は1メッセージずつ。ユーザ空間でペーシングする時は1回の送信量をバースト量までに抑える
+        const size_t batch_limit = (send_mode_ == SendMode::SENDMSG) ? 1 : config_.batch_size;
+        const bool userspace_pacing = pacer_.enabled() && !kernel_pacing_;
+
+        size_t batch = 0;
+        size_t batch_bytes = 0;
+        while (sent + batch < msgs_.size() && batch < batch_limit) {
+            if (batch > 0 && userspace_pacing && batch_bytes + messages_[sent + batch].bytes > pacer_.burst_bytes()) {
                 break;
             }
+            batch_bytes += messages_[sent + batch].bytes;
+            batch += 1;
+        }
 
-            if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS) {
-                retry_count += 1;
+        if (userspace_pacing) {
+            pacer_.acquire(batch_bytes);
+        }
 
-                if (retry_count >= MAX_RETRIES) {
-                    LOG_E("UDP send buffer full, dropped packet.");
+        int ret;
+        if (batch == 1) {
+            ret = (sendmsg(sock_fd_, &msgs_[sent].msg_hdr, flags) < 0) ? -1 : 1;
+        } else if (send_mode_ == SendMode::IO_URING) {
+            ret = uring_->send_messages(sock_fd_, &msgs_[sent], static_cast<unsigned>(batch), flags);
+        } else {
+            ret = sendmmsg(sock_fd_, &msgs_[sent], batch, flags); //送信実行 カーネル側
+        }
+        syscall_count_ += 1;
 
-                    return false;   // ここで終わるとGUI側で線が入ったりする
-                }
+        if (ret > 0) {
+            if (zerocopy) {
+                // 成功した送信1回 (メッセージ1個) 毎にカーネルがIDを1つ割り当てる
+                zerocopy_next_id_ += ret;
+            }
+
+            for (int k = 0; k < ret; ++k) {
+                sent_packets_ += messages_[sent + k].packet_count;
+            }
+            sent += ret;
+            retry_count = 0;
+
+            continue;
+        }
+
+        if (ret < 0 && errno == EINTR) {
+            continue;
+        }
+
+        if (ret < 0 && send_mode_ == SendMode::GSO && messages_[sent].packet_count > 1
+            && (errno == EIO || errno == EINVAL || errno == EOPNOTSUPP || errno == ENOPROTOOPT)) {
+            // NIC がチェックサムオフロード非対応、MTU超過など。以降は sendmmsg で送る
+            LOG_W("UDP GSO send failed (%s), falling back to sendmmsg", std::strerror(errno));
 
-                std::this_thread::sleep_for(std::chrono::microseconds(500));
-            } else {
-                LOG_E("UDP sendmsg fatal error : %s", std::strerror(errno));
+            send_mode_ = SendMode::SENDMMSG;
+            // 送信先が複数なら、既に送れた送信先にはこのメッセージが重複して届く（受信側で捨てる）
+            build_messages(messages_[sent].first_packet, zerocopy, only);
+            sent = 0;
 
-                return false;
+            continue;
+        }
+
+        if (ret < 0 && zerocopy && errno == EMSGSIZE) {
+            // ページ断片数の上限がカーネル設定と異なる等。以降はコピー送信する
+            LOG_W("MSG_ZEROCOPY send failed (%s), using copying sends", std::strerror(errno));
+
+            zerocopy = false;
+            zerocopy_enabled_ = false;
+            flags = 0;
+            build_messages(messages_[sent].first_packet, false, only);
+            sent = 0;
+
+            continue;
+        }
+
+        if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == ENOBUFS)) {
+            retry_count += 1;
+
+            if (zerocopy) {
+                // 完了通知が溜まると optmem 不足で ENOBUFS になる
+                reap_zerocopy_completions(0);
+            }
+
+            if (retry_count < MAX_RETRIES) {
+                // 固定時間のスリープではなく、送信バッファが空くまで待つ
+                struct pollfd pfd{};
+                pfd.fd = sock_fd_;
+                pfd.events = POLLOUT;
+                poll(&pfd, 1, RETRY_WAIT_MS);
+
+                continue;
+            }
+
+            LOG_E("UDP send buffer full, dropped packet.");
+        } else if (ret < 0 && only == nullptr && destinations_.size() > 1
+                   && (errno == EHOSTUNREACH || errno == ENETUNREACH || errno == ECONNREFUSED || errno == EPERM)) {
+            // 1つの送信先に届かなくても、他の送信先には送り続ける
+            LOG_W("UDP send to %s failed : %s",
+                  inet_ntoa(static_cast<const struct sockaddr_in*>(msgs_[sent].msg_hdr.msg_name)->sin_addr),
+                  std::strerror(errno));
+
+            dropped_packets_ += messages_[sent].packet_count;
+            sent += 1;
+
+            continue;
+        } else {
+            LOG_E("UDP send fatal error : %s", std::strerror(errno));
+        }
+
+        for (size_t k = sent; k < messages_.size(); ++k) {
+            dropped_packets_ += messages_[k].packet_count;
+        }
+
+        return false;   // ここで終わるとGUI側で線が入ったりする
+    }
+
+    return true;
+}
+
+bool UDPSender::is_zerocopy_completed(uint32_t boundary) const
+{
+    // IDは32bitで一周するので差分で比較する
+    return static_cast<int32_t>(boundary - zerocopy_completed_id_) <= 0;
+}
+
+void UDPSender::reap_zerocopy_completions(int timeout_ms)
+{
+    if (sock_fd_ < 0 || zerocopy_completed_id_ == zerocopy_next_id_) {
+        return;
+    }
+
+    if (timeout_ms > 0) {
+        // エラーキューに通知が入ると POLLERR になる
+        struct pollfd pfd{};
+        pfd.fd = sock_fd_;
+        pfd.events = 0;
+        poll(&pfd, 1, timeout_ms);
+    }
+
+    while (true) {
+        char control[CMSG_SPACE(sizeof(struct sock_extended_err) + sizeof(struct sockaddr_in))];
+        struct msghdr msg;
+        std::memset(&msg, 0, sizeof(msg));
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+
+        if (recvmsg(sock_fd_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+            break;
+        }
+
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level != SOL_IP || cmsg->cmsg_type != IP_RECVERR) {
+                continue;
             }
-        } while (retry_count <= MAX_RETRIES);
 
-        offset += chunk_size;
+            struct sock_extended_err serr;
+            std::memcpy(&serr, CMSG_DATA(cmsg), sizeof(serr));
 
-        packet_count += 1;
+            if (serr.ee_origin != SO_EE_ORIGIN_ZEROCOPY || serr.ee_errno != 0) {
+                continue;
+            }
+
+            // ee_info..ee_data の範囲の送信が完了した
+            complete_zerocopy(serr.ee_info, serr.ee_data, (serr.ee_code & SO_EE_CODE_ZEROCOPY_COPIED) != 0);
+        }
+    }
+
+    // 完了したフレームのヘッダ領域を再利用に回す
+    while (!zerocopy_headers_.empty() && is_zerocopy_completed(zerocopy_headers_.front().first)) {
+        std::vector<uint8_t> headers = std::move(zerocopy_headers_.front().second);
+        zerocopy_headers_.pop_front();
+
+        headers.clear();
+        spare_headers_.push_back(std::move(headers));
+    }
+}
 
-        if (packet_count % 10 == 0) {
-            std::this_thread::sleep_for(std::chrono::microseconds(100));
+void UDPSender::complete_zerocopy(uint32_t lo, uint32_t hi, bool copied)
+{
+    zerocopy_pending_.emplace_back(lo, hi);
+
+    // 通知は概ね順番に届くが、保証はないので連続した範囲だけ完了扱いにする
+    bool advanced = true;
+    while (advanced) {
+        advanced = false;
+
+        for (size_t i = 0; i < zerocopy_pending_.size(); ++i) {
+            if (zerocopy_pending_[i].first == zerocopy_completed_id_) {
+                zerocopy_completed_id_ = zerocopy_pending_[i].second + 1;
+                zerocopy_pending_.erase(zerocopy_pending_.begin() + i);
+                advanced = true;
+                break;
+            }
         }
     }
 
+    // ループバックやオフロード非対応のNICでは結局コピーされ、通知の分だけ損になる
+    zerocopy_copied_streak_ = copied ? zerocopy_copied_streak_ + (hi - lo + 1) : 0;
+
+    if (zerocopy_enabled_ && zerocopy_copied_streak_ >= ZEROCOPY_COPIED_LIMIT) {
+        LOG_I("MSG_ZEROCOPY sends are always copied by the kernel, using copying sends");
+
+        zerocopy_enabled_ = false;
+    }
+}
+
+bool UDPSender::enable_kernel_pacing()
+{
+    std::string interface;
+
+    if (!find_egress_interface(destinations_.front(), interface)) {
+        LOG_W("Could not determine the egress interface, using userspace pacing");
+
+        return false;
+    }
+
+    if (!interface_has_fq_qdisc(interface)) {
+        LOG_I("No fq qdisc on %s, using userspace pacing", interface.c_str());
+
+        return false;
+    }
+
+    // 1 Mbit/s = 125000 byte/s。カーネル 4.20 より前は 32bit 値しか受け付けない
+    const uint64_t rate_64 = static_cast<uint64_t>(config_.max_rate_mbps) * 125000;
+
+    if (setsockopt(sock_fd_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate_64, sizeof(rate_64)) < 0) {
+        const uint32_t rate_32 = static_cast<uint32_t>(std::min<uint64_t>(rate_64, UINT32_MAX));
+
+        if (setsockopt(sock_fd_, SOL_SOCKET, SO_MAX_PACING_RATE, &rate_32, sizeof(rate_32)) < 0) {
+            LOG_W("SO_MAX_PACING_RATE failed (%s), using userspace pacing", std::strerror(errno));
+
+            return false;
+        }
+    }
+
+    LOG_I("Pacing is done by the fq qdisc on %s", interface.c_str());
+
     return true;
 }
@@ -6,19 +6,78 @@
  * @date    2025-12-16
  */
 
+#include <chrono>
+#include <random>
+
 #include "network/udp_sender_thread.hpp"
+#include "network/rtp_header.hpp"
 #include "logger/logger.hpp"
 
-#define MAX_QUEUE_SiZE 1  /**< 送信キューの最大サイズ */
+#define MAX_POOL_SIZE 4   /**< 再利用のために保持するバッファ数 */
+#define FRAME_MAILBOX_SIZE 8        /**< 送信スレッドへ受け渡し中にできるフレーム数 */
+#define METADATA_MAILBOX_SIZE 256   /**< 送信スレッドへ受け渡し中にできるメタデータ数 */
+#define MAX_IN_FLIGHT 8   /**< 完了待ちのゼロコピー送信フレーム数の上限 (超えたら完了を待つ) */
+#define DRAIN_TIMEOUT_MS 100 /**< 停止時にゼロコピー送信の完了を待つ最大時間 [ms] */
+#define NACK_POLL_INTERVAL_MS 2 /**< 再送キャッシュがある間、NACK を確認する間隔 [ms] */
+#define RTCP_REPORT_INTERVAL_MS 1000    /**< RTCP 送信者レポートの送信間隔 [ms] */
+
+#define RTP_PAYLOAD_TYPE_H264 96    /**< H.264用の動的ペイロードタイプ */
 
-UDPSenderThread::UDPSenderThread(const std::string& ip, uint16_t port)
-    : sender_(ip, port),
+UDPSenderThread::UDPSenderThread(const std::string& ip,
+                                 uint16_t port,
+                                 PayloadFormat format,
+                                 const UDPSender::Config& config)
+    : sender_(ip, port, config),
+      format_(format),
+      cache_frames_(format == PayloadFormat::CHUNKED ? config.retransmit_cache_frames : 0),
+      retransmit_deadline_(config.retransmit_deadline_ms),
+      cache_(),
+      nack_(),
+      nack_requester_(),
+      rtp_ssrc_(std::random_device{}()),
+      rtp_packetizer_(RTP_PAYLOAD_TYPE_H264, rtp_ssrc_, config.max_payload_size),
+      rtp_jpeg_packetizer_(rtp_ssrc_, config.max_payload_size),
+      rtp_packets_(),
+      rtcp_(),
+      rtp_packet_count_(0),
+      rtp_octet_count_(0),
+      next_rtcp_report_(),
       send_thread_(),
-      mutex_(),
-      cond_var_(),
-      send_queue_(),
-      running_(false)
+      wakeup_(),
+      frame_mailbox_(FRAME_MAILBOX_SIZE),
+      metadata_mailbox_(METADATA_MAILBOX_SIZE),
+      buffer_pool_(MAX_POOL_SIZE),
+      metadata_pool_(METADATA_MAILBOX_SIZE),
+      producer_waiting_for_keyframe_(false),
+      scheduler_(config.queue_policy, config.queue_depth),
+      discarded_(),
+      slice_chunks_((format == PayloadFormat::CHUNKED && config.max_rate_mbps > 0) ? config.send_slice_chunks : 0),
+      last_preempted_(false),
+      metadata_packets_(),
+      next_frame_id_(0),
+      in_flight_(),
+      running_(false),
+      stat_sent_frames_(0),
+      stat_sent_bytes_(0),
+      stat_dropped_packets_(0),
+      stat_last_send_time_us_(0),
+      stat_retransmitted_packets_(0),
+      stat_rtcp_reports_(0),
+      stat_loss_fraction_(0.0),
+      stat_jitter_ms_(0.0),
+      stat_rtt_ms_(-1.0),
+      stat_dropped_frames_(0),
+      stat_rejected_frames_(0),
+      stat_preempted_frames_(0),
+      stat_keyframe_requests_(0),
+      stat_metadata_packets_(0)
 {
+    if (format != PayloadFormat::CHUNKED && config.rtcp) {
+        const uint16_t rtcp_port = (config.rtcp_port != 0) ? config.rtcp_port : static_cast<uint16_t>(port + 1);
+
+        rtcp_ = std::make_unique<RtcpSession>(ip, rtcp_port, rtp_ssrc_, RTP_VIDEO_CLOCK_RATE);
+    }
+
     LOG_I("UDPSenderThread initialized. Target: %s:%d", ip.c_str(), port);
 }
 
@@ -29,11 +88,11 @@ UDPSenderThread::~UDPSenderThread()
 
 void UDPSenderThread::start(void)
 {
-    if (running_) {
+    if (running_.load(std::memory_order_acquire)) {
         return;
     }
 
-    running_ = true;
+    running_.store(true, std::memory_order_release);
     send_thread_ = std::thread(&UDPSenderThread::send_loop, this);
 
     LOG_I("UDP sender thread started");
@@ -41,73 +100,402 @@ void UDPSenderThread::start(void)
 
 void UDPSenderThread::stop(void)
 {
-    if (!running_) {
+    if (!running_.load(std::memory_order_acquire)) {
         return;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        running_ = false;
-    }
-
-    cond_var_.notify_all();
+    running_.store(false, std::memory_order_release);
+    wakeup_.notify();
 
     if (send_thread_.joinable()) {
         send_thread_.join();
     }
 
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
-        while (!send_queue_.empty()) {
-            send_queue_.pop();
-        }
+    expire_cache(0);
+
+    // カーネルが参照しているバッファを解放しないよう、完了通知を待つ
+    const auto drain_deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(DRAIN_TIMEOUT_MS);
+    while (!in_flight_.empty() && std::chrono::steady_clock::now() < drain_deadline) {
+        reap_in_flight(1);
+    }
+    if (!in_flight_.empty()) {
+        LOG_W("%zu zero-copy frames still in flight at shutdown", in_flight_.size());
     }
 
+    // 送信スレッドは終わっているので、受け渡し列の残りもこのスレッドで捨ててよい
+    drain_mailbox();
+    scheduler_.clear();
+
     LOG_I("UDP sender thread stopped");
 }
 
-void UDPSenderThread::enqueue(std::vector<uint8_t>&& data)
+void UDPSenderThread::enqueue(std::vector<uint8_t>&& data, uint64_t timestamp_us, bool keyframe)
 {
-    if (!running_) {
+    if (!running_.load(std::memory_order_acquire)) {
         return;
     }
 
-    {
-        std::lock_guard<std::mutex> lock(mutex_);
+    if (producer_waiting_for_keyframe_) {
+        if (!keyframe) {
+            stat_rejected_frames_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        producer_waiting_for_keyframe_ = false;
+    }
+
+    SendScheduler::Frame frame;
+    frame.data = std::move(data);
+    frame.timestamp_us = timestamp_us;
+    frame.keyframe = keyframe;
+
+    if (!frame_mailbox_.try_push(frame)) {
+        // 送信スレッドが1回の送信で止まっている。待たずにこのフレームを諦める
+        stat_rejected_frames_.fetch_add(1, std::memory_order_relaxed);
 
-        // 常に最新のフレームを送るために捨てる
-        while (!send_queue_.empty()) {
-            send_queue_.pop();
+        if (scheduler_.policy() == SendScheduler::QueuePolicy::KEYFRAME && !keyframe) {
+            // 後続の差分は受信側で復号できないので、キーフレームまで渡さない
+            producer_waiting_for_keyframe_ = true;
+            stat_keyframe_requests_.fetch_add(1, std::memory_order_relaxed);
         }
+        return;
+    }
+
+    wakeup_.notify();
+}
 
-        send_queue_.push(std::move(data));
+void UDPSenderThread::enqueue_metadata(std::vector<uint8_t>&& datagram)
+{
+    if (!running_.load(std::memory_order_acquire) || datagram.empty()) {
+        return;
+    }
+
+    if (!metadata_mailbox_.try_push(datagram)) {
+        return;
+    }
+
+    wakeup_.notify();
+}
+
+void UDPSenderThread::drain_mailbox(void)
+{
+    SendScheduler::Frame frame;
+    while (frame_mailbox_.try_pop(frame)) {
+        scheduler_.push_frame(std::move(frame), discarded_);
+    }
+
+    std::vector<uint8_t> datagram;
+    while (metadata_mailbox_.try_pop(datagram)) {
+        scheduler_.push_metadata(std::move(datagram));
+    }
+
+    for (std::vector<uint8_t>& buffer : discarded_) {
+        release_buffer(std::move(buffer));
     }
+    discarded_.clear();
 
-    cond_var_.notify_one();
+    if (scheduler_.take_keyframe_request()) {
+        stat_keyframe_requests_.fetch_add(1, std::memory_order_relaxed);
+    }
+    stat_dropped_frames_.store(scheduler_.dropped_frames(), std::memory_order_relaxed);
 }
 
 void UDPSenderThread::send_loop(void)
 {
+    const auto has_work = [this]() {
+        return !frame_mailbox_.empty() || !metadata_mailbox_.empty()
+            || scheduler_.has_frame() || scheduler_.has_metadata()
+            || !running_.load(std::memory_order_acquire);
+    };
+
     while (true) {
-        std::vector<uint8_t> packet;
+        SendScheduler::Frame frame_in;
 
-        {
-            std::unique_lock<std::mutex> lock(mutex_);
+        // 再送キャッシュがある間は NACK を見るために定期的に起きる
+        wakeup_.wait(cache_.empty() ? -1 : NACK_POLL_INTERVAL_MS, has_work);
 
-            cond_var_.wait(lock, [this]() {
-                return !send_queue_.empty() || !running_;
-            });
+        drain_mailbox();
+
+        if (!running_.load(std::memory_order_acquire) && !scheduler_.has_frame()) {
+            break;
+        }
 
-            if (!running_ && send_queue_.empty()) {
-                break;
+        scheduler_.pop_frame(frame_in);
+
+        // 画像より先にメタデータを送る
+        send_metadata();
+
+        if (cache_frames_ > 0) {
+            process_nacks();
+            expire_cache(cache_frames_);
+        }
+
+        std::vector<uint8_t>& packet = frame_in.data;
+        const uint64_t timestamp_us = frame_in.timestamp_us;
+
+        if (packet.empty()) {
+            continue;
+        }
+
+        const auto send_start = std::chrono::steady_clock::now();
+
+        const size_t packet_size = packet.size();
+        bool completed = true;
+
+        if (format_ == PayloadFormat::RTP_H264) {
+            send_rtp_h264(packet, timestamp_us);
+            release_buffer(std::move(packet));
+        } else if (format_ == PayloadFormat::RTP_JPEG) {
+            send_rtp_jpeg(packet, timestamp_us);
+            release_buffer(std::move(packet));
+        } else {
+            CachedFrame frame;
+            frame.frame_id = next_frame_id_;
+            frame.timestamp_us = timestamp_us;
+
+            if (slice_chunks_ > 0) {
+                // 送信がフレーム間隔より遅いと打ち切りが続いて1枚も届かないので、打ち切りは連続させない
+                completed = send_chunked_frame(packet, frame.frame_id, timestamp_us, !last_preempted_);
+                last_preempted_ = !completed;
+            } else {
+                sender_.send(packet.data(), packet.size(), frame.frame_id, timestamp_us);
+            }
+            next_frame_id_ += 1;
+
+            frame.sent_at = std::chrono::steady_clock::now();
+            frame.zerocopy_boundary = sender_.zerocopy_boundary();
+            frame.data = std::move(packet);
+
+            // 打ち切ったフレームは受信側で揃わないので再送しない
+            if (cache_frames_ > 0 && completed) {
+                cache_.push_back(std::move(frame));
+                expire_cache(cache_frames_);
+            } else {
+                retire_frame(std::move(frame));
+            }
+        }
+
+        const auto send_time = std::chrono::steady_clock::now() - send_start;
+
+        if (rtcp_) {
+            process_rtcp();
+        }
+
+        if (!in_flight_.empty()) {
+            reap_in_flight(0);
+
+            while (in_flight_.size() > MAX_IN_FLIGHT && sender_.zerocopy_enabled()) {
+                reap_in_flight(1);
             }
+        }
 
-            packet = std::move(send_queue_.front());
-            send_queue_.pop();
+        stat_last_send_time_us_.store(
+            std::chrono::duration_cast<std::chrono::microseconds>(send_time).count(),
+            std::memory_order_relaxed);
+        stat_dropped_packets_.store(sender_.dropped_packets(), std::memory_order_relaxed);
+        stat_retransmitted_packets_.store(sender_.retransmitted_packets(), std::memory_order_relaxed);
+        stat_sent_bytes_.fetch_add(packet_size, std::memory_order_relaxed);
+        if (completed) {
+            stat_sent_frames_.fetch_add(1, std::memory_order_relaxed);
+        } else {
+            stat_preempted_frames_.fetch_add(1, std::memory_order_relaxed);
         }
+    }
+
+    // 停止前に積まれたメタデータは送っておく
+    send_metadata();
+}
+
+bool UDPSenderThread::send_chunked_frame(const std::vector<uint8_t>& data,
+                                         uint32_t frame_id,
+                                         uint64_t timestamp_us,
+                                         bool preemptible)
+{
+    const size_t chunk_count = sender_.chunk_count(data.size());
+
+    for (size_t first = 0; first < chunk_count; first += slice_chunks_) {
+        if (first > 0 && (!frame_mailbox_.empty() || !metadata_mailbox_.empty())) {
+            drain_mailbox();
+            send_metadata();
 
-        if (!packet.empty()) {
-            sender_.send(packet.data(), packet.size());
+            if (preemptible && scheduler_.should_preempt()) {
+                return false;
+            }
         }
+
+        sender_.send_chunks(data.data(), data.size(), frame_id, timestamp_us, first, slice_chunks_);
+    }
+
+    return true;
+}
+
+void UDPSenderThread::send_metadata(void)
+{
+    if (!scheduler_.has_metadata()) {
+        return;
+    }
+
+    const size_t count = scheduler_.pop_metadata(metadata_packets_);
+
+    sender_.send_packets(metadata_packets_, count);
+    stat_metadata_packets_.fetch_add(count, std::memory_order_relaxed);
+
+    // 送信済みのバッファを呼び出し側へ戻す (プールが満杯なら次の pop_metadata() で解放される)
+    for (size_t i = 0; i < count; ++i) {
+        metadata_packets_[i].clear();
+        metadata_pool_.try_push(metadata_packets_[i]);
+    }
+}
+
+std::vector<uint8_t> UDPSenderThread::acquire_buffer(void)
+{
+    std::vector<uint8_t> buffer;
+
+    buffer_pool_.try_pop(buffer);
+
+    return buffer;
+}
+
+std::vector<uint8_t> UDPSenderThread::acquire_metadata_buffer(void)
+{
+    std::vector<uint8_t> buffer;
+
+    metadata_pool_.try_pop(buffer);
+
+    return buffer;
+}
+
+void UDPSenderThread::release_buffer(std::vector<uint8_t>&& buffer)
+{
+    buffer.clear();
+
+    // プールが満杯ならここで解放する
+    buffer_pool_.try_push(buffer);
+}
+
+void UDPSenderThread::process_nacks(void)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    while (sender_.receive_nack(nack_, nack_requester_)) {
+        for (const CachedFrame& frame : cache_) {
+            if (frame.frame_id != nack_.frame_id) {
+                continue;
+            }
+
+            // 期限を過ぎたフレームは再送しても表示に間に合わない
+            if (now - frame.sent_at <= retransmit_deadline_) {
+                sender_.resend_chunks(frame.data.data(), frame.data.size(),
+                                      frame.frame_id, frame.timestamp_us, nack_.chunks, nack_requester_);
+            }
+            break;
+        }
+    }
+
+    stat_retransmitted_packets_.store(sender_.retransmitted_packets(), std::memory_order_relaxed);
+}
+
+void UDPSenderThread::expire_cache(size_t max_frames)
+{
+    const auto now = std::chrono::steady_clock::now();
+
+    while (!cache_.empty()
+           && (cache_.size() > max_frames || now - cache_.front().sent_at > retransmit_deadline_)) {
+        retire_frame(std::move(cache_.front()));
+        cache_.pop_front();
+    }
+}
+
+void UDPSenderThread::retire_frame(CachedFrame&& frame)
+{
+    if (sender_.is_zerocopy_completed(frame.zerocopy_boundary)) {
+        release_buffer(std::move(frame.data));
+    } else {
+        // 送信完了通知が届くまでカーネルがこのバッファを参照している
+        in_flight_.emplace_back(frame.zerocopy_boundary, std::move(frame.data));
+    }
+}
+
+void UDPSenderThread::reap_in_flight(int timeout_ms)
+{
+    sender_.reap_zerocopy_completions(timeout_ms);
+
+    while (!in_flight_.empty() && sender_.is_zerocopy_completed(in_flight_.front().first)) {
+        release_buffer(std::move(in_flight_.front().second));
+        in_flight_.pop_front();
+    }
+}
+
+UDPSenderThread::Stats UDPSenderThread::get_stats(void) const
+{
+    Stats stats;
+
+    stats.sent_frames = stat_sent_frames_.load(std::memory_order_relaxed);
+    stats.sent_bytes = stat_sent_bytes_.load(std::memory_order_relaxed);
+    stats.dropped_packets = stat_dropped_packets_.load(std::memory_order_relaxed);
+    stats.last_send_time_us = stat_last_send_time_us_.load(std::memory_order_relaxed);
+    stats.retransmitted_packets = stat_retransmitted_packets_.load(std::memory_order_relaxed);
+    stats.rtcp_reports = stat_rtcp_reports_.load(std::memory_order_relaxed);
+    stats.loss_fraction = stat_loss_fraction_.load(std::memory_order_relaxed);
+    stats.jitter_ms = stat_jitter_ms_.load(std::memory_order_relaxed);
+    stats.rtt_ms = stat_rtt_ms_.load(std::memory_order_relaxed);
+    stats.dropped_frames = stat_dropped_frames_.load(std::memory_order_relaxed)
+                         + stat_rejected_frames_.load(std::memory_order_relaxed);
+    stats.preempted_frames = stat_preempted_frames_.load(std::memory_order_relaxed);
+    stats.keyframe_requests = stat_keyframe_requests_.load(std::memory_order_relaxed);
+    stats.metadata_packets = stat_metadata_packets_.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void UDPSenderThread::send_rtp_h264(const std::vector<uint8_t>& data, uint64_t timestamp_us)
+{
+    // キャプチャ時刻を90kHzのメディアクロックに変換する
+    const uint32_t timestamp = static_cast<uint32_t>(timestamp_us * RTP_VIDEO_CLOCK_RATE / 1000000);
+
+    const size_t count = rtp_packetizer_.packetize(data.data(), data.size(), timestamp, rtp_packets_);
+
+    send_rtp_packets(count);
+}
+
+void UDPSenderThread::send_rtp_jpeg(const std::vector<uint8_t>& data, uint64_t timestamp_us)
+{
+    const uint32_t timestamp = static_cast<uint32_t>(timestamp_us * RTP_VIDEO_CLOCK_RATE / 1000000);
+
+    const size_t count = rtp_jpeg_packetizer_.packetize(data.data(), data.size(), timestamp, rtp_packets_);
+
+    send_rtp_packets(count);
+}
+
+void UDPSenderThread::send_rtp_packets(size_t count)
+{
+    if (count == 0) {
+        return;
+    }
+
+    sender_.send_packets(rtp_packets_, count);
+
+    // SR の送信数は RTP ヘッダを除いたペイロードで数える (RFC 3550 6.4.1)
+    rtp_packet_count_ += static_cast<uint32_t>(count);
+    for (size_t i = 0; i < count; ++i) {
+        rtp_octet_count_ += static_cast<uint32_t>(rtp_packets_[i].size() - RTP_HEADER_SIZE);
+    }
+}
+
+void UDPSenderThread::process_rtcp(void)
+{
+    if (rtcp_->poll_receiver_reports() > 0) {
+        const RtcpSession::ReceptionStats& reception = rtcp_->stats();
+
+        stat_loss_fraction_.store(reception.fraction_lost, std::memory_order_relaxed);
+        stat_jitter_ms_.store(reception.jitter_ms, std::memory_order_relaxed);
+        stat_rtt_ms_.store(reception.rtt_ms, std::memory_order_relaxed);
+        stat_rtcp_reports_.store(reception.reports, std::memory_order_relaxed);
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+
+    if (now >= next_rtcp_report_) {
+        rtcp_->send_sender_report(rtp_packet_count_, rtp_octet_count_);
+        next_rtcp_report_ = now + std::chrono::milliseconds(RTCP_REPORT_INTERVAL_MS);
     }
 }
@@ -17,14 +17,76 @@ ReadYaml::ReadYaml()
     config_data_.network.dest_ip = "127.0.0.1";
     config_data_.network.top_view_port = 50000;
     config_data_.network.bottom_view_port = 50001;
+    config_data_.network.max_payload_size = 1400;
+    config_data_.network.batch_size = 64;
+    config_data_.network.max_rate_mbps = 0;
+    config_data_.network.burst_bytes = 65536;
+    config_data_.network.kernel_pacing = true;
+    config_data_.network.send_mode = "sendmmsg";
+    config_data_.network.zerocopy = false;
+    config_data_.network.fec_group_size = 0;
+    config_data_.network.retransmit_cache_frames = 0;
+    config_data_.network.retransmit_deadline_ms = 100;
+    config_data_.network.extra_dest_ips.clear();
+    config_data_.network.multicast_ttl = 1;
+    config_data_.network.multicast_loopback = false;
+    config_data_.network.multicast_interface = "";
+    config_data_.network.jpeg_payload = "chunked";
+    config_data_.network.rtcp = true;
+    config_data_.network.rtcp_port = 0;
+    config_data_.network.send_queue_policy = "latest";
+    config_data_.network.send_queue_depth = 4;
+    config_data_.network.send_slice_chunks = 32;
+    config_data_.network.detection_metadata = false;
 
     config_data_.camera.top_view_device = "/dev/video0";
     config_data_.camera.bottom_view_device = "/dev/video2";
+    config_data_.camera.bottom_view_enabled = false;
+    config_data_.camera.source = "v4l2";
     config_data_.camera.width = 800;
     config_data_.camera.height = 600;
+    config_data_.camera.pixel_format = "yuyv";
+    config_data_.camera.event_loop = "io_uring";
+    config_data_.camera.mode.policy = "exact";
+    config_data_.camera.mode.min_width = 0;
+    config_data_.camera.mode.min_fps = 0.0;
+    config_data_.camera.mode.list = false;
+    config_data_.camera.replay.path = "";
+    config_data_.camera.replay.pacing = "realtime";
+    config_data_.camera.replay.fps = 30.0;
+    config_data_.camera.replay.loop = true;
+    config_data_.camera.replay.start_frame = 0;
+    config_data_.camera.recovery.initial_backoff_ms = 200;
+    config_data_.camera.recovery.max_backoff_ms = 5000;
+    config_data_.camera.controls.list = false;
+    config_data_.camera.controls.frame_rate = 0;
+    config_data_.camera.controls.exposure = -1;
+    config_data_.camera.controls.exposure_auto_priority = -1;
+    config_data_.camera.controls.gain = -1;
+    config_data_.camera.controls.white_balance = -1;
+    config_data_.camera.controls.focus = -1;
 
     config_data_.image_processor.jpeg_quality = 80;
     config_data_.image_processor.resize_width = 640.0;
+    config_data_.image_processor.codec = "jpeg";
+    config_data_.image_processor.roi_background_quality = 0;
+    config_data_.image_processor.jpeg_subsampling = "444";
+    config_data_.image_processor.draw_overlay = true;
+    config_data_.image_processor.h264.bitrate_kbps = 2000;
+    config_data_.image_processor.h264.gop = 30;
+    config_data_.image_processor.h264.fps = 30;
+
+    config_data_.rate_control.enabled = false;
+    config_data_.rate_control.target_bitrate_kbps = 20000;
+    config_data_.rate_control.target_fps = 15;
+    config_data_.rate_control.min_quality = 40;
+    config_data_.rate_control.max_quality = 90;
+    config_data_.rate_control.min_scale = 0.5;
+
+    config_data_.recorder.enabled = false;
+    config_data_.recorder.directory = "./recordings";
+    config_data_.recorder.segment_size_mb = 256;
+    config_data_.recorder.queue_frames = 16;
 }
 
 // デストラクタ
@@ -44,6 +106,70 @@ bool ReadYaml::load_config(const std::string& filepath)
             config_data_.network.dest_ip = net["dest_ip"].as<std::string>();
             config_data_.network.top_view_port = net["top_view_port"].as<uint16_t>();
             config_data_.network.bottom_view_port = net["bottom_view_port"].as<uint16_t>();
+
+            if (net["max_payload_size"]) {
+                config_data_.network.max_payload_size = net["max_payload_size"].as<uint32_t>();
+            }
+            if (net["batch_size"]) {
+                config_data_.network.batch_size = net["batch_size"].as<uint32_t>();
+            }
+            if (net["max_rate_mbps"]) {
+                config_data_.network.max_rate_mbps = net["max_rate_mbps"].as<uint32_t>();
+            }
+            if (net["burst_bytes"]) {
+                config_data_.network.burst_bytes = net["burst_bytes"].as<uint32_t>();
+            }
+            if (net["kernel_pacing"]) {
+                config_data_.network.kernel_pacing = net["kernel_pacing"].as<bool>();
+            }
+            if (net["send_mode"]) {
+                config_data_.network.send_mode = net["send_mode"].as<std::string>();
+            }
+            if (net["zerocopy"]) {
+                config_data_.network.zerocopy = net["zerocopy"].as<bool>();
+            }
+            if (net["fec_group_size"]) {
+                config_data_.network.fec_group_size = net["fec_group_size"].as<uint32_t>();
+            }
+            if (net["retransmit_cache_frames"]) {
+                config_data_.network.retransmit_cache_frames = net["retransmit_cache_frames"].as<uint32_t>();
+            }
+            if (net["retransmit_deadline_ms"]) {
+                config_data_.network.retransmit_deadline_ms = net["retransmit_deadline_ms"].as<uint32_t>();
+            }
+            if (net["extra_dest_ips"]) {
+                config_data_.network.extra_dest_ips = net["extra_dest_ips"].as<std::vector<std::string>>();
+            }
+            if (net["multicast_ttl"]) {
+                config_data_.network.multicast_ttl = net["multicast_ttl"].as<int>();
+            }
+            if (net["multicast_loopback"]) {
+                config_data_.network.multicast_loopback = net["multicast_loopback"].as<bool>();
+            }
+            if (net["multicast_interface"]) {
+                config_data_.network.multicast_interface = net["multicast_interface"].as<std::string>();
+            }
+            if (net["jpeg_payload"]) {
+                config_data_.network.jpeg_payload = net["jpeg_payload"].as<std::string>();
+            }
+            if (net["rtcp"]) {
+                config_data_.network.rtcp = net["rtcp"].as<bool>();
+            }
+            if (net["rtcp_port"]) {
+                config_data_.network.rtcp_port = net["rtcp_port"].as<uint16_t>();
+            }
+            if (net["send_queue_policy"]) {
+                config_data_.network.send_queue_policy = net["send_queue_policy"].as<std::string>();
+            }
+            if (net["send_queue_depth"]) {
+                config_data_.network.send_queue_depth = net["send_queue_depth"].as<uint32_t>();
+            }
+            if (net["send_slice_chunks"]) {
+                config_data_.network.send_slice_chunks = net["send_slice_chunks"].as<uint32_t>();
+            }
+            if (net["detection_metadata"]) {
+                config_data_.network.detection_metadata = net["detection_metadata"].as<bool>();
+            }
         }
 
         if(config["camera"]) {
@@ -51,8 +177,95 @@ bool ReadYaml::load_config(const std::string& filepath)
 
             config_data_.camera.top_view_device = cam["top_view_device"].as<std::string>();
             config_data_.camera.bottom_view_device = cam["bottom_view_device"].as<std::string>();
+            if (cam["bottom_view_enabled"]) {
+                config_data_.camera.bottom_view_enabled = cam["bottom_view_enabled"].as<bool>();
+            }
+            if (cam["source"]) {
+                config_data_.camera.source = cam["source"].as<std::string>();
+            }
             config_data_.camera.width = cam["width"].as<uint32_t>();
             config_data_.camera.height = cam["height"].as<uint32_t>();
+
+            if (cam["pixel_format"]) {
+                config_data_.camera.pixel_format = cam["pixel_format"].as<std::string>();
+            }
+            if (cam["event_loop"]) {
+                config_data_.camera.event_loop = cam["event_loop"].as<std::string>();
+            }
+
+            if (cam["mode"]) {
+                auto mode = cam["mode"];
+
+                if (mode["policy"]) {
+                    config_data_.camera.mode.policy = mode["policy"].as<std::string>();
+                }
+                if (mode["min_width"]) {
+                    config_data_.camera.mode.min_width = mode["min_width"].as<uint32_t>();
+                }
+                if (mode["min_fps"]) {
+                    config_data_.camera.mode.min_fps = mode["min_fps"].as<double>();
+                }
+                if (mode["list"]) {
+                    config_data_.camera.mode.list = mode["list"].as<bool>();
+                }
+            }
+
+            if (cam["replay"]) {
+                auto replay = cam["replay"];
+
+                if (replay["path"]) {
+                    config_data_.camera.replay.path = replay["path"].as<std::string>();
+                }
+                if (replay["pacing"]) {
+                    config_data_.camera.replay.pacing = replay["pacing"].as<std::string>();
+                }
+                if (replay["fps"]) {
+                    config_data_.camera.replay.fps = replay["fps"].as<double>();
+                }
+                if (replay["loop"]) {
+                    config_data_.camera.replay.loop = replay["loop"].as<bool>();
+                }
+                if (replay["start_frame"]) {
+                    config_data_.camera.replay.start_frame = replay["start_frame"].as<uint32_t>();
+                }
+            }
+
+            if (cam["recovery"]) {
+                auto recovery = cam["recovery"];
+
+                if (recovery["initial_backoff_ms"]) {
+                    config_data_.camera.recovery.initial_backoff_ms = recovery["initial_backoff_ms"].as<uint32_t>();
+                }
+                if (recovery["max_backoff_ms"]) {
+                    config_data_.camera.recovery.max_backoff_ms = recovery["max_backoff_ms"].as<uint32_t>();
+                }
+            }
+
+            if (cam["controls"]) {
+                auto ctrl = cam["controls"];
+
+                if (ctrl["list"]) {
+                    config_data_.camera.controls.list = ctrl["list"].as<bool>();
+                }
+                if (ctrl["frame_rate"]) {
+                    config_data_.camera.controls.frame_rate = ctrl["frame_rate"].as<uint32_t>();
+                }
+                if (ctrl["exposure"]) {
+                    config_data_.camera.controls.exposure = ctrl["exposure"].as<int32_t>();
+                }
+                if (ctrl["exposure_auto_priority"]) {
+                    config_data_.camera.controls.exposure_auto_priority = ctrl["exposure_auto_priority"].as<int32_t>();
+                }
+                if (ctrl["gain"]) {
+                    config_data_.camera.controls.gain = ctrl["gain"].as<int32_t>();
+                }
+                if (ctrl["white_balance"]) {
+                    config_data_.camera.controls.white_balance = ctrl["white_balance"].as<int32_t>();
+                }
+                if (ctrl["focus"]) {
+                    config_data_.camera.controls.focus = ctrl["focus"].as<int32_t>();
+                }
+            }
         }
 
         if(config["image_processor"]) {
@@ -62,6 +275,58 @@ bool ReadYaml::load_config(const std::string& filepath)
             config_data_.image_processor.jpeg_quality = static_cast<uint8_t>(tmp);
 
             config_data_.image_processor.resize_width = img_proc["resize_width"].as<double>();
+
+            if (img_proc["codec"]) {
+                config_data_.image_processor.codec = img_proc["codec"].as<std::string>();
+            }
+
+            if (img_proc["roi_background_quality"]) {
+                config_data_.image_processor.roi_background_quality = img_proc["roi_background_quality"].as<int>();
+            }
+
+            if (img_proc["jpeg_subsampling"]) {
+                config_data_.image_processor.jpeg_subsampling = img_proc["jpeg_subsampling"].as<std::string>();
+            }
+
+            if (img_proc["draw_overlay"]) {
+                config_data_.image_processor.draw_overlay = img_proc["draw_overlay"].as<bool>();
+            }
+
+            if (img_proc["h264"]) {
+                auto h264 = img_proc["h264"];
+
+                config_data_.image_processor.h264.bitrate_kbps = h264["bitrate_kbps"].as<uint32_t>();
+                config_data_.image_processor.h264.gop = h264["gop"].as<uint32_t>();
+                config_data_.image_processor.h264.fps = h264["fps"].as<uint32_t>();
+            }
+        }
+
+        if(config["rate_control"]) {
+            auto rc = config["rate_control"];
+
+            config_data_.rate_control.enabled = rc["enabled"].as<bool>();
+            config_data_.rate_control.target_bitrate_kbps = rc["target_bitrate_kbps"].as<uint32_t>();
+            config_data_.rate_control.target_fps = rc["target_fps"].as<uint32_t>();
+            config_data_.rate_control.min_quality = rc["min_quality"].as<int>();
+            config_data_.rate_control.max_quality = rc["max_quality"].as<int>();
+            config_data_.rate_control.min_scale = rc["min_scale"].as<double>();
+        }
+
+        if (config["recorder"]) {
+            auto rec = config["recorder"];
+
+            if (rec["enabled"]) {
+                config_data_.recorder.enabled = rec["enabled"].as<bool>();
+            }
+            if (rec["directory"]) {
+                config_data_.recorder.directory = rec["directory"].as<std::string>();
+            }
+            if (rec["segment_size_mb"]) {
+                config_data_.recorder.segment_size_mb = rec["segment_size_mb"].as<uint32_t>();
+            }
+            if (rec["queue_frames"]) {
+                config_data_.recorder.queue_frames = rec["queue_frames"].as<uint32_t>();
+            }
         }
     } catch (const YAML::BadFile& e) {
         LOG_E("Failed to open config file: %s", e.what());
@@ -0,0 +1,446 @@
+/**
+ * @file    frame_recorder.cpp
+ * @brief   カメラのフレームの記録の実装
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+#include "recorder/frame_recorder.hpp"
+#include "logger/logger.hpp"
+
+#define WRITEBACK_CHUNK_SIZE (8u << 20)     /**< この量を書く毎に書き出しを始める [byte] (ページの倍数) */
+#define SEGMENT_ALIGN 4096                  /**< セグメントの大きさの単位 [byte] */
+#define MAX_RUN_DIRECTORY_SUFFIX 100        /**< 同じ秒に start() した時に付ける番号の上限 */
+
+/**
+ * @brief ディレクトリを作る (既にあれば何もしない)
+ */
+static bool make_directory(const std::string& path)
+{
+    if (mkdir(path.c_str(), 0755) < 0 && errno != EEXIST) {
+        LOG_E("Failed to create %s: %s", path.c_str(), strerror(errno));
+
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * @brief fd への書き込みを全て終える (短い書き込み・割り込みを繰り返す)
+ */
+static bool write_all(int fd, const uint8_t* data, size_t size)
+{
+    while (size > 0) {
+        const ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+
+        data += written;
+        size -= static_cast<size_t>(written);
+    }
+
+    return true;
+}
+
+FrameRecorder::FrameRecorder(const std::string& directory, size_t segment_size_mb, size_t queue_frames)
+    : directory_(directory),
+      segment_size_(std::max<size_t>(segment_size_mb, 1) << 20),
+      queue_frames_(std::max<size_t>(queue_frames, 1)),
+      recording_directory_(),
+      write_thread_(),
+      running_(false),
+      failed_(false),
+      mailbox_(queue_frames_),
+      buffer_pool_(queue_frames_),
+      wakeup_(),
+      sequence_(0),
+      spare_buffer_(),
+      has_spare_buffer_(false),
+      size_warned_(false),
+      index_fd_(-1),
+      segment_fd_(-1),
+      segment_map_(nullptr),
+      segment_capacity_(0),
+      segment_number_(0),
+      write_pos_(0),
+      flushed_pos_(0),
+      released_pos_(0),
+      stat_recorded_frames_(0),
+      stat_recorded_bytes_(0),
+      stat_dropped_frames_(0),
+      stat_segments_(0)
+{
+}
+
+FrameRecorder::~FrameRecorder()
+{
+    stop();
+}
+
+bool FrameRecorder::start()
+{
+    if (running_.load(std::memory_order_acquire)) {
+        return true;
+    }
+
+    if (!wakeup_.is_valid() || !make_directory(directory_)) {
+        return false;
+    }
+
+    // 記録毎に日時のディレクトリを作る (同じ秒なら番号を付ける)
+    char stamp[32];
+    const time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", &local);
+
+    recording_directory_.clear();
+    for (int suffix = 0; suffix < MAX_RUN_DIRECTORY_SUFFIX; ++suffix) {
+        const std::string candidate = directory_ + "/" + stamp + (suffix == 0 ? "" : "_" + std::to_string(suffix));
+        if (mkdir(candidate.c_str(), 0755) == 0) {
+            recording_directory_ = candidate;
+            break;
+        }
+        if (errno != EEXIST) {
+            LOG_E("Failed to create %s: %s", candidate.c_str(), strerror(errno));
+
+            return false;
+        }
+    }
+    if (recording_directory_.empty()) {
+        LOG_E("Failed to create a recording directory in %s", directory_.c_str());
+
+        return false;
+    }
+
+    const std::string index_path = recording_directory_ + "/" + RECORDING_INDEX_FILE;
+    index_fd_ = ::open(index_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND | O_CLOEXEC, 0644);
+    if (index_fd_ < 0) {
+        LOG_E("Failed to create %s: %s", index_path.c_str(), strerror(errno));
+
+        return false;
+    }
+
+    uint8_t header[RECORDING_INDEX_HEADER_SIZE];
+    write_recording_index_header(header);
+    if (!write_all(index_fd_, header, sizeof(header))) {
+        LOG_E("Failed to write %s: %s", index_path.c_str(), strerror(errno));
+
+        ::close(index_fd_);
+        index_fd_ = -1;
+
+        return false;
+    }
+
+    // キャプチャスレッドが使うバッファを先に用意しておく (中身の確保はフレームの大きさが分かる最初の1回だけ)
+    std::vector<uint8_t> buffer;
+    while (buffer_pool_.try_pop(buffer)) {
+    }
+    for (size_t i = 0; i < queue_frames_; ++i) {
+        std::vector<uint8_t> empty;
+        buffer_pool_.try_push(empty);
+    }
+    spare_buffer_.clear();
+    has_spare_buffer_ = false;
+    size_warned_ = false;
+
+    failed_ = false;
+    segment_number_ = 0;
+    stat_recorded_frames_.store(0, std::memory_order_relaxed);
+    stat_recorded_bytes_.store(0, std::memory_order_relaxed);
+    stat_dropped_frames_.store(0, std::memory_order_relaxed);
+    stat_segments_.store(0, std::memory_order_relaxed);
+
+    running_.store(true, std::memory_order_release);
+    write_thread_ = std::thread(&FrameRecorder::write_loop, this);
+
+    LOG_I("Recording frames to %s (segments of %zu MiB, %zu queued frames)",
+          recording_directory_.c_str(), segment_size_ >> 20, queue_frames_);
+
+    return true;
+}
+
+void FrameRecorder::stop()
+{
+    if (!running_.load(std::memory_order_acquire)) {
+        return;
+    }
+
+    running_.store(false, std::memory_order_release);
+    wakeup_.notify();
+
+    if (write_thread_.joinable()) {
+        write_thread_.join();
+    }
+
+    close_segment();
+
+    if (index_fd_ >= 0) {
+        fdatasync(index_fd_);
+        ::close(index_fd_);
+        index_fd_ = -1;
+    }
+
+    const Stats stats = get_stats();
+    LOG_I("Recording stopped: %llu frames (%.1f MiB) in %u segments, %llu dropped, %s",
+          static_cast<unsigned long long>(stats.recorded_frames), stats.recorded_bytes / 1048576.0,
+          stats.segments, static_cast<unsigned long long>(stats.dropped_frames), recording_directory_.c_str());
+}
+
+bool FrameRecorder::record(const FrameSource::Frame& frame)
+{
+    if (!running_.load(std::memory_order_acquire) || frame.data == nullptr || frame.size == 0) {
+        return false;
+    }
+
+    const uint32_t sequence = sequence_++;
+
+    // 索引の幅・高さは 16 bit なので、収まらないフレームは切り詰めずに記録しない
+    if (frame.width > UINT16_MAX || frame.height > UINT16_MAX) {
+        if (!size_warned_) {
+            LOG_W("Frame size %ux%u does not fit the recording index, not recording it", frame.width, frame.height);
+            size_warned_ = true;
+        }
+        stat_dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+
+        return false;
+    }
+
+    PendingFrame pending;
+    if (has_spare_buffer_) {
+        pending.data = std::move(spare_buffer_);
+        has_spare_buffer_ = false;
+    } else if (!buffer_pool_.try_pop(pending.data)) {
+        // 記録スレッドがディスクを待っている。キャプチャは止めずにこのフレームを諦める
+        stat_dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+
+        return false;
+    }
+
+    pending.data.resize(frame.size);
+    std::memcpy(pending.data.data(), frame.data, frame.size);
+
+    pending.entry.timestamp_us = frame.timestamp_us;
+    pending.entry.size = frame.size;
+    pending.entry.sequence = sequence;
+    pending.entry.fourcc = frame.fourcc;
+    pending.entry.width = static_cast<uint16_t>(frame.width);
+    pending.entry.height = static_cast<uint16_t>(frame.height);
+
+    // バッファとリングは同じ数なので、バッファが取れれば列にも入るはず。
+    // 入らなかった時はバッファを失わないよう手元に残し、次のフレームで使う
+    // (buffer_pool_ へ戻すと生産者が2つになるので戻さない)
+    if (!mailbox_.try_push(pending)) {
+        spare_buffer_ = std::move(pending.data);
+        has_spare_buffer_ = true;
+        stat_dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+
+        return false;
+    }
+
+    wakeup_.notify();
+
+    return true;
+}
+
+FrameRecorder::Stats FrameRecorder::get_stats() const
+{
+    Stats stats;
+    stats.recorded_frames = stat_recorded_frames_.load(std::memory_order_relaxed);
+    stats.recorded_bytes = stat_recorded_bytes_.load(std::memory_order_relaxed);
+    stats.dropped_frames = stat_dropped_frames_.load(std::memory_order_relaxed);
+    stats.segments = stat_segments_.load(std::memory_order_relaxed);
+
+    return stats;
+}
+
+void FrameRecorder::write_loop()
+{
+    const auto has_work = [this]() {
+        return !mailbox_.empty() || !running_.load(std::memory_order_acquire);
+    };
+
+    while (true) {
+        wakeup_.wait(-1, has_work);
+
+        // 止める前に渡されたフレームは全て書く
+        const bool stopping = !running_.load(std::memory_order_acquire);
+
+        PendingFrame pending;
+        while (mailbox_.try_pop(pending)) {
+            if (failed_ || !write_frame(pending)) {
+                stat_dropped_frames_.fetch_add(1, std::memory_order_relaxed);
+            }
+
+            // 捨てずにキャプチャ側へ戻す (中身の確保を使い回す)
+            buffer_pool_.try_push(pending.data);
+        }
+
+        if (stopping) {
+            break;
+        }
+    }
+}
+
+bool FrameRecorder::write_frame(PendingFrame& pending)
+{
+    const size_t size = pending.data.size();
+
+    if (segment_map_ == nullptr || write_pos_ + size > segment_capacity_) {
+        close_segment();
+
+        if (!open_segment(size)) {
+            failed_ = true;
+
+            return false;
+        }
+    }
+
+    std::memcpy(segment_map_ + write_pos_, pending.data.data(), size);
+
+    // 中身を書いてから索引に足す (索引にあるフレームは必ず読める)
+    pending.entry.segment = segment_number_;
+    pending.entry.offset = write_pos_;
+
+    uint8_t row[RECORDING_INDEX_ENTRY_SIZE];
+    write_recording_index_entry(pending.entry, row);
+    if (!write_all(index_fd_, row, sizeof(row))) {
+        LOG_E("Failed to write the recording index: %s", strerror(errno));
+
+        failed_ = true;
+
+        return false;
+    }
+
+    write_pos_ += size;
+
+    stat_recorded_frames_.fetch_add(1, std::memory_order_relaxed);
+    stat_recorded_bytes_.fetch_add(size, std::memory_order_relaxed);
+
+    write_back();
+
+    return true;
+}
+
+bool FrameRecorder::open_segment(size_t min_size)
+{
+    const size_t capacity = (std::max(segment_size_, min_size) + SEGMENT_ALIGN - 1) / SEGMENT_ALIGN * SEGMENT_ALIGN;
+    const uint32_t number = stat_segments_.load(std::memory_order_relaxed);
+    const std::string path = recording_segment_path(recording_directory_, number);
+
+    const int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        LOG_E("Failed to create %s: %s", path.c_str(), strerror(errno));
+
+        return false;
+    }
+
+    // 先にブロックを確保しておき、書いている途中で容量不足やブロック割り当てを待たないようにする
+    if (fallocate(fd, 0, 0, static_cast<off_t>(capacity)) < 0) {
+        if (errno != EOPNOTSUPP) {
+            LOG_E("Failed to allocate %zu MiB for %s: %s", capacity >> 20, path.c_str(), strerror(errno));
+
+            ::close(fd);
+            unlink(path.c_str());
+
+            return false;
+        }
+
+        // fallocate の無いファイルシステムでは大きさだけ合わせる
+        if (ftruncate(fd, static_cast<off_t>(capacity)) < 0) {
+            LOG_E("Failed to resize %s: %s", path.c_str(), strerror(errno));
+
+            ::close(fd);
+            unlink(path.c_str());
+
+            return false;
+        }
+    }
+
+    void* mapping = mmap(nullptr, capacity, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        LOG_E("mmap %s failed: %s", path.c_str(), strerror(errno));
+
+        ::close(fd);
+        unlink(path.c_str());
+
+        return false;
+    }
+
+    // 前から順に1回だけ書く
+    madvise(mapping, capacity, MADV_SEQUENTIAL);
+
+    segment_fd_ = fd;
+    segment_map_ = static_cast<uint8_t*>(mapping);
+    segment_capacity_ = capacity;
+    segment_number_ = number;
+    write_pos_ = 0;
+    flushed_pos_ = 0;
+    released_pos_ = 0;
+
+    stat_segments_.fetch_add(1, std::memory_order_relaxed);
+
+    return true;
+}
+
+void FrameRecorder::close_segment()
+{
+    if (segment_map_ == nullptr) {
+        return;
+    }
+
+    munmap(segment_map_, segment_capacity_);
+
+    // 確保したまま使わなかった後ろを返す
+    if (ftruncate(segment_fd_, static_cast<off_t>(write_pos_)) < 0) {
+        LOG_W("Failed to shrink segment %u: %s", segment_number_, strerror(errno));
+    }
+
+    ::close(segment_fd_);
+
+    segment_fd_ = -1;
+    segment_map_ = nullptr;
+    segment_capacity_ = 0;
+}
+
+void FrameRecorder::write_back()
+{
+    const size_t boundary = write_pos_ / WRITEBACK_CHUNK_SIZE * WRITEBACK_CHUNK_SIZE;
+    if (boundary <= flushed_pos_) {
+        return;
+    }
+
+    // 書き終えた区切りまでの書き出しを始める (待たない)
+    sync_file_range(segment_fd_, static_cast<off_t>(flushed_pos_), static_cast<off_t>(boundary - flushed_pos_),
+                    SYNC_FILE_RANGE_WRITE);
+
+    // 1つ前の区切りまでは書き出しが進んでいるはずなので、終わりを待ってページキャッシュから外す
+    if (flushed_pos_ > released_pos_) {
+        const size_t length = flushed_pos_ - released_pos_;
+
+        sync_file_range(segment_fd_, static_cast<off_t>(released_pos_), static_cast<off_t>(length),
+                        SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER);
+        madvise(segment_map_ + released_pos_, length, MADV_DONTNEED);
+        posix_fadvise(segment_fd_, static_cast<off_t>(released_pos_), static_cast<off_t>(length),
+                      POSIX_FADV_DONTNEED);
+
+        released_pos_ = flushed_pos_;
+    }
+
+    flushed_pos_ = boundary;
+}
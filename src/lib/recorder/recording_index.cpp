@@ -0,0 +1,135 @@
+/**
+ * @file    recording_index.cpp
+ * @brief   生フレーム記録の索引ファイルの読み書き
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "recorder/recording_index.hpp"
+
+static void put_u16(uint8_t* out, uint16_t value)
+{
+    out[0] = static_cast<uint8_t>(value);
+    out[1] = static_cast<uint8_t>(value >> 8);
+}
+
+static void put_u32(uint8_t* out, uint32_t value)
+{
+    for (int i = 0; i < 4; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static void put_u64(uint8_t* out, uint64_t value)
+{
+    for (int i = 0; i < 8; ++i) {
+        out[i] = static_cast<uint8_t>(value >> (8 * i));
+    }
+}
+
+static uint16_t get_u16(const uint8_t* in)
+{
+    return static_cast<uint16_t>(in[0] | (in[1] << 8));
+}
+
+static uint32_t get_u32(const uint8_t* in)
+{
+    uint32_t value = 0;
+    for (int i = 3; i >= 0; --i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+static uint64_t get_u64(const uint8_t* in)
+{
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; --i) {
+        value = (value << 8) | in[i];
+    }
+    return value;
+}
+
+std::string recording_segment_path(const std::string& directory, uint32_t segment)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "segment_%06u.raw", segment);
+
+    return directory + "/" + name;
+}
+
+void write_recording_index_header(uint8_t* out)
+{
+    put_u32(out + 0, RECORDING_INDEX_MAGIC);
+    put_u16(out + 4, RECORDING_INDEX_VERSION);
+    put_u16(out + 6, static_cast<uint16_t>(RECORDING_INDEX_ENTRY_SIZE));
+    put_u64(out + 8, 0);
+}
+
+void write_recording_index_entry(const RecordingIndexEntry& entry, uint8_t* out)
+{
+    put_u64(out + 0, entry.timestamp_us);
+    put_u64(out + 8, entry.offset);
+    put_u32(out + 16, entry.segment);
+    put_u32(out + 20, entry.size);
+    put_u32(out + 24, entry.sequence);
+    put_u32(out + 28, entry.fourcc);
+    put_u16(out + 32, entry.width);
+    put_u16(out + 34, entry.height);
+    put_u32(out + 36, 0);
+}
+
+bool read_recording_index(const std::string& directory, std::vector<RecordingIndexEntry>& entries)
+{
+    entries.clear();
+
+    std::ifstream in(directory + "/" + RECORDING_INDEX_FILE, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+
+    uint8_t header[RECORDING_INDEX_HEADER_SIZE];
+    if (!in.read(reinterpret_cast<char*>(header), sizeof(header))) {
+        return false;
+    }
+
+    if (get_u32(header) != RECORDING_INDEX_MAGIC || get_u16(header + 4) != RECORDING_INDEX_VERSION) {
+        return false;
+    }
+
+    // 新しい版で行が伸びても、知っている先頭部分だけ読めるようにする
+    const size_t entry_size = get_u16(header + 6);
+    if (entry_size < RECORDING_INDEX_ENTRY_SIZE) {
+        return false;
+    }
+
+    std::vector<uint8_t> row(entry_size);
+    while (in.read(reinterpret_cast<char*>(row.data()), static_cast<std::streamsize>(row.size()))) {
+        RecordingIndexEntry entry;
+        entry.timestamp_us = get_u64(&row[0]);
+        entry.offset = get_u64(&row[8]);
+        entry.segment = get_u32(&row[16]);
+        entry.size = get_u32(&row[20]);
+        entry.sequence = get_u32(&row[24]);
+        entry.fourcc = get_u32(&row[28]);
+        entry.width = get_u16(&row[32]);
+        entry.height = get_u16(&row[34]);
+        entries.push_back(entry);
+    }
+
+    return true;
+}
+
+size_t find_recording_entry(const std::vector<RecordingIndexEntry>& entries, uint64_t timestamp_us)
+{
+    const auto it = std::lower_bound(entries.begin(), entries.end(), timestamp_us,
+                                     [](const RecordingIndexEntry& entry, uint64_t value) {
+                                         return entry.timestamp_us < value;
+                                     });
+
+    return static_cast<size_t>(it - entries.begin());
+}
@@ -1,22 +1,143 @@
 #include <csignal>
 #include <thread>
 #include <chrono>
+#include <algorithm>
 
 #include "logger/logger.hpp"
 #include "read_config/read_yaml.hpp"
 #include "camera/v4l2_capture.hpp"
+#include "camera/capture_loop.hpp"
+#include "camera/frame_source.hpp"
+#include "event_loop/io_reactor.hpp"
 #include "network/udp_sender_thread.hpp"
+#include "network/detection_packet.hpp"
 #include "image_processor/image_processor.hpp"
+#include "image_processor/rate_controller.hpp"
+#include "image_processor/yuyv_convert.hpp"
+#include "recorder/frame_recorder.hpp"
 
 #include <opencv2/opencv.hpp>
 
 #define MODEL_PATH "../train_data/best.onnx"
+#define TOP_VIEW_STREAM_ID 0    // パケットヘッダのストリームID (上カメラ)
+#define BOTTOM_VIEW_STREAM_ID 1 // パケットヘッダのストリームID (下カメラ)
+#define CAPTURE_TIMEOUT_MS 1000 // この時間フレームが来なければ警告する
 
 volatile std::sig_atomic_t g_signal_status = 0;
+IoReactor* volatile g_reactor = nullptr;    // シグナルで止めるイベントループ
 
 void signal_handler(int signal)
 {
     g_signal_status = signal;
+
+    // 待機中のイベントループをすぐに起こす (eventfd への write なので async-signal-safe)
+    IoReactor* reactor = g_reactor;
+    if (reactor != nullptr) {
+        reactor->stop();
+    }
+}
+
+/**
+ * @brief 検出結果をメタデータパケットにして送信キューへ積む (映像より優先して送られる)
+ * @param[in]     ai            検出結果 (座標は全解像度)
+ * @param[in]     capture_index キャプチャ番号
+ * @param[in]     timestamp_us  キャプチャ時刻 [us] (映像と同じ値)
+ * @param[in,out] packet        組み立て用の再利用バッファ
+ * @param[in,out] datagram      書き込み先の再利用バッファ (送信スレッドへ渡した後は送信済みのバッファに入れ替わる)
+ * @param[in,out] sender        送信スレッド
+ */
+static void send_detections(const ImageProcessor::AiProcessedData& ai,
+                            uint32_t capture_index,
+                            uint64_t timestamp_us,
+                            DetectionPacket& packet,
+                            std::vector<uint8_t>& datagram,
+                            UDPSenderThread& sender)
+{
+    const auto to_u16 = [](int value) {
+        return static_cast<uint16_t>(std::clamp(value, 0, 65535));
+    };
+
+    packet.stream_id = TOP_VIEW_STREAM_ID;
+    packet.capture_index = capture_index;
+    packet.timestamp_us = timestamp_us;
+    packet.image_width = to_u16(static_cast<int>(ai.width));
+    packet.image_height = to_u16(static_cast<int>(ai.height));
+
+    packet.detections.clear();
+    for (const auto& r : ai.resistors) {
+        DetectionRecord record;
+        record.track_id = r.track_id;
+        record.x = to_u16(r.box.x);
+        record.y = to_u16(r.box.y);
+        record.width = to_u16(r.box.width);
+        record.height = to_u16(r.box.height);
+        record.confidence = r.confidence;
+        record.resistance_value = static_cast<float>(r.resistance_value);
+        packet.detections.push_back(record);
+    }
+
+    datagram.clear();
+    write_detection_packet(datagram, packet);
+
+    sender.enqueue_metadata(std::move(datagram));
+
+    // 送信済みのバッファを次の組み立て先に再利用する
+    datagram = sender.acquire_metadata_buffer();
+}
+
+/**
+ * @brief 推論・描画をしないカメラのフレームを JPEG にする
+ * @details MJPEG はカメラの JPEG をそのまま使い、YUYV は resize_width 以下に縮小しながら BGR にして圧縮する
+ * @param[in]     frame        カメラのフレーム
+ * @param[in]     resize_width 送信画像の最大の横幅 [px]
+ * @param[in,out] encoder      JPEG エンコーダ
+ * @param[in,out] bgr          変換用の再利用バッファ
+ * @param[out]    out          JPEG
+ * @return true 成功 / false 失敗
+ */
+static bool encode_plain_frame(const FrameSource::Frame& frame,
+                               double resize_width,
+                               JpegEncoder& encoder,
+                               cv::Mat& bgr,
+                               std::vector<uint8_t>& out)
+{
+    if (frame.fourcc == V4L2_PIX_FMT_MJPEG) {
+        out.assign(frame.data, frame.data + frame.size);
+
+        return !out.empty();
+    }
+
+    const double max_factor = (resize_width > 0.0) ? frame.width / resize_width : 1.0;
+    const uint32_t factor = yuyv_downscale_factor(frame.width, frame.height, max_factor);
+
+    if (factor >= 2) {
+        bgr.create(frame.height / factor, frame.width / factor, CV_8UC3);
+        yuyv_to_bgr_downscale(frame.data, frame.width, frame.height, factor, bgr.data, bgr.step);
+    } else {
+        cv::Mat yuyv(frame.height, frame.width, CV_8UC2, frame.data);
+        cv::cvtColor(yuyv, bgr, cv::COLOR_YUV2BGR_YUYV);
+    }
+
+    bool is_keyframe = true;
+
+    return encoder.encode(bgr, out, is_keyframe);
+}
+
+/**
+ * @brief カメラが抜けて復帰した回数・時間をログに出す
+ * @param[in] name   ログに出す名前
+ * @param[in] camera カメラ
+ */
+static void log_recovery_stats(const char* name, const V4L2Capture& camera)
+{
+    const V4L2Capture::RecoveryStats& stats = camera.recovery_stats();
+    if (stats.disconnects == 0) {
+        return;
+    }
+
+    LOG_I("%s camera: %u disconnects, %u reconnects, %u failed reopen attempts, %.1f s without frames%s",
+          name, stats.disconnects, stats.reconnects, stats.failed_reconnects, stats.downtime_ms / 1000.0,
+          camera.is_disconnected() ? " (still disconnected)" : "");
 }
 
 int main()
@@ -32,21 +153,155 @@ int main()
     std::signal(SIGINT, signal_handler);
     LOG_I("Debug GUI Streaming Start");
 
-    V4L2Capture top_view_cam(
-        config.camera.top_view_device,
-        config.camera.width,
-        config.camera.height);
+    uint32_t pixel_format = V4L2_PIX_FMT_YUYV;
+    if (!V4L2Capture::parse_pixel_format(config.camera.pixel_format, pixel_format)) {
+        LOG_W("Unknown pixel_format '%s', using yuyv", config.camera.pixel_format.c_str());
+    }
+
+    V4L2Capture::ModeRequest mode_request;
+    if (!V4L2Capture::parse_mode_policy(config.camera.mode.policy, mode_request.policy)) {
+        LOG_W("Unknown mode policy '%s', using exact", config.camera.mode.policy.c_str());
+    }
+    mode_request.min_width = config.camera.mode.min_width;
+    mode_request.min_fps = config.camera.mode.min_fps;
+
+    V4L2Capture::Controls camera_controls;
+    camera_controls.frame_rate = config.camera.controls.frame_rate;
+    camera_controls.exposure = config.camera.controls.exposure;
+    camera_controls.exposure_auto_priority = config.camera.controls.exposure_auto_priority;
+    camera_controls.gain = config.camera.controls.gain;
+    camera_controls.white_balance = config.camera.controls.white_balance;
+    camera_controls.focus = config.camera.controls.focus;
+
+    // 上カメラの代わりにファイル再生・テストパターンも使える (カメラなしでの負荷試験用)
+    std::unique_ptr<FrameSource> top_view_source;
+    V4L2Capture* top_view_cam = nullptr;
+    FileFrameSource* top_view_replay = nullptr;
+
+    FramePacer::Mode replay_pacing = FramePacer::Mode::REAL_TIME;
+    if (!FramePacer::parse_mode(config.camera.replay.pacing, replay_pacing)) {
+        LOG_W("Unknown replay pacing '%s', using realtime", config.camera.replay.pacing.c_str());
+    }
+
+    if (config.camera.source == "file") {
+        auto replay = std::make_unique<FileFrameSource>(
+            config.camera.replay.path,
+            config.camera.width,
+            config.camera.height,
+            replay_pacing,
+            config.camera.replay.fps,
+            config.camera.replay.loop);
+
+        top_view_replay = replay.get();
+        top_view_source = std::move(replay);
+    } else if (config.camera.source == "synthetic") {
+        top_view_source = std::make_unique<SyntheticFrameSource>(
+            config.camera.width,
+            config.camera.height,
+            replay_pacing,
+            config.camera.replay.fps);
+    } else {
+        if (config.camera.source != "v4l2") {
+            LOG_W("Unknown camera source '%s', using v4l2", config.camera.source.c_str());
+        }
+
+        auto camera = std::make_unique<V4L2Capture>(
+            config.camera.top_view_device,
+            config.camera.width,
+            config.camera.height,
+            pixel_format);
+        camera->set_mode_request(mode_request);
+        camera->set_controls(camera_controls);
+
+        top_view_cam = camera.get();
+        top_view_source = std::move(camera);
+    }
 
     LOG_I("Initializing Top View Camera...");
-    if (!top_view_cam.initialize()) {
+    if (!top_view_source->initialize()) {
         LOG_E("Failed to initialize Top View Camera (%s)",
-              config.camera.top_view_device.c_str());
+              top_view_source->name().c_str());
         return -1;
     }
+    if (top_view_replay != nullptr && config.camera.replay.start_frame > 0) {
+        top_view_replay->seek(config.camera.replay.start_frame);
+    }
+    if (top_view_cam != nullptr && config.camera.mode.list) {
+        top_view_cam->log_modes();
+    }
+    if (top_view_cam != nullptr && config.camera.controls.list) {
+        top_view_cam->log_controls();
+    }
+
+    const bool jpeg_over_rtp = (config.network.jpeg_payload == "rtp");
+    if (!jpeg_over_rtp && config.network.jpeg_payload != "chunked") {
+        LOG_W("Unknown jpeg_payload '%s', using chunked", config.network.jpeg_payload.c_str());
+    }
+
+    int jpeg_subsampling = TJSAMP_444;
+    if (!JpegEncoder::parse_subsampling(config.image_processor.jpeg_subsampling, jpeg_subsampling)) {
+        LOG_W("Unknown jpeg_subsampling '%s', using 444", config.image_processor.jpeg_subsampling.c_str());
+    }
+    if (jpeg_over_rtp && jpeg_subsampling == TJSAMP_444) {
+        // RFC 2435 は 4:2:2 / 4:2:0 しか運べない
+        LOG_W("RTP/JPEG needs 4:2:2 or 4:2:0, using 420");
+        jpeg_subsampling = TJSAMP_420;
+    }
+
+    std::unique_ptr<VideoEncoder> encoder = create_video_encoder(
+        config.image_processor.codec,
+        config.image_processor.jpeg_quality,
+        config.image_processor.h264.bitrate_kbps,
+        config.image_processor.h264.gop,
+        config.image_processor.h264.fps,
+        config.image_processor.roi_background_quality,
+        jpeg_subsampling);
+    const VideoEncoder::Codec encoder_codec = encoder->codec();
+
+    const UDPSenderThread::PayloadFormat payload_format =
+        (encoder_codec == VideoEncoder::Codec::H264) ? UDPSenderThread::PayloadFormat::RTP_H264
+        : jpeg_over_rtp                              ? UDPSenderThread::PayloadFormat::RTP_JPEG
+                                                     : UDPSenderThread::PayloadFormat::CHUNKED;
+
+    UDPSender::Config sender_config;
+    sender_config.max_payload_size = config.network.max_payload_size;
+    sender_config.batch_size = config.network.batch_size;
+    sender_config.max_rate_mbps = config.network.max_rate_mbps;
+    sender_config.burst_bytes = config.network.burst_bytes;
+    sender_config.kernel_pacing = config.network.kernel_pacing;
+    sender_config.zerocopy = config.network.zerocopy;
+    sender_config.stream_id = TOP_VIEW_STREAM_ID;
+    sender_config.fec_group_size = config.network.fec_group_size;
+    sender_config.retransmit_cache_frames = config.network.retransmit_cache_frames;
+    sender_config.retransmit_deadline_ms = config.network.retransmit_deadline_ms;
+    sender_config.extra_destinations = config.network.extra_dest_ips;
+    sender_config.multicast_ttl = config.network.multicast_ttl;
+    sender_config.multicast_loopback = config.network.multicast_loopback;
+    sender_config.multicast_interface = config.network.multicast_interface;
+    sender_config.rtcp = config.network.rtcp;
+    sender_config.rtcp_port = config.network.rtcp_port;
+    if (!UDPSender::parse_send_mode(config.network.send_mode, sender_config.send_mode)) {
+        LOG_W("Unknown send_mode '%s', using sendmmsg", config.network.send_mode.c_str());
+        sender_config.send_mode = UDPSender::SendMode::SENDMMSG;
+    }
+    if (!SendScheduler::parse_policy(config.network.send_queue_policy, sender_config.queue_policy)) {
+        LOG_W("Unknown send_queue_policy '%s', using latest", config.network.send_queue_policy.c_str());
+        sender_config.queue_policy = SendScheduler::QueuePolicy::LATEST;
+    }
+    if (encoder_codec == VideoEncoder::Codec::H264
+        && sender_config.queue_policy == SendScheduler::QueuePolicy::LATEST) {
+        // 差分フレームを黙って捨てると、次の IDR まで受信側の映像が崩れる
+        LOG_W("send_queue_policy latest drops H.264 delta frames, using keyframe");
+        sender_config.queue_policy = SendScheduler::QueuePolicy::KEYFRAME;
+    }
+    sender_config.queue_depth = config.network.send_queue_depth;
+    sender_config.send_slice_chunks = config.network.send_slice_chunks;
 
     UDPSenderThread top_view_sender(
         config.network.dest_ip,
-        config.network.top_view_port);
+        config.network.top_view_port,
+        payload_format,
+        sender_config);
 
     top_view_sender.start();
 
@@ -57,6 +312,37 @@ int main()
         MODEL_PATH,
         config.image_processor.jpeg_quality,
         config.image_processor.resize_width);
+
+    processor.set_encoder(std::move(encoder));
+    processor.set_draw_overlay(config.image_processor.draw_overlay);
+
+    // メタデータは映像と同じポートへ送り、受信側がマジックで見分ける (RTP の受信側は解釈できない)
+    const bool send_metadata = config.network.detection_metadata
+                            && payload_format == UDPSenderThread::PayloadFormat::CHUNKED;
+    if (config.network.detection_metadata && !send_metadata) {
+        LOG_W("detection_metadata needs jpeg_payload chunked, disabled");
+    }
+    if (!config.image_processor.draw_overlay && !send_metadata) {
+        LOG_W("draw_overlay is off and detection_metadata is not sent: detections will not reach the receiver");
+    }
+    DetectionPacket detection_packet;
+    std::vector<uint8_t> detection_datagram;
+
+    // JPEG送信時のみ品質・解像度の閉ループ制御を行う (H.264はエンコーダ内でレート制御する)
+    // RTP/JPEG 送信時は RTCP 受信者レポートのロス率も輻輳判定に使う
+    RateController::Config rc_config;
+    rc_config.target_bitrate_kbps = config.rate_control.target_bitrate_kbps;
+    rc_config.target_fps = config.rate_control.target_fps;
+    rc_config.min_quality = config.rate_control.min_quality;
+    rc_config.max_quality = config.rate_control.max_quality;
+    rc_config.min_scale = config.rate_control.min_scale;
+
+    RateController rate_controller(rc_config, config.image_processor.jpeg_quality);
+    const bool use_rate_control = config.rate_control.enabled
+                                && encoder_codec == VideoEncoder::Codec::JPEG;
+    uint64_t last_dropped_packets = 0;
+    uint64_t last_rtcp_reports = 0;
+    uint64_t last_keyframe_requests = 0;
     
     ImageProcessor::GuiProcessedData gui;
     ImageProcessor::AiProcessedData ai;
@@ -64,43 +350,181 @@ int main()
     uint64_t frame_count = 0;
     const int INFERENCE_INTERVAL = 4;   //4回に一回推論
 
-    LOG_I("Streaming Loop Start");
+    IoReactor::Backend loop_backend = IoReactor::Backend::IO_URING;
+    if (!IoReactor::parse_backend(config.camera.event_loop, loop_backend)) {
+        LOG_W("Unknown event_loop '%s', using io_uring", config.camera.event_loop.c_str());
+    }
+
+    IoReactor reactor(loop_backend);
+    if (!reactor.is_valid()) {
+        LOG_E("Failed to initialize event loop");
+        top_view_sender.stop();
+        return -1;
+    }
+
+    // 上下のカメラを1つのイベントループで待ち、届いた方から1フレームずつ処理する
+    CaptureLoop capture_loop(reactor, CAPTURE_TIMEOUT_MS);
+
+    CaptureLoop::RecoveryPolicy recovery_policy;
+    recovery_policy.initial_backoff_ms = config.camera.recovery.initial_backoff_ms;
+    recovery_policy.max_backoff_ms = config.camera.recovery.max_backoff_ms;
+    capture_loop.set_recovery_policy(recovery_policy);
 
-    while (g_signal_status == 0) {
-        //auto loop_start = std::chrono::steady_clock::now();
+    // 見逃しを後で再現できるよう、処理する前のフレームをそのまま記録する (ディスクは記録スレッドが待つ)
+    std::unique_ptr<FrameRecorder> recorder;
+    if (config.recorder.enabled) {
+        recorder = std::make_unique<FrameRecorder>(
+            config.recorder.directory,
+            config.recorder.segment_size_mb,
+            config.recorder.queue_frames);
 
+        if (!recorder->start()) {
+            LOG_E("Failed to start recording, streaming without it");
+            recorder.reset();
+        }
+    }
+
+    capture_loop.add_camera("top view", *top_view_source, [&](FrameSource::Frame& frame) {
+        frame_count += 1;
+
+        if (recorder) {
+            recorder->record(frame);
+        }
+
+        bool is_run_ai = (frame_count % INFERENCE_INTERVAL) ? false : true;
+
+        const bool processed = (frame.fourcc == V4L2_PIX_FMT_MJPEG)
+            ? processor.process_mjpeg_frame(frame.data, frame.size, frame.width, frame.height,
+                                            gui, ai, is_run_ai)
+            : processor.process_frame(frame.data, frame.width, frame.height,
+                                      gui, ai, is_run_ai);
+
+        if (processed)
         {
-            V4L2Capture::Frame frame;
-
-            if (top_view_cam.get_once_frame(frame)) {
-                frame_count += 1;
-
-                bool is_run_ai = (frame_count % INFERENCE_INTERVAL) ? false : true;
-
-                if (processor.process_frame(
-                        frame.data,
-                        frame.width,
-                        frame.height,
-                        gui,
-                        ai,
-                        is_run_ai))
-                {
-                    if (gui.is_jpeg && !gui.image.empty()) {
-                        top_view_sender.enqueue(
-                            std::move(gui.image));
-                    }
+            if (use_rate_control) {
+                const UDPSenderThread::Stats stats = top_view_sender.get_stats();
+
+                RateController::Feedback feedback;
+                feedback.encoded_bytes = gui.image.size();
+                feedback.send_time_us = stats.last_send_time_us;
+                feedback.dropped_packets = stats.dropped_packets - last_dropped_packets;
+                last_dropped_packets = stats.dropped_packets;
+
+                // 受信者レポートは1秒毎なので、新しく届いた時だけロス率を使う
+                if (stats.rtcp_reports != last_rtcp_reports) {
+                    feedback.loss_fraction = stats.loss_fraction;
+                    last_rtcp_reports = stats.rtcp_reports;
                 }
-            } else {
-                LOG_W("Failed to capture frame from Top Camera");
+
+                rate_controller.update(feedback);
+
+                processor.set_jpeg_quality(rate_controller.quality());
+                processor.set_output_scale(rate_controller.scale());
             }
 
-            top_view_cam.release_frame(frame);
+            if (send_metadata) {
+                send_detections(ai, static_cast<uint32_t>(frame_count), frame.timestamp_us,
+                                detection_packet, detection_datagram, top_view_sender);
+            }
+
+            if ((gui.is_jpeg || gui.is_h264) && !gui.image.empty()) {
+                top_view_sender.enqueue(
+                    std::move(gui.image),
+                    frame.timestamp_us,
+                    gui.is_keyframe);
+
+                // 送信側が差分フレームを捨てたら、次をキーフレームにして復帰させる
+                const uint64_t keyframe_requests = top_view_sender.get_stats().keyframe_requests;
+                if (keyframe_requests != last_keyframe_requests) {
+                    processor.request_keyframe();
+                    last_keyframe_requests = keyframe_requests;
+                }
+
+                // 送信済みのバッファを次のエンコード先に再利用する
+                gui.image = top_view_sender.acquire_buffer();
+            }
         }
+    });
+
+    // 下カメラは推論せず、そのまま JPEG にして送る
+    std::unique_ptr<V4L2Capture> bottom_view_cam;
+    std::unique_ptr<UDPSenderThread> bottom_view_sender;
+    JpegEncoder bottom_view_encoder(config.image_processor.jpeg_quality, 0, jpeg_subsampling);
+    cv::Mat bottom_view_bgr;
+    std::vector<uint8_t> bottom_view_image;
+
+    if (config.camera.bottom_view_enabled) {
+        bottom_view_cam = std::make_unique<V4L2Capture>(
+            config.camera.bottom_view_device,
+            config.camera.width,
+            config.camera.height,
+            pixel_format);
+        bottom_view_cam->set_mode_request(mode_request);
+        bottom_view_cam->set_controls(camera_controls);
+
+        LOG_I("Initializing Bottom View Camera...");
+        if (!bottom_view_cam->initialize()) {
+            // 上カメラだけでも動かし続ける
+            LOG_E("Failed to initialize Bottom View Camera (%s), streaming top view only",
+                  config.camera.bottom_view_device.c_str());
+            bottom_view_cam.reset();
+        } else {
+            if (config.camera.mode.list) {
+                bottom_view_cam->log_modes();
+            }
+            if (config.camera.controls.list) {
+                bottom_view_cam->log_controls();
+            }
+        }
+    }
+
+    if (bottom_view_cam) {
+        UDPSender::Config bottom_config = sender_config;
+        bottom_config.stream_id = BOTTOM_VIEW_STREAM_ID;
+        bottom_config.queue_policy = SendScheduler::QueuePolicy::LATEST;
 
-        //std::this_thread::sleep_until(loop_start + std::chrono::milliseconds(250));
+        bottom_view_sender = std::make_unique<UDPSenderThread>(
+            config.network.dest_ip,
+            config.network.bottom_view_port,
+            jpeg_over_rtp ? UDPSenderThread::PayloadFormat::RTP_JPEG : UDPSenderThread::PayloadFormat::CHUNKED,
+            bottom_config);
+
+        bottom_view_sender->start();
+
+        capture_loop.add_camera("bottom view", *bottom_view_cam, [&](FrameSource::Frame& frame) {
+            if (encode_plain_frame(frame, config.image_processor.resize_width, bottom_view_encoder,
+                                   bottom_view_bgr, bottom_view_image)) {
+                bottom_view_sender->enqueue(std::move(bottom_view_image), frame.timestamp_us, true);
+                bottom_view_image = bottom_view_sender->acquire_buffer();
+            }
+        });
     }
 
+    g_reactor = &reactor;
+    if (g_signal_status != 0) {
+        reactor.stop();
+    }
+
+    LOG_I("Streaming Loop Start");
+
+    reactor.run();
+
+    g_reactor = nullptr;
+
+    if (top_view_cam != nullptr) {
+        log_recovery_stats("top view", *top_view_cam);
+    }
+    if (bottom_view_cam) {
+        log_recovery_stats("bottom view", *bottom_view_cam);
+        capture_loop.remove_camera(*bottom_view_cam);
+    }
+    if (bottom_view_sender) {
+        bottom_view_sender->stop();
+    }
     top_view_sender.stop();
+    if (recorder) {
+        recorder->stop();
+    }
 
     LOG_I("Debug GUI Streaming Stop");
 
@@ -0,0 +1,573 @@
+/**
+ * @file    webcam_receiver.cpp
+ * @brief   分割送信された JPEG ストリーム (独自形式 v1) の受信・表示プログラム
+ * @details
+ * 受信スレッドが recvmmsg でデータグラムをまとめて受け取り、FrameAssembler で
+ * フレームを再構成する (FEC 復元・再送要求を含む)。完成したフレームは最新1枚だけを
+ * デコードスレッドへ渡し、TurboJPEG で BGR に展開する。
+ * メインスレッドは表示 (--null なら表示しない) と、受信 fps・ロス・遅延の定期表示を行う。
+ * 同じポートに届く検出結果メタデータ ("WD") はキャプチャ時刻で画像と突き合わせ、枠と抵抗値を描画する。
+ *
+ * 遅延はフレームのキャプチャ時刻 (送信側の CLOCK_MONOTONIC) からデコード完了までで、
+ * 送信側と同じホストで動かした時だけ意味を持つ。
+ * --loss で受信したデータグラムをわざと捨てると、送信側の FEC・再送経路の負荷試験になる。
+ *
+ * 使い方: webcam_receiver [--port N] [--bind IP] [--group ADDR] [--null] [--no-nack]
+ *                         [--loss RATE] [--duration SEC]
+ * @author  sawada souta
+ * @date    2026-10-17
+ */
+
+#include <time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <csignal>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <turbojpeg.h>
+#include <opencv2/opencv.hpp>
+
+#include "logger/logger.hpp"
+#include "network/detection_packet.hpp"
+#include "network/frame_assembler.hpp"
+#include "network/udp_receiver.hpp"
+
+#define DEFAULT_PORT 50000              /**< 既定の受信ポート (config.yaml の top_view_port) */
+#define NACK_CHECK_INTERVAL_MS 5        /**< 欠落を調べて再送を要求する間隔 [ms] */
+#define REPORT_INTERVAL_MS 1000         /**< 統計を表示する間隔 [ms] */
+#define DISPLAY_INTERVAL_MS 33          /**< 表示を更新する間隔 [ms] */
+#define MAX_VALID_LATENCY_US 10000000   /**< これを超える遅延は時計が違う (別ホスト) とみなす [us] */
+#define MAX_KEPT_DETECTIONS 16          /**< 画像との突き合わせ用に残す検出結果パケット数 */
+#define MAX_UDP_DATAGRAM_SIZE 65535     /**< --max-datagram の上限 [byte] */
+#define WINDOW_NAME "Video Stream"
+
+volatile std::sig_atomic_t g_signal_status = 0;
+
+void signal_handler(int signal)
+{
+    g_signal_status = signal;
+}
+
+/**
+ * @brief コマンドライン引数
+ */
+struct Options {
+    uint16_t port = DEFAULT_PORT;
+    std::string bind_ip = "0.0.0.0";
+    std::string multicast_group;
+    size_t max_datagram_size = UDPReceiver::Config().max_datagram_size;  /**< 受信できるデータグラムの最大長 [byte] */
+    bool display = true;        /**< false = デコードまでで表示しない (ヌルシンク) */
+    bool nack = true;           /**< 欠けたチャンクの再送を要求する */
+    double loss_rate = 0.0;     /**< 受信したデータグラムをわざと捨てる割合 */
+    int duration_s = 0;         /**< この時間 [s] で終了する (0 = 無制限) */
+};
+
+/**
+ * @brief 受信スレッドの統計 (統計表示用の写し)
+ */
+struct ReceiveStats {
+    FrameAssembler::Stats assembler;
+    uint64_t datagrams = 0;         /**< 受信したデータグラム数 */
+    uint64_t bytes = 0;             /**< 受信したバイト数 */
+    uint64_t receive_calls = 0;     /**< recvmmsg の呼び出し回数 */
+    uint64_t dropped_by_option = 0; /**< --loss で捨てたデータグラム数 */
+    uint64_t nacks_sent = 0;        /**< 送った再送要求の数 */
+    uint64_t detection_packets = 0; /**< 受信した検出結果メタデータの数 */
+    uint32_t kernel_drops = 0;      /**< 受信ソケットの溢れ */
+    uint64_t truncated = 0;         /**< 受信バッファより長く切り詰めたデータグラム数 */
+};
+
+/**
+ * @brief 前回の統計表示時点の累計値
+ */
+struct ReportState {
+    ReceiveStats receive;
+    uint64_t decoded_frames = 0;
+    uint64_t decode_errors = 0;
+    uint64_t overwritten_frames = 0;
+};
+
+/**
+ * @brief 受信スレッドとデコードスレッドの共有状態
+ */
+struct Shared {
+    std::atomic<bool> running{true};
+
+    // 受信 → デコード (最新1枚)
+    std::mutex frame_mutex;
+    std::condition_variable frame_cond;
+    FrameAssembler::Frame frame;
+    bool has_frame = false;
+    uint64_t overwritten_frames = 0;    /**< デコードが間に合わず上書きしたフレーム数 */
+
+    // 受信スレッドの統計
+    std::mutex stats_mutex;
+    ReceiveStats receive_stats;
+
+    // デコード → 表示 (最新1枚) と遅延
+    std::mutex decoded_mutex;
+    std::vector<uint8_t> decoded;
+    int decoded_width = 0;
+    int decoded_height = 0;
+    uint64_t decoded_timestamp_us = 0;
+    bool has_decoded = false;
+    std::vector<int64_t> latencies_us;
+    uint64_t decoded_frames = 0;
+    uint64_t decode_errors = 0;
+
+    // 受信 → 表示 (検出結果メタデータ、古い順)
+    std::mutex detection_mutex;
+    std::deque<DetectionPacket> detections;
+};
+
+/**
+ * @brief キャプチャ時刻と同じ時計 (CLOCK_MONOTONIC) の現在時刻 [us]
+ */
+static uint64_t monotonic_now_us()
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+
+    return static_cast<uint64_t>(ts.tv_sec) * 1000000ULL + static_cast<uint64_t>(ts.tv_nsec) / 1000;
+}
+
+/**
+ * @brief 受信スレッド: データグラムの受信・フレーム再構成・再送要求
+ */
+static void receive_loop(const Options& options, Shared& shared)
+{
+    UDPReceiver::Config receiver_config;
+    receiver_config.multicast_group = options.multicast_group;
+    receiver_config.poll_timeout_ms = NACK_CHECK_INTERVAL_MS;
+    receiver_config.max_datagram_size = options.max_datagram_size;
+
+    UDPReceiver receiver(options.bind_ip, options.port, receiver_config);
+    if (!receiver.is_valid()) {
+        shared.running = false;
+        g_signal_status = SIGTERM;
+
+        return;
+    }
+
+    FrameAssembler assembler(FrameAssembler::Config{});
+    FrameAssembler::Frame frame;
+    std::vector<FrameNack> nacks;
+    std::vector<uint8_t> nack_buffer(FRAME_NACK_HEADER_SIZE + 2 * FRAME_NACK_MAX_CHUNKS);
+
+    std::mt19937 random(std::random_device{}());
+    std::uniform_real_distribution<double> uniform(0.0, 1.0);
+
+    ReceiveStats stats;
+    DetectionPacket detection;
+    struct sockaddr_in sender_addr;
+    bool has_sender = false;
+    auto next_nack_check = std::chrono::steady_clock::now();
+
+    while (shared.running) {
+        const int received = receiver.receive();
+        if (received < 0) {
+            break;
+        }
+
+        for (int i = 0; i < received; ++i) {
+            stats.datagrams += 1;
+            stats.bytes += receiver.length(i);
+
+            // 再送要求は送信ソケット (フレームの送信元) へ返す
+            sender_addr = receiver.source(i);
+            has_sender = true;
+
+            if (options.loss_rate > 0.0 && uniform(random) < options.loss_rate) {
+                stats.dropped_by_option += 1;
+                continue;
+            }
+
+            if (read_detection_packet(receiver.data(i), receiver.length(i), detection)) {
+                stats.detection_packets += 1;
+
+                if (options.display) {
+                    std::lock_guard<std::mutex> lock(shared.detection_mutex);
+                    if (shared.detections.size() >= MAX_KEPT_DETECTIONS) {
+                        shared.detections.pop_front();
+                    }
+                    shared.detections.push_back(detection);
+                }
+                continue;
+            }
+
+            if (!assembler.push(receiver.data(i), receiver.length(i), frame)) {
+                continue;
+            }
+
+            // デコード待ちのフレームと入れ替えて、バッファを使い回す
+            {
+                std::lock_guard<std::mutex> lock(shared.frame_mutex);
+                if (shared.has_frame) {
+                    shared.overwritten_frames += 1;
+                }
+                std::swap(shared.frame, frame);
+                shared.has_frame = true;
+            }
+            shared.frame_cond.notify_one();
+        }
+
+        const auto now = std::chrono::steady_clock::now();
+        if (now >= next_nack_check) {
+            const size_t count = assembler.collect_nacks(nacks);
+
+            if (options.nack && has_sender) {
+                for (size_t i = 0; i < count; ++i) {
+                    const size_t length = write_frame_nack(nack_buffer.data(), nacks[i]);
+
+                    if (receiver.send_to(nack_buffer.data(), length, sender_addr)) {
+                        stats.nacks_sent += 1;
+                    }
+                }
+            }
+
+            next_nack_check = now + std::chrono::milliseconds(NACK_CHECK_INTERVAL_MS);
+        }
+
+        stats.assembler = assembler.stats();
+        stats.receive_calls = receiver.receive_calls();
+        stats.kernel_drops = receiver.kernel_drops();
+        stats.truncated = receiver.truncated_datagrams();
+
+        std::lock_guard<std::mutex> lock(shared.stats_mutex);
+        shared.receive_stats = stats;
+    }
+
+    shared.running = false;
+    shared.frame_cond.notify_all();
+}
+
+/**
+ * @brief デコードスレッド: 最新のフレームを TurboJPEG で BGR に展開する
+ */
+static void decode_loop(const Options& options, Shared& shared)
+{
+    tjhandle tj_instance = tjInitDecompress();
+    if (tj_instance == nullptr) {
+        LOG_E("Failed to initialize TurboJPEG decompressor");
+        shared.running = false;
+
+        return;
+    }
+
+    FrameAssembler::Frame frame;
+    std::vector<uint8_t> bgr;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(shared.frame_mutex);
+            shared.frame_cond.wait(lock, [&shared] { return shared.has_frame || !shared.running; });
+
+            if (!shared.has_frame) {
+                break;
+            }
+
+            std::swap(shared.frame, frame);
+            shared.has_frame = false;
+        }
+
+        int width = 0;
+        int height = 0;
+        int subsampling = 0;
+        int colorspace = 0;
+
+        const unsigned long size = static_cast<unsigned long>(frame.data.size());
+        bool ok = tjDecompressHeader3(tj_instance, frame.data.data(), size,
+                                      &width, &height, &subsampling, &colorspace) == 0;
+        if (ok) {
+            bgr.resize(static_cast<size_t>(width) * height * 3);
+            ok = tjDecompress2(tj_instance, frame.data.data(), size, bgr.data(),
+                               width, 0, height, TJPF_BGR, TJFLAG_FASTDCT) == 0;
+        }
+
+        const int64_t latency_us = static_cast<int64_t>(monotonic_now_us() - frame.timestamp_us);
+
+        std::lock_guard<std::mutex> lock(shared.decoded_mutex);
+        if (!ok) {
+            shared.decode_errors += 1;
+            continue;
+        }
+
+        shared.decoded_frames += 1;
+        shared.latencies_us.push_back(latency_us);
+
+        if (options.display) {
+            std::swap(shared.decoded, bgr);
+            shared.decoded_width = width;
+            shared.decoded_height = height;
+            shared.decoded_timestamp_us = frame.timestamp_us;
+            shared.has_decoded = true;
+        }
+    }
+
+    tjDestroy(tj_instance);
+}
+
+/**
+ * @brief 画像と同じキャプチャ時刻 (無ければ直前) の検出結果を探す
+ * @return true 見つかった / false 該当なし
+ */
+static bool find_detections(Shared& shared, uint64_t timestamp_us, DetectionPacket& packet)
+{
+    std::lock_guard<std::mutex> lock(shared.detection_mutex);
+
+    for (auto it = shared.detections.rbegin(); it != shared.detections.rend(); ++it) {
+        if (it->timestamp_us <= timestamp_us) {
+            packet = *it;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief 検出結果の枠・トラックID・抵抗値を画像に描画する (座標は送信側の画像サイズから換算)
+ */
+static void draw_detections(cv::Mat& image, const DetectionPacket& packet)
+{
+    if (packet.image_width == 0 || packet.image_height == 0) {
+        return;
+    }
+
+    const double sx = static_cast<double>(image.cols) / packet.image_width;
+    const double sy = static_cast<double>(image.rows) / packet.image_height;
+    const cv::Scalar COLOR_GREEN(0, 255, 0);
+    const cv::Scalar COLOR_BLACK(0, 0, 0);
+
+    for (const DetectionRecord& d : packet.detections) {
+        const cv::Rect box(static_cast<int>(d.x * sx), static_cast<int>(d.y * sy),
+                           static_cast<int>(d.width * sx), static_cast<int>(d.height * sy));
+
+        cv::rectangle(image, box, COLOR_GREEN, 2);
+
+        char label[64];
+        if (d.resistance_value > 0.0f) {
+            std::snprintf(label, sizeof(label), "#%u %.0f ohm (%.2f)", d.track_id, d.resistance_value, d.confidence);
+        } else {
+            std::snprintf(label, sizeof(label), "#%u (%.2f)", d.track_id, d.confidence);
+        }
+
+        int base_line = 0;
+        const cv::Size label_size = cv::getTextSize(label, cv::FONT_HERSHEY_SIMPLEX, 0.5, 1, &base_line);
+
+        cv::rectangle(image, cv::Rect(cv::Point(box.x, box.y - label_size.height),
+                                      cv::Size(label_size.width, label_size.height + base_line)),
+                      COLOR_GREEN, cv::FILLED);
+        cv::putText(image, label, cv::Point(box.x, box.y), cv::FONT_HERSHEY_SIMPLEX, 0.5, COLOR_BLACK, 1);
+    }
+}
+
+/**
+ * @brief 前回からの差分で統計を1行表示する
+ */
+static void report(Shared& shared, ReportState& last, double interval_s, std::vector<int64_t>& latencies)
+{
+    ReceiveStats now;
+    {
+        std::lock_guard<std::mutex> lock(shared.stats_mutex);
+        now = shared.receive_stats;
+    }
+
+    uint64_t decoded;
+    uint64_t decode_errors;
+    latencies.clear();
+    {
+        std::lock_guard<std::mutex> lock(shared.decoded_mutex);
+        decoded = shared.decoded_frames;
+        decode_errors = shared.decode_errors;
+        std::swap(latencies, shared.latencies_us);
+    }
+
+    uint64_t overwritten;
+    {
+        std::lock_guard<std::mutex> lock(shared.frame_mutex);
+        overwritten = shared.overwritten_frames;
+    }
+
+    const FrameAssembler::Stats& a = now.assembler;
+    const ReceiveStats& last_receive = last.receive;
+    const FrameAssembler::Stats& b = last_receive.assembler;
+
+    const uint64_t completed = a.completed_frames - b.completed_frames;
+    const uint64_t lost = a.lost_frames - b.lost_frames;
+    const uint64_t datagrams = now.datagrams - last_receive.datagrams;
+    const uint64_t calls = now.receive_calls - last_receive.receive_calls;
+
+    char latency_text[64] = "n/a";
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+
+        const int64_t p50 = latencies[latencies.size() / 2];
+        const int64_t p99 = latencies[std::min(latencies.size() - 1, latencies.size() * 99 / 100)];
+
+        if (p50 >= 0 && p99 < MAX_VALID_LATENCY_US) {
+            std::snprintf(latency_text, sizeof(latency_text), "p50 %.1f ms p99 %.1f ms", p50 / 1000.0, p99 / 1000.0);
+        } else {
+            std::snprintf(latency_text, sizeof(latency_text), "n/a (sender on another host)");
+        }
+    }
+
+    LOG_I("recv %.1f fps  decode %.1f fps  %.1f Mbps  %.1f dgrams/call  "
+          "frame loss %.2f%%  fec %llu  nack %llu  meta %llu  kernel drops %u  truncated %llu  decode skipped %llu  errors %llu  latency %s",
+          completed / interval_s,
+          (decoded - last.decoded_frames) / interval_s,
+          (now.bytes - last_receive.bytes) * 8.0 / interval_s / 1e6,
+          calls ? static_cast<double>(datagrams) / calls : 0.0,
+          (completed + lost) ? 100.0 * lost / (completed + lost) : 0.0,
+          static_cast<unsigned long long>(a.recovered_chunks - b.recovered_chunks),
+          static_cast<unsigned long long>(now.nacks_sent - last_receive.nacks_sent),
+          static_cast<unsigned long long>(now.detection_packets - last_receive.detection_packets),
+          now.kernel_drops - last_receive.kernel_drops,
+          static_cast<unsigned long long>(now.truncated - last_receive.truncated),
+          static_cast<unsigned long long>(overwritten - last.overwritten_frames),
+          static_cast<unsigned long long>(decode_errors - last.decode_errors),
+          latency_text);
+
+    last.receive = now;
+    last.decoded_frames = decoded;
+    last.decode_errors = decode_errors;
+    last.overwritten_frames = overwritten;
+}
+
+/**
+ * @brief コマンドライン引数を読む
+ * @return true 成功 / false 不正な引数
+ */
+static bool parse_options(int argc, char** argv, Options& options)
+{
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+
+        if (arg == "--port" && has_value) {
+            options.port = static_cast<uint16_t>(std::atoi(argv[++i]));
+        } else if (arg == "--bind" && has_value) {
+            options.bind_ip = argv[++i];
+        } else if (arg == "--group" && has_value) {
+            options.multicast_group = argv[++i];
+        } else if (arg == "--max-datagram" && has_value) {
+            const int size = std::atoi(argv[++i]);
+            if (size <= 0 || size > MAX_UDP_DATAGRAM_SIZE) {
+                return false;
+            }
+            options.max_datagram_size = static_cast<size_t>(size);
+        } else if (arg == "--null") {
+            options.display = false;
+        } else if (arg == "--no-nack") {
+            options.nack = false;
+        } else if (arg == "--loss" && has_value) {
+            options.loss_rate = std::atof(argv[++i]);
+        } else if (arg == "--duration" && has_value) {
+            options.duration_s = std::atoi(argv[++i]);
+        } else {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    if (!parse_options(argc, argv, options)) {
+        std::fprintf(stderr,
+                     "usage: %s [--port N] [--bind IP] [--group ADDR] [--max-datagram BYTES] [--null] [--no-nack]"
+                     " [--loss RATE] [--duration SEC]\n", argv[0]);
+        return 1;
+    }
+
+    std::signal(SIGINT, signal_handler);
+    std::signal(SIGTERM, signal_handler);
+
+    Shared shared;
+
+    std::thread receive_thread(receive_loop, std::cref(options), std::ref(shared));
+    std::thread decode_thread(decode_loop, std::cref(options), std::ref(shared));
+
+    const auto start = std::chrono::steady_clock::now();
+    auto last_report = start;
+    ReportState last;
+    std::vector<int64_t> latencies;
+    std::vector<uint8_t> image;
+    DetectionPacket detection;
+
+    while (g_signal_status == 0 && shared.running) {
+        const auto now = std::chrono::steady_clock::now();
+
+        if (options.duration_s > 0 && now - start >= std::chrono::seconds(options.duration_s)) {
+            break;
+        }
+
+        if (now - last_report >= std::chrono::milliseconds(REPORT_INTERVAL_MS)) {
+            const double interval_s = std::chrono::duration<double>(now - last_report).count();
+
+            report(shared, last, interval_s, latencies);
+            last_report = now;
+        }
+
+        if (!options.display) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(DISPLAY_INTERVAL_MS));
+            continue;
+        }
+
+        int width = 0;
+        int height = 0;
+        uint64_t timestamp_us = 0;
+        {
+            std::lock_guard<std::mutex> lock(shared.decoded_mutex);
+            if (shared.has_decoded) {
+                std::swap(image, shared.decoded);
+                width = shared.decoded_width;
+                height = shared.decoded_height;
+                timestamp_us = shared.decoded_timestamp_us;
+                shared.has_decoded = false;
+            }
+        }
+
+        if (width > 0) {
+            cv::Mat view(height, width, CV_8UC3, image.data());
+
+            if (find_detections(shared, timestamp_us, detection)) {
+                draw_detections(view, detection);
+            }
+
+            cv::imshow(WINDOW_NAME, view);
+        }
+
+        // 'q'キーで終了
+        if ((cv::waitKey(DISPLAY_INTERVAL_MS) & 0xFF) == 'q') {
+            break;
+        }
+    }
+
+    shared.running = false;
+    shared.frame_cond.notify_all();
+
+    receive_thread.join();
+    decode_thread.join();
+
+    if (options.display) {
+        cv::destroyAllWindows();
+    }
+
+    LOG_I("Receiver stopped");
+
+    return 0;
+}